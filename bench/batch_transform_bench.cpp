@@ -0,0 +1,93 @@
+// world, MVP and normal matrices per second: chained GLM calls against the batch kernels
+#include "../headers/batch_transform.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+const uint32_t OBJECT_COUNT = 10000;
+const unsigned int ITERATIONS = 200;
+
+template <typename Func>
+double run(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count() / ITERATIONS;
+}
+
+void report(const char* name, double seconds, double baseline) {
+    std::printf("%-22s %10.3f ms %12.1f Mobjects/s %8.2fx\n", name, seconds * 1e3, OBJECT_COUNT / seconds * 1e-6, baseline / seconds);
+}
+
+// largest difference of any element, to check the kernels agree with GLM
+float maxDifference(const float* a, const float* b, size_t count) {
+    float result = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        result = std::max(result, std::fabs(a[i] - b[i]));
+    }
+    return result;
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+
+    std::vector<glm::vec3> positions(OBJECT_COUNT), scales(OBJECT_COUNT);
+    std::vector<glm::quat> rotations(OBJECT_COUNT);
+    TransformArrays transforms;
+    transforms.resize(OBJECT_COUNT);
+    for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+        positions[i] = glm::vec3(position(rng), position(rng), position(rng));
+        rotations[i] = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+        scales[i] = glm::vec3(scale(rng), scale(rng), scale(rng));
+        transforms.set(i, positions[i], rotations[i], scales[i]);
+    }
+
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+        * glm::lookAt(glm::vec3(0.0f, 10.0f, 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::vector<glm::mat4> world(OBJECT_COUNT), mvp(OBJECT_COUNT);
+    std::vector<glm::mat3> normal(OBJECT_COUNT);
+    std::vector<glm::mat4> referenceWorld(OBJECT_COUNT), referenceMvp(OBJECT_COUNT);
+    std::vector<glm::mat3> referenceNormal(OBJECT_COUNT);
+
+    std::printf("objects: %u, detected: %s\n", OBJECT_COUNT, simdLevelName(activeSimdLevel()));
+
+    // what a per-object update usually looks like: translate * rotate * scale as three 4x4 multiplies,
+    // and the normal matrix as a full inverse
+    double chained = run([&]() {
+        for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]) * glm::scale(glm::mat4(1.0f), scales[i]);
+            referenceWorld[i] = model;
+            referenceMvp[i] = viewProjection * model;
+            referenceNormal[i] = glm::mat3(glm::transpose(glm::inverse(model)));
+        }
+    });
+    report("glm chained", chained, chained);
+
+    for (int level = SIMD_SCALAR; level <= activeSimdLevel(); level++) {
+        double seconds = run([&]() {
+            batchTransform(transforms, 0, OBJECT_COUNT, viewProjection, world.data(), mvp.data(), normal.data(), (simdLevel)level);
+        });
+        char name[32];
+        std::snprintf(name, sizeof(name), "batch %s", simdLevelName((simdLevel)level));
+        report(name, seconds, chained);
+
+        float worldError = maxDifference(&world[0][0][0], &referenceWorld[0][0][0], OBJECT_COUNT * 16);
+        float mvpError = maxDifference(&mvp[0][0][0], &referenceMvp[0][0][0], OBJECT_COUNT * 16);
+        float normalError = maxDifference(&normal[0][0][0], &referenceNormal[0][0][0], OBJECT_COUNT * 9);
+        std::printf("%-22s max error world %.2e, mvp %.2e, normal %.2e\n", "", worldError, mvpError, normalError);
+    }
+
+    return 0;
+}
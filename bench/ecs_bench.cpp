@@ -0,0 +1,127 @@
+// iteration throughput of the entity registry for 1M entities
+#include "../headers/ecs.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+const uint32_t ENTITY_COUNT = 1000000;
+const unsigned int ITERATIONS = 20;
+
+struct Position {
+    glm::vec3 Value;
+};
+
+struct Velocity {
+    glm::vec3 Value;
+};
+
+struct Health {
+    float Value;
+};
+
+// the same data as one struct per object, for comparison with the usual array-of-objects layout
+struct GameObject {
+    glm::vec3 Position;
+    glm::vec3 Velocity;
+    float Health;
+    glm::mat4 Cached;
+    bool Active;
+};
+
+template <typename Func>
+double run(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count() / ITERATIONS;
+}
+
+void report(const char* name, double seconds) {
+    std::printf("%-28s %10.3f ms %10.2f ns/entity\n", name, seconds * 1e3, seconds * 1e9 / ENTITY_COUNT);
+}
+
+int main() {
+    const float dt = 1.0f / 60.0f;
+
+    EntityRegistry registry;
+    std::vector<Entity> entities;
+    entities.reserve(ENTITY_COUNT);
+
+    auto start = std::chrono::steady_clock::now();
+    // half of the entities carry an extra component, so queries span two archetypes
+    for (uint32_t i = 0; i < ENTITY_COUNT; i++) {
+        Position position = { glm::vec3((float)i, 0.0f, 0.0f) };
+        Velocity velocity = { glm::vec3(1.0f, 2.0f, 3.0f) };
+        if (i & 1) {
+            entities.push_back(registry.create(position, velocity, Health{ 100.0f }));
+        }
+        else {
+            entities.push_back(registry.create(position, velocity));
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double create = std::chrono::duration<double>(end - start).count();
+
+    std::printf("entities: %u\n", ENTITY_COUNT);
+    report("create", create);
+
+    report("each<Position, Velocity>", run([&]() {
+        registry.each<Position, Velocity>([dt](Entity, Position& position, Velocity& velocity) {
+            position.Value += velocity.Value * dt;
+        });
+    }));
+
+    report("each<Health>", run([&]() {
+        registry.each<Health>([](Entity, Health& health) {
+            health.Value -= 0.1f;
+        });
+    }));
+
+    std::vector<ChunkView> chunks;
+    report("query + chunk arrays", run([&]() {
+        chunks.clear();
+        registry.query<Position, Velocity>(chunks);
+        for (const ChunkView& chunk : chunks) {
+            Position* positions = chunk.array<Position>();
+            Velocity* velocities = chunk.array<Velocity>();
+            for (uint32_t i = 0; i < chunk.Count; i++) {
+                positions[i].Value += velocities[i].Value * dt;
+            }
+        }
+    }));
+
+    report("random get<Position>", run([&]() {
+        uint32_t index = 0;
+        for (uint32_t i = 0; i < ENTITY_COUNT; i++) {
+            index = (index + 7919) % ENTITY_COUNT;
+            registry.get<Position>(entities[index])->Value.y += 1.0f;
+        }
+    }));
+
+    std::vector<GameObject> objects(ENTITY_COUNT);
+    for (uint32_t i = 0; i < ENTITY_COUNT; i++) {
+        objects[i].Position = glm::vec3((float)i, 0.0f, 0.0f);
+        objects[i].Velocity = glm::vec3(1.0f, 2.0f, 3.0f);
+        objects[i].Active = true;
+    }
+    report("array of objects", run([&]() {
+        for (GameObject& object : objects) {
+            object.Position += object.Velocity * dt;
+        }
+    }));
+
+    // keep the results alive so the loops are not optimised away
+    float checksum = 0.0f;
+    registry.each<Position>([&](Entity, Position& position) {
+        checksum += position.Value.x;
+    });
+    checksum += objects[ENTITY_COUNT / 2].Position.x;
+    std::printf("checksum: %f\n", checksum);
+
+    return 0;
+}
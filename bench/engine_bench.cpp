@@ -0,0 +1,427 @@
+// Runs the engine headless over every benchmark scene and compares the frame times against a stored
+// baseline. Each case is a separate engine process, so one scene's resources never skew the next.
+// Run it from the repository root, where the engine finds its shaders and assets.
+//
+//   engine_bench [--engine PATH] [--baseline FILE] [--output FILE] [--update-baseline]
+//                [--case NAME]... [--frames N] [--warmup N] [--width W] [--height H]
+//
+// exit code 0 = no regressions, 1 = a metric is slower than the baseline allows, 2 = a run failed
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchCase {
+    const char* Name;
+    const char* Scene;
+    const char* CameraPath;     // nullptr for the scene's own orbit
+};
+
+const BenchCase CASES[] = {
+    { "default", "default", "assets/camera_paths/flythrough.txt" },
+    { "cubes", "cubes", "assets/camera_paths/grid_flyover.txt" },
+    { "lights", "lights", nullptr },
+    { "textures", "textures", nullptr },
+    { "shaders", "shaders", nullptr }
+};
+
+const char* METRICS[] = { "cpu_ms.mean", "cpu_ms.p50", "cpu_ms.p99", "gpu_ms.mean", "gpu_ms.p50", "gpu_ms.p99" };
+
+// allowed slowdown relative to the baseline when the baseline does not say otherwise
+const double DEFAULT_THRESHOLD_MEAN = 0.10;
+const double DEFAULT_THRESHOLD_P99 = 0.25;
+const double DEFAULT_THRESHOLD_FLOOR_MS = 0.05;     // differences below this are noise, whatever the ratio
+
+// Reads the numbers and strings of a JSON document into a flat map keyed by their path, so
+// {"cases": {"cubes": {"cpu_ms": {"mean": 1.5}}}} becomes "cases.cubes.cpu_ms.mean" = 1.5.
+// Arrays are skipped; the reports and baselines do not use them.
+class FlatJson {
+public:
+    std::map<std::string, double> Numbers;
+    std::map<std::string, std::string> Strings;
+
+    bool parse(const std::string& text) {
+        this->text = &text;
+        position = 0;
+        return value("") && (skipSpace(), position == text.size());
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string data = contents.str();
+        return parse(data);
+    }
+
+private:
+    const std::string* text = nullptr;
+    size_t position = 0;
+
+    void skipSpace() {
+        while (position < text->size() && std::isspace((unsigned char)(*text)[position])) {
+            position++;
+        }
+    }
+
+    bool string(std::string& result) {
+        if ((*text)[position] != '"') {
+            return false;
+        }
+        for (position++; position < text->size() && (*text)[position] != '"'; position++) {
+            if ((*text)[position] == '\\' && position + 1 < text->size()) {
+                position++;
+            }
+            result += (*text)[position];
+        }
+        return position++ < text->size();
+    }
+
+    bool value(const std::string& path) {
+        skipSpace();
+        if (position >= text->size()) {
+            return false;
+        }
+        char next = (*text)[position];
+        if (next == '{' || next == '[') {
+            char close = next == '{' ? '}' : ']';
+            position++;
+            skipSpace();
+            if (position < text->size() && (*text)[position] == close) {
+                position++;
+                return true;
+            }
+            for (unsigned int index = 0;; index++) {
+                std::string key = std::to_string(index);
+                if (next == '{') {
+                    skipSpace();
+                    key.clear();
+                    if (!string(key)) {
+                        return false;
+                    }
+                    skipSpace();
+                    if (position >= text->size() || (*text)[position++] != ':') {
+                        return false;
+                    }
+                }
+                if (!value(path.empty() ? key : path + "." + key)) {
+                    return false;
+                }
+                skipSpace();
+                if (position >= text->size()) {
+                    return false;
+                }
+                char separator = (*text)[position++];
+                if (separator == close) {
+                    return true;
+                }
+                if (separator != ',') {
+                    return false;
+                }
+            }
+        }
+        if (next == '"') {
+            std::string result;
+            if (!string(result)) {
+                return false;
+            }
+            Strings[path] = result;
+            return true;
+        }
+
+        // numbers, true/false/null are read as words and only numbers are kept
+        size_t start = position;
+        while (position < text->size() && (std::isalnum((unsigned char)(*text)[position]) || std::strchr("+-.", (*text)[position]))) {
+            position++;
+        }
+        std::string word = text->substr(start, position - start);
+        if (word.empty()) {
+            return false;
+        }
+        char* end = nullptr;
+        double number = std::strtod(word.c_str(), &end);
+        if (*end == '\0') {
+            Numbers[path] = number;
+        }
+        return true;
+    }
+};
+
+struct Options {
+    std::string Engine = "./engine";
+    std::string Baseline = "bench/baseline.json";
+    std::string Output = "engine_bench_results.json";
+    bool UpdateBaseline = false;
+    std::vector<std::string> Cases;
+    // 0 = the value the baseline was recorded with, or the default below when there is none
+    unsigned int Frames = 0;
+    unsigned int Warmup = 0;
+    int Width = 0;
+    int Height = 0;
+};
+
+const unsigned int DEFAULT_FRAMES = 60;
+const unsigned int DEFAULT_WARMUP = 10;
+const int DEFAULT_WIDTH = 640;
+const int DEFAULT_HEIGHT = 360;
+
+// timings are only comparable when taken with the same settings, so unset ones follow the baseline
+void applyRunSettings(Options& options, FlatJson& baseline) {
+    auto setting = [&baseline](const char* name, double fallback) {
+        return baseline.Numbers.count(name) ? baseline.Numbers[name] : fallback;
+    };
+    if (options.Frames == 0) {
+        options.Frames = (unsigned int)setting("frames", DEFAULT_FRAMES);
+    }
+    if (options.Warmup == 0) {
+        options.Warmup = (unsigned int)setting("warmup", DEFAULT_WARMUP);
+    }
+    if (options.Width == 0) {
+        options.Width = (int)setting("width", DEFAULT_WIDTH);
+    }
+    if (options.Height == 0) {
+        options.Height = (int)setting("height", DEFAULT_HEIGHT);
+    }
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--engine" && hasValue) {
+            options.Engine = argv[++i];
+        }
+        else if (argument == "--baseline" && hasValue) {
+            options.Baseline = argv[++i];
+        }
+        else if (argument == "--output" && hasValue) {
+            options.Output = argv[++i];
+        }
+        else if (argument == "--update-baseline") {
+            options.UpdateBaseline = true;
+        }
+        else if (argument == "--case" && hasValue) {
+            options.Cases.push_back(argv[++i]);
+        }
+        else if (argument == "--frames" && hasValue) {
+            options.Frames = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (argument == "--warmup" && hasValue) {
+            options.Warmup = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (argument == "--width" && hasValue) {
+            options.Width = std::atoi(argv[++i]);
+        }
+        else if (argument == "--height" && hasValue) {
+            options.Height = std::atoi(argv[++i]);
+        }
+        else {
+            std::cout << "usage: " << argv[0] << " [--engine PATH] [--baseline FILE] [--output FILE] [--update-baseline]"
+                << " [--case NAME]... [--frames N] [--warmup N] [--width W] [--height H]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// runs one case and reads back the report the engine wrote
+bool runCase(const Options& options, const BenchCase& benchCase, FlatJson& report) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string reportPath = (directory / (std::string("engine_bench_") + benchCase.Name + ".json")).string();
+    std::string logPath = (directory / (std::string("engine_bench_") + benchCase.Name + ".log")).string();
+    std::filesystem::remove(reportPath);
+
+    std::string command = "\"" + options.Engine + "\" --headless --scene " + benchCase.Scene
+        + " --frames " + std::to_string(options.Frames) + " --warmup " + std::to_string(options.Warmup)
+        + " --width " + std::to_string(options.Width) + " --height " + std::to_string(options.Height)
+        + " --report \"" + reportPath + "\"";
+    if (benchCase.CameraPath) {
+        command += std::string(" --camera-path ") + benchCase.CameraPath;
+    }
+    command += " > \"" + logPath + "\" 2>&1";
+
+    int status = std::system(command.c_str());
+    if (status != 0 || !report.load(reportPath)) {
+        std::cout << benchCase.Name << ": engine run failed (status " << status << "), see " << logPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// text for inside a JSON string, quotes and backslashes escaped
+std::string jsonEscape(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+// true when the baseline holds every metric of the case
+bool baselineHasCase(const FlatJson& baseline, const std::string& name) {
+    for (const char* metric : METRICS) {
+        if (!baseline.Numbers.count("cases." + name + "." + metric)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the baseline format: renderer, run settings, thresholds and one block of metrics per case.
+// with merge, cases that were not run keep their numbers from baseline
+void writeResults(const std::string& path, const Options& options, const std::string& renderer, const std::vector<std::pair<std::string, FlatJson>>& results, const FlatJson& baseline, bool merge) {
+    // every case in the order of CASES, each with where its numbers come from
+    std::vector<std::pair<std::string, std::string>> cases;
+    for (const BenchCase& benchCase : CASES) {
+        bool ran = false;
+        for (const auto& result : results) {
+            ran = ran || result.first == benchCase.Name;
+        }
+        if (ran) {
+            cases.push_back({ benchCase.Name, "" });
+        }
+        else if (merge && baselineHasCase(baseline, benchCase.Name)) {
+            cases.push_back({ benchCase.Name, std::string("cases.") + benchCase.Name + "." });
+        }
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "ERROR::ENGINE_BENCH::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+        return;
+    }
+
+    auto threshold = [&baseline](const char* name, double fallback) {
+        auto found = baseline.Numbers.find(std::string("thresholds.") + name);
+        return found != baseline.Numbers.end() ? found->second : fallback;
+    };
+    file << "{\n  \"renderer\": \"" << jsonEscape(renderer) << "\",\n  \"frames\": " << options.Frames << ",\n  \"warmup\": " << options.Warmup
+        << ",\n  \"width\": " << options.Width << ",\n  \"height\": " << options.Height
+        << ",\n  \"thresholds\": {\"mean\": " << threshold("mean", DEFAULT_THRESHOLD_MEAN) << ", \"p50\": " << threshold("p50", DEFAULT_THRESHOLD_MEAN)
+        << ", \"p99\": " << threshold("p99", DEFAULT_THRESHOLD_P99) << ", \"floor_ms\": " << threshold("floor_ms", DEFAULT_THRESHOLD_FLOOR_MS) << "},\n"
+        << "  \"cases\": {";
+    for (size_t i = 0; i < cases.size(); i++) {
+        const std::string& name = cases[i].first;
+        const FlatJson* source = &baseline;
+        for (const auto& result : results) {
+            if (result.first == name) {
+                source = &result.second;
+            }
+        }
+        file << (i > 0 ? "," : "") << "\n    \"" << name << "\": {";
+        const char* groups[] = { "cpu_ms", "gpu_ms" };
+        for (int group = 0; group < 2; group++) {
+            std::string prefix = cases[i].second + groups[group] + ".";
+            file << (group > 0 ? ", " : "") << "\"" << groups[group] << "\": {\"mean\": " << source->Numbers.at(prefix + "mean")
+                << ", \"p50\": " << source->Numbers.at(prefix + "p50") << ", \"p99\": " << source->Numbers.at(prefix + "p99") << "}";
+        }
+        file << "}";
+    }
+    file << "\n  }\n}\n";
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    // an existing baseline still supplies settings and thresholds when it is being replaced, and
+    // keeps the cases that are not run when it is updated with --case
+    FlatJson baseline;
+    bool haveBaseline = baseline.load(options.Baseline);
+    applyRunSettings(options, baseline);
+    bool merge = haveBaseline && options.UpdateBaseline && !options.Cases.empty();
+    if (merge && (baseline.Numbers["frames"] != options.Frames || baseline.Numbers["warmup"] != options.Warmup
+        || baseline.Numbers["width"] != options.Width || baseline.Numbers["height"] != options.Height)) {
+        std::cout << "warning: the run settings differ from the baseline's, its other cases are not kept" << std::endl;
+        merge = false;
+    }
+    haveBaseline = haveBaseline && !options.UpdateBaseline;
+    if (!options.UpdateBaseline && !haveBaseline) {
+        std::cout << "no baseline at " << options.Baseline << ", results are reported without comparison" << std::endl;
+    }
+
+    std::vector<std::pair<std::string, FlatJson>> results;
+    std::string renderer;
+    bool failed = false;
+    for (const BenchCase& benchCase : CASES) {
+        if (!options.Cases.empty()) {
+            bool selected = false;
+            for (const std::string& name : options.Cases) {
+                selected = selected || name == benchCase.Name;
+            }
+            if (!selected) {
+                continue;
+            }
+        }
+
+        std::cout << "running " << benchCase.Name << "..." << std::endl;
+        FlatJson report;
+        if (!runCase(options, benchCase, report)) {
+            failed = true;
+            continue;
+        }
+        renderer = report.Strings["renderer"];
+        results.push_back({ benchCase.Name, report });
+    }
+    if (results.empty()) {
+        return 2;
+    }
+
+    if (haveBaseline && baseline.Strings["renderer"] != renderer) {
+        std::cout << "warning: the baseline was recorded on " << baseline.Strings["renderer"] << ", this run uses " << renderer << std::endl;
+    }
+    double floorMs = baseline.Numbers.count("thresholds.floor_ms") ? baseline.Numbers["thresholds.floor_ms"] : DEFAULT_THRESHOLD_FLOOR_MS;
+
+    // one line per case and metric: current, baseline and the change in percent
+    bool regressed = false;
+    std::printf("\n%-10s %-12s %10s %10s %8s\n", "case", "metric", "ms", "baseline", "change");
+    for (const auto& result : results) {
+        for (const char* metric : METRICS) {
+            double current = result.second.Numbers.at(metric);
+            std::string key = "cases." + result.first + "." + metric;
+            if (!haveBaseline || !baseline.Numbers.count(key)) {
+                std::printf("%-10s %-12s %10.3f %10s %8s\n", result.first.c_str(), metric, current, "-", "-");
+                continue;
+            }
+
+            std::string statistic = std::string(metric).substr(std::string(metric).find('.') + 1);
+            double fallback = statistic == "p99" ? DEFAULT_THRESHOLD_P99 : DEFAULT_THRESHOLD_MEAN;
+            double threshold = baseline.Numbers.count("thresholds." + statistic) ? baseline.Numbers["thresholds." + statistic] : fallback;
+            double reference = baseline.Numbers[key];
+            double change = reference > 0.0 ? (current - reference) / reference : 0.0;
+            bool slower = current - reference > floorMs && change > threshold;
+            regressed = regressed || slower;
+            std::printf("%-10s %-12s %10.3f %10.3f %+7.1f%%%s\n", result.first.c_str(), metric, current, reference, change * 100.0,
+                slower ? "  REGRESSION" : "");
+        }
+    }
+
+    writeResults(options.UpdateBaseline ? options.Baseline : options.Output, options, renderer, results, baseline, merge);
+    std::cout << "\nresults written to " << (options.UpdateBaseline ? options.Baseline : options.Output) << std::endl;
+
+    if (failed) {
+        return 2;
+    }
+    if (regressed) {
+        std::cout << "FAIL: slower than the baseline allows" << std::endl;
+        return 1;
+    }
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,121 @@
+// scaling of the job system from one thread up to every core
+#include "../headers/job_system.h"
+#include "../headers/scene_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+const uint32_t MATRIX_COUNT = 1 << 20;
+const uint32_t EMPTY_JOBS = 100000;
+const uint32_t LIFETIME_ROUNDS = 200000;
+const unsigned int ITERATIONS = 5;
+
+template <typename Func>
+double run(Func func) {
+    func();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count() / ITERATIONS;
+}
+
+int main(int argc, char** argv) {
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        maxThreads = (unsigned int)std::atoi(argv[1]);
+    }
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+
+    std::vector<glm::mat4> input(MATRIX_COUNT, glm::mat4(1.001f));
+    std::vector<glm::mat4> output(MATRIX_COUNT);
+    glm::mat4 viewProjection = glm::mat4(0.5f);
+
+    SceneGraph scene;
+    scene.reserve(1000000);
+    uint32_t root = scene.addNode();
+    for (unsigned int c = 0; c < 999; c++) {
+        uint32_t child = scene.addNode(root, glm::vec3((float)c, 0.0f, 0.0f));
+        for (unsigned int g = 0; g < 1000; g++) {
+            scene.addNode(child, glm::vec3(0.0f, (float)g, 0.0f));
+        }
+    }
+
+    double baseline[3] = { 0.0, 0.0, 0.0 };
+    std::printf("%-8s %14s %8s %14s %8s %14s %8s\n", "threads", "matrices ms", "speedup", "transforms ms", "speedup", "Mjobs/s", "speedup");
+
+    for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads - 1);
+
+        double matrices = run([&]() {
+            JobCounter counter;
+            auto multiply = [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    output[i] = viewProjection * input[i];
+                }
+            };
+            jobs.parallelFor(counter, MATRIX_COUNT, 4096, multiply);
+            jobs.wait(counter);
+        });
+
+        double transforms = run([&]() {
+            scene.setRotation(root, glm::angleAxis(0.1f, glm::vec3(0.0f, 1.0f, 0.0f)));
+            scene.updateWorldTransformsParallel(jobs);
+        });
+
+        // scheduler overhead: jobs that do next to nothing
+        std::atomic<uint32_t> executed{ 0 };
+        double empty = run([&]() {
+            JobCounter counter;
+            for (uint32_t i = 0; i < EMPTY_JOBS; i++) {
+                jobs.run(counter, [&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+                // stay below the per-thread pool size
+                if ((i & 2047) == 2047) {
+                    jobs.wait(counter);
+                }
+            }
+            jobs.wait(counter);
+        });
+        double jobRate = EMPTY_JOBS / empty * 1e-6;
+
+        if (threads == 1) {
+            baseline[0] = matrices;
+            baseline[1] = transforms;
+            baseline[2] = jobRate;
+        }
+        std::printf("%-8u %14.3f %7.2fx %14.3f %7.2fx %14.2f %7.2fx\n", threads,
+            matrices * 1e3, baseline[0] / matrices,
+            transforms * 1e3, baseline[1] / transforms,
+            jobRate, jobRate / baseline[2]);
+    }
+
+    std::printf("checksum: %f\n", output[MATRIX_COUNT / 2][0][0] + scene.World[scene.size() - 1][3][1]);
+
+    // counters on the stack go away as soon as wait returns, while the thread that ran the last job
+    // may still be finishing it. more threads than cores make that window wide; run under ASan
+    JobSystem jobs(std::max(maxThreads, 4u) - 1);
+    std::atomic<uint32_t> completed{ 0 };
+    for (uint32_t round = 0; round < LIFETIME_ROUNDS; round++) {
+        JobCounter counter;
+        JobCounter after;
+        for (uint32_t i = 0; i < 4; i++) {
+            jobs.run(counter, [&completed]() { completed.fetch_add(1, std::memory_order_relaxed); });
+        }
+        jobs.runAfter(counter, after, [&completed]() { completed.fetch_add(1, std::memory_order_relaxed); });
+        jobs.wait(counter);
+        jobs.wait(after);
+    }
+    if (completed.load() != LIFETIME_ROUNDS * 5) {
+        std::printf("counter lifetime: %u of %u jobs completed\n", completed.load(), LIFETIME_ROUNDS * 5);
+        return 1;
+    }
+    std::printf("counter lifetime: %u rounds\n", LIFETIME_ROUNDS);
+    return 0;
+}
@@ -0,0 +1,259 @@
+// parse throughput of the model importer on large generated OBJ and GLB files, what welding and the
+// vertex cache and fetch optimizations cost and gain on the result, how long the level of detail
+// chain takes to simplify and split into meshlets and how fast the same mesh loads from the engine's
+// own format
+#include "../headers/mesh_import.h"
+#include "../headers/mesh_format.h"
+#include "../headers/mesh_meshlets.h"
+#include "../headers/mesh_simplify.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+const unsigned int GRID_SIZE = 512;     // quads around each axis of the torus, a quarter million
+const unsigned int ITERATIONS = 5;
+
+template <typename Func>
+double run(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count() / ITERATIONS;
+}
+
+// a torus as a GRID_SIZE x GRID_SIZE grid of quads, whose last row and column share the first's
+// positions and normals but not their texture coordinates, like any exported model with a seam
+struct Torus {
+    std::vector<glm::vec3> Positions;
+    std::vector<glm::vec3> Normals;
+    std::vector<glm::vec2> TexCoords;
+    std::vector<uint32_t> Quads;    // four corners each, in shuffled order like an unoptimized export
+};
+
+Torus makeTorus() {
+    Torus torus;
+    const unsigned int row = GRID_SIZE + 1;
+    for (unsigned int j = 0; j <= GRID_SIZE; j++) {
+        for (unsigned int i = 0; i <= GRID_SIZE; i++) {
+            float u = (float)i / GRID_SIZE * 6.2831853f;
+            float v = (float)j / GRID_SIZE * 6.2831853f;
+            glm::vec3 normal(std::cos(u) * std::cos(v), std::sin(v), std::sin(u) * std::cos(v));
+            torus.Positions.push_back(glm::vec3(std::cos(u), 0.0f, std::sin(u)) * 2.0f + normal * 0.5f);
+            torus.Normals.push_back(normal);
+            torus.TexCoords.push_back(glm::vec2((float)i / GRID_SIZE, (float)j / GRID_SIZE));
+        }
+    }
+    std::vector<uint32_t> order(GRID_SIZE * GRID_SIZE);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+    for (uint32_t quad : order) {
+        uint32_t i = quad % GRID_SIZE, j = quad / GRID_SIZE;
+        uint32_t corner = j * row + i;
+        torus.Quads.insert(torus.Quads.end(), { corner, corner + 1, corner + row + 1, corner + row });
+    }
+    return torus;
+}
+
+// positions and normals are written once per grid point and indexed separately from the texture
+// coordinates, so the seams only split on texture coordinates like a real export
+void writeObj(const Torus& torus, const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    char line[128];
+    const unsigned int row = GRID_SIZE + 1;
+    auto shared = [row](uint32_t index) { return (index / row % GRID_SIZE) * row + index % row % GRID_SIZE; };
+    for (size_t i = 0; i < torus.Positions.size(); i++) {
+        const glm::vec3& p = torus.Positions[i];
+        const glm::vec3& n = torus.Normals[i];
+        const glm::vec2& t = torus.TexCoords[i];
+        file.write(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n", p.x, p.y, p.z, n.x, n.y, n.z, t.x, t.y));
+    }
+    for (size_t i = 0; i < torus.Quads.size(); i += 4) {
+        int length = std::snprintf(line, sizeof(line), "f");
+        for (size_t k = 0; k < 4; k++) {
+            uint32_t corner = torus.Quads[i + k];
+            uint32_t point = shared(corner) + 1;
+            length += std::snprintf(line + length, sizeof(line) - length, " %u/%u/%u", point, corner + 1, point);
+        }
+        line[length++] = '\n';
+        file.write(line, length);
+    }
+}
+
+// one buffer of interleaved float attributes followed by 32-bit indices
+void writeGlb(const Torus& torus, const std::string& path) {
+    std::vector<unsigned char> binary(torus.Positions.size() * sizeof(MeshVertex));
+    for (size_t i = 0; i < torus.Positions.size(); i++) {
+        MeshVertex vertex = { torus.Positions[i], torus.Normals[i], torus.TexCoords[i] };
+        std::memcpy(binary.data() + i * sizeof(MeshVertex), &vertex, sizeof(MeshVertex));
+    }
+    size_t vertexBytes = binary.size();
+    for (size_t i = 0; i < torus.Quads.size(); i += 4) {
+        const uint32_t* quad = &torus.Quads[i];
+        uint32_t triangles[6] = { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] };
+        binary.insert(binary.end(), reinterpret_cast<unsigned char*>(triangles), reinterpret_cast<unsigned char*>(triangles + 6));
+    }
+    size_t indexCount = torus.Quads.size() / 4 * 6;
+
+    char json[2048];
+    int length = std::snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+        "\"buffers\":[{\"byteLength\":%zu}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"byteStride\":32},"
+        "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+        "\"accessors\":[{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+        "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+        "{\"bufferView\":0,\"byteOffset\":24,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+        "{\"bufferView\":1,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+        binary.size(), vertexBytes, vertexBytes, binary.size() - vertexBytes,
+        torus.Positions.size(), torus.Positions.size(), torus.Positions.size(), indexCount);
+    while (length % 4) {
+        json[length++] = ' ';
+    }
+
+    uint32_t jsonHeader[2] = { (uint32_t)length, 0x4E4F534A };
+    uint32_t binaryHeader[2] = { (uint32_t)binary.size(), 0x004E4942 };
+    uint32_t header[3] = { 0x46546C67, 2, (uint32_t)(sizeof(header) + sizeof(jsonHeader) + length + sizeof(binaryHeader) + binary.size()) };
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(jsonHeader), sizeof(jsonHeader));
+    file.write(json, length);
+    file.write(reinterpret_cast<const char*>(binaryHeader), sizeof(binaryHeader));
+    file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+}
+
+void measure(const std::string& path) {
+    meshFileFormat format;
+    if (!meshFileFormatFromPath(path, format)) {
+        std::printf("%s: unknown model format\n", path.c_str());
+        return;
+    }
+    MappedFile file;
+    if (!file.open(path.c_str())) {
+        return;
+    }
+    double megabytes = file.size() / (1024.0 * 1024.0);
+
+    MeshData parsed;
+    bool ok = true;
+    double parseSeconds = run([&]() {
+        parsed = MeshData();
+        ok = format == MESH_FILE_OBJ
+            ? parseObj(file.data(), file.size(), parsed)
+            : parseGltf(file.data(), file.size(), "", format == MESH_FILE_GLB, parsed);
+    });
+    if (!ok) {
+        std::printf("%s: parse failed\n", meshFileFormatName(format));
+        return;
+    }
+    MeshData optimized;
+    double importSeconds = run([&]() {
+        importMesh(path, optimized);
+    });
+
+    std::printf("%-5s %8.1f MB  parse %8.1f ms %8.1f MB/s   import %8.1f ms %8.1f MB/s\n", meshFileFormatName(format), megabytes,
+        parseSeconds * 1e3, megabytes / parseSeconds, importSeconds * 1e3, megabytes / importSeconds);
+    std::printf("      %zu -> %zu vertices, %zu triangles, ACMR %.3f -> %.3f\n", parsed.Vertices.size(), optimized.Vertices.size(),
+        optimized.Indices.size() / 3, averageCacheMissRatio(parsed.Indices, parsed.Vertices.size()),
+        averageCacheMissRatio(optimized.Indices, optimized.Vertices.size()));
+}
+
+// the chain mesh_convert builds, simplified once since it dwarfs the other steps
+void measureLods(MeshData& mesh) {
+    auto start = std::chrono::steady_clock::now();
+    buildMeshLods(mesh);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("lods  %8zu levels in %8.1f ms  ", mesh.Lods.size(), seconds * 1e3);
+    for (const MeshLod& level : mesh.Lods) {
+        std::printf(" %u (%.4f)", level.IndexCount / 3, level.Error);
+    }
+    std::printf("  triangles (error)\n");
+}
+
+// meshlets of every level, with how full they are on average
+void measureMeshlets(MeshData& mesh) {
+    auto start = std::chrono::steady_clock::now();
+    buildMeshlets(mesh);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t vertices = 0, triangles = 0, cones = 0;
+    for (const Meshlet& meshlet : mesh.Meshlets) {
+        vertices += meshlet.VertexCount;
+        triangles += meshlet.TriangleCount;
+        cones += meshlet.ConeCutoff > 0.0f;
+    }
+    size_t count = std::max<size_t>(mesh.Meshlets.size(), 1);
+    std::printf("mlets %8zu built  in %8.1f ms   %.1f of %u vertices, %.1f of %u triangles, %zu with a normal cone\n",
+        mesh.Meshlets.size(), seconds * 1e3, (double)vertices / count, MESHLET_MAX_VERTICES, (double)triangles / count,
+        MESHLET_MAX_TRIANGLES, cones);
+}
+
+// mapping the file and copying its blobs out is all the engine does with it before the GPU copy
+void measureMeshFile(const MeshData& mesh, const std::string& path) {
+    writeMeshFile(path, mesh);
+    std::vector<unsigned char> staging(mesh.Vertices.size() * sizeof(MeshVertex) + mesh.Indices.size() * sizeof(uint32_t));
+    bool ok = true;
+    double megabytes = 0.0;
+    double seconds = run([&]() {
+        MeshFile file;
+        ok = file.open(path);
+        if (ok) {
+            const MeshFileHeader& header = file.header();
+            std::memcpy(staging.data(), file.vertices(), header.Vertices.Size);
+            std::memcpy(staging.data() + header.Vertices.Size, file.indices(), header.Indices.Size);
+            megabytes = header.FileSize / (1024.0 * 1024.0);
+        }
+    });
+    MeshFile file;
+    MeshData loaded;
+    if (!ok || !file.open(path)) {
+        std::printf("mesh: load failed\n");
+        return;
+    }
+    file.read(loaded);
+    bool same = loaded.Indices == mesh.Indices && loaded.Lods.size() == mesh.Lods.size()
+        && std::memcmp(loaded.Lods.data(), mesh.Lods.data(), mesh.Lods.size() * sizeof(MeshLod)) == 0
+        && loaded.Meshlets.size() == mesh.Meshlets.size() && loaded.MeshletVertices == mesh.MeshletVertices
+        && loaded.MeshletTriangles == mesh.MeshletTriangles
+        && std::memcmp(loaded.Meshlets.data(), mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(Meshlet)) == 0
+        && std::memcmp(loaded.Vertices.data(), mesh.Vertices.data(), mesh.Vertices.size() * sizeof(MeshVertex)) == 0;
+    std::printf("%-5s %8.1f MB  load  %8.1f ms %8.1f MB/s   %s\n", "mesh", megabytes, seconds * 1e3, megabytes / seconds,
+        same ? "round trip exact" : "ROUND TRIP MISMATCH");
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "mesh_import_bench";
+    std::filesystem::create_directories(directory);
+    std::string objPath = (directory / "torus.obj").string();
+    std::string glbPath = (directory / "torus.glb").string();
+    std::string meshPath = (directory / "torus.mesh").string();
+
+    Torus torus = makeTorus();
+    writeObj(torus, objPath);
+    writeGlb(torus, glbPath);
+
+    std::printf("%u x %u quad torus, averages of %u runs, import = parse + weld + normals + cache and fetch order\n",
+        GRID_SIZE, GRID_SIZE, ITERATIONS);
+    measure(objPath);
+    measure(glbPath);
+
+    // the OBJ shares the seam positions, so the torus is closed and its meshlets get normal cones
+    MeshData mesh;
+    importMesh(objPath, mesh);
+    measureLods(mesh);
+    measureMeshlets(mesh);
+    measureMeshFile(mesh, meshPath);
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,59 @@
+// cost of one PROFILE_SCOPE while recording, while idle and compiled out
+#ifndef ENGINE_PROFILE
+#define ENGINE_PROFILE
+#endif
+#include "../headers/profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+const unsigned int SCOPES_PER_BATCH = 32768;    // half a thread buffer, so nothing is dropped
+const unsigned int BATCHES = 64;
+
+// keeps the compiler from folding the loops away
+volatile unsigned int sink = 0;
+
+// nanoseconds per iteration of body, timing only the loops; between batches the flusher drains the
+// buffer completely, so its work never lands inside a measured batch even on a single core
+template <typename Func>
+double nsPerScope(Func body) {
+    ProfileThreadBuffer& buffer = profiler().threadBuffer();
+    double total = 0.0;
+    for (unsigned int batch = 0; batch < BATCHES; batch++) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < SCOPES_PER_BATCH; i++) {
+            body(i);
+        }
+        total += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        while (buffer.Tail.load(std::memory_order_acquire) != buffer.Head.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return total / ((double)BATCHES * SCOPES_PER_BATCH);
+}
+
+int main() {
+    double empty = nsPerScope([](unsigned int i) { sink = i; });
+    double idle = nsPerScope([](unsigned int i) {
+        PROFILE_SCOPE("idle");
+        sink = i;
+    });
+
+    TraceLog trace;
+    trace.open("profiler_bench_trace.json");
+    profiler().start(trace);
+    double recording = nsPerScope([](unsigned int i) {
+        PROFILE_SCOPE("recording");
+        sink = i;
+    });
+    profiler().stop();
+    trace.close();
+    std::remove("profiler_bench_trace.json");
+
+    std::printf("%u scopes per configuration\n", BATCHES * SCOPES_PER_BATCH);
+    std::printf("loop only           %6.2f ns\n", empty);
+    std::printf("profiler stopped    %6.2f ns/scope\n", idle - empty);
+    std::printf("profiler recording  %6.2f ns/scope\n", recording - empty);
+    return 0;
+}
@@ -0,0 +1,79 @@
+// world-matrix update throughput of the scene graph for 1M nodes
+#include "../headers/job_system.h"
+#include "../headers/scene_graph.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+const unsigned int CHILDREN = 999;
+const unsigned int GRANDCHILDREN = 1000;
+const unsigned int ITERATIONS = 10;
+
+// a single root with 999 children of 1000 leaves each: 1,000,000 nodes in total
+void buildScene(SceneGraph& scene) {
+    scene.reserve(1 + CHILDREN + CHILDREN * GRANDCHILDREN);
+    uint32_t root = scene.addNode();
+    for (unsigned int c = 0; c < CHILDREN; c++) {
+        uint32_t child = scene.addNode(root, glm::vec3((float)c, 0.0f, 0.0f));
+        for (unsigned int g = 0; g < GRANDCHILDREN; g++) {
+            scene.addNode(child, glm::vec3(0.0f, (float)g * 0.01f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+        }
+    }
+    scene.updateWorldTransforms();
+}
+
+template <typename Update>
+double run(SceneGraph& scene, const std::vector<uint32_t>& dirtyNodes, Update update) {
+    double total = 0.0;
+    for (unsigned int i = 0; i < ITERATIONS; i++) {
+        glm::quat rotation = glm::angleAxis(0.01f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+        for (uint32_t node : dirtyNodes) {
+            scene.setRotation(node, rotation);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        update();
+        auto end = std::chrono::steady_clock::now();
+        total += std::chrono::duration<double>(end - start).count();
+    }
+    return total / ITERATIONS;
+}
+
+int main() {
+    SceneGraph scene;
+    buildScene(scene);
+    uint32_t nodeCount = (uint32_t)scene.size();
+    JobSystem jobs;
+    unsigned int threads = jobs.threadCount();
+
+    std::printf("nodes: %u, threads: %u\n", nodeCount, threads);
+    std::printf("%8s %-10s %12s %14s\n", "dirty", "path", "ms/update", "Mnodes/s");
+
+    const float ratios[] = { 0.01f, 1.0f };
+    for (float ratio : ratios) {
+        std::vector<uint32_t> dirtyNodes;
+        if (ratio >= 1.0f) {
+            for (uint32_t node = 0; node < nodeCount; node++) {
+                dirtyNodes.push_back(node);
+            }
+        }
+        else {
+            std::mt19937 rng(1234);
+            std::uniform_int_distribution<uint32_t> pick(0, nodeCount - 1);
+            for (uint32_t i = 0; i < (uint32_t)(nodeCount * ratio); i++) {
+                dirtyNodes.push_back(pick(rng));
+            }
+        }
+
+        double serial = run(scene, dirtyNodes, [&]() { scene.updateWorldTransforms(); });
+        double parallel = run(scene, dirtyNodes, [&]() { scene.updateWorldTransformsParallel(jobs); });
+
+        // throughput is reported against the full node count so both ratios are comparable
+        std::printf("%7.0f%% %-10s %12.3f %14.1f\n", ratio * 100.0f, "serial", serial * 1e3, nodeCount / serial * 1e-6);
+        std::printf("%7.0f%% %-10s %12.3f %14.1f\n", ratio * 100.0f, "parallel", parallel * 1e3, nodeCount / parallel * 1e-6);
+    }
+
+    return 0;
+}
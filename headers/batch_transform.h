@@ -0,0 +1,424 @@
+#ifndef BATCH_TRANSFORM_H
+#define BATCH_TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BATCH_TRANSFORM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC accepts any intrinsic anywhere, GCC and Clang need the instruction set enabled per function
+// so the rest of the engine keeps building for the baseline CPU
+#if defined(BATCH_TRANSFORM_X86) && !defined(_MSC_VER)
+#define BATCH_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define BATCH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define BATCH_TARGET_SSE41
+#define BATCH_TARGET_AVX2
+#endif
+
+enum simdLevel {
+	SIMD_SCALAR,
+	SIMD_SSE41,     // 4 objects per iteration
+	SIMD_AVX2       // 8 objects per iteration, with FMA
+};
+
+inline const char* simdLevelName(simdLevel level) {
+	static const char* names[] = { "scalar", "SSE4.1", "AVX2" };
+	return names[level];
+}
+
+// widest instruction set the CPU has and the OS saves the registers of, read through CPUID
+inline simdLevel detectSimdLevel() {
+#ifdef BATCH_TRANSFORM_X86
+	unsigned int features[4] = {};      // eax, ebx, ecx, edx
+	unsigned int extended[4] = {};
+#ifdef _MSC_VER
+	int registers[4];
+	__cpuid(registers, 0);
+	unsigned int highest = (unsigned int)registers[0];
+	__cpuidex(registers, 1, 0);
+	for (int i = 0; i < 4; i++) {
+		features[i] = (unsigned int)registers[i];
+	}
+	if (highest >= 7) {
+		__cpuidex(registers, 7, 0);
+		for (int i = 0; i < 4; i++) {
+			extended[i] = (unsigned int)registers[i];
+		}
+	}
+#else
+	unsigned int highest = __get_cpuid_max(0, nullptr);
+	__cpuid_count(1, 0, features[0], features[1], features[2], features[3]);
+	if (highest >= 7) {
+		__cpuid_count(7, 0, extended[0], extended[1], extended[2], extended[3]);
+	}
+#endif
+
+	bool sse41 = (features[2] >> 19) & 1;
+	bool fma = (features[2] >> 12) & 1;
+	bool osxsave = (features[2] >> 27) & 1;
+	bool avx = (features[2] >> 28) & 1;
+	bool avx2 = (extended[1] >> 5) & 1;
+
+	// AVX registers are only usable when the OS saves the upper halves on context switches
+	bool ymmSaved = false;
+	if (osxsave) {
+#ifdef _MSC_VER
+		ymmSaved = (_xgetbv(0) & 6) == 6;
+#else
+		unsigned int low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		ymmSaved = (low & 6) == 6;
+#endif
+	}
+
+	if (avx && avx2 && fma && ymmSaved) {
+		return SIMD_AVX2;
+	}
+	if (sse41) {
+		return SIMD_SSE41;
+	}
+#endif
+	return SIMD_SCALAR;
+}
+
+// detected once, every batch call after that dispatches on the cached result
+inline simdLevel activeSimdLevel() {
+	static const simdLevel level = detectSimdLevel();
+	return level;
+}
+
+// Translation, rotation and scale of many objects, one array per component, so the SIMD kernels
+// load the same component of 4 or 8 objects with a single instruction.
+struct TransformArrays {
+	std::vector<float> PositionX, PositionY, PositionZ;
+	std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+
+	size_t size() const {
+		return PositionX.size();
+	}
+
+	void resize(size_t count) {
+		for (std::vector<float>* component : { &PositionX, &PositionY, &PositionZ, &RotationX, &RotationY, &RotationZ, &RotationW, &ScaleX, &ScaleY, &ScaleZ }) {
+			component->resize(count);
+		}
+	}
+
+	void set(uint32_t i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		PositionX[i] = position.x;
+		PositionY[i] = position.y;
+		PositionZ[i] = position.z;
+		RotationX[i] = rotation.x;
+		RotationY[i] = rotation.y;
+		RotationZ[i] = rotation.z;
+		RotationW[i] = rotation.w;
+		ScaleX[i] = scale.x;
+		ScaleY[i] = scale.y;
+		ScaleZ[i] = scale.z;
+	}
+};
+
+// splits world matrices with axis-aligned scale back into translation, rotation and scale
+inline void decomposeTransforms(const glm::mat4* matrices, uint32_t begin, uint32_t end, TransformArrays& out) {
+	for (uint32_t i = begin; i < end; i++) {
+		const glm::mat4& m = matrices[i];
+		glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		if (scale.x != 0.0f && scale.y != 0.0f && scale.z != 0.0f) {
+			rotation = glm::quat_cast(glm::mat3(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z));
+		}
+		out.set(i, glm::vec3(m[3]), rotation, scale);
+	}
+}
+
+// Blends two sets of transforms: translation and scale are lerped, rotation is lerped the short way
+// round and renormalized, which over the small angle between two simulation ticks is as good as a
+// slerp. out must already have the size of a and b.
+inline void interpolateTransforms(const TransformArrays& a, const TransformArrays& b, float alpha, uint32_t begin, uint32_t end, TransformArrays& out) {
+	float keep = 1.0f - alpha;
+	for (uint32_t i = begin; i < end; i++) {
+		out.PositionX[i] = a.PositionX[i] * keep + b.PositionX[i] * alpha;
+		out.PositionY[i] = a.PositionY[i] * keep + b.PositionY[i] * alpha;
+		out.PositionZ[i] = a.PositionZ[i] * keep + b.PositionZ[i] * alpha;
+		out.ScaleX[i] = a.ScaleX[i] * keep + b.ScaleX[i] * alpha;
+		out.ScaleY[i] = a.ScaleY[i] * keep + b.ScaleY[i] * alpha;
+		out.ScaleZ[i] = a.ScaleZ[i] * keep + b.ScaleZ[i] * alpha;
+
+		float cosine = a.RotationX[i] * b.RotationX[i] + a.RotationY[i] * b.RotationY[i] + a.RotationZ[i] * b.RotationZ[i] + a.RotationW[i] * b.RotationW[i];
+		float towards = cosine < 0.0f ? -alpha : alpha;
+		float x = a.RotationX[i] * keep + b.RotationX[i] * towards;
+		float y = a.RotationY[i] * keep + b.RotationY[i] * towards;
+		float z = a.RotationZ[i] * keep + b.RotationZ[i] * towards;
+		float w = a.RotationW[i] * keep + b.RotationW[i] * towards;
+		float length = std::sqrt(x * x + y * y + z * z + w * w);
+		float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		out.RotationX[i] = x * inverse;
+		out.RotationY[i] = y * inverse;
+		out.RotationZ[i] = z * inverse;
+		out.RotationW[i] = w * inverse;
+	}
+}
+
+// one object at a time through GLM, also the tail of the SIMD kernels
+inline void batchTransformScalar(const TransformArrays& in, uint32_t begin, uint32_t end, const glm::mat4& viewProjection, glm::mat4* world, glm::mat4* mvp, glm::mat3* normal) {
+	for (uint32_t i = begin; i < end; i++) {
+		glm::mat3 rotation = glm::mat3_cast(glm::quat(in.RotationW[i], in.RotationX[i], in.RotationY[i], in.RotationZ[i]));
+		glm::vec3 scale(in.ScaleX[i], in.ScaleY[i], in.ScaleZ[i]);
+
+		glm::mat4 model(rotation);
+		model[0] *= scale.x;
+		model[1] *= scale.y;
+		model[2] *= scale.z;
+		model[3] = glm::vec4(in.PositionX[i], in.PositionY[i], in.PositionZ[i], 1.0f);
+		if (world) {
+			world[i] = model;
+		}
+		if (mvp) {
+			mvp[i] = viewProjection * model;
+		}
+		if (normal) {
+			// inverse transpose of rotation * scale is rotation / scale
+			normal[i] = glm::mat3(rotation[0] / scale.x, rotation[1] / scale.y, rotation[2] / scale.z);
+		}
+	}
+}
+
+#ifdef BATCH_TRANSFORM_X86
+
+// rows[i] holds element i of 8 objects; afterwards rows[j] holds elements 0-7 of object j
+BATCH_TARGET_AVX2 inline void transpose8x8(__m256 rows[8]) {
+	__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+	__m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+	__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+	__m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+	__m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+	__m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+	__m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+	__m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// elements[k] holds element k (column-major) of 8 matrices, written out as 8 consecutive mat4s
+BATCH_TARGET_AVX2 inline void storeMatrices8(__m256 elements[16], glm::mat4* out) {
+	transpose8x8(elements);
+	transpose8x8(elements + 8);
+	for (int lane = 0; lane < 8; lane++) {
+		_mm256_storeu_ps(&out[lane][0][0], elements[lane]);
+		_mm256_storeu_ps(&out[lane][2][0], elements[8 + lane]);
+	}
+}
+
+// Computes the matrices of 8 objects per iteration entirely in registers, one register per matrix
+// element, so the 4x4 multiply for the MVP is 48 FMAs with the view-projection broadcast, and only
+// transposes back to one matrix per object when storing.
+BATCH_TARGET_AVX2 inline void batchTransformAvx2(const TransformArrays& in, uint32_t begin, uint32_t end, const glm::mat4& viewProjection, glm::mat4* world, glm::mat4* mvp, glm::mat3* normal) {
+	__m256 vp[16];
+	for (int k = 0; k < 16; k++) {
+		vp[k] = _mm256_set1_ps(viewProjection[k / 4][k % 4]);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&in.RotationX[i]);
+		__m256 y = _mm256_loadu_ps(&in.RotationY[i]);
+		__m256 z = _mm256_loadu_ps(&in.RotationZ[i]);
+		__m256 w = _mm256_loadu_ps(&in.RotationW[i]);
+		__m256 scaleX = _mm256_loadu_ps(&in.ScaleX[i]);
+		__m256 scaleY = _mm256_loadu_ps(&in.ScaleY[i]);
+		__m256 scaleZ = _mm256_loadu_ps(&in.ScaleZ[i]);
+
+		// the rotation matrix of glm::mat3_cast, column by column
+		__m256 x2 = _mm256_mul_ps(x, two), y2 = _mm256_mul_ps(y, two), z2 = _mm256_mul_ps(z, two);
+		__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+		__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+		__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+		__m256 rotation[9] = {
+			_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz), _mm256_sub_ps(xz, wy),
+			_mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, wx),
+			_mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy))
+		};
+
+		__m256 model[16] = {
+			_mm256_mul_ps(rotation[0], scaleX), _mm256_mul_ps(rotation[1], scaleX), _mm256_mul_ps(rotation[2], scaleX), zero,
+			_mm256_mul_ps(rotation[3], scaleY), _mm256_mul_ps(rotation[4], scaleY), _mm256_mul_ps(rotation[5], scaleY), zero,
+			_mm256_mul_ps(rotation[6], scaleZ), _mm256_mul_ps(rotation[7], scaleZ), _mm256_mul_ps(rotation[8], scaleZ), zero,
+			_mm256_loadu_ps(&in.PositionX[i]), _mm256_loadu_ps(&in.PositionY[i]), _mm256_loadu_ps(&in.PositionZ[i]), one
+		};
+
+		if (mvp) {
+			// column c of the MVP is the view-projection applied to column c of the model matrix,
+			// whose w is 0 for the three axes and 1 for the translation
+			__m256 product[16];
+			for (int c = 0; c < 4; c++) {
+				for (int r = 0; r < 4; r++) {
+					__m256 sum = c == 3 ? vp[12 + r] : zero;
+					sum = _mm256_fmadd_ps(vp[r], model[c * 4], sum);
+					sum = _mm256_fmadd_ps(vp[4 + r], model[c * 4 + 1], sum);
+					product[c * 4 + r] = _mm256_fmadd_ps(vp[8 + r], model[c * 4 + 2], sum);
+				}
+			}
+			storeMatrices8(product, mvp + i);
+		}
+		if (world) {
+			storeMatrices8(model, world + i);
+		}
+		if (normal) {
+			__m256 inverseX = _mm256_div_ps(one, scaleX);
+			__m256 inverseY = _mm256_div_ps(one, scaleY);
+			__m256 inverseZ = _mm256_div_ps(one, scaleZ);
+			__m256 elements[8] = {
+				_mm256_mul_ps(rotation[0], inverseX), _mm256_mul_ps(rotation[1], inverseX), _mm256_mul_ps(rotation[2], inverseX),
+				_mm256_mul_ps(rotation[3], inverseY), _mm256_mul_ps(rotation[4], inverseY), _mm256_mul_ps(rotation[5], inverseY),
+				_mm256_mul_ps(rotation[6], inverseZ), _mm256_mul_ps(rotation[7], inverseZ)
+			};
+			alignas(32) float last[8];
+			_mm256_store_ps(last, _mm256_mul_ps(rotation[8], inverseZ));
+			transpose8x8(elements);
+			// a mat3 is 9 floats, so each 8-float store ends just before the object's last element
+			for (int lane = 0; lane < 8; lane++) {
+				_mm256_storeu_ps(&normal[i + lane][0][0], elements[lane]);
+				normal[i + lane][2][2] = last[lane];
+			}
+		}
+	}
+	batchTransformScalar(in, i, end, viewProjection, world, mvp, normal);
+}
+
+// elements[k] holds element k (column-major) of 4 matrices, written out as 4 consecutive mat4s
+BATCH_TARGET_SSE41 inline void storeMatrices4(__m128 elements[16], glm::mat4* out) {
+	for (int c = 0; c < 4; c++) {
+		__m128* column = elements + c * 4;
+		_MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+		for (int lane = 0; lane < 4; lane++) {
+			_mm_storeu_ps(&out[lane][c][0], column[lane]);
+		}
+	}
+}
+
+// the AVX2 kernel at half the width and without FMA
+BATCH_TARGET_SSE41 inline void batchTransformSse41(const TransformArrays& in, uint32_t begin, uint32_t end, const glm::mat4& viewProjection, glm::mat4* world, glm::mat4* mvp, glm::mat3* normal) {
+	__m128 vp[16];
+	for (int k = 0; k < 16; k++) {
+		vp[k] = _mm_set1_ps(viewProjection[k / 4][k % 4]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&in.RotationX[i]);
+		__m128 y = _mm_loadu_ps(&in.RotationY[i]);
+		__m128 z = _mm_loadu_ps(&in.RotationZ[i]);
+		__m128 w = _mm_loadu_ps(&in.RotationW[i]);
+		__m128 scaleX = _mm_loadu_ps(&in.ScaleX[i]);
+		__m128 scaleY = _mm_loadu_ps(&in.ScaleY[i]);
+		__m128 scaleZ = _mm_loadu_ps(&in.ScaleZ[i]);
+
+		__m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+		__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+		__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+		__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+		__m128 rotation[9] = {
+			_mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy),
+			_mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx),
+			_mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy))
+		};
+
+		__m128 model[16] = {
+			_mm_mul_ps(rotation[0], scaleX), _mm_mul_ps(rotation[1], scaleX), _mm_mul_ps(rotation[2], scaleX), zero,
+			_mm_mul_ps(rotation[3], scaleY), _mm_mul_ps(rotation[4], scaleY), _mm_mul_ps(rotation[5], scaleY), zero,
+			_mm_mul_ps(rotation[6], scaleZ), _mm_mul_ps(rotation[7], scaleZ), _mm_mul_ps(rotation[8], scaleZ), zero,
+			_mm_loadu_ps(&in.PositionX[i]), _mm_loadu_ps(&in.PositionY[i]), _mm_loadu_ps(&in.PositionZ[i]), one
+		};
+
+		if (mvp) {
+			__m128 product[16];
+			for (int c = 0; c < 4; c++) {
+				for (int r = 0; r < 4; r++) {
+					__m128 sum = _mm_mul_ps(vp[r], model[c * 4]);
+					sum = _mm_add_ps(sum, _mm_mul_ps(vp[4 + r], model[c * 4 + 1]));
+					sum = _mm_add_ps(sum, _mm_mul_ps(vp[8 + r], model[c * 4 + 2]));
+					product[c * 4 + r] = c == 3 ? _mm_add_ps(sum, vp[12 + r]) : sum;
+				}
+			}
+			storeMatrices4(product, mvp + i);
+		}
+		if (world) {
+			storeMatrices4(model, world + i);
+		}
+		if (normal) {
+			__m128 inverseX = _mm_div_ps(one, scaleX);
+			__m128 inverseY = _mm_div_ps(one, scaleY);
+			__m128 inverseZ = _mm_div_ps(one, scaleZ);
+			__m128 elements[8] = {
+				_mm_mul_ps(rotation[0], inverseX), _mm_mul_ps(rotation[1], inverseX), _mm_mul_ps(rotation[2], inverseX),
+				_mm_mul_ps(rotation[3], inverseY), _mm_mul_ps(rotation[4], inverseY), _mm_mul_ps(rotation[5], inverseY),
+				_mm_mul_ps(rotation[6], inverseZ), _mm_mul_ps(rotation[7], inverseZ)
+			};
+			alignas(16) float last[4];
+			_mm_store_ps(last, _mm_mul_ps(rotation[8], inverseZ));
+			_MM_TRANSPOSE4_PS(elements[0], elements[1], elements[2], elements[3]);
+			_MM_TRANSPOSE4_PS(elements[4], elements[5], elements[6], elements[7]);
+			for (int lane = 0; lane < 4; lane++) {
+				float* out = &normal[i + lane][0][0];
+				_mm_storeu_ps(out, elements[lane]);
+				_mm_storeu_ps(out + 4, elements[4 + lane]);
+				out[8] = last[lane];
+			}
+		}
+	}
+	batchTransformScalar(in, i, end, viewProjection, world, mvp, normal);
+}
+
+#endif
+
+// Builds the world, model-view-projection and normal matrices of objects [begin, end) into the
+// same slots of the output arrays, any of which may be null when it is not needed. The level
+// defaults to the widest one the CPU supports and must never be wider than that.
+inline void batchTransform(const TransformArrays& in, uint32_t begin, uint32_t end, const glm::mat4& viewProjection, glm::mat4* world, glm::mat4* mvp, glm::mat3* normal, simdLevel level = activeSimdLevel()) {
+#ifdef BATCH_TRANSFORM_X86
+	if (level == SIMD_AVX2) {
+		batchTransformAvx2(in, begin, end, viewProjection, world, mvp, normal);
+		return;
+	}
+	if (level == SIMD_SSE41) {
+		batchTransformSse41(in, begin, end, viewProjection, world, mvp, normal);
+		return;
+	}
+#endif
+	batchTransformScalar(in, begin, end, viewProjection, world, mvp, normal);
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef BENCH_SCENES_H
+#define BENCH_SCENES_H
+
+#include "camera_path.h"
+#include "components.h"
+#include "ecs.h"
+#include "lighting.h"
+#include "scene_graph.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Synthetic scenes for benchmarking, each stressing one part of a frame. SCENE_DEFAULT is the
+// hand-built demo scene in main.cpp; the others are generated here from a fixed seed, so every run
+// of a scene is identical.
+enum benchScene {
+	SCENE_DEFAULT,
+	SCENE_CUBES,        // many animated objects: simulation, culling and draw submission
+	SCENE_LIGHTS,       // every point light the lit shaders support, all of them moving
+	SCENE_TEXTURES,     // a material per texture, so texture binds dominate
+	SCENE_SHADERS       // separately linked copies of the lit program, so program switches dominate
+};
+
+const unsigned int BENCH_SCENE_COUNT = 5;
+const unsigned int BENCH_TEXTURE_COUNT = 256;
+const unsigned int BENCH_TEXTURE_SIZE = 128;
+const unsigned int BENCH_SHADER_COUNT = 32;
+
+inline const char* sceneName(benchScene scene) {
+	static const char* names[BENCH_SCENE_COUNT] = { "default", "cubes", "lights", "textures", "shaders" };
+	return names[scene];
+}
+
+inline bool parseSceneName(const std::string& name, benchScene& scene) {
+	for (unsigned int i = 0; i < BENCH_SCENE_COUNT; i++) {
+		if (name == sceneName((benchScene)i)) {
+			scene = (benchScene)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// deterministic value in [0, 1) for the index'th random number of a scene
+inline float benchRandom(uint32_t index) {
+	uint32_t x = index * 0x9E3779B9u + 0x7F4A7C15u;
+	x ^= x >> 16;
+	x *= 0x85EBCA6Bu;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35u;
+	x ^= x >> 16;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+// perSide^3 spinning objects centred on the origin, cycling through materials
+inline void addObjectGrid(SceneGraph& scene, EntityRegistry& registry, uint32_t mesh, const std::vector<uint32_t>& materials, unsigned int perSide, float spacing) {
+	float offset = (perSide - 1) * spacing * 0.5f;
+	uint32_t index = 0;
+	for (unsigned int x = 0; x < perSide; x++) {
+		for (unsigned int y = 0; y < perSide; y++) {
+			for (unsigned int z = 0; z < perSide; z++, index++) {
+				glm::vec3 position = glm::vec3(x, y, z) * spacing - glm::vec3(offset);
+				glm::vec3 axis = glm::normalize(glm::vec3(benchRandom(index * 3), benchRandom(index * 3 + 1), benchRandom(index * 3 + 2)) + glm::vec3(0.1f));
+				registry.create(
+					Transform{ scene.addNode(INVALID_NODE, position) },
+					Renderable{ mesh, materials[index % materials.size()] },
+					Animation{ position, glm::vec3(0.0f), axis, 0.5f + benchRandom(index + 100000) * 2.0f }
+				);
+			}
+		}
+	}
+}
+
+// count coloured point lights drifting through a sphere of the given radius, each drawn as a lamp
+inline void addPointLights(SceneGraph& scene, EntityRegistry& registry, uint32_t lampMesh, uint32_t lampMaterial, unsigned int count, float radius) {
+	for (unsigned int i = 0; i < count; i++) {
+		uint32_t seed = 200000 + i * 8;
+		glm::vec3 direction = glm::normalize(glm::vec3(benchRandom(seed), benchRandom(seed + 1), benchRandom(seed + 2)) * 2.0f - glm::vec3(1.0f) + glm::vec3(0.001f));
+		glm::vec3 position = direction * radius * (0.3f + 0.7f * benchRandom(seed + 3));
+		glm::vec3 color = glm::vec3(0.3f) + 0.7f * glm::vec3(benchRandom(seed + 4), benchRandom(seed + 5), benchRandom(seed + 6));
+		registry.create(
+			Transform{ scene.addNode(INVALID_NODE, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.3f)) },
+			Renderable{ lampMesh, lampMaterial },
+			Animation{ position, glm::normalize(glm::cross(direction, glm::vec3(0.0f, 1.0f, 0.0f)) + glm::vec3(0.001f)) * 4.0f, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f },
+			PointLight{ color * 0.05f, color, color, 1.0f, 0.14f, 0.07f }
+		);
+	}
+}
+
+// RGBA checkerboard in a colour picked by index, allocated with malloc like stb_image's output
+inline unsigned char* createPatternPixels(uint32_t index, unsigned int size) {
+	unsigned char* pixels = (unsigned char*)std::malloc((size_t)size * size * 4);
+	glm::vec3 color = glm::vec3(benchRandom(300000 + index * 3), benchRandom(300001 + index * 3), benchRandom(300002 + index * 3));
+	unsigned int cell = 8 + index % 4 * 8;
+	for (unsigned int y = 0; y < size; y++) {
+		for (unsigned int x = 0; x < size; x++) {
+			float shade = ((x / cell + y / cell) & 1) ? 1.0f : 0.35f;
+			unsigned char* pixel = &pixels[((size_t)y * size + x) * 4];
+			pixel[0] = (unsigned char)(color.r * shade * 255.0f);
+			pixel[1] = (unsigned char)(color.g * shade * 255.0f);
+			pixel[2] = (unsigned char)(color.b * shade * 255.0f);
+			pixel[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+// grid size and camera orbit of each generated scene
+inline unsigned int benchGridSize(benchScene scene) {
+	switch (scene) {
+	case SCENE_CUBES:
+		return 22;      // 10648 objects
+	case SCENE_LIGHTS:
+		return 12;
+	default:
+		return 16;
+	}
+}
+
+const float BENCH_GRID_SPACING = 2.0f;
+
+// the path a scene is benchmarked along when no path file is given
+inline CameraPath benchCameraPath(benchScene scene) {
+	if (scene == SCENE_DEFAULT) {
+		return CameraPath::orbit(glm::vec3(0.0f, 0.0f, -4.0f), 9.0f, 2.0f, 20.0f);
+	}
+	float extent = benchGridSize(scene) * BENCH_GRID_SPACING;
+	return CameraPath::orbit(glm::vec3(0.0f), extent, extent * 0.25f, 20.0f);
+}
+
+#endif
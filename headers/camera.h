@@ -4,8 +4,12 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
-#include <vector>
+#include "culling.h"
+
+#include <cmath>
+#include <cstdint>
 
 enum cameraMovement {
 	FORWARD,
@@ -20,80 +24,203 @@ const float PITCH		= 0.0f;
 const float SPEED		= 2.5f;
 const float SENSITIVITY	= 0.1f;
 const float FOV			= 70.0f;
+const float NEAR_PLANE	= 0.1f;
+const float FAR_PLANE	= 100.0f;
+
+// Perspective projection for reversed depth with the far plane at infinity: depth is 1 at the near
+// plane and falls towards 0 with distance, for a [0, 1] clip range (glClipControl). Paired with a
+// float depth buffer the exponent spreads precision evenly over the whole view distance, so there is
+// no far plane to tune and distant surfaces do not z-fight.
+inline glm::mat4 reversedInfinitePerspective(float fovy, float aspect, float nearPlane) {
+	float f = 1.0f / std::tan(fovy * 0.5f);
+	glm::mat4 result(0.0f);
+	result[0][0] = f / aspect;
+	result[1][1] = f;
+	result[2][3] = -1.0f;
+	result[3][2] = nearPlane;
+	return result;
+}
 
+// Fly camera with its orientation kept as a quaternion. Input only records what changed; the
+// orientation, view, projection, view-projection and frustum are rebuilt lazily the first time
+// they are asked for afterwards, so any number of mouse events per frame cost one rebuild and a
+// frame where nothing moved costs none. getVersion() changes whenever any of them does, so
+// systems deriving data from the camera can skip their work while it stays the same.
+//
+// A sub-pixel jitter for temporal anti-aliasing shifts the projection and view-projection only;
+// the frustum, the unjittered view-projection and the version ignore it, so a jitter that changes
+// every frame does not look like camera movement to anything else.
 class Camera {
 public:
-	// Camera Attributes
-	glm::vec3 Position;
-	glm::vec3 Front;
-	glm::vec3 Up;
-	glm::vec3 Right;
-	glm::vec3 WorldUp;
-
-	float Yaw;
-	float Pitch;
-
 	float MovementSpeed;
 	float MouseSensitivity;
-	float Fov;
 
 	Camera(
 		glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f),
 		float yaw = YAW,
 		float pitch = PITCH
-	) : Front(
-		glm::vec3(0.0f, 0.0f, -1.0f)),
-		MovementSpeed(SPEED),
+	) : MovementSpeed(SPEED),
 		MouseSensitivity(SENSITIVITY),
-		Fov(FOV
-		) {
-		Position = position;
-		WorldUp = up;
-		Yaw = yaw;
-		Pitch = pitch;
-		updateCameraVectors();
-	}
-		
+		position(position),
+		worldUp(up),
+		yaw(yaw),
+		pitch(pitch) {
+	}
+
 	Camera(
-		float posX, 
-		float posY, 
-		float posZ, 
-		float upX, 
-		float upY, 
-		float upZ, 
-		float yaw, 
+		float posX,
+		float posY,
+		float posZ,
+		float upX,
+		float upY,
+		float upZ,
+		float yaw,
 		float pitch
-	) : Front(
-		glm::vec3(0.0f, 0.0f, -1.0f)), 
-		MovementSpeed(SPEED), 
-		MouseSensitivity(SENSITIVITY), 
-		Fov(FOV)
-	{
-		Position = glm::vec3(posX, posY, posZ);
-		WorldUp = glm::vec3(upX, upY, upZ);
-		yaw = yaw;
-		pitch = pitch;
-		updateCameraVectors();
+	) : Camera(glm::vec3(posX, posY, posZ), glm::vec3(upX, upY, upZ), yaw, pitch) {
+	}
+
+	const glm::vec3& getPosition() const {
+		return position;
+	}
+
+	void setPosition(const glm::vec3& value) {
+		if (value != position) {
+			position = value;
+			viewDirty = true;
+		}
+	}
+
+	float getYaw() const {
+		return yaw;
+	}
+
+	float getPitch() const {
+		return pitch;
+	}
+
+	float getFov() const {
+		return fov;
+	}
+
+	float getAspect() const {
+		return aspect;
 	}
 
-	glm::mat4 getViewMatrix() {
-		return glm::lookAt(Position, Position + Front, Up);
+	float getNearPlane() const {
+		return nearDistance;
+	}
+
+	// points the camera directly, e.g. from a scripted camera path
+	void setOrientation(float yawDegrees, float pitchDegrees) {
+		if (yawDegrees != yaw || pitchDegrees != pitch) {
+			yaw = yawDegrees;
+			pitch = pitchDegrees;
+			orientationDirty = true;
+		}
+	}
+
+	const glm::quat& getOrientation() {
+		updateOrientation();
+		return orientation;
+	}
+
+	const glm::vec3& getFront() {
+		updateOrientation();
+		return front;
+	}
+
+	const glm::vec3& getRight() {
+		updateOrientation();
+		return right;
+	}
+
+	const glm::vec3& getUp() {
+		updateOrientation();
+		return up;
+	}
+
+	// switches to the reversed infinite projection, the depth state has to match, see applyDepthMode
+	void setReversedDepth(bool reversed) {
+		if (reversed != reversedDepth) {
+			reversedDepth = reversed;
+			projectionDirty = true;
+		}
+	}
+
+	bool isReversedDepth() const {
+		return reversedDepth;
+	}
+
+	// aspect ratio and depth range of the projection, the field of view comes from zooming. the far
+	// plane is ignored with reversed depth, which always projects to infinity
+	void setProjection(float aspectRatio, float nearPlane = NEAR_PLANE, float farPlane = FAR_PLANE) {
+		if (aspectRatio != aspect || nearPlane != nearDistance || farPlane != farDistance) {
+			aspect = aspectRatio;
+			nearDistance = nearPlane;
+			farDistance = farPlane;
+			projectionDirty = true;
+		}
+	}
+
+	const glm::mat4& getViewMatrix() {
+		updateMatrices();
+		return view;
+	}
+
+	const glm::mat4& getProjectionMatrix() {
+		updateMatrices();
+		return projection;
+	}
+
+	const glm::mat4& getViewProjectionMatrix() {
+		updateMatrices();
+		return viewProjection;
+	}
+
+	// without the jitter, what motion vectors are measured against
+	const glm::mat4& getUnjitteredViewProjectionMatrix() {
+		updateMatrices();
+		return unjitteredViewProjection;
+	}
+
+	// offset of the projection in normalized device coordinates, (2 / width, 2 / height) is one pixel
+	void setJitter(const glm::vec2& offset) {
+		if (offset != jitter) {
+			jitter = offset;
+			jitterDirty = true;
+		}
+	}
+
+	const glm::vec2& getJitter() const {
+		return jitter;
+	}
+
+	const Frustum& getFrustum() {
+		updateMatrices();
+		return frustum;
+	}
+
+	// bumped every time the matrices are rebuilt with a different pose or projection
+	uint64_t getVersion() {
+		updateMatrices();
+		return version;
 	}
 
 	void processKeyboard(cameraMovement direction, float deltaTime) {
+		updateOrientation();
 		float velocity = MovementSpeed * deltaTime;
 		if (direction == FORWARD) {
-			Position += Front * velocity;
+			setPosition(position + front * velocity);
 		}
 		if (direction == BACKWARD) {
-			Position -= Front * velocity;
+			setPosition(position - front * velocity);
 		}
 		if (direction == LEFT) {
-			Position -= Right * velocity;
+			setPosition(position - right * velocity);
 		}
 		if (direction == RIGHT) {
-			Position += Right * velocity;
+			setPosition(position + right * velocity);
 		}
 	}
 
@@ -101,43 +228,122 @@ public:
 		xOffset *= MouseSensitivity;
 		yOffset *= MouseSensitivity;
 
-		Yaw += xOffset;
-		Pitch += yOffset;
-
+		float newPitch = pitch + yOffset;
 		if (constrainPitch) {
-			if (Pitch > 89.0f) {
-				Pitch = 89.0f;
+			if (newPitch > 89.0f) {
+				newPitch = 89.0f;
 			}
-			if (Pitch < -89.0f) {
-				Pitch = -89.0f;
+			if (newPitch < -89.0f) {
+				newPitch = -89.0f;
 			}
 		}
 
-		updateCameraVectors();
+		setOrientation(yaw + xOffset, newPitch);
 	}
 
 	void processMouseScroll(float yOffset) {
-		Fov -= (float)yOffset;
-		if (Fov < 1.0f) {
-			Fov = 1.0f;
+		float newFov = fov - (float)yOffset;
+		if (newFov < 1.0f) {
+			newFov = 1.0f;
+		}
+		if (newFov > FOV) {
+			newFov = FOV;
 		}
-		if (Fov > FOV) {
-			Fov = FOV;
+		if (newFov != fov) {
+			fov = newFov;
+			projectionDirty = true;
 		}
 	}
 
 private:
-	void updateCameraVectors() {
-		glm::vec3 front;
-		front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-		front.y = sin(glm::radians(Pitch));
-		front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+	glm::vec3 position;
+	glm::vec3 worldUp;
+	float yaw;
+	float pitch;
+	float fov = FOV;
+	float aspect = 1.0f;
+	float nearDistance = NEAR_PLANE;
+	float farDistance = FAR_PLANE;
+	bool reversedDepth = false;
+
+	glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+	glm::vec3 right = glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	glm::mat4 unjitteredProjection = glm::mat4(1.0f);
+	glm::mat4 unjitteredViewProjection = glm::mat4(1.0f);
+	glm::vec2 jitter = glm::vec2(0.0f);
+	Frustum frustum = {};
+	uint64_t version = 0;
+
+	bool orientationDirty = true;
+	bool viewDirty = true;
+	bool projectionDirty = true;
+	bool jitterDirty = false;
+
+	// yaw turns around the world up axis, pitch around the camera's right axis; yaw -90 with no
+	// pitch looks down -Z like the default OpenGL camera
+	void updateOrientation() {
+		if (!orientationDirty) {
+			return;
+		}
+		glm::quat turn = glm::angleAxis(glm::radians(-90.0f - yaw), worldUp);
+		orientation = glm::normalize(turn * glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f)));
+
+		glm::mat3 axes = glm::mat3_cast(orientation);
+		right = axes[0];
+		up = axes[1];
+		front = -axes[2];
+		orientationDirty = false;
+		viewDirty = true;
+	}
 
-		Front = glm::normalize(front);
-		Right = glm::normalize(glm::cross(Front, WorldUp));
-		Up = glm::normalize(glm::cross(Right, Front));
+	void updateMatrices() {
+		updateOrientation();
+		if (!viewDirty && !projectionDirty) {
+			if (jitterDirty) {
+				applyJitter();
+			}
+			return;
+		}
+		if (viewDirty) {
+			// the inverse of a rotation is its transpose, so no lookAt is needed
+			glm::mat3 rotation = glm::transpose(glm::mat3_cast(orientation));
+			view = glm::mat4(rotation);
+			view[3] = glm::vec4(-(rotation * position), 1.0f);
+			viewDirty = false;
+		}
+		if (projectionDirty) {
+			if (reversedDepth) {
+				unjitteredProjection = reversedInfinitePerspective(glm::radians(fov), aspect, nearDistance);
+			}
+			else {
+				unjitteredProjection = glm::perspective(glm::radians(fov), aspect, nearDistance, farDistance);
+			}
+			projectionDirty = false;
+		}
+		unjitteredViewProjection = unjitteredProjection * view;
+		frustum = extractFrustum(unjitteredViewProjection, reversedDepth);
+		applyJitter();
+		version++;
+	}
+
+	// shifting clip x and y by jitter * w moves every projected point by jitter in NDC
+	void applyJitter() {
+		projection = unjitteredProjection;
+		if (jitter != glm::vec2(0.0f)) {
+			glm::mat4 shift(1.0f);
+			shift[3] = glm::vec4(jitter, 0.0f, 1.0f);
+			projection = shift * unjitteredProjection;
+		}
+		viewProjection = projection * view;
+		jitterDirty = false;
 	}
 };
 
 // code modified from https://learnopengl.com/
-#endif
\ No newline at end of file
+#endif
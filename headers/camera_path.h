@@ -0,0 +1,132 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// one pose along a scripted camera path, angles in degrees like Camera::getYaw/getPitch
+struct CameraKeyframe {
+	float Time;
+	glm::vec3 Position;
+	float Yaw;
+	float Pitch;
+};
+
+// Scripted camera motion for unattended runs. Positions follow a Catmull-Rom spline through the
+// keyframes, angles are interpolated linearly, and the path loops once it reaches its last keyframe.
+class CameraPath {
+public:
+	std::vector<CameraKeyframe> Keyframes;
+
+	// reads "time x y z yaw pitch" per line, blank lines and lines starting with # are skipped
+	bool load(const char* path) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+			return false;
+		}
+
+		Keyframes.clear();
+		std::string line;
+		unsigned int lineNumber = 0;
+		while (std::getline(file, line)) {
+			lineNumber++;
+			size_t first = line.find_first_not_of(" \t\r");
+			if (first == std::string::npos || line[first] == '#') {
+				continue;
+			}
+
+			std::istringstream fields(line);
+			CameraKeyframe keyframe;
+			if (!(fields >> keyframe.Time >> keyframe.Position.x >> keyframe.Position.y >> keyframe.Position.z >> keyframe.Yaw >> keyframe.Pitch)) {
+				std::cout << "ERROR::CAMERA_PATH::MALFORMED_LINE " << path << ":" << lineNumber << std::endl;
+				return false;
+			}
+			if (!Keyframes.empty() && keyframe.Time <= Keyframes.back().Time) {
+				std::cout << "ERROR::CAMERA_PATH::TIME_NOT_INCREASING " << path << ":" << lineNumber << std::endl;
+				return false;
+			}
+			Keyframes.push_back(keyframe);
+		}
+
+		if (Keyframes.empty()) {
+			std::cout << "ERROR::CAMERA_PATH::EMPTY " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// writes the keyframes in the format load reads, e.g. a path recorded from a live session
+	bool save(const char* path) const {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		file << "# time x y z yaw pitch\n";
+		for (const CameraKeyframe& keyframe : Keyframes) {
+			file << keyframe.Time << " " << keyframe.Position.x << " " << keyframe.Position.y << " " << keyframe.Position.z
+				<< " " << keyframe.Yaw << " " << keyframe.Pitch << "\n";
+		}
+		return true;
+	}
+
+	float duration() const {
+		return Keyframes.empty() ? 0.0f : Keyframes.back().Time;
+	}
+
+	CameraKeyframe sample(float time) const {
+		if (Keyframes.empty()) {
+			return { time, glm::vec3(0.0f), -90.0f, 0.0f };
+		}
+		if (Keyframes.size() == 1 || duration() <= 0.0f) {
+			return Keyframes.front();
+		}
+
+		time = glm::mod(time, duration());
+		size_t next = 1;
+		while (next < Keyframes.size() - 1 && Keyframes[next].Time < time) {
+			next++;
+		}
+		const CameraKeyframe& a = Keyframes[next - 1];
+		const CameraKeyframe& b = Keyframes[next];
+		const CameraKeyframe& before = Keyframes[next > 1 ? next - 2 : next - 1];
+		const CameraKeyframe& after = Keyframes[next + 1 < Keyframes.size() ? next + 1 : next];
+
+		float t = glm::clamp((time - a.Time) / (b.Time - a.Time), 0.0f, 1.0f);
+		float t2 = t * t;
+		float t3 = t2 * t;
+		glm::vec3 position = 0.5f * ((2.0f * a.Position) + (b.Position - before.Position) * t
+			+ (2.0f * before.Position - 5.0f * a.Position + 4.0f * b.Position - after.Position) * t2
+			+ (3.0f * a.Position - before.Position - 3.0f * b.Position + after.Position) * t3);
+
+		return { time, position, glm::mix(a.Yaw, b.Yaw, t), glm::mix(a.Pitch, b.Pitch, t) };
+	}
+
+	// a loop around the scene that always faces the centre, used when no path file is given
+	static CameraPath orbit(const glm::vec3& center, float radius, float height, float duration, unsigned int keyframeCount = 16) {
+		CameraPath path;
+		for (unsigned int i = 0; i <= keyframeCount; i++) {
+			float angle = glm::two_pi<float>() * i / keyframeCount;
+			glm::vec3 position = center + glm::vec3(cos(angle) * radius, height, sin(angle) * radius);
+			glm::vec3 toCenter = glm::normalize(center - position);
+
+			CameraKeyframe keyframe;
+			keyframe.Time = duration * i / keyframeCount;
+			keyframe.Position = position;
+			// unwrapped so the yaw keeps turning the same way instead of snapping back at 360 degrees
+			keyframe.Yaw = glm::degrees(angle) + 180.0f;
+			keyframe.Pitch = glm::degrees(asin(toCenter.y));
+			path.Keyframes.push_back(keyframe);
+		}
+		return path;
+	}
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef CLUSTER_CULLING_H
+#define CLUSTER_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "command_buffer.h"
+#include "components.h"
+#include "culling.h"
+#include "render_stats.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+const uint32_t CLUSTER_GROUP_SIZE = 64;            // must match the culling shader
+const uint32_t CLUSTER_MAX_DRAWS = 64 * 1024;      // indirect commands per frame, meshes past them are drawn whole
+const uint32_t CLUSTER_NONE = ~0u;                 // recordCull's answer for a mesh that is drawn whole
+const unsigned int CLUSTER_STATISTICS_FRAMES = 4;  // frames the drawn meshlet and triangle counts are read back behind
+const float CLUSTER_UNIFORM_SCALE = 1.001f;        // largest ratio of axis scales the normal cones still hold at
+
+// binding points of the culling shader's buffers. the uniform binding sits above the light shadow
+// block, the storage bindings above the post chain's exposure
+const GLuint CLUSTER_VIEW_BINDING = 2;
+const GLuint CLUSTER_DRAW_BINDING = 1;
+const GLuint CLUSTER_MESHLET_BINDING = 2;
+const GLuint CLUSTER_STATISTICS_BINDING = 3;
+
+// the parameters glMultiDrawElementsIndirect reads per draw
+struct DrawElementsIndirectCommand {
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+
+// Culls the meshlets of dense meshes on the GPU before they are drawn. For every visible draw of a
+// mesh with meshlets, a compute dispatch tests each meshlet of the level being drawn against the
+// view frustum and its normal cone against the camera position, and writes one indirect draw
+// command per meshlet: its index range if it survives, an empty draw if not. The passes then draw
+// the mesh with one glMultiDrawElementsIndirect over those commands, so off-screen and back-facing
+// clusters never reach the rasterizer and the CPU never learns which ones did. How many meshlets and
+// triangles survived is counted on the GPU and read back CLUSTER_STATISTICS_FRAMES frames later for
+// the report; the triangles counter of the frame only knows what was submitted.
+// Shadow passes draw the whole level, as the cones only hold for the camera's point of view.
+class ClusterCulling {
+public:
+	ClusterCulling() = default;
+	ClusterCulling(const ClusterCulling&) = delete;
+	ClusterCulling& operator=(const ClusterCulling&) = delete;
+
+	bool create() {
+		shader = new Shader(Shader::compute("./shaders/cull/clusters-cs.glsl"));
+		uniforms.Model = shader->uniformLocation("model");
+		uniforms.Scale = shader->uniformLocation("scale");
+		uniforms.ConeCulling = shader->uniformLocation("coneCulling");
+		uniforms.MeshletOffset = shader->uniformLocation("meshletOffset");
+		uniforms.MeshletCount = shader->uniformLocation("meshletCount");
+		uniforms.DrawOffset = shader->uniformLocation("drawOffset");
+		uniforms.StatisticsSlot = shader->uniformLocation("statisticsSlot");
+
+		// the draw commands stay bound for the indirect draws and for the shader to write
+		glGenBuffers(1, &drawBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, CLUSTER_MAX_DRAWS * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_DRAW_BINDING, drawBuffer);
+
+		glGenBuffers(1, &viewBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, viewBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewBlock), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_VIEW_BINDING, viewBuffer);
+
+		FrameStatistics counts[CLUSTER_STATISTICS_FRAMES] = {};
+		glGenBuffers(1, &statisticsBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, statisticsBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counts), counts, GL_DYNAMIC_READ);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_STATISTICS_BINDING, statisticsBuffer);
+		trackGpuMemory(bufferBytes());
+		return true;
+	}
+
+	// waits for the counts still in flight, then frees everything
+	void destroy() {
+		for (unsigned int i = 0; i < CLUSTER_STATISTICS_FRAMES; i++) {
+			readStatistics(i);
+		}
+		if (shader) {
+			glDeleteProgram(shader->ID);
+			delete shader;
+			shader = nullptr;
+		}
+		if (drawBuffer) {
+			glDeleteBuffers(1, &drawBuffer);
+			glDeleteBuffers(1, &viewBuffer);
+			glDeleteBuffers(1, &statisticsBuffer);
+			trackGpuMemory(-bufferBytes());
+			drawBuffer = viewBuffer = statisticsBuffer = 0;
+		}
+	}
+
+	bool enabled() const {
+		return shader != nullptr;
+	}
+
+	// main thread, once per frame before the first recordCull: the view the clusters are tested from
+	void recordBegin(CommandBuffer& commands, const Frustum& frustum, const glm::vec3& viewPosition) {
+		ViewBlock view;
+		std::memcpy(view.Planes, frustum.Planes, sizeof(view.Planes));
+		view.ViewPosition = glm::vec4(viewPosition, 1.0f);
+		commands.bufferSubData(GL_UNIFORM_BUFFER, viewBuffer, &view, sizeof(view));
+		commands.callback(&ClusterCulling::beginCommand, this, slot);
+		commands.useProgram(shader->ID);
+		commands.setInt(uniforms.StatisticsSlot, (int)slot);
+		recordedDraws = 0;
+		boundMeshlets = 0;
+	}
+
+	// records the test of the meshlets of mesh's level lod drawn with world, right after recordBegin
+	// or another recordCull. returns the first of the level's draw commands, or CLUSTER_NONE when
+	// the level has no meshlets or the frame's commands ran out and it has to be drawn whole
+	uint32_t recordCull(CommandBuffer& commands, const Mesh& mesh, uint32_t lod, const glm::mat4& world) {
+		if (!mesh.MeshletBuffer || lod >= mesh.LodCount) {
+			return CLUSTER_NONE;
+		}
+		const MeshLevel& level = mesh.Lods[lod];
+		if (level.MeshletCount == 0 || recordedDraws + level.MeshletCount > CLUSTER_MAX_DRAWS) {
+			return CLUSTER_NONE;
+		}
+		if (mesh.MeshletBuffer != boundMeshlets) {
+			commands.bindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_MESHLET_BINDING, mesh.MeshletBuffer);
+			boundMeshlets = mesh.MeshletBuffer;
+		}
+		float scales[3] = { glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) };
+		float largest = std::max(scales[0], std::max(scales[1], scales[2]));
+		float smallest = std::min(scales[0], std::min(scales[1], scales[2]));
+		commands.setMat4(uniforms.Model, world);
+		commands.setFloat(uniforms.Scale, largest);
+		commands.setInt(uniforms.ConeCulling, smallest > 0.0f && largest <= smallest * CLUSTER_UNIFORM_SCALE);
+		commands.setInt(uniforms.MeshletOffset, (int)level.MeshletOffset);
+		commands.setInt(uniforms.MeshletCount, (int)level.MeshletCount);
+		commands.setInt(uniforms.DrawOffset, (int)recordedDraws);
+		commands.dispatchCompute((level.MeshletCount + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1);
+
+		uint32_t first = recordedDraws;
+		recordedDraws += level.MeshletCount;
+		return first;
+	}
+
+	// main thread, after the last recordCull: the commands are ready once the barrier has passed,
+	// and the statistics for the glGetBufferSubData and glBufferSubData that read and clear them
+	void recordEnd(CommandBuffer& commands) {
+		commands.memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+		commands.callback(&ClusterCulling::endCommand, this, (uint64_t)recordedDraws << 32 | slot);
+		slot = (slot + 1) % CLUSTER_STATISTICS_FRAMES;
+	}
+
+	// draws what survived of the level recordCull returned firstDraw for, its vertex array bound.
+	// the triangle counter gets the whole level as submitted, averageDrawnTriangles has the survivors
+	void recordDraw(CommandBuffer& commands, const Mesh& mesh, uint32_t lod, uint32_t firstDraw) const {
+		const MeshLevel& level = mesh.Lods[lod];
+		commands.multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (uint64_t)firstDraw * sizeof(DrawElementsIndirectCommand),
+			(GLsizei)level.MeshletCount);
+		commands.addCounter(COUNTER_TRIANGLES, level.IndexCount / 3);
+		commands.addCounter(COUNTER_FULL_DETAIL_TRIANGLES, mesh.IndexCount / 3);
+	}
+
+	// meshlets tested and drawn per frame, over the frames read back so far. render thread, or any
+	// thread once it has stopped
+	double averageTested() const {
+		return framesRead > 0 ? (double)testedTotal / framesRead : 0.0;
+	}
+
+	double averageDrawn() const {
+		return framesRead > 0 ? (double)drawnTotal / framesRead : 0.0;
+	}
+
+	// triangles of the meshlets drawn per frame, counted once per cull however many passes draw them
+	double averageDrawnTriangles() const {
+		return framesRead > 0 ? (double)drawnTrianglesTotal / framesRead : 0.0;
+	}
+
+private:
+	struct Uniforms {
+		GLint Model = -1;
+		GLint Scale = -1;
+		GLint ConeCulling = -1;
+		GLint MeshletOffset = -1;
+		GLint MeshletCount = -1;
+		GLint DrawOffset = -1;
+		GLint StatisticsSlot = -1;
+	};
+
+	// std140 layout of the ClusterView block
+	struct ViewBlock {
+		glm::vec4 Planes[6];
+		glm::vec4 ViewPosition;
+	};
+
+	// std430 layout of a statistics slot
+	struct FrameStatistics {
+		uint32_t Meshlets;
+		uint32_t Triangles;
+	};
+
+	Shader* shader = nullptr;
+	Uniforms uniforms;
+	GLuint drawBuffer = 0;
+	GLuint viewBuffer = 0;
+	GLuint statisticsBuffer = 0;
+
+	// main thread
+	uint32_t slot = 0;             // statistics slot of the frame being recorded
+	uint32_t recordedDraws = 0;    // draw commands handed out this frame, one per meshlet tested
+	GLuint boundMeshlets = 0;
+
+	// render thread
+	GLsync fences[CLUSTER_STATISTICS_FRAMES] = {};
+	uint32_t tested[CLUSTER_STATISTICS_FRAMES] = {};
+	uint64_t testedTotal = 0;
+	uint64_t drawnTotal = 0;
+	uint64_t drawnTrianglesTotal = 0;
+	uint64_t framesRead = 0;
+
+	static int64_t bufferBytes() {
+		return (int64_t)(CLUSTER_MAX_DRAWS * sizeof(DrawElementsIndirectCommand) + sizeof(ViewBlock) + CLUSTER_STATISTICS_FRAMES * sizeof(FrameStatistics));
+	}
+
+	// adds up the counts in index once the frame that wrote it has finished, which it has long since
+	// done by the time the slot comes round again
+	void readStatistics(unsigned int index) {
+		GLsync& fence = fences[index];
+		if (!fence) {
+			return;
+		}
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0));
+		glDeleteSync(fence);
+		fence = 0;
+		FrameStatistics drawn = {};
+		glBindBuffer(GL_COPY_READ_BUFFER, statisticsBuffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, index * sizeof(FrameStatistics), sizeof(FrameStatistics), &drawn);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		testedTotal += tested[index];
+		drawnTotal += drawn.Meshlets;
+		drawnTrianglesTotal += drawn.Triangles;
+		framesRead++;
+	}
+
+	// the slot is read back and cleared before this frame counts into it
+	static void beginCommand(void* user, uint64_t index) {
+		ClusterCulling* culling = static_cast<ClusterCulling*>(user);
+		culling->readStatistics((unsigned int)index);
+		FrameStatistics zero = {};
+		glBindBuffer(GL_COPY_WRITE_BUFFER, culling->statisticsBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, index * sizeof(FrameStatistics), sizeof(FrameStatistics), &zero);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	static void endCommand(void* user, uint64_t argument) {
+		ClusterCulling* culling = static_cast<ClusterCulling*>(user);
+		unsigned int index = (unsigned int)(argument & 0xFFFFFFFFu);
+		culling->tested[index] = (uint32_t)(argument >> 32);
+		culling->fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+};
+
+#endif
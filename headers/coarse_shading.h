@@ -0,0 +1,186 @@
+#ifndef COARSE_SHADING_H
+#define COARSE_SHADING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "command_buffer.h"
+#include "render_stats.h"
+#include "render_target.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// how many pixels per axis share one evaluation of the point and spot lights
+enum coarseShadingRate {
+	COARSE_SHADING_OFF,        // every pixel runs the whole lighting function
+	COARSE_SHADING_HALF,       // one lighting sample per 2x2 pixels
+	COARSE_SHADING_QUARTER,    // one per 4x4
+	COARSE_SHADING_RATE_COUNT
+};
+
+inline const char* coarseShadingRateName(coarseShadingRate rate) {
+	static const char* names[COARSE_SHADING_RATE_COUNT] = { "off", "half", "quarter" };
+	return names[rate];
+}
+
+inline bool parseCoarseShadingRate(const std::string& name, coarseShadingRate& rate) {
+	for (unsigned int i = 0; i < COARSE_SHADING_RATE_COUNT; i++) {
+		if (name == coarseShadingRateName((coarseShadingRate)i)) {
+			rate = (coarseShadingRate)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+inline int coarseShadingDivisor(coarseShadingRate rate) {
+	return 1 << (int)rate;
+}
+
+// texture units the lit shaders built with COARSE_LIGHTING read the buffer from, clear of the
+// material, shadow, post and TAA units
+const GLenum COARSE_DIFFUSE_UNIT = 10;
+const GLenum COARSE_SPECULAR_UNIT = 11;
+const GLenum COARSE_GEOMETRY_UNIT = 12;
+
+// Software coarse shading for materials whose lighting changes slowly across their surface. Their
+// geometry is drawn twice: first into this buffer at a fraction of the render size by the
+// COARSE_PASS build of their shader, which evaluates only the point lights and the flashlight, the
+// expensive part with its loop and shadow lookups, and stores the diffuse and specular light apart
+// from the material together with the normal and view depth. The main pass then draws them with
+// the COARSE_LIGHTING build, which keeps the directional light per pixel and upsamples the rest
+// with a bilateral filter that only mixes coarse samples of the same surface, before applying the
+// full resolution texture maps. Size changes are recorded like RenderTarget's.
+class CoarseShading {
+public:
+	GLuint DiffuseTexture = 0;    // point and spot light reaching each coarse texel
+	GLuint SpecularTexture = 0;
+	GLuint GeometryTexture = 0;   // normal and view depth
+
+	CoarseShading() = default;
+	CoarseShading(const CoarseShading&) = delete;
+	CoarseShading& operator=(const CoarseShading&) = delete;
+
+	// width and height of the full scene target, the buffer is a divisor smaller
+	bool create(int width, int height, coarseShadingRate shadingRate, depthMode mode) {
+		rate = shadingRate;
+		depthFormat = mode == DEPTH_REVERSED ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+		depthType = mode == DEPTH_REVERSED ? GL_FLOAT : GL_UNSIGNED_INT;
+
+		glGenFramebuffers(1, &framebuffer);
+		glGenTextures(1, &DiffuseTexture);
+		glGenTextures(1, &SpecularTexture);
+		glGenTextures(1, &GeometryTexture);
+		glGenTextures(1, &depthTexture);
+		for (GLuint texture : { DiffuseTexture, SpecularTexture, GeometryTexture, depthTexture }) {
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		}
+		allocate(width, height);
+
+		GLenum buffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, DiffuseTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, SpecularTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, GeometryTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		glDrawBuffers(3, buffers);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::COARSE_SHADING::FRAMEBUFFER_INCOMPLETE " << status << std::endl;
+			destroy();
+			return false;
+		}
+		recordedWidth = width;
+		recordedHeight = height;
+		return true;
+	}
+
+	void destroy() {
+		if (!framebuffer) {
+			return;
+		}
+		glDeleteFramebuffers(1, &framebuffer);
+		GLuint textures[4] = { DiffuseTexture, SpecularTexture, GeometryTexture, depthTexture };
+		glDeleteTextures(4, textures);
+		trackGpuMemory(-allocatedBytes);
+		framebuffer = DiffuseTexture = SpecularTexture = GeometryTexture = depthTexture = 0;
+		allocatedBytes = 0;
+	}
+
+	bool enabled() const {
+		return framebuffer != 0;
+	}
+
+	// coarse texels covering size pixels
+	int coarseSize(int size) const {
+		int divisor = coarseShadingDivisor(rate);
+		return (size + divisor - 1) / divisor;
+	}
+
+	// main thread: reallocates the buffer at this point of the frame if the scene size changed
+	void recordResize(CommandBuffer& commands, int width, int height) {
+		if (width == recordedWidth && height == recordedHeight) {
+			return;
+		}
+		recordedWidth = width;
+		recordedHeight = height;
+		commands.callback(&CoarseShading::resizeCallback, this, ((uint64_t)(uint32_t)width << 32) | (uint32_t)height);
+	}
+
+	// binds and clears the part of the buffer covering the renderWidth x renderHeight scene, the
+	// coarse materials are drawn next with the same camera
+	void recordBeginPass(CommandBuffer& commands, int renderWidth, int renderHeight) {
+		commands.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		commands.viewport(0, 0, coarseSize(renderWidth), coarseSize(renderHeight));
+		// a zero view depth in the geometry marks texels nothing was drawn into
+		commands.clear(glm::vec4(0.0f), GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	// the buffer for the main pass, on the units the COARSE_LIGHTING shaders read it from
+	void recordBindTextures(CommandBuffer& commands) {
+		commands.bindTexture(GL_TEXTURE0 + COARSE_DIFFUSE_UNIT, GL_TEXTURE_2D, DiffuseTexture);
+		commands.bindTexture(GL_TEXTURE0 + COARSE_SPECULAR_UNIT, GL_TEXTURE_2D, SpecularTexture);
+		commands.bindTexture(GL_TEXTURE0 + COARSE_GEOMETRY_UNIT, GL_TEXTURE_2D, GeometryTexture);
+	}
+
+private:
+	coarseShadingRate rate = COARSE_SHADING_OFF;
+	GLuint framebuffer = 0;
+	GLuint depthTexture = 0;
+	GLenum depthFormat = GL_DEPTH_COMPONENT32F;
+	GLenum depthType = GL_FLOAT;
+	int recordedWidth = 0;     // size as of the last recorded command, main thread only
+	int recordedHeight = 0;
+	int64_t allocatedBytes = 0;
+
+	void allocate(int width, int height) {
+		width = coarseSize(width > 0 ? width : 1);
+		height = coarseSize(height > 0 ? height : 1);
+		glBindTexture(GL_TEXTURE_2D, DiffuseTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+		glBindTexture(GL_TEXTURE_2D, SpecularTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+		glBindTexture(GL_TEXTURE_2D, GeometryTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, depthFormat, width, height, 0, GL_DEPTH_COMPONENT, depthType, nullptr);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// two packed colours, a half float vec4 and depth
+		int64_t bytes = (int64_t)width * height * (4 + 4 + 8 + 4);
+		trackGpuMemory(bytes - allocatedBytes);
+		allocatedBytes = bytes;
+	}
+
+	static void resizeCallback(void* user, uint64_t size) {
+		static_cast<CoarseShading*>(user)->allocate((int)(size >> 32), (int)(size & 0xFFFFFFFFu));
+	}
+};
+
+#endif
@@ -0,0 +1,527 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "render_stats.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+
+// Render commands recorded on the main thread and replayed on the render thread.
+// Commands are plain structs written back to back into a fixed linear arena, so recording
+// a frame never allocates and replaying it is a single forward walk over memory.
+
+enum commandType : uint32_t {
+	CMD_CLEAR,
+	CMD_VIEWPORT,
+	CMD_USE_PROGRAM,
+	CMD_UNIFORM_INT,
+	CMD_UNIFORM_FLOAT,
+	CMD_UNIFORM_VEC2,
+	CMD_UNIFORM_VEC3,
+	CMD_UNIFORM_MAT3,
+	CMD_UNIFORM_MAT4,
+	CMD_BIND_TEXTURE,
+	CMD_BIND_VERTEX_ARRAY,
+	CMD_DRAW_ARRAYS,
+	CMD_DRAW_ELEMENTS,
+	CMD_MULTI_DRAW_ELEMENTS_INDIRECT,
+	CMD_BIND_FRAMEBUFFER,
+	CMD_BLIT_FRAMEBUFFER,
+	CMD_BUFFER_SUB_DATA,
+	CMD_BIND_IMAGE_TEXTURE,
+	CMD_BIND_BUFFER_BASE,
+	CMD_DISPATCH_COMPUTE,
+	CMD_MEMORY_BARRIER,
+	CMD_CALLBACK
+};
+
+struct CommandHeader {
+	uint32_t Type;
+	uint32_t Size;  // including the header, keeps the next command 8-byte aligned
+};
+
+struct ClearCommand {
+	float Color[4];
+	GLbitfield Mask;
+};
+
+struct ViewportCommand {
+	GLint X, Y;
+	GLsizei Width, Height;
+};
+
+struct UseProgramCommand {
+	GLuint Program;
+};
+
+struct UniformIntCommand {
+	GLint Location;
+	GLint Value;
+};
+
+struct UniformFloatCommand {
+	GLint Location;
+	GLfloat Value;
+};
+
+struct UniformVec2Command {
+	GLint Location;
+	GLfloat Value[2];
+};
+
+struct UniformVec3Command {
+	GLint Location;
+	GLfloat Value[3];
+};
+
+struct UniformMat3Command {
+	GLint Location;
+	GLfloat Value[9];
+};
+
+struct UniformMat4Command {
+	GLint Location;
+	GLfloat Value[16];
+};
+
+struct BindTextureCommand {
+	GLenum Unit;
+	GLenum Target;
+	GLuint Texture;
+};
+
+struct BindVertexArrayCommand {
+	GLuint VertexArray;
+};
+
+struct DrawArraysCommand {
+	GLenum Mode;
+	GLint First;
+	GLsizei Count;
+};
+
+// indices come from the element buffer of the bound vertex array, Offset bytes in
+struct DrawElementsCommand {
+	GLenum Mode;
+	GLsizei Count;
+	GLenum Type;
+	uint64_t Offset;
+};
+
+// DrawCount draws whose parameters the GPU reads from the bound draw indirect buffer, Offset bytes in
+struct MultiDrawElementsIndirectCommand {
+	GLenum Mode;
+	GLenum Type;
+	uint64_t Offset;
+	GLsizei DrawCount;
+};
+
+struct BindFramebufferCommand {
+	GLenum Target;
+	GLuint Framebuffer;
+};
+
+// copies a rectangle from one framebuffer to another, rebinding the read and draw targets
+struct BlitFramebufferCommand {
+	GLuint Read, Draw;
+	GLint SourceWidth, SourceHeight;
+	GLint DestinationWidth, DestinationHeight;
+	GLbitfield Mask;
+	GLenum Filter;
+};
+
+// replaces the start of a buffer, the data follows the command in the arena
+struct BufferSubDataCommand {
+	GLenum Target;
+	GLuint Buffer;
+	uint32_t Size;
+};
+
+// binds one mip level of a texture for image load/store in compute shaders
+struct BindImageTextureCommand {
+	GLuint Unit;
+	GLuint Texture;
+	GLint Level;
+	GLenum Access;
+	GLenum Format;
+};
+
+struct BindBufferBaseCommand {
+	GLenum Target;
+	GLuint Index;
+	GLuint Buffer;
+};
+
+struct DispatchComputeCommand {
+	GLuint GroupsX, GroupsY, GroupsZ;
+};
+
+struct MemoryBarrierCommand {
+	GLbitfield Barriers;
+};
+
+// runs engine code on the render thread at this point of the frame, e.g. framebuffer readbacks
+typedef void (*CommandFunction)(void* user, uint64_t argument);
+
+struct CallbackCommand {
+	CommandFunction Function;
+	void* User;
+	uint64_t Argument;
+};
+
+const size_t COMMAND_BUFFER_SIZE = 8 * 1024 * 1024;
+
+class CommandBuffer {
+public:
+	explicit CommandBuffer(size_t capacity = COMMAND_BUFFER_SIZE)
+		: memory(new unsigned char[capacity]), capacity(capacity) {
+	}
+
+	void reset() {
+		used = 0;
+		commandCount = 0;
+		overflowed = false;
+		counters = RenderCounters();
+	}
+
+	size_t size() const {
+		return used;
+	}
+
+	uint32_t count() const {
+		return commandCount;
+	}
+
+	// draws, uniform uploads and binds recorded since the last reset
+	const RenderCounters& renderCounters() const {
+		return counters;
+	}
+
+	// for counts only the caller knows, like the triangles a draw would have had at full detail
+	void addCounter(renderCounter counter, uint64_t amount) {
+		// once the buffer has overflowed the rest of the frame is dropped, and not counted either
+		if (!overflowed) {
+			counters.add(counter, amount);
+		}
+	}
+
+	void clear(const glm::vec4& color, GLbitfield mask) {
+		if (ClearCommand* command = push<ClearCommand>(CMD_CLEAR)) {
+			std::memcpy(command->Color, &color[0], sizeof(command->Color));
+			command->Mask = mask;
+		}
+	}
+
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+		if (ViewportCommand* command = push<ViewportCommand>(CMD_VIEWPORT)) {
+			*command = { x, y, width, height };
+		}
+	}
+
+	void useProgram(GLuint program) {
+		if (UseProgramCommand* command = push<UseProgramCommand>(CMD_USE_PROGRAM)) {
+			command->Program = program;
+			counters.add(COUNTER_PROGRAM_BINDS);
+		}
+	}
+
+	// uniform setters take locations resolved up front, see Shader::uniformLocation
+	void setInt(GLint location, int value) {
+		if (UniformIntCommand* command = push<UniformIntCommand>(CMD_UNIFORM_INT)) {
+			*command = { location, value };
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void setFloat(GLint location, float value) {
+		if (UniformFloatCommand* command = push<UniformFloatCommand>(CMD_UNIFORM_FLOAT)) {
+			*command = { location, value };
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void setVec2(GLint location, const glm::vec2& value) {
+		if (UniformVec2Command* command = push<UniformVec2Command>(CMD_UNIFORM_VEC2)) {
+			command->Location = location;
+			std::memcpy(command->Value, &value[0], sizeof(command->Value));
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void setVec3(GLint location, const glm::vec3& value) {
+		if (UniformVec3Command* command = push<UniformVec3Command>(CMD_UNIFORM_VEC3)) {
+			command->Location = location;
+			std::memcpy(command->Value, &value[0], sizeof(command->Value));
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void setMat3(GLint location, const glm::mat3& value) {
+		if (UniformMat3Command* command = push<UniformMat3Command>(CMD_UNIFORM_MAT3)) {
+			command->Location = location;
+			std::memcpy(command->Value, &value[0][0], sizeof(command->Value));
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void setMat4(GLint location, const glm::mat4& value) {
+		if (UniformMat4Command* command = push<UniformMat4Command>(CMD_UNIFORM_MAT4)) {
+			command->Location = location;
+			std::memcpy(command->Value, &value[0][0], sizeof(command->Value));
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void bindTexture(GLenum unit, GLenum target, GLuint texture) {
+		if (BindTextureCommand* command = push<BindTextureCommand>(CMD_BIND_TEXTURE)) {
+			*command = { unit, target, texture };
+			counters.add(COUNTER_TEXTURE_BINDS);
+		}
+	}
+
+	void bindVertexArray(GLuint vertexArray) {
+		if (BindVertexArrayCommand* command = push<BindVertexArrayCommand>(CMD_BIND_VERTEX_ARRAY)) {
+			command->VertexArray = vertexArray;
+			counters.add(COUNTER_VERTEX_ARRAY_BINDS);
+		}
+	}
+
+	void drawArrays(GLenum mode, GLint first, GLsizei count) {
+		if (DrawArraysCommand* command = push<DrawArraysCommand>(CMD_DRAW_ARRAYS)) {
+			*command = { mode, first, count };
+			counters.add(COUNTER_DRAW_CALLS);
+		}
+	}
+
+	void drawElements(GLenum mode, GLsizei count, GLenum type, uint64_t offset = 0) {
+		if (DrawElementsCommand* command = push<DrawElementsCommand>(CMD_DRAW_ELEMENTS)) {
+			*command = { mode, count, type, offset };
+			counters.add(COUNTER_DRAW_CALLS);
+		}
+	}
+
+	void multiDrawElementsIndirect(GLenum mode, GLenum type, uint64_t offset, GLsizei drawCount) {
+		if (MultiDrawElementsIndirectCommand* command = push<MultiDrawElementsIndirectCommand>(CMD_MULTI_DRAW_ELEMENTS_INDIRECT)) {
+			*command = { mode, type, offset, drawCount };
+			counters.add(COUNTER_DRAW_CALLS);
+		}
+	}
+
+	void bindFramebuffer(GLenum target, GLuint framebuffer) {
+		if (BindFramebufferCommand* command = push<BindFramebufferCommand>(CMD_BIND_FRAMEBUFFER)) {
+			*command = { target, framebuffer };
+		}
+	}
+
+	void blitFramebuffer(GLuint read, GLint sourceWidth, GLint sourceHeight, GLuint draw, GLint destinationWidth, GLint destinationHeight,
+		GLbitfield mask, GLenum filter) {
+		if (BlitFramebufferCommand* command = push<BlitFramebufferCommand>(CMD_BLIT_FRAMEBUFFER)) {
+			*command = { read, draw, sourceWidth, sourceHeight, destinationWidth, destinationHeight, mask, filter };
+		}
+	}
+
+	// copies size bytes into the command buffer, so data may change as soon as this returns
+	void bufferSubData(GLenum target, GLuint buffer, const void* data, uint32_t size) {
+		if (BufferSubDataCommand* command = push<BufferSubDataCommand>(CMD_BUFFER_SUB_DATA, size)) {
+			*command = { target, buffer, size };
+			std::memcpy(command + 1, data, size);
+			counters.add(COUNTER_UNIFORM_UPLOADS);
+		}
+	}
+
+	void bindImageTexture(GLuint unit, GLuint texture, GLint level, GLenum access, GLenum format) {
+		if (BindImageTextureCommand* command = push<BindImageTextureCommand>(CMD_BIND_IMAGE_TEXTURE)) {
+			*command = { unit, texture, level, access, format };
+			counters.add(COUNTER_TEXTURE_BINDS);
+		}
+	}
+
+	// binds a uniform or shader storage buffer to an indexed binding point
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+		if (BindBufferBaseCommand* command = push<BindBufferBaseCommand>(CMD_BIND_BUFFER_BASE)) {
+			*command = { target, index, buffer };
+		}
+	}
+
+	void dispatchCompute(GLuint groupsX, GLuint groupsY, GLuint groupsZ = 1) {
+		if (DispatchComputeCommand* command = push<DispatchComputeCommand>(CMD_DISPATCH_COMPUTE)) {
+			*command = { groupsX, groupsY, groupsZ };
+			counters.add(COUNTER_DISPATCHES);
+		}
+	}
+
+	// makes writes of earlier dispatches visible to the kinds of access in barriers
+	void memoryBarrier(GLbitfield barriers) {
+		if (MemoryBarrierCommand* command = push<MemoryBarrierCommand>(CMD_MEMORY_BARRIER)) {
+			command->Barriers = barriers;
+		}
+	}
+
+	void callback(CommandFunction function, void* user, uint64_t argument = 0) {
+		if (CallbackCommand* command = push<CallbackCommand>(CMD_CALLBACK)) {
+			*command = { function, user, argument };
+		}
+	}
+
+	// issues every recorded command, must run on the thread that owns the GL context
+	void execute() const {
+		size_t offset = 0;
+		while (offset < used) {
+			const CommandHeader* header = reinterpret_cast<const CommandHeader*>(memory.get() + offset);
+			const void* data = header + 1;
+
+			switch (header->Type) {
+			case CMD_CLEAR: {
+				const ClearCommand* command = static_cast<const ClearCommand*>(data);
+				glClearColor(command->Color[0], command->Color[1], command->Color[2], command->Color[3]);
+				glClear(command->Mask);
+				break;
+			}
+			case CMD_VIEWPORT: {
+				const ViewportCommand* command = static_cast<const ViewportCommand*>(data);
+				glViewport(command->X, command->Y, command->Width, command->Height);
+				break;
+			}
+			case CMD_USE_PROGRAM:
+				glUseProgram(static_cast<const UseProgramCommand*>(data)->Program);
+				break;
+			case CMD_UNIFORM_INT: {
+				const UniformIntCommand* command = static_cast<const UniformIntCommand*>(data);
+				glUniform1i(command->Location, command->Value);
+				break;
+			}
+			case CMD_UNIFORM_FLOAT: {
+				const UniformFloatCommand* command = static_cast<const UniformFloatCommand*>(data);
+				glUniform1f(command->Location, command->Value);
+				break;
+			}
+			case CMD_UNIFORM_VEC2: {
+				const UniformVec2Command* command = static_cast<const UniformVec2Command*>(data);
+				glUniform2fv(command->Location, 1, command->Value);
+				break;
+			}
+			case CMD_UNIFORM_VEC3: {
+				const UniformVec3Command* command = static_cast<const UniformVec3Command*>(data);
+				glUniform3fv(command->Location, 1, command->Value);
+				break;
+			}
+			case CMD_UNIFORM_MAT3: {
+				const UniformMat3Command* command = static_cast<const UniformMat3Command*>(data);
+				glUniformMatrix3fv(command->Location, 1, GL_FALSE, command->Value);
+				break;
+			}
+			case CMD_UNIFORM_MAT4: {
+				const UniformMat4Command* command = static_cast<const UniformMat4Command*>(data);
+				glUniformMatrix4fv(command->Location, 1, GL_FALSE, command->Value);
+				break;
+			}
+			case CMD_BIND_TEXTURE: {
+				const BindTextureCommand* command = static_cast<const BindTextureCommand*>(data);
+				glActiveTexture(command->Unit);
+				glBindTexture(command->Target, command->Texture);
+				break;
+			}
+			case CMD_BIND_VERTEX_ARRAY:
+				glBindVertexArray(static_cast<const BindVertexArrayCommand*>(data)->VertexArray);
+				break;
+			case CMD_DRAW_ARRAYS: {
+				const DrawArraysCommand* command = static_cast<const DrawArraysCommand*>(data);
+				glDrawArrays(command->Mode, command->First, command->Count);
+				break;
+			}
+			case CMD_DRAW_ELEMENTS: {
+				const DrawElementsCommand* command = static_cast<const DrawElementsCommand*>(data);
+				glDrawElements(command->Mode, command->Count, command->Type, reinterpret_cast<const void*>((uintptr_t)command->Offset));
+				break;
+			}
+			case CMD_MULTI_DRAW_ELEMENTS_INDIRECT: {
+				const MultiDrawElementsIndirectCommand* command = static_cast<const MultiDrawElementsIndirectCommand*>(data);
+				glMultiDrawElementsIndirect(command->Mode, command->Type, reinterpret_cast<const void*>((uintptr_t)command->Offset), command->DrawCount, 0);
+				break;
+			}
+			case CMD_BIND_FRAMEBUFFER: {
+				const BindFramebufferCommand* command = static_cast<const BindFramebufferCommand*>(data);
+				glBindFramebuffer(command->Target, command->Framebuffer);
+				break;
+			}
+			case CMD_BLIT_FRAMEBUFFER: {
+				const BlitFramebufferCommand* command = static_cast<const BlitFramebufferCommand*>(data);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, command->Read);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, command->Draw);
+				glBlitFramebuffer(0, 0, command->SourceWidth, command->SourceHeight, 0, 0, command->DestinationWidth, command->DestinationHeight,
+					command->Mask, command->Filter);
+				break;
+			}
+			case CMD_BUFFER_SUB_DATA: {
+				const BufferSubDataCommand* command = static_cast<const BufferSubDataCommand*>(data);
+				glBindBuffer(command->Target, command->Buffer);
+				glBufferSubData(command->Target, 0, command->Size, command + 1);
+				break;
+			}
+			case CMD_BIND_IMAGE_TEXTURE: {
+				const BindImageTextureCommand* command = static_cast<const BindImageTextureCommand*>(data);
+				glBindImageTexture(command->Unit, command->Texture, command->Level, GL_FALSE, 0, command->Access, command->Format);
+				break;
+			}
+			case CMD_BIND_BUFFER_BASE: {
+				const BindBufferBaseCommand* command = static_cast<const BindBufferBaseCommand*>(data);
+				glBindBufferBase(command->Target, command->Index, command->Buffer);
+				break;
+			}
+			case CMD_DISPATCH_COMPUTE: {
+				const DispatchComputeCommand* command = static_cast<const DispatchComputeCommand*>(data);
+				glDispatchCompute(command->GroupsX, command->GroupsY, command->GroupsZ);
+				break;
+			}
+			case CMD_MEMORY_BARRIER:
+				glMemoryBarrier(static_cast<const MemoryBarrierCommand*>(data)->Barriers);
+				break;
+			case CMD_CALLBACK: {
+				const CallbackCommand* command = static_cast<const CallbackCommand*>(data);
+				command->Function(command->User, command->Argument);
+				break;
+			}
+			}
+
+			offset += header->Size;
+		}
+	}
+
+private:
+	std::unique_ptr<unsigned char[]> memory;
+	size_t capacity;
+	size_t used = 0;
+	uint32_t commandCount = 0;
+	bool overflowed = false;
+	RenderCounters counters;
+
+	// payload bytes are reserved right after the command for commands that carry data
+	template <typename T>
+	T* push(commandType type, size_t payload = 0) {
+		static_assert(std::is_trivially_copyable<T>::value, "commands must be plain data");
+		const uint32_t size = (uint32_t)((sizeof(CommandHeader) + sizeof(T) + payload + 7) & ~size_t(7));
+		if (used + size > capacity) {
+			// drop the rest of the frame rather than grow mid-frame
+			if (!overflowed) {
+				std::cout << "ERROR::COMMAND_BUFFER::OUT_OF_MEMORY" << std::endl;
+				overflowed = true;
+			}
+			return nullptr;
+		}
+
+		CommandHeader* header = reinterpret_cast<CommandHeader*>(memory.get() + used);
+		header->Type = type;
+		header->Size = size;
+		used += size;
+		commandCount++;
+		return reinterpret_cast<T*>(header + 1);
+	}
+};
+
+#endif
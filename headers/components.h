@@ -0,0 +1,119 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "command_buffer.h"
+
+#include <cstdint>
+
+struct ProgramUniforms;
+
+// Components attached to scene entities. They are plain data so the registry can
+// move them between archetype chunks with memcpy.
+
+// places the entity in the scene graph, which owns the transform hierarchy
+struct Transform {
+	uint32_t Node;
+};
+
+// draws the entity with a mesh and a material from the tables below
+struct Renderable {
+	uint32_t Mesh;
+	uint32_t Material;
+};
+
+// oscillates the local position along MoveDirection around BasePosition and spins the node around SpinAxis
+struct Animation {
+	glm::vec3 BasePosition;
+	glm::vec3 MoveDirection;
+	glm::vec3 SpinAxis;
+	float SpinSpeed;
+};
+
+// point lights take their position from the entity's world transform
+struct PointLight {
+	glm::vec3 Ambient;
+	glm::vec3 Diffuse;
+	glm::vec3 Specular;
+	float Constant;
+	float Linear;
+	float Quadratic;
+};
+
+struct DirectionalLight {
+	glm::vec3 Direction;
+	glm::vec3 Ambient;
+	glm::vec3 Diffuse;
+	glm::vec3 Specular;
+};
+
+// the flashlight follows the camera, so it carries its own position and direction
+struct SpotLight {
+	glm::vec3 Position;
+	glm::vec3 Direction;
+	glm::vec3 Ambient;
+	glm::vec3 Diffuse;
+	glm::vec3 Specular;
+	float Constant;
+	float Linear;
+	float Quadratic;
+	float CutOff;
+	float OuterCutOff;
+	bool Enabled;
+};
+
+const uint32_t MESH_MAX_LODS = 8;  // levels of detail a Mesh holds, the full mesh included
+
+// a range of the element buffer drawn in place of the full mesh, and the meshlets it is split into
+struct MeshLevel {
+	GLsizei FirstIndex;
+	GLsizei IndexCount;
+	float Error;            // object space distance from the full mesh
+	uint32_t MeshletOffset;
+	uint32_t MeshletCount;
+};
+
+// resources referenced by index from Renderable
+struct Mesh {
+	GLuint VAO;
+	GLsizei VertexCount;
+	float BoundingRadius;   // around the local origin
+	GLsizei IndexCount = 0; // imported meshes are drawn from 32-bit indices in the VAO's element buffer
+	uint32_t LodCount = 0;  // levels in Lods, level 0 is the full mesh; below 2 there is nothing to choose
+	MeshLevel Lods[MESH_MAX_LODS] = {};
+	GLuint MeshletBuffer = 0;   // every level's meshlets as MeshFileMeshlet records, for cluster culling
+};
+
+// records the draw of a mesh whose vertex array is bound, at level of detail lod where it has one
+// the triangle counters are kept here so drawn and full detail cover the same draws
+inline void recordDrawMesh(CommandBuffer& commands, const Mesh& mesh, uint32_t lod = 0) {
+	GLsizei fullDetail = mesh.IndexCount > 0 ? mesh.IndexCount : mesh.VertexCount;
+	if (lod > 0 && lod < mesh.LodCount) {
+		const MeshLevel& level = mesh.Lods[lod];
+		commands.drawElements(GL_TRIANGLES, level.IndexCount, GL_UNSIGNED_INT, (uint64_t)level.FirstIndex * sizeof(uint32_t));
+		commands.addCounter(COUNTER_TRIANGLES, level.IndexCount / 3);
+	}
+	else if (mesh.IndexCount > 0) {
+		commands.drawElements(GL_TRIANGLES, mesh.IndexCount, GL_UNSIGNED_INT);
+		commands.addCounter(COUNTER_TRIANGLES, mesh.IndexCount / 3);
+	}
+	else {
+		commands.drawArrays(GL_TRIANGLES, 0, mesh.VertexCount);
+		commands.addCounter(COUNTER_TRIANGLES, mesh.VertexCount / 3);
+	}
+	commands.addCounter(COUNTER_FULL_DETAIL_TRIANGLES, fullDetail / 3);
+}
+
+struct Material {
+	const ProgramUniforms* Program;
+	GLuint Diffuse;
+	GLuint Specular;
+	bool Lit;
+	// with coarse shading, the program that shades the point and spot lighting into the lighting
+	// buffer first; Program then reads it back. null lights every pixel in full
+	const ProgramUniforms* CoarsePass = nullptr;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+// view frustum as six inward-facing planes (xyz = normal, w = distance)
+struct Frustum {
+	glm::vec4 Planes[6];
+};
+
+// extracts the planes straight from a view-projection matrix (Gribb & Hartmann). zeroToOneDepth is
+// for projections built for a [0, 1] clip depth range; with reversed depth the last two planes swap
+// places, and an infinite far plane comes out as 0 = near, which every point passes
+inline Frustum extractFrustum(const glm::mat4& viewProjection, bool zeroToOneDepth = false) {
+	glm::mat4 m = glm::transpose(viewProjection);
+	Frustum frustum;
+	frustum.Planes[0] = m[3] + m[0];   // left
+	frustum.Planes[1] = m[3] - m[0];   // right
+	frustum.Planes[2] = m[3] + m[1];   // bottom
+	frustum.Planes[3] = m[3] - m[1];   // top
+	frustum.Planes[4] = zeroToOneDepth ? m[2] : m[3] + m[2];   // near
+	frustum.Planes[5] = m[3] - m[2];   // far
+
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(frustum.Planes[i]));
+		if (length > 0.0f) {
+			frustum.Planes[i] /= length;
+		}
+	}
+	return frustum;
+}
+
+inline bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius) {
+	for (int i = 0; i < 6; i++) {
+		if (glm::dot(glm::vec3(frustum.Planes[i]), center) + frustum.Planes[i].w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// bounding sphere of an origin-centred local sphere after a world transform
+inline glm::vec4 worldBoundingSphere(const glm::mat4& world, float radius) {
+	float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	return glm::vec4(glm::vec3(world[3]), radius * scale);
+}
+
+#endif
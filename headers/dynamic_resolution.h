@@ -0,0 +1,73 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <cmath>
+#include <cstdint>
+
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;     // per axis, a quarter of the pixels
+const float DYNAMIC_RESOLUTION_HEADROOM = 0.9f;      // share of the budget the controller aims for
+const float DYNAMIC_RESOLUTION_DOWN_RATE = 0.6f;     // fraction of the step taken when over budget
+const float DYNAMIC_RESOLUTION_UP_RATE = 0.2f;       // and when under, so it backs off fast and recovers slowly
+const float DYNAMIC_RESOLUTION_DEADBAND = 0.02f;     // smaller scale changes are ignored
+const unsigned int DYNAMIC_RESOLUTION_SETTLE_FRAMES = 6;  // GPU timings lag a few frames behind
+
+// Picks the fraction of the output resolution the scene is rendered at from the GPU frame time, so
+// heavy frames lose sharpness instead of missing the budget. GPU time is treated as proportional to
+// the pixel count: the scale that would just fit is scale * sqrt(target / time), and the controller
+// moves part of the way there. After every change it waits until the profiler reports frames that
+// were rendered at the new size, otherwise the latency of the timer queries makes it oscillate.
+class DynamicResolution {
+public:
+	// budget in milliseconds, 0 keeps the full resolution
+	void configure(float budgetMs) {
+		budget = budgetMs;
+		scale = 1.0f;
+		settle = 0;
+	}
+
+	bool enabled() const {
+		return budget > 0.0f;
+	}
+
+	float budgetMs() const {
+		return budget;
+	}
+
+	// once per frame with the newest GPU frame time, returns the scale to render this frame at
+	float update(double gpuMs) {
+		if (!enabled() || gpuMs <= 0.0) {
+			return scale;
+		}
+		if (settle > 0) {
+			settle--;
+			return scale;
+		}
+
+		float fit = scale * std::sqrt(budget * DYNAMIC_RESOLUTION_HEADROOM / (float)gpuMs);
+		float rate = fit < scale ? DYNAMIC_RESOLUTION_DOWN_RATE : DYNAMIC_RESOLUTION_UP_RATE;
+		float next = scale + (fit - scale) * rate;
+		next = next < DYNAMIC_RESOLUTION_MIN_SCALE ? DYNAMIC_RESOLUTION_MIN_SCALE : (next > 1.0f ? 1.0f : next);
+		if (std::fabs(next - scale) >= DYNAMIC_RESOLUTION_DEADBAND || (next == 1.0f && scale != 1.0f)) {
+			scale = next;
+			settle = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+		}
+		return scale;
+	}
+
+	float currentScale() const {
+		return scale;
+	}
+
+	// output size scaled, at least one pixel
+	int scaled(int size) const {
+		int result = (int)(size * scale + 0.5f);
+		return result > 0 ? result : 1;
+	}
+
+private:
+	float budget = 0.0f;
+	float scale = 1.0f;
+	unsigned int settle = 0;
+};
+
+#endif
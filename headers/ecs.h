@@ -0,0 +1,350 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Archetype-based entity-component storage.
+// Every distinct set of component types is an archetype. An archetype keeps its entities in
+// fixed-size chunks, and inside a chunk each component type has its own tightly packed array,
+// so a query walks contiguous memory for exactly the components it asks for.
+
+const size_t ECS_CHUNK_SIZE = 16 * 1024;
+const uint32_t ECS_MAX_COMPONENTS = 64;
+
+typedef uint64_t ComponentMask;
+
+// entity handles are an index plus a generation, so a handle to a destroyed entity is detectably stale
+struct Entity {
+	uint32_t Index;
+	uint32_t Generation;
+
+	bool operator==(const Entity& other) const {
+		return Index == other.Index && Generation == other.Generation;
+	}
+	bool operator!=(const Entity& other) const {
+		return !(*this == other);
+	}
+};
+
+const Entity NULL_ENTITY = { 0xFFFFFFFFu, 0 };
+
+struct ComponentInfo {
+	size_t Size;
+	size_t Align;
+};
+
+inline std::vector<ComponentInfo>& componentRegistry() {
+	static std::vector<ComponentInfo> infos;
+	return infos;
+}
+
+// component ids are assigned on first use, so register types from a single thread
+template <typename T>
+uint32_t componentId() {
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy and must be trivially copyable");
+	static const uint32_t id = []() {
+		std::vector<ComponentInfo>& infos = componentRegistry();
+		assert(infos.size() < ECS_MAX_COMPONENTS);
+		infos.push_back({ sizeof(T), alignof(T) });
+		return (uint32_t)infos.size() - 1;
+	}();
+	return id;
+}
+
+template <typename... Ts>
+ComponentMask componentMask() {
+	ComponentMask mask = 0;
+	using expand = int[];
+	(void)expand{ 0, ((mask |= ComponentMask(1) << componentId<Ts>()), 0)... };
+	return mask;
+}
+
+struct Archetype {
+	ComponentMask Mask;
+	uint32_t Capacity;              // entities per chunk
+	uint32_t Count;                 // entities across all chunks, chunks are filled front to back
+	uint32_t ComponentOffset[ECS_MAX_COMPONENTS]; // byte offset of each component array within a chunk
+	std::vector<uint32_t> Components;
+	std::vector<unsigned char*> Chunks;
+
+	// chunks emptied by removals are kept for reuse, so trailing chunks may hold nothing
+	uint32_t chunkCount(uint32_t chunk) const {
+		uint32_t begin = chunk * Capacity;
+		if (begin >= Count) {
+			return 0;
+		}
+		return Count - begin < Capacity ? Count - begin : Capacity;
+	}
+
+	Entity* entities(uint32_t chunk) const {
+		return reinterpret_cast<Entity*>(Chunks[chunk]);
+	}
+
+	void* componentArray(uint32_t chunk, uint32_t id) const {
+		return Chunks[chunk] + ComponentOffset[id];
+	}
+
+	void* component(uint32_t row, uint32_t id) const {
+		return Chunks[row / Capacity] + ComponentOffset[id] + (row % Capacity) * componentRegistry()[id].Size;
+	}
+};
+
+// a single chunk of a query result, used to split a query across threads
+struct ChunkView {
+	Archetype* Arch;
+	uint32_t Chunk;
+	uint32_t Count;
+
+	const Entity* entities() const {
+		return Arch->entities(Chunk);
+	}
+
+	template <typename T>
+	T* array() const {
+		return static_cast<T*>(Arch->componentArray(Chunk, componentId<T>()));
+	}
+};
+
+class EntityRegistry {
+public:
+	EntityRegistry() = default;
+	EntityRegistry(const EntityRegistry&) = delete;
+	EntityRegistry& operator=(const EntityRegistry&) = delete;
+
+	~EntityRegistry() {
+		for (Archetype* archetype : archetypes) {
+			for (unsigned char* chunk : archetype->Chunks) {
+				::operator delete(chunk, std::align_val_t(64));
+			}
+			delete archetype;
+		}
+	}
+
+	template <typename... Ts>
+	Entity create(const Ts&... components) {
+		Entity entity = allocateEntity();
+		Archetype* archetype = getArchetype(componentMask<Ts...>());
+		uint32_t row = allocateRow(archetype, entity);
+
+		using expand = int[];
+		(void)expand{ 0, (std::memcpy(archetype->component(row, componentId<Ts>()), &components, sizeof(Ts)), 0)... };
+
+		records[entity.Index].Arch = archetype;
+		records[entity.Index].Row = row;
+		return entity;
+	}
+
+	void destroy(Entity entity) {
+		if (!isAlive(entity)) {
+			return;
+		}
+		EntityRecord& record = records[entity.Index];
+		removeRow(record.Arch, record.Row);
+		record.Arch = nullptr;
+		record.Generation++;
+		freeIndices.push_back(entity.Index);
+		alive--;
+	}
+
+	bool isAlive(Entity entity) const {
+		return entity.Index < records.size()
+			&& records[entity.Index].Generation == entity.Generation
+			&& records[entity.Index].Arch != nullptr;
+	}
+
+	size_t size() const {
+		return alive;
+	}
+
+	template <typename T>
+	bool has(Entity entity) const {
+		return isAlive(entity) && (records[entity.Index].Arch->Mask & (ComponentMask(1) << componentId<T>()));
+	}
+
+	// returns nullptr for stale handles or entities without the component
+	template <typename T>
+	T* get(Entity entity) {
+		if (!has<T>(entity)) {
+			return nullptr;
+		}
+		const EntityRecord& record = records[entity.Index];
+		return static_cast<T*>(record.Arch->component(record.Row, componentId<T>()));
+	}
+
+	template <typename T>
+	void add(Entity entity, const T& component) {
+		if (!isAlive(entity)) {
+			return;
+		}
+		ComponentMask mask = records[entity.Index].Arch->Mask | (ComponentMask(1) << componentId<T>());
+		moveEntity(entity, mask);
+		std::memcpy(get<T>(entity), &component, sizeof(T));
+	}
+
+	template <typename T>
+	void remove(Entity entity) {
+		if (!has<T>(entity)) {
+			return;
+		}
+		moveEntity(entity, records[entity.Index].Arch->Mask & ~(ComponentMask(1) << componentId<T>()));
+	}
+
+	// calls func(entity, components&...) for every entity that has all of Ts
+	template <typename... Ts, typename Func>
+	void each(Func func) {
+		ComponentMask mask = componentMask<Ts...>();
+		for (Archetype* archetype : archetypes) {
+			if ((archetype->Mask & mask) != mask) {
+				continue;
+			}
+			for (uint32_t chunk = 0; chunk < archetype->Chunks.size(); chunk++) {
+				eachInChunk<Ts...>(ChunkView{ archetype, chunk, archetype->chunkCount(chunk) }, func);
+			}
+		}
+	}
+
+	// appends the non-empty chunks matching Ts, so a query can be split into independent work items
+	template <typename... Ts>
+	void query(std::vector<ChunkView>& chunks) {
+		ComponentMask mask = componentMask<Ts...>();
+		for (Archetype* archetype : archetypes) {
+			if ((archetype->Mask & mask) != mask) {
+				continue;
+			}
+			for (uint32_t chunk = 0; chunk < archetype->Chunks.size(); chunk++) {
+				uint32_t count = archetype->chunkCount(chunk);
+				if (count > 0) {
+					chunks.push_back({ archetype, chunk, count });
+				}
+			}
+		}
+	}
+
+	template <typename... Ts, typename Func>
+	static void eachInChunk(const ChunkView& view, Func& func) {
+		const Entity* entities = view.entities();
+		eachInChunkImpl(view, func, entities, view.array<Ts>()...);
+	}
+
+private:
+	struct EntityRecord {
+		Archetype* Arch;
+		uint32_t Row;
+		uint32_t Generation;
+	};
+
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+	std::vector<Archetype*> archetypes;
+	std::unordered_map<ComponentMask, Archetype*> archetypeByMask;
+	size_t alive = 0;
+
+	template <typename Func, typename... Ts>
+	static void eachInChunkImpl(const ChunkView& view, Func& func, const Entity* entities, Ts*... arrays) {
+		for (uint32_t i = 0; i < view.Count; i++) {
+			func(entities[i], arrays[i]...);
+		}
+	}
+
+	Entity allocateEntity() {
+		alive++;
+		if (!freeIndices.empty()) {
+			uint32_t index = freeIndices.back();
+			freeIndices.pop_back();
+			return { index, records[index].Generation };
+		}
+		records.push_back({ nullptr, 0, 0 });
+		return { (uint32_t)records.size() - 1, 0 };
+	}
+
+	Archetype* getArchetype(ComponentMask mask) {
+		auto found = archetypeByMask.find(mask);
+		if (found != archetypeByMask.end()) {
+			return found->second;
+		}
+
+		const std::vector<ComponentInfo>& infos = componentRegistry();
+		Archetype* archetype = new Archetype();
+		archetype->Mask = mask;
+		archetype->Count = 0;
+
+		size_t rowSize = sizeof(Entity);
+		size_t padding = 0;
+		for (uint32_t id = 0; id < infos.size(); id++) {
+			if (mask & (ComponentMask(1) << id)) {
+				archetype->Components.push_back(id);
+				rowSize += infos[id].Size;
+				padding += infos[id].Align;
+			}
+		}
+		archetype->Capacity = (uint32_t)((ECS_CHUNK_SIZE - padding) / rowSize);
+
+		// one array per component, each aligned for its type
+		size_t offset = archetype->Capacity * sizeof(Entity);
+		for (uint32_t id : archetype->Components) {
+			offset = (offset + infos[id].Align - 1) / infos[id].Align * infos[id].Align;
+			archetype->ComponentOffset[id] = (uint32_t)offset;
+			offset += archetype->Capacity * infos[id].Size;
+		}
+		assert(offset <= ECS_CHUNK_SIZE);
+
+		archetypes.push_back(archetype);
+		archetypeByMask[mask] = archetype;
+		return archetype;
+	}
+
+	uint32_t allocateRow(Archetype* archetype, Entity entity) {
+		if (archetype->Count == archetype->Chunks.size() * archetype->Capacity) {
+			unsigned char* chunk = static_cast<unsigned char*>(::operator new(ECS_CHUNK_SIZE, std::align_val_t(64)));
+			archetype->Chunks.push_back(chunk);
+		}
+		uint32_t row = archetype->Count++;
+		archetype->entities(row / archetype->Capacity)[row % archetype->Capacity] = entity;
+		return row;
+	}
+
+	// swap-removes a row, keeping every chunk except the last one full
+	void removeRow(Archetype* archetype, uint32_t row) {
+		uint32_t last = archetype->Count - 1;
+		if (row != last) {
+			const std::vector<ComponentInfo>& infos = componentRegistry();
+			for (uint32_t id : archetype->Components) {
+				std::memcpy(archetype->component(row, id), archetype->component(last, id), infos[id].Size);
+			}
+			Entity moved = archetype->entities(last / archetype->Capacity)[last % archetype->Capacity];
+			archetype->entities(row / archetype->Capacity)[row % archetype->Capacity] = moved;
+			records[moved.Index].Row = row;
+		}
+		archetype->Count--;
+	}
+
+	void moveEntity(Entity entity, ComponentMask mask) {
+		EntityRecord& record = records[entity.Index];
+		Archetype* from = record.Arch;
+		Archetype* to = getArchetype(mask);
+		if (from == to) {
+			return;
+		}
+
+		uint32_t row = allocateRow(to, entity);
+		const std::vector<ComponentInfo>& infos = componentRegistry();
+		for (uint32_t id : from->Components) {
+			if (mask & (ComponentMask(1) << id)) {
+				std::memcpy(to->component(row, id), from->component(record.Row, id), infos[id].Size);
+			}
+		}
+
+		removeRow(from, record.Row);
+		record.Arch = to;
+		record.Row = row;
+	}
+};
+
+#endif
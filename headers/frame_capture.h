@@ -0,0 +1,168 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "command_buffer.h"
+#include "image_io.h"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// a finished readback, handed from the render thread to whoever writes it out
+struct CapturedFrame {
+	uint64_t Frame = 0;
+	Image Pixels;
+};
+
+const unsigned int CAPTURE_RING_SIZE = 3;
+
+// Asynchronous framebuffer readback. A capture only queues a glReadPixels into a pixel pack buffer
+// and drops a fence behind it; the copy out of the buffer happens frames later, once the fence has
+// signalled, so capturing never waits for the GPU to drain. Captures are requested by recording
+// commands, see recordCapture/recordPoll, and everything except takeCompleted runs on the GL thread.
+class FrameCapture {
+public:
+	FrameCapture() = default;
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	void create() {
+		glGenBuffers(CAPTURE_RING_SIZE, buffers);
+	}
+
+	// maps whatever is still in flight, waiting for it if needed, then frees the buffers
+	void destroy() {
+		if (!buffers[0]) {
+			return;
+		}
+		poll(true);
+		glDeleteBuffers(CAPTURE_RING_SIZE, buffers);
+		for (unsigned int i = 0; i < CAPTURE_RING_SIZE; i++) {
+			buffers[i] = 0;
+		}
+	}
+
+	// reads the current viewport of the bound read framebuffer into the next free pack buffer
+	void readback(uint64_t frame) {
+		Slot& slot = slots[nextSlot];
+		if (slot.Fence) {
+			// every buffer is still in flight, the oldest has to finish before it can be reused
+			finish(nextSlot, true);
+		}
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		slot.Frame = frame;
+		slot.Width = viewport[2];
+		slot.Height = viewport[3];
+
+		size_t size = (size_t)slot.Width * slot.Height * 4;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[nextSlot]);
+		if (size > slot.Capacity) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+			slot.Capacity = size;
+		}
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(viewport[0], viewport[1], slot.Width, slot.Height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		nextSlot = (nextSlot + 1) % CAPTURE_RING_SIZE;
+	}
+
+	// copies out every readback the GPU has finished, or all of them when wait is set
+	void poll(bool wait = false) {
+		for (unsigned int i = 0; i < CAPTURE_RING_SIZE; i++) {
+			unsigned int index = (nextSlot + i) % CAPTURE_RING_SIZE;
+			if (slots[index].Fence) {
+				finish(index, wait);
+			}
+		}
+	}
+
+	// any thread: moves the finished captures into frames
+	void takeCompleted(std::vector<CapturedFrame>& frames) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (CapturedFrame& frame : completed) {
+			frames.push_back(std::move(frame));
+		}
+		completed.clear();
+	}
+
+	// records a readback of the frame drawn so far, typically as the last command of a frame
+	void recordCapture(CommandBuffer& commands, uint64_t frame) {
+		commands.callback(&FrameCapture::readbackCommand, this, frame);
+	}
+
+	// records a check for finished readbacks, cheap enough to do every frame
+	void recordPoll(CommandBuffer& commands) {
+		commands.callback(&FrameCapture::pollCommand, this);
+	}
+
+private:
+	struct Slot {
+		uint64_t Frame = 0;
+		int Width = 0;
+		int Height = 0;
+		size_t Capacity = 0;
+		GLsync Fence = 0;
+	};
+
+	GLuint buffers[CAPTURE_RING_SIZE] = {};
+	Slot slots[CAPTURE_RING_SIZE];
+	unsigned int nextSlot = 0;
+
+	std::mutex mutex;
+	std::vector<CapturedFrame> completed;
+
+	static void readbackCommand(void* user, uint64_t frame) {
+		static_cast<FrameCapture*>(user)->readback(frame);
+	}
+
+	static void pollCommand(void* user, uint64_t) {
+		static_cast<FrameCapture*>(user)->poll();
+	}
+
+	void finish(unsigned int index, bool wait) {
+		Slot& slot = slots[index];
+		GLenum status = glClientWaitSync(slot.Fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED && wait) {
+			status = glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0));
+		}
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			return;
+		}
+		glDeleteSync(slot.Fence);
+		slot.Fence = 0;
+
+		CapturedFrame frame;
+		frame.Frame = slot.Frame;
+		frame.Pixels.Width = slot.Width;
+		frame.Pixels.Height = slot.Height;
+		frame.Pixels.Pixels.resize((size_t)slot.Width * slot.Height * 4);
+
+		// GL rows start at the bottom, images at the top
+		size_t stride = (size_t)slot.Width * 4;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[index]);
+		const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, stride * slot.Height, GL_MAP_READ_BIT);
+		if (mapped) {
+			for (int y = 0; y < slot.Height; y++) {
+				std::memcpy(&frame.Pixels.Pixels[y * stride], mapped + (slot.Height - 1 - y) * stride, stride);
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else {
+			std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED frame " << slot.Frame << std::endl;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (mapped) {
+			std::lock_guard<std::mutex> lock(mutex);
+			completed.push_back(std::move(frame));
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// distribution of a set of timings, in the unit they were added in
+struct StatSummary {
+	size_t Count = 0;
+	double Mean = 0.0;
+	double Min = 0.0;
+	double P50 = 0.0;
+	double P95 = 0.0;
+	double P99 = 0.0;
+	double Max = 0.0;
+};
+
+// collects one sample per frame and summarizes them at the end of a run
+class FrameStats {
+public:
+	void reserve(size_t count) {
+		samples.reserve(count);
+	}
+
+	void add(double sample) {
+		samples.push_back(sample);
+	}
+
+	size_t count() const {
+		return samples.size();
+	}
+
+	void clear() {
+		samples.clear();
+	}
+
+	StatSummary summarize() const {
+		StatSummary summary;
+		if (samples.empty()) {
+			return summary;
+		}
+
+		std::vector<double> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double sample : sorted) {
+			total += sample;
+		}
+
+		summary.Count = sorted.size();
+		summary.Mean = total / sorted.size();
+		summary.Min = sorted.front();
+		summary.P50 = percentile(sorted, 0.50);
+		summary.P95 = percentile(sorted, 0.95);
+		summary.P99 = percentile(sorted, 0.99);
+		summary.Max = sorted.back();
+		return summary;
+	}
+
+private:
+	std::vector<double> samples;
+
+	// nearest-rank percentile of already sorted samples
+	static double percentile(const std::vector<double>& sorted, double fraction) {
+		size_t rank = (size_t)std::ceil(fraction * sorted.size());
+		return sorted[rank > 0 ? rank - 1 : 0];
+	}
+};
+
+#endif
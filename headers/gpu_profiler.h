@@ -0,0 +1,261 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "command_buffer.h"
+#include "frame_stats.h"
+#include "trace.h"
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+const unsigned int GPU_PROFILER_FRAMES = 4;         // frames in flight before a frame's queries are read
+const unsigned int GPU_PROFILER_MAX_SCOPES = 64;    // per frame, deeper or later scopes are ignored
+const unsigned int GPU_PROFILER_HISTORY = 240;      // samples per scope in the rolling statistics
+
+// rolling GPU time of one named scope, in milliseconds
+struct GpuScopeStats {
+	const char* Name;
+	unsigned int Depth;
+	StatSummary Time;
+	double CpuTime;     // average render thread time between the scope's begin and end
+};
+
+// Scoped GPU timing with GL_TIMESTAMP queries. Each frame writes its queries into one of
+// GPU_PROFILER_FRAMES sets and only reads them back when the set comes around again, by which time
+// the GPU has long finished, so reading results never stalls the pipeline. Scopes nest and are
+// recorded as commands (recordBegin/recordEnd), so they time exactly the commands between them.
+// The render thread's CPU time for the same scopes is kept alongside, and both can be exported to
+// a TraceLog on one timeline.
+class GpuProfiler {
+public:
+	GpuProfiler() = default;
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// GL thread; trace may be null when no timeline is wanted
+	void create(TraceLog* trace = nullptr) {
+		this->trace = trace;
+		for (FrameQueries& frame : frames) {
+			glGenQueries(GPU_PROFILER_MAX_SCOPES * 2, frame.Queries);
+		}
+		calibrate();
+		if (trace) {
+			trace->nameTrack(TRACE_GPU_TRACK, "GPU");
+		}
+		created = true;
+	}
+
+	// collects whatever is still outstanding, then frees the queries
+	void destroy() {
+		if (!created) {
+			return;
+		}
+		for (unsigned int i = 1; i <= GPU_PROFILER_FRAMES; i++) {
+			collect(frames[(frameIndex + i) % GPU_PROFILER_FRAMES]);
+		}
+		for (FrameQueries& frame : frames) {
+			glDeleteQueries(GPU_PROFILER_MAX_SCOPES * 2, frame.Queries);
+		}
+		created = false;
+	}
+
+	// recording side, the frame scope encloses every other scope of the frame
+	void recordBeginFrame(CommandBuffer& commands, uint64_t frame) {
+		commands.callback(&GpuProfiler::beginFrameCommand, this, frame);
+	}
+
+	void recordEndFrame(CommandBuffer& commands) {
+		commands.callback(&GpuProfiler::endCommand, this);
+	}
+
+	// name must outlive the profiler, string literals or names owned by long lived objects
+	void recordBegin(CommandBuffer& commands, const char* name) {
+		commands.callback(&GpuProfiler::beginCommand, this, (uint64_t)(uintptr_t)name);
+	}
+
+	void recordEnd(CommandBuffer& commands) {
+		commands.callback(&GpuProfiler::endCommand, this);
+	}
+
+	// any thread: rolling statistics of every scope seen so far, in first-seen order
+	std::vector<GpuScopeStats> statistics() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<GpuScopeStats> result;
+		for (const ScopeHistory& history : histories) {
+			FrameStats samples;
+			double cpuTotal = 0.0;
+			for (unsigned int i = 0; i < history.Count; i++) {
+				samples.add(history.Gpu[i]);
+				cpuTotal += history.Cpu[i];
+			}
+			result.push_back({ history.Name, history.Depth, samples.summarize(), history.Count > 0 ? cpuTotal / history.Count : 0.0 });
+		}
+		return result;
+	}
+
+	// any thread: GPU time of the newest frame read back so far, in milliseconds
+	double latestFrameTime() const {
+		return latestFrame.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Scope {
+		const char* Name;
+		unsigned int Depth;
+		uint32_t Track;     // trace track of the thread that replayed the scope
+		double CpuBegin;
+		double CpuEnd;
+		bool Ended;         // its end query was issued; a scope left open has no time to read back
+	};
+
+	struct FrameQueries {
+		GLuint Queries[GPU_PROFILER_MAX_SCOPES * 2];
+		Scope Scopes[GPU_PROFILER_MAX_SCOPES];
+		unsigned int ScopeCount = 0;
+	};
+
+	struct ScopeHistory {
+		const char* Name;
+		unsigned int Depth;
+		double Gpu[GPU_PROFILER_HISTORY];
+		double Cpu[GPU_PROFILER_HISTORY];
+		unsigned int Count = 0;
+		unsigned int Next = 0;
+	};
+
+	FrameQueries frames[GPU_PROFILER_FRAMES];
+	unsigned int frameIndex = 0;
+	bool created = false;
+
+	// render thread only
+	unsigned int stack[GPU_PROFILER_MAX_SCOPES];
+	unsigned int depth = 0;
+	unsigned int ignoredDepth = 0;  // open scopes that did not fit into the frame
+	double gpuToTrace = 0.0;        // microseconds to add to a GPU timestamp to land on traceNow's clock
+	bool namedRenderTrack = false;
+
+	std::mutex mutex;
+	std::vector<ScopeHistory> histories;
+	std::atomic<double> latestFrame{ 0.0 };
+	TraceLog* trace = nullptr;
+
+	static void beginFrameCommand(void* user, uint64_t frame) {
+		GpuProfiler* profiler = static_cast<GpuProfiler*>(user);
+		profiler->beginFrame(frame);
+		profiler->begin("frame");
+	}
+
+	static void beginCommand(void* user, uint64_t name) {
+		static_cast<GpuProfiler*>(user)->begin((const char*)(uintptr_t)name);
+	}
+
+	static void endCommand(void* user, uint64_t) {
+		static_cast<GpuProfiler*>(user)->end();
+	}
+
+	// pairs the GPU clock with the CPU trace clock; GL_TIMESTAMP is read without waiting for the GPU
+	void calibrate() {
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		gpuToTrace = traceNow() - gpuNow / 1000.0;
+	}
+
+	void beginFrame(uint64_t frame) {
+		if (trace && !namedRenderTrack) {
+			trace->nameTrack(traceThreadId(), "render thread");
+			namedRenderTrack = true;
+		}
+		frameIndex = (unsigned int)(frame % GPU_PROFILER_FRAMES);
+		collect(frames[frameIndex]);
+		depth = 0;
+		ignoredDepth = 0;
+
+		// the two clocks drift apart slowly, re-pair them every few seconds of frames
+		if (frame % 256 == 0) {
+			calibrate();
+		}
+	}
+
+	void begin(const char* name) {
+		FrameQueries& current = frames[frameIndex];
+		if (current.ScopeCount >= GPU_PROFILER_MAX_SCOPES || ignoredDepth > 0) {
+			ignoredDepth++;
+			return;
+		}
+
+		unsigned int index = current.ScopeCount++;
+		current.Scopes[index] = { name, depth, traceThreadId(), traceNow(), 0.0, false };
+		glQueryCounter(current.Queries[index * 2], GL_TIMESTAMP);
+		stack[depth++] = index;
+	}
+
+	void end() {
+		if (ignoredDepth > 0) {
+			ignoredDepth--;
+			return;
+		}
+		if (depth == 0) {
+			return;
+		}
+
+		FrameQueries& current = frames[frameIndex];
+		unsigned int index = stack[--depth];
+		glQueryCounter(current.Queries[index * 2 + 1], GL_TIMESTAMP);
+		current.Scopes[index].CpuEnd = traceNow();
+		current.Scopes[index].Ended = true;
+	}
+
+	// reads a finished frame's queries; they were issued GPU_PROFILER_FRAMES frames ago, so the
+	// results are normally available and asking for them does not block
+	void collect(FrameQueries& frame) {
+		if (frame.ScopeCount == 0) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (unsigned int i = 0; i < frame.ScopeCount; i++) {
+			const Scope& scope = frame.Scopes[i];
+			if (!scope.Ended) {
+				continue;
+			}
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(frame.Queries[i * 2], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.Queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+			double gpuMs = (end - begin) / 1000000.0;
+			double cpuMs = (scope.CpuEnd - scope.CpuBegin) / 1000.0;
+
+			ScopeHistory& history = historyFor(scope.Name, scope.Depth);
+			history.Gpu[history.Next] = gpuMs;
+			history.Cpu[history.Next] = cpuMs;
+			history.Next = (history.Next + 1) % GPU_PROFILER_HISTORY;
+			history.Count = history.Count < GPU_PROFILER_HISTORY ? history.Count + 1 : GPU_PROFILER_HISTORY;
+			if (scope.Depth == 0) {
+				latestFrame.store(gpuMs, std::memory_order_relaxed);
+			}
+
+			if (trace) {
+				trace->add({ scope.Name, "gpu", TRACE_GPU_TRACK, begin / 1000.0 + gpuToTrace, (end - begin) / 1000.0 });
+				trace->add({ scope.Name, "render", scope.Track, scope.CpuBegin, scope.CpuEnd - scope.CpuBegin });
+			}
+		}
+		frame.ScopeCount = 0;
+	}
+
+	ScopeHistory& historyFor(const char* name, unsigned int scopeDepth) {
+		for (ScopeHistory& history : histories) {
+			if (history.Name == name && history.Depth == scopeDepth) {
+				return history;
+			}
+		}
+		histories.emplace_back();
+		histories.back().Name = name;
+		histories.back().Depth = scopeDepth;
+		return histories.back();
+	}
+};
+
+#endif
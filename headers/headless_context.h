@@ -0,0 +1,194 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// OpenGL context without a window, created through EGL so it runs on machines without a display
+// server or GPU (Mesa llvmpipe). The surfaceless platform is preferred; when it is unavailable the
+// default display with a small pbuffer is used instead. Either way the frame is rendered into an
+// offscreen framebuffer of the requested size.
+class HeadlessContext {
+public:
+	int Width = 0;
+	int Height = 0;
+	GLuint Framebuffer = 0;
+
+	HeadlessContext() = default;
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+#ifndef _WIN32
+	// creates the context and makes it current on the calling thread
+	bool create(int width, int height) {
+		Width = width;
+		Height = height;
+
+		const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY && !eglInitialize(display, nullptr, nullptr)) {
+				display = EGL_NO_DISPLAY;
+			}
+		}
+		if (display == EGL_NO_DISPLAY) {
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+				std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+				display = EGL_NO_DISPLAY;
+				return false;
+			}
+		}
+
+		// without surfaceless contexts a pbuffer stands in as the (unused) draw surface
+		bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			std::cout << "ERROR::HEADLESS::NO_MATCHING_CONFIG" << std::endl;
+			return false;
+		}
+
+		// llvmpipe tops out at 4.5, which is what the shaders target
+		eglBindAPI(EGL_OPENGL_API);
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, 5,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context == EGL_NO_CONTEXT) {
+			std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+			return false;
+		}
+
+		if (!surfaceless) {
+			const EGLint pbufferAttributes[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+			surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+			if (surface == EGL_NO_SURFACE) {
+				std::cout << "ERROR::HEADLESS::PBUFFER_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+				return false;
+			}
+		}
+
+		makeCurrent();
+		return true;
+	}
+
+	// for gladLoadGLLoader
+	static void* getProcAddress(const char* name) {
+		return (void*)eglGetProcAddress(name);
+	}
+
+	void makeCurrent() {
+		eglMakeCurrent(display, surface, surface, context);
+	}
+
+	void release() {
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+
+	// tears down the framebuffer and the context, the context must not be current on another thread
+	void destroy() {
+		if (display == EGL_NO_DISPLAY) {
+			return;
+		}
+		if (context != EGL_NO_CONTEXT) {
+			makeCurrent();
+			destroyFramebuffer();
+			release();
+			eglDestroyContext(display, context);
+			context = EGL_NO_CONTEXT;
+		}
+		if (surface != EGL_NO_SURFACE) {
+			eglDestroySurface(display, surface);
+			surface = EGL_NO_SURFACE;
+		}
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+	}
+#else
+	bool create(int, int) {
+		std::cout << "ERROR::HEADLESS::EGL_UNAVAILABLE" << std::endl;
+		return false;
+	}
+
+	static void* getProcAddress(const char*) {
+		return nullptr;
+	}
+
+	void makeCurrent() {}
+	void release() {}
+	void destroy() {}
+#endif
+
+	// needs loaded GL functions, so it is called after glad; leaves the framebuffer bound
+	bool createFramebuffer() {
+		glGenFramebuffers(1, &Framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+
+		glGenRenderbuffers(2, renderbuffers);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, Width, Height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, Width, Height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	~HeadlessContext() {
+		destroy();
+	}
+
+private:
+#ifndef _WIN32
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+	EGLSurface surface = EGL_NO_SURFACE;
+#endif
+	GLuint renderbuffers[2] = { 0, 0 };
+
+	static bool hasExtension(const char* extensions, const char* name) {
+		if (!extensions) {
+			return false;
+		}
+		size_t length = std::strlen(name);
+		for (const char* found = std::strstr(extensions, name); found; found = std::strstr(found + length, name)) {
+			if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0')) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void destroyFramebuffer() {
+		if (Framebuffer) {
+			glDeleteFramebuffers(1, &Framebuffer);
+			glDeleteRenderbuffers(2, renderbuffers);
+			Framebuffer = 0;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+// stb_image.h expands its implementation again on every include once it has been enabled
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include "stb_image.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 8-bit RGBA image, rows stored top to bottom
+struct Image {
+	int Width = 0;
+	int Height = 0;
+	std::vector<unsigned char> Pixels;
+};
+
+// Writers for frame captures and the readers used to compare them. PNGs are compressed with a small
+// LZ77 + fixed Huffman deflate, which is plenty for rendered frames with large flat areas; PAM is
+// the uncompressed dump that any image tool can read back bit-exactly.
+namespace imageio {
+
+	inline uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+		// built once, thread-safe so captures can be encoded from several jobs at once
+		static const std::array<uint32_t, 256> table = []() {
+			std::array<uint32_t, 256> result;
+			for (uint32_t n = 0; n < 256; n++) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) {
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				result[n] = c;
+			}
+			return result;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	inline uint32_t adler32(const unsigned char* data, size_t size) {
+		uint32_t a = 1, b = 0;
+		for (size_t i = 0; i < size; i++) {
+			a = (a + data[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	// LSB-first bit packing as deflate expects it
+	class BitWriter {
+	public:
+		std::vector<unsigned char>& Output;
+
+		explicit BitWriter(std::vector<unsigned char>& output) : Output(output) {
+		}
+
+		void write(uint32_t value, unsigned int count) {
+			bits |= (uint64_t)value << bitCount;
+			bitCount += count;
+			while (bitCount >= 8) {
+				Output.push_back((unsigned char)bits);
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+
+		// huffman codes are defined most significant bit first
+		void writeCode(uint32_t code, unsigned int length) {
+			uint32_t reversed = 0;
+			for (unsigned int i = 0; i < length; i++) {
+				reversed = (reversed << 1) | ((code >> i) & 1);
+			}
+			write(reversed, length);
+		}
+
+		void flush() {
+			if (bitCount > 0) {
+				Output.push_back((unsigned char)bits);
+			}
+			bits = 0;
+			bitCount = 0;
+		}
+
+	private:
+		uint64_t bits = 0;
+		unsigned int bitCount = 0;
+	};
+
+	inline void writeLiteral(BitWriter& writer, unsigned int symbol) {
+		if (symbol < 144) {
+			writer.writeCode(0x30 + symbol, 8);
+		}
+		else if (symbol < 256) {
+			writer.writeCode(0x190 + symbol - 144, 9);
+		}
+		else if (symbol < 280) {
+			writer.writeCode(symbol - 256, 7);
+		}
+		else {
+			writer.writeCode(0xC0 + symbol - 280, 8);
+		}
+	}
+
+	inline void writeMatch(BitWriter& writer, unsigned int length, unsigned int distance) {
+		static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		unsigned int lengthCode = 28;
+		while (lengthBase[lengthCode] > length) {
+			lengthCode--;
+		}
+		writeLiteral(writer, 257 + lengthCode);
+		writer.write(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+
+		unsigned int distanceCode = 29;
+		while (distanceBase[distanceCode] > distance) {
+			distanceCode--;
+		}
+		writer.writeCode(distanceCode, 5);
+		writer.write(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+	}
+
+	// zlib stream with a single fixed-Huffman deflate block
+	inline std::vector<unsigned char> compress(const std::vector<unsigned char>& data) {
+		const unsigned int WINDOW = 32768;
+		const unsigned int HASH_BITS = 15;
+		const unsigned int MAX_CHAIN = 16;
+		const unsigned int MIN_MATCH = 3;
+		const unsigned int MAX_MATCH = 258;
+
+		std::vector<unsigned char> output = { 0x78, 0x01 };
+		BitWriter writer(output);
+		writer.write(1, 1);     // final block
+		writer.write(1, 2);     // fixed huffman codes
+
+		std::vector<int32_t> head(1u << HASH_BITS, -1);
+		std::vector<int32_t> previous(WINDOW, -1);
+		auto hashAt = [&](size_t i) {
+			return ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - HASH_BITS);
+		};
+		auto insert = [&](size_t i) {
+			uint32_t hash = hashAt(i);
+			previous[i % WINDOW] = head[hash];
+			head[hash] = (int32_t)i;
+		};
+
+		size_t size = data.size();
+		size_t i = 0;
+		while (i < size) {
+			unsigned int bestLength = 0;
+			unsigned int bestDistance = 0;
+			if (i + MIN_MATCH <= size) {
+				unsigned int limit = (unsigned int)std::min<size_t>(MAX_MATCH, size - i);
+				int32_t candidate = head[hashAt(i)];
+				for (unsigned int chain = 0; chain < MAX_CHAIN && candidate >= 0 && i - candidate <= WINDOW; chain++) {
+					unsigned int length = 0;
+					while (length < limit && data[candidate + length] == data[i + length]) {
+						length++;
+					}
+					if (length > bestLength) {
+						bestLength = length;
+						bestDistance = (unsigned int)(i - candidate);
+						if (length == limit) {
+							break;
+						}
+					}
+					candidate = previous[candidate % WINDOW];
+				}
+			}
+
+			if (bestLength >= MIN_MATCH) {
+				writeMatch(writer, bestLength, bestDistance);
+				for (unsigned int k = 0; k < bestLength; k++, i++) {
+					if (i + MIN_MATCH <= size) {
+						insert(i);
+					}
+				}
+			}
+			else {
+				writeLiteral(writer, data[i]);
+				if (i + MIN_MATCH <= size) {
+					insert(i);
+				}
+				i++;
+			}
+		}
+		writeLiteral(writer, 256);
+		writer.flush();
+
+		uint32_t checksum = adler32(data.data(), data.size());
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			output.push_back((unsigned char)(checksum >> shift));
+		}
+		return output;
+	}
+
+	inline void appendChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data) {
+		uint32_t length = (uint32_t)data.size();
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			png.push_back((unsigned char)(length >> shift));
+		}
+		size_t start = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		uint32_t crc = crc32(&png[start], png.size() - start);
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			png.push_back((unsigned char)(crc >> shift));
+		}
+	}
+
+	inline bool writeFile(const std::string& path, const unsigned char* data, size_t size) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open() || !file.write((const char*)data, size)) {
+			std::cout << "ERROR::IMAGE::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+}
+
+inline bool writePng(const std::string& path, const Image& image) {
+	// every row uses the "up" filter, which turns smooth vertical gradients into runs of zeros
+	size_t stride = (size_t)image.Width * 4;
+	std::vector<unsigned char> filtered((stride + 1) * image.Height);
+	for (int y = 0; y < image.Height; y++) {
+		unsigned char* row = &filtered[y * (stride + 1)];
+		const unsigned char* source = &image.Pixels[y * stride];
+		const unsigned char* above = y > 0 ? source - stride : nullptr;
+		row[0] = 2;
+		for (size_t x = 0; x < stride; x++) {
+			row[x + 1] = (unsigned char)(source[x] - (above ? above[x] : 0));
+		}
+	}
+
+	std::vector<unsigned char> header(13);
+	for (int shift = 24, i = 0; shift >= 0; shift -= 8, i++) {
+		header[i] = (unsigned char)(image.Width >> shift);
+		header[4 + i] = (unsigned char)(image.Height >> shift);
+	}
+	header[8] = 8;      // bit depth
+	header[9] = 6;      // RGBA
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<unsigned char> png(signature, signature + 8);
+	imageio::appendChunk(png, "IHDR", header);
+	imageio::appendChunk(png, "IDAT", imageio::compress(filtered));
+	imageio::appendChunk(png, "IEND", std::vector<unsigned char>());
+	return imageio::writeFile(path, png.data(), png.size());
+}
+
+// netpbm PAM, an uncompressed dump with a short text header
+inline bool writePam(const std::string& path, const Image& image) {
+	std::string header = "P7\nWIDTH " + std::to_string(image.Width) + "\nHEIGHT " + std::to_string(image.Height)
+		+ "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+	std::vector<unsigned char> pam(header.begin(), header.end());
+	pam.insert(pam.end(), image.Pixels.begin(), image.Pixels.end());
+	return imageio::writeFile(path, pam.data(), pam.size());
+}
+
+inline bool readPam(const std::string& path, Image& image) {
+	std::ifstream file(path, std::ios::binary);
+	std::string token;
+	if (!(file >> token) || token != "P7") {
+		return false;
+	}
+
+	int depth = 0, maxValue = 0;
+	while (file >> token && token != "ENDHDR") {
+		if (token == "WIDTH") {
+			file >> image.Width;
+		}
+		else if (token == "HEIGHT") {
+			file >> image.Height;
+		}
+		else if (token == "DEPTH") {
+			file >> depth;
+		}
+		else if (token == "MAXVAL") {
+			file >> maxValue;
+		}
+		else {
+			std::getline(file, token);
+		}
+	}
+	file.get();
+	if (depth != 4 || maxValue != 255 || image.Width <= 0 || image.Height <= 0) {
+		return false;
+	}
+
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	return (bool)file.read((char*)image.Pixels.data(), image.Pixels.size());
+}
+
+// loads a PAM dump or anything stb_image understands, always as RGBA
+inline bool loadImage(const std::string& path, Image& image) {
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".pam") == 0) {
+		if (readPam(path, image)) {
+			return true;
+		}
+	}
+	else {
+		int components;
+		unsigned char* pixels = stbi_load(path.c_str(), &image.Width, &image.Height, &components, 4);
+		if (pixels) {
+			image.Pixels.assign(pixels, pixels + (size_t)image.Width * image.Height * 4);
+			stbi_image_free(pixels);
+			return true;
+		}
+	}
+	std::cout << "ERROR::IMAGE::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+	return false;
+}
+
+#endif
@@ -0,0 +1,404 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include "profiler.h"
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Work-stealing job scheduler.
+// Every participating thread owns a Chase-Lev deque: it pushes and pops jobs at the bottom,
+// idle threads steal from the top of someone else's deque. Waiting on a counter never blocks,
+// the waiting thread keeps executing jobs until the counter drops to zero.
+
+const uint32_t JOB_QUEUE_SIZE = 4096;   // per thread, must be a power of two
+const uint32_t JOB_POOL_SIZE = 4096;    // jobs a thread may have in flight at once
+const uint32_t JOB_STORAGE_SIZE = 48;   // bytes of captured state a job can carry
+const unsigned int JOB_MAX_EXTERNAL_THREADS = 4;
+
+struct Job;
+
+class SpinLock {
+public:
+	void lock() {
+		while (flag.exchange(true, std::memory_order_acquire)) {
+			while (flag.load(std::memory_order_relaxed)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void unlock() {
+		flag.store(false, std::memory_order_release);
+	}
+
+private:
+	std::atomic<bool> flag{ false };
+};
+
+// counts unfinished jobs; jobs scheduled with runAfter start once it reaches zero.
+// a finishing job still touches the counter after Pending has dropped, Finishing keeps done() false
+// until it has let go, so a counter on the stack may be destroyed as soon as wait returns
+struct JobCounter {
+	std::atomic<int32_t> Pending{ 0 };
+	std::atomic<int32_t> Finishing{ 0 };
+	SpinLock Lock;
+	std::vector<Job*> Continuations;
+
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool done() const {
+		return Pending.load(std::memory_order_acquire) == 0 && Finishing.load(std::memory_order_acquire) == 0;
+	}
+};
+
+struct Job {
+	void (*Invoke)(Job*);
+	JobCounter* Counter;
+	std::atomic<bool> Busy{ false };    // created and not finished yet, the pool slot can't be reused
+	bool Heap = false;                  // allocated because its pool slot was still busy
+	alignas(16) unsigned char Storage[JOB_STORAGE_SIZE];
+};
+
+// fixed-capacity Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models")
+class WorkStealingQueue {
+public:
+	// returns false when the queue is full
+	bool push(Job* job) {
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= (int64_t)JOB_QUEUE_SIZE) {
+			return false;
+		}
+		buffer[b & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// owner only
+	Job* pop() {
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = buffer[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+		if (t == b) {
+			// last job: race against thieves for it
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = nullptr;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// any thread
+	Job* steal() {
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+
+		if (t >= b) {
+			return nullptr;
+		}
+		Job* job = buffer[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return job;
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	std::atomic<Job*> buffer[JOB_QUEUE_SIZE];
+};
+
+class JobSystem {
+public:
+	// the constructing thread takes part as thread 0, so workerCount extra threads are started
+	explicit JobSystem(unsigned int workerCount = defaultWorkerCount()) {
+		threadSlots = workerCount + 1 + JOB_MAX_EXTERNAL_THREADS;
+		queues = new WorkStealingQueue[threadSlots];
+		pools = new JobPool[threadSlots];
+		registeredThreads = 1;
+		bindThread(0);
+
+		workers.reserve(workerCount);
+		for (unsigned int i = 0; i < workerCount; i++) {
+			registeredThreads++;
+			workers.emplace_back([this, i]() {
+				bindThread(i + 1);
+				PROFILE_THREAD("worker " + std::to_string(i + 1));
+				workerLoop();
+			});
+		}
+	}
+
+	~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		sleepCondition.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		if (current().System == this) {
+			current() = ThreadBinding();
+		}
+		delete[] queues;
+		delete[] pools;
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	static unsigned int defaultWorkerCount() {
+		unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 0;
+	}
+
+	// threads that take part in executing jobs, including the owning thread
+	unsigned int threadCount() const {
+		return (unsigned int)workers.size() + 1;
+	}
+
+	// threads other than the owner and the workers must register before submitting or waiting
+	void registerThread() {
+		unsigned int slot = registeredThreads.fetch_add(1);
+		assert(slot < threadSlots);
+		bindThread(slot);
+	}
+
+	template <typename Func>
+	void run(JobCounter& counter, Func&& func) {
+		counter.Pending.fetch_add(1, std::memory_order_relaxed);
+		submit(createJob(counter, std::forward<Func>(func)));
+	}
+
+	// func runs once dependency has reached zero
+	template <typename Func>
+	void runAfter(JobCounter& dependency, JobCounter& counter, Func&& func) {
+		counter.Pending.fetch_add(1, std::memory_order_relaxed);
+		Job* job = createJob(counter, std::forward<Func>(func));
+
+		// Pending alone decides, under the lock a finisher has either not taken the continuations yet
+		// or has already dropped it to zero
+		dependency.Lock.lock();
+		if (dependency.Pending.load(std::memory_order_acquire) == 0) {
+			dependency.Lock.unlock();
+			submit(job);
+			return;
+		}
+		dependency.Continuations.push_back(job);
+		dependency.Lock.unlock();
+	}
+
+	// splits [0, count) into jobs of at most grainSize items and calls func(begin, end) for each.
+	// the jobs refer to func, so it must stay alive until counter has been waited on
+	template <typename Func>
+	void parallelFor(JobCounter& counter, uint32_t count, uint32_t grainSize, const Func& func) {
+		if (grainSize == 0) {
+			grainSize = 1;
+		}
+		for (uint32_t begin = 0; begin < count; begin += grainSize) {
+			uint32_t end = count - begin < grainSize ? count : begin + grainSize;
+			const Func* body = &func;
+			run(counter, [body, begin, end]() {
+				(*body)(begin, end);
+			});
+		}
+	}
+
+	// the jobs only point at func, a temporary would be gone before they run
+	template <typename Func>
+	void parallelFor(JobCounter& counter, uint32_t count, uint32_t grainSize, const Func&& func) = delete;
+
+	// executes other jobs until the counter has reached zero
+	void wait(JobCounter& counter) {
+		while (!counter.done()) {
+			Job* job = findJob();
+			if (job) {
+				execute(job);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+private:
+	struct JobPool {
+		Job Jobs[JOB_POOL_SIZE];
+		uint32_t Next = 0;
+	};
+
+	struct ThreadBinding {
+		JobSystem* System = nullptr;
+		unsigned int Slot = 0;
+	};
+
+	unsigned int threadSlots;
+	WorkStealingQueue* queues;
+	JobPool* pools;
+	std::vector<std::thread> workers;
+	std::atomic<unsigned int> registeredThreads{ 0 };
+
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	std::atomic<int32_t> queuedJobs{ 0 };
+	std::atomic<int32_t> sleepingWorkers{ 0 };
+	bool stopping = false;
+
+	static ThreadBinding& current() {
+		static thread_local ThreadBinding binding;
+		return binding;
+	}
+
+	void bindThread(unsigned int slot) {
+		current().System = this;
+		current().Slot = slot;
+	}
+
+	unsigned int currentSlot() const {
+		assert(current().System == this && "thread is not registered with this job system");
+		return current().Slot;
+	}
+
+	template <typename Func>
+	Job* createJob(JobCounter& counter, Func&& func) {
+		typedef typename std::decay<Func>::type Callable;
+		static_assert(sizeof(Callable) <= JOB_STORAGE_SIZE, "job captures too much state, capture by reference instead");
+		static_assert(alignof(Callable) <= 16, "job capture is over-aligned");
+
+		// the pool is a ring, a slot whose job is still pending (a long continuation chain or a
+		// blocked worker) is skipped and the job goes to the heap instead
+		JobPool& pool = pools[currentSlot()];
+		Job* job = &pool.Jobs[pool.Next++ & (JOB_POOL_SIZE - 1)];
+		if (job->Busy.load(std::memory_order_acquire)) {
+			job = new Job();
+			job->Heap = true;
+		}
+		job->Busy.store(true, std::memory_order_relaxed);
+		new (job->Storage) Callable(std::forward<Func>(func));
+		job->Counter = &counter;
+		job->Invoke = [](Job* self) {
+			Callable* callable = reinterpret_cast<Callable*>(self->Storage);
+			(*callable)();
+			callable->~Callable();
+		};
+		return job;
+	}
+
+	void submit(Job* job) {
+		if (!queues[currentSlot()].push(job)) {
+			// the queue is full, running the job right here is the only way to make progress
+			invoke(job);
+			return;
+		}
+		queuedJobs.fetch_add(1);
+		if (sleepingWorkers.load() > 0) {
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_one();
+		}
+	}
+
+	Job* findJob() {
+		unsigned int slot = currentSlot();
+		Job* job = queues[slot].pop();
+		if (job) {
+			return job;
+		}
+
+		unsigned int slots = registeredThreads.load() < threadSlots ? registeredThreads.load() : threadSlots;
+		for (unsigned int i = 1; i < slots; i++) {
+			job = queues[(slot + i) % slots].steal();
+			if (job) {
+				return job;
+			}
+		}
+		return nullptr;
+	}
+
+	void execute(Job* job) {
+		queuedJobs.fetch_sub(1);
+		invoke(job);
+	}
+
+	void invoke(Job* job) {
+		JobCounter* counter = job->Counter;
+		job->Invoke(job);
+		if (job->Heap) {
+			delete job;
+		}
+		else {
+			job->Busy.store(false, std::memory_order_release);
+		}
+		finish(*counter);
+	}
+
+	void finish(JobCounter& counter) {
+		counter.Finishing.fetch_add(1, std::memory_order_relaxed);
+		std::vector<Job*> ready;
+		if (counter.Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			// the counter reached zero: release anything waiting on it
+			counter.Lock.lock();
+			ready.swap(counter.Continuations);
+			counter.Lock.unlock();
+		}
+		// the last access, the counter may be gone right after it
+		counter.Finishing.fetch_sub(1, std::memory_order_release);
+		for (Job* job : ready) {
+			submit(job);
+		}
+	}
+
+	void workerLoop() {
+		for (;;) {
+			Job* job = findJob();
+			if (job) {
+				execute(job);
+				continue;
+			}
+
+			// spin briefly before going to sleep, frame work tends to arrive in bursts
+			for (int spin = 0; spin < 64 && !job; spin++) {
+				std::this_thread::yield();
+				job = findJob();
+			}
+			if (job) {
+				execute(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkers.fetch_add(1);
+			sleepCondition.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+			sleepingWorkers.fetch_sub(1);
+			if (stopping) {
+				return;
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include "shader.h"
+#include "command_buffer.h"
+#include "components.h"
+#include "ecs.h"
+#include "scene_graph.h"
+#include "shadow_maps.h"
+#include "simulation.h"
+
+#include <string>
+
+// must match NR_POINT_LIGHTS in the lit fragment shaders, the lights in use are passed as pointLightCount
+const unsigned int MAX_POINT_LIGHTS = 32;
+
+struct DirLightUniforms {
+	GLint Direction, Ambient, Diffuse, Specular;
+};
+
+struct PointLightUniforms {
+	GLint Position, Ambient, Diffuse, Specular, Constant, Linear, Quadratic;
+};
+
+struct SpotLightUniforms {
+	GLint Position, Direction, Ambient, Diffuse, Specular, Constant, Linear, Quadratic, CutOff, OuterCutOff;
+};
+
+struct ShadowUniforms {
+	GLint Matrices[SHADOW_CASCADE_COUNT];
+	GLint Splits[SHADOW_CASCADE_COUNT];
+	GLint TexelSizes[SHADOW_CASCADE_COUNT];
+	GLint CascadeCount, ViewForward;
+};
+
+// uniform locations of a program, resolved once after linking so that recording
+// a frame never needs a GL context or a string lookup
+struct ProgramUniforms {
+	const char* Name;   // pass name in profiler output
+	GLuint Program;
+	GLint Model, Mvp, NormalMatrix, ViewPos, Shininess;
+	GLint PreviousMvp, Jitter;   // only in programs built with VELOCITY, -1 otherwise
+	GLint CoarseScale, CoarseSize;   // only in programs built with COARSE_LIGHTING
+	DirLightUniforms DirLight;
+	PointLightUniforms PointLights[MAX_POINT_LIGHTS];
+	GLint PointLightCount;
+	SpotLightUniforms Spot;
+	ShadowUniforms Shadows;
+};
+
+inline ProgramUniforms resolveUniforms(const Shader& shader, const char* name) {
+	ProgramUniforms uniforms;
+	uniforms.Name = name;
+	uniforms.Program = shader.ID;
+	uniforms.Model = shader.uniformLocation("model");
+	uniforms.Mvp = shader.uniformLocation("mvp");
+	uniforms.NormalMatrix = shader.uniformLocation("normalMatrix");
+	uniforms.ViewPos = shader.uniformLocation("viewPos");
+	uniforms.Shininess = shader.uniformLocation("material.shininess");
+	uniforms.PreviousMvp = shader.uniformLocation("previousMvp");
+	uniforms.Jitter = shader.uniformLocation("jitter");
+	uniforms.CoarseScale = shader.uniformLocation("coarseScale");
+	uniforms.CoarseSize = shader.uniformLocation("coarseSize");
+
+	uniforms.DirLight.Direction = shader.uniformLocation("dirLight.direction");
+	uniforms.DirLight.Ambient = shader.uniformLocation("dirLight.ambient");
+	uniforms.DirLight.Diffuse = shader.uniformLocation("dirLight.diffuse");
+	uniforms.DirLight.Specular = shader.uniformLocation("dirLight.specular");
+
+	uniforms.PointLightCount = shader.uniformLocation("pointLightCount");
+	for (unsigned int i = 0; i < MAX_POINT_LIGHTS; i++) {
+		std::string name = "pointLights[" + std::to_string(i) + "].";
+		PointLightUniforms& light = uniforms.PointLights[i];
+		light.Position = shader.uniformLocation(name + "position");
+		light.Ambient = shader.uniformLocation(name + "ambient");
+		light.Diffuse = shader.uniformLocation(name + "diffuse");
+		light.Specular = shader.uniformLocation(name + "specular");
+		light.Constant = shader.uniformLocation(name + "constant");
+		light.Linear = shader.uniformLocation(name + "linear");
+		light.Quadratic = shader.uniformLocation(name + "quadratic");
+	}
+
+	uniforms.Spot.Position = shader.uniformLocation("spotLight.position");
+	uniforms.Spot.Direction = shader.uniformLocation("spotLight.direction");
+	uniforms.Spot.Ambient = shader.uniformLocation("spotLight.ambient");
+	uniforms.Spot.Diffuse = shader.uniformLocation("spotLight.diffuse");
+	uniforms.Spot.Specular = shader.uniformLocation("spotLight.specular");
+	uniforms.Spot.Constant = shader.uniformLocation("spotLight.constant");
+	uniforms.Spot.Linear = shader.uniformLocation("spotLight.linear");
+	uniforms.Spot.Quadratic = shader.uniformLocation("spotLight.quadratic");
+	uniforms.Spot.CutOff = shader.uniformLocation("spotLight.cutOff");
+	uniforms.Spot.OuterCutOff = shader.uniformLocation("spotLight.outerCutOff");
+
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+		std::string index = "[" + std::to_string(i) + "]";
+		uniforms.Shadows.Matrices[i] = shader.uniformLocation("shadowMatrices" + index);
+		uniforms.Shadows.Splits[i] = shader.uniformLocation("shadowSplits" + index);
+		uniforms.Shadows.TexelSizes[i] = shader.uniformLocation("shadowTexelSizes" + index);
+	}
+	uniforms.Shadows.CascadeCount = shader.uniformLocation("shadowCascadeCount");
+	uniforms.Shadows.ViewForward = shader.uniformLocation("viewForward");
+	return uniforms;
+}
+
+// records the directional light, the point lights and the flashlight for a lit program
+inline void recordLightUniforms(CommandBuffer& commands, const ProgramUniforms& uniforms, EntityRegistry& registry, const SceneGraph& scene, const SimulationState& state) {
+	registry.each<DirectionalLight>([&](Entity, DirectionalLight& light) {
+		commands.setVec3(uniforms.DirLight.Direction, light.Direction);
+		commands.setVec3(uniforms.DirLight.Ambient, light.Ambient);
+		commands.setVec3(uniforms.DirLight.Diffuse, light.Diffuse);
+		commands.setVec3(uniforms.DirLight.Specular, light.Specular);
+	});
+
+	unsigned int index = 0;
+	registry.each<Transform, PointLight>([&](Entity, Transform& transform, PointLight& light) {
+		if (index >= MAX_POINT_LIGHTS) {
+			return;
+		}
+		const PointLightUniforms& target = uniforms.PointLights[index++];
+		commands.setVec3(target.Position, glm::vec3(state.World[scene.slotOf(transform.Node)][3]));
+		commands.setVec3(target.Ambient, light.Ambient);
+		commands.setVec3(target.Diffuse, light.Diffuse);
+		commands.setVec3(target.Specular, light.Specular);
+		commands.setFloat(target.Constant, light.Constant);
+		commands.setFloat(target.Linear, light.Linear);
+		commands.setFloat(target.Quadratic, light.Quadratic);
+	});
+	commands.setInt(uniforms.PointLightCount, (int)index);
+
+	registry.each<SpotLight>([&](Entity, SpotLight& light) {
+		// a disabled flashlight keeps its cone but contributes no light
+		glm::vec3 enabled = glm::vec3(light.Enabled ? 1.0f : 0.0f);
+		commands.setVec3(uniforms.Spot.Position, light.Position);
+		commands.setVec3(uniforms.Spot.Direction, light.Direction);
+		commands.setVec3(uniforms.Spot.Ambient, light.Ambient * enabled);
+		commands.setVec3(uniforms.Spot.Diffuse, light.Diffuse * enabled);
+		commands.setVec3(uniforms.Spot.Specular, light.Specular * enabled);
+		commands.setFloat(uniforms.Spot.Constant, light.Constant);
+		commands.setFloat(uniforms.Spot.Linear, light.Linear);
+		commands.setFloat(uniforms.Spot.Quadratic, light.Quadratic);
+		commands.setFloat(uniforms.Spot.CutOff, light.CutOff);
+		commands.setFloat(uniforms.Spot.OuterCutOff, light.OuterCutOff);
+	});
+}
+
+// records the cascades the lit shaders look shadows up in, cascadeCount 0 leaves everything unshadowed
+inline void recordShadowUniforms(CommandBuffer& commands, const ProgramUniforms& uniforms, const ShadowCascade* cascades, unsigned int cascadeCount,
+	const glm::vec3& viewForward) {
+	for (unsigned int i = 0; i < cascadeCount; i++) {
+		commands.setMat4(uniforms.Shadows.Matrices[i], cascades[i].Lookup);
+		commands.setFloat(uniforms.Shadows.Splits[i], cascades[i].SplitDistance);
+		commands.setFloat(uniforms.Shadows.TexelSizes[i], cascades[i].TexelSize);
+	}
+	commands.setInt(uniforms.Shadows.CascadeCount, (int)cascadeCount);
+	commands.setVec3(uniforms.Shadows.ViewForward, viewForward);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef LOD_SELECTION_H
+#define LOD_SELECTION_H
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "components.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+const float LOD_PIXEL_ERROR = 1.0f;    // pixels a level of detail may deviate from the full mesh by on screen
+const float LOD_HYSTERESIS = 0.25f;    // fraction below the threshold a coarser level has to fit before it is taken
+
+// Picks a level of detail per draw from how large its error would appear: the object space error of
+// each level, scaled like the mesh, is projected with the camera's field of view at the distance of
+// the nearest point of the bounding sphere onto the pixels of the rendered view. The coarsest level
+// within PixelError is drawn, but a slot keeps last frame's level until that exceeds the threshold
+// or a coarser one fits LOD_HYSTERESIS below it, so an object hovering around a switching distance
+// does not pop back and forth. select() may run on several jobs at once for different slots.
+class LodSelector {
+public:
+	float PixelError = LOD_PIXEL_ERROR;    // 0 draws everything at full detail
+
+	// call once per frame before selecting; slotCount covers every slot select() will be given
+	void begin(const Camera& camera, int viewHeight, uint32_t slotCount) {
+		viewPosition = camera.getPosition();
+		nearPlane = camera.getNearPlane();
+		pixelsPerUnit = (float)viewHeight / (2.0f * std::tan(glm::radians(camera.getFov()) * 0.5f));
+		if (levels.size() < slotCount) {
+			levels.resize(slotCount, 0);
+		}
+	}
+
+	// the level to draw mesh at for the node in slot, sphere is its world space bounding sphere
+	uint32_t select(const Mesh& mesh, uint32_t slot, const glm::vec4& sphere) {
+		if (mesh.LodCount < 2 || PixelError <= 0.0f || mesh.BoundingRadius <= 0.0f) {
+			return 0;
+		}
+		float distance = std::max(glm::length(glm::vec3(sphere) - viewPosition) - sphere.w, nearPlane);
+		float pixelsPerError = sphere.w / mesh.BoundingRadius * pixelsPerUnit / distance;
+		auto pixels = [&](uint32_t level) { return mesh.Lods[level].Error * pixelsPerError; };
+
+		uint32_t level = std::min<uint32_t>(levels[slot], mesh.LodCount - 1);
+		while (level > 0 && pixels(level) > PixelError) {
+			level--;
+		}
+		while (level + 1 < mesh.LodCount && pixels(level + 1) <= PixelError * (1.0f - LOD_HYSTERESIS)) {
+			level++;
+		}
+		levels[slot] = (uint8_t)level;
+		return level;
+	}
+
+private:
+	glm::vec3 viewPosition = glm::vec3(0.0f);
+	float nearPlane = NEAR_PLANE;
+	float pixelsPerUnit = 1.0f;
+	std::vector<uint8_t> levels;   // last frame's level per slot
+};
+
+#endif
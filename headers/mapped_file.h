@@ -0,0 +1,120 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only into memory. Parsers read it in place, so loading a large asset
+// costs no copy into a buffer of our own and pages the OS already has cached are not read again.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const char* path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER fileSize;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize)) {
+			std::cout << "ERROR::MAPPED_FILE::NOT_OPENED " << path << std::endl;
+			close();
+			return false;
+		}
+		bytes = (size_t)fileSize.QuadPart;
+		if (bytes > 0) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (!view) {
+				std::cout << "ERROR::MAPPED_FILE::NOT_MAPPED " << path << std::endl;
+				close();
+				return false;
+			}
+		}
+#else
+		int descriptor = ::open(path, O_RDONLY);
+		struct stat status;
+		if (descriptor < 0 || fstat(descriptor, &status) != 0) {
+			std::cout << "ERROR::MAPPED_FILE::NOT_OPENED " << path << std::endl;
+			if (descriptor >= 0) {
+				::close(descriptor);
+			}
+			return false;
+		}
+		bytes = (size_t)status.st_size;
+		if (bytes > 0) {
+			view = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (view == MAP_FAILED) {
+				view = nullptr;
+				bytes = 0;
+				::close(descriptor);
+				std::cout << "ERROR::MAPPED_FILE::NOT_MAPPED " << path << std::endl;
+				return false;
+			}
+			// parsers walk the file front to back, so the kernel can read ahead aggressively
+			madvise(view, bytes, MADV_SEQUENTIAL);
+		}
+		// the mapping keeps the file alive on its own
+		::close(descriptor);
+#endif
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (view) {
+			UnmapViewOfFile(view);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (view) {
+			munmap(view, bytes);
+		}
+#endif
+		view = nullptr;
+		bytes = 0;
+	}
+
+	// an empty file has no mapping, data() is then an empty string
+	const char* data() const {
+		return view ? static_cast<const char*>(view) : "";
+	}
+
+	size_t size() const {
+		return bytes;
+	}
+
+private:
+	void* view = nullptr;
+	size_t bytes = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef MESH_FORMAT_H
+#define MESH_FORMAT_H
+
+#include "mapped_file.h"
+#include "mesh_import.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The engine's own mesh file, written offline by mesh_convert and loaded without parsing: a fixed
+// header followed by blobs that are already in the layout the GPU buffers take, each starting on a
+// MESH_FILE_ALIGNMENT boundary so a mapped file can be copied from directly. All values are little
+// endian. A reader accepts exactly MESH_FILE_VERSION; any change to a record bumps it.
+const uint32_t MESH_FILE_MAGIC = 0x48534D45;    // "EMSH"
+const uint32_t MESH_FILE_VERSION = 1;
+const uint64_t MESH_FILE_ALIGNMENT = 64;
+const unsigned int MESH_FILE_MAX_ATTRIBUTES = 8;
+const char* const MESH_FILE_EXTENSION = ".mesh";
+
+// how an attribute's components are stored, each maps to a GL type and normalization
+enum meshAttributeType : uint8_t {
+	MESH_ATTRIBUTE_FLOAT,
+	MESH_ATTRIBUTE_HALF_FLOAT,
+	MESH_ATTRIBUTE_UNORM8,
+	MESH_ATTRIBUTE_SNORM16,
+	MESH_ATTRIBUTE_TYPE_COUNT
+};
+
+inline uint32_t meshAttributeTypeSize(meshAttributeType type) {
+	static const uint32_t sizes[MESH_ATTRIBUTE_TYPE_COUNT] = { 4, 2, 1, 2 };
+	return sizes[type];
+}
+
+struct MeshFileAttribute {
+	uint8_t Location;      // shader input location: 0 position, 1 normal, 2 texture coordinates
+	uint8_t Components;
+	uint8_t Type;          // meshAttributeType
+	uint8_t Reserved;
+	uint32_t Offset;       // from the start of the vertex
+};
+
+// the vertex layout descriptor, one interleaved stream
+struct MeshFileLayout {
+	uint32_t Stride;
+	uint32_t AttributeCount;
+	MeshFileAttribute Attributes[MESH_FILE_MAX_ATTRIBUTES];
+};
+
+struct MeshFileSection {
+	uint64_t Offset;       // from the start of the file, a multiple of MESH_FILE_ALIGNMENT
+	uint64_t Size;
+};
+
+// one level of detail: a range of the index blob and of the meshlet table, level 0 is the full mesh
+struct MeshFileLod {
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+	uint32_t MeshletOffset;
+	uint32_t MeshletCount;
+	float Error;           // object space distance the level deviates from the full mesh by
+	uint32_t Reserved;
+};
+
+// a small cluster of triangles: its vertices index the vertex blob from the meshlet vertex blob, its
+// triangles are three bytes each indexing those, and the sphere and normal cone bound it for culling.
+// The triangle blob mirrors the index blob byte for index, so a meshlet's triangles are also the
+// contiguous index range starting at TriangleOffset. The record is laid out like a std430 struct
+struct MeshFileMeshlet {
+	uint32_t VertexOffset;
+	uint32_t TriangleOffset;   // in bytes into the meshlet triangle blob, the same as the first index
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+	float Center[3];
+	float Radius;
+	float ConeAxis[3];
+	float ConeCutoff;          // cosine of the half angle of the normals around the axis, 0 or less never faces away
+};
+
+struct MeshFileHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t HeaderSize;
+	uint32_t Flags;
+	uint64_t FileSize;
+	uint32_t VertexCount;
+	uint32_t IndexCount;       // of level 0, indices are 32-bit
+	uint32_t LodCount;
+	uint32_t MeshletCount;
+	float BoundsMin[3];
+	float BoundsMax[3];
+	float BoundingRadius;      // around the local origin
+	uint32_t Reserved;
+	MeshFileLayout Layout;
+	MeshFileSection Vertices;
+	MeshFileSection Indices;   // every level's indices, one after the other
+	MeshFileSection Lods;
+	MeshFileSection Meshlets;
+	MeshFileSection MeshletVertices;
+	MeshFileSection MeshletTriangles;
+};
+
+static_assert(sizeof(MeshFileAttribute) == 8, "mesh file records have a fixed size");
+static_assert(sizeof(MeshFileLayout) == 72, "mesh file records have a fixed size");
+static_assert(sizeof(MeshFileLod) == 24, "mesh file records have a fixed size");
+static_assert(sizeof(MeshFileMeshlet) == 48, "mesh file records have a fixed size");
+static_assert(sizeof(MeshFileHeader) == 240, "mesh file records have a fixed size");
+static_assert(sizeof(MeshFileMeshlet) == sizeof(Meshlet), "meshlets are written as they are built");
+
+inline bool isMeshFilePath(const std::string& path) {
+	size_t length = std::strlen(MESH_FILE_EXTENSION);
+	return path.size() > length && path.compare(path.size() - length, length, MESH_FILE_EXTENSION) == 0;
+}
+
+// the layout of MeshVertex, what the importer produces
+inline MeshFileLayout meshVertexLayout() {
+	MeshFileLayout layout = {};
+	layout.Stride = sizeof(MeshVertex);
+	layout.AttributeCount = 3;
+	layout.Attributes[0] = { 0, 3, MESH_ATTRIBUTE_FLOAT, 0, (uint32_t)offsetof(MeshVertex, Position) };
+	layout.Attributes[1] = { 1, 3, MESH_ATTRIBUTE_FLOAT, 0, (uint32_t)offsetof(MeshVertex, Normal) };
+	layout.Attributes[2] = { 2, 2, MESH_ATTRIBUTE_FLOAT, 0, (uint32_t)offsetof(MeshVertex, TexCoord) };
+	return layout;
+}
+
+inline uint64_t alignMeshFileOffset(uint64_t offset) {
+	return (offset + MESH_FILE_ALIGNMENT - 1) & ~(MESH_FILE_ALIGNMENT - 1);
+}
+
+// writes mesh with its levels of detail, or as a single level when it has none, and their meshlets
+inline bool writeMeshFile(const std::string& path, const MeshData& mesh) {
+	MeshFileHeader header = {};
+	header.Magic = MESH_FILE_MAGIC;
+	header.Version = MESH_FILE_VERSION;
+	header.HeaderSize = sizeof(MeshFileHeader);
+	header.VertexCount = (uint32_t)mesh.Vertices.size();
+	header.IndexCount = fullDetailIndexCount(mesh);
+	header.LodCount = mesh.Lods.empty() ? 1 : (uint32_t)mesh.Lods.size();
+	header.MeshletCount = (uint32_t)mesh.Meshlets.size();
+	std::memcpy(header.BoundsMin, &mesh.BoundsMin, sizeof(header.BoundsMin));
+	std::memcpy(header.BoundsMax, &mesh.BoundsMax, sizeof(header.BoundsMax));
+	header.BoundingRadius = mesh.BoundingRadius;
+	header.Layout = meshVertexLayout();
+
+	std::vector<MeshFileLod> lods(header.LodCount);
+	for (uint32_t i = 0; i < header.LodCount; i++) {
+		const MeshLod level = mesh.Lods.empty() ? MeshLod{ 0, header.IndexCount, 0.0f } : mesh.Lods[i];
+		lods[i] = { level.IndexOffset, level.IndexCount, level.MeshletOffset, level.MeshletCount, level.Error, 0 };
+	}
+
+	// sections in file order, each aligned
+	uint64_t offset = alignMeshFileOffset(sizeof(MeshFileHeader));
+	auto place = [&offset](MeshFileSection& section, uint64_t size) {
+		section = { offset, size };
+		offset = alignMeshFileOffset(offset + size);
+	};
+	place(header.Vertices, mesh.Vertices.size() * sizeof(MeshVertex));
+	place(header.Indices, mesh.Indices.size() * sizeof(uint32_t));
+	place(header.Lods, lods.size() * sizeof(MeshFileLod));
+	place(header.Meshlets, mesh.Meshlets.size() * sizeof(MeshFileMeshlet));
+	place(header.MeshletVertices, mesh.MeshletVertices.size() * sizeof(uint32_t));
+	place(header.MeshletTriangles, mesh.MeshletTriangles.size());
+	header.FileSize = offset;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "ERROR::MESH_FILE::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+	uint64_t written = 0;
+	auto write = [&file, &written](uint64_t at, const void* data, uint64_t size) {
+		static const char padding[MESH_FILE_ALIGNMENT] = {};
+		file.write(padding, (std::streamsize)(at - written));
+		file.write(static_cast<const char*>(data), (std::streamsize)size);
+		written = at + size;
+	};
+	write(0, &header, sizeof(header));
+	write(header.Vertices.Offset, mesh.Vertices.data(), header.Vertices.Size);
+	write(header.Indices.Offset, mesh.Indices.data(), header.Indices.Size);
+	write(header.Lods.Offset, lods.data(), header.Lods.Size);
+	write(header.Meshlets.Offset, mesh.Meshlets.data(), header.Meshlets.Size);
+	write(header.MeshletVertices.Offset, mesh.MeshletVertices.data(), header.MeshletVertices.Size);
+	write(header.MeshletTriangles.Offset, mesh.MeshletTriangles.data(), header.MeshletTriangles.Size);
+	write(header.FileSize, nullptr, 0);
+	if (!file.good()) {
+		std::cout << "ERROR::MESH_FILE::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// A mesh file mapped into memory. open() checks the header and that every section lies inside the
+// file and agrees with the counts, but not the index values: they were checked when the file was
+// written, and reading every index back would make loading bound by the CPU again.
+class MeshFile {
+public:
+	bool open(const std::string& path) {
+		if (!file.open(path.c_str())) {
+			return false;
+		}
+		if (file.size() < sizeof(MeshFileHeader)) {
+			std::cout << "ERROR::MESH_FILE::TRUNCATED " << path << std::endl;
+			file.close();
+			return false;
+		}
+		std::memcpy(&fileHeader, file.data(), sizeof(MeshFileHeader));
+		if (fileHeader.Magic != MESH_FILE_MAGIC) {
+			std::cout << "ERROR::MESH_FILE::NOT_A_MESH_FILE " << path << std::endl;
+			file.close();
+			return false;
+		}
+		if (fileHeader.Version != MESH_FILE_VERSION || fileHeader.HeaderSize != sizeof(MeshFileHeader)) {
+			std::cout << "ERROR::MESH_FILE::UNSUPPORTED_VERSION " << fileHeader.Version << " " << path << std::endl;
+			file.close();
+			return false;
+		}
+		if (!validate()) {
+			std::cout << "ERROR::MESH_FILE::CORRUPT " << path << std::endl;
+			file.close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		file.close();
+	}
+
+	const MeshFileHeader& header() const {
+		return fileHeader;
+	}
+
+	const void* vertices() const {
+		return section(fileHeader.Vertices);
+	}
+
+	const uint32_t* indices() const {
+		return static_cast<const uint32_t*>(section(fileHeader.Indices));
+	}
+
+	const MeshFileLod* lods() const {
+		return static_cast<const MeshFileLod*>(section(fileHeader.Lods));
+	}
+
+	const MeshFileMeshlet* meshlets() const {
+		return static_cast<const MeshFileMeshlet*>(section(fileHeader.Meshlets));
+	}
+
+	const uint32_t* meshletVertices() const {
+		return static_cast<const uint32_t*>(section(fileHeader.MeshletVertices));
+	}
+
+	const uint8_t* meshletTriangles() const {
+		return static_cast<const uint8_t*>(section(fileHeader.MeshletTriangles));
+	}
+
+	// copies the vertices, indices, levels of detail and meshlets out, for tools working on the mesh
+	void read(MeshData& mesh) const {
+		mesh = MeshData();
+		mesh.Vertices.resize(fileHeader.VertexCount);
+		const unsigned char* source = static_cast<const unsigned char*>(vertices());
+		MeshFileLayout layout = meshVertexLayout();
+		if (std::memcmp(&layout, &fileHeader.Layout, sizeof(layout)) == 0) {
+			std::memcpy(mesh.Vertices.data(), source, fileHeader.Vertices.Size);
+		}
+		else {
+			// other layouts only carry their float attributes over
+			for (uint32_t i = 0; i < fileHeader.VertexCount; i++) {
+				float* target = &mesh.Vertices[i].Position.x;
+				std::memset(target, 0, sizeof(MeshVertex));
+				for (uint32_t a = 0; a < fileHeader.Layout.AttributeCount; a++) {
+					const MeshFileAttribute& attribute = fileHeader.Layout.Attributes[a];
+					if (attribute.Type == MESH_ATTRIBUTE_FLOAT && attribute.Location < 3) {
+						uint32_t components = std::min<uint32_t>(attribute.Components, layout.Attributes[attribute.Location].Components);
+						std::memcpy(reinterpret_cast<unsigned char*>(target) + layout.Attributes[attribute.Location].Offset,
+							source + (size_t)i * fileHeader.Layout.Stride + attribute.Offset, components * sizeof(float));
+					}
+				}
+			}
+		}
+		mesh.Indices.assign(indices(), indices() + fileHeader.Indices.Size / sizeof(uint32_t));
+		for (uint32_t i = 0; i < fileHeader.LodCount; i++) {
+			mesh.Lods.push_back({ lods()[i].IndexOffset, lods()[i].IndexCount, lods()[i].Error, lods()[i].MeshletOffset, lods()[i].MeshletCount });
+		}
+		const Meshlet* clusters = reinterpret_cast<const Meshlet*>(meshlets());
+		mesh.Meshlets.assign(clusters, clusters + fileHeader.MeshletCount);
+		mesh.MeshletVertices.assign(meshletVertices(), meshletVertices() + fileHeader.MeshletVertices.Size / sizeof(uint32_t));
+		mesh.MeshletTriangles.assign(meshletTriangles(), meshletTriangles() + fileHeader.MeshletTriangles.Size);
+		std::memcpy(&mesh.BoundsMin, fileHeader.BoundsMin, sizeof(fileHeader.BoundsMin));
+		std::memcpy(&mesh.BoundsMax, fileHeader.BoundsMax, sizeof(fileHeader.BoundsMax));
+		mesh.BoundingRadius = fileHeader.BoundingRadius;
+	}
+
+private:
+	MappedFile file;
+	MeshFileHeader fileHeader = {};
+
+	const void* section(const MeshFileSection& entry) const {
+		return file.data() + entry.Offset;
+	}
+
+	bool validate() const {
+		const MeshFileHeader& h = fileHeader;
+		if (h.FileSize > file.size()) {
+			return false;
+		}
+		for (const MeshFileSection* entry : { &h.Vertices, &h.Indices, &h.Lods, &h.Meshlets, &h.MeshletVertices, &h.MeshletTriangles }) {
+			if (entry->Offset % MESH_FILE_ALIGNMENT != 0 || entry->Offset > h.FileSize || entry->Size > h.FileSize - entry->Offset) {
+				return false;
+			}
+		}
+		if (h.Layout.Stride == 0 || h.Layout.AttributeCount > MESH_FILE_MAX_ATTRIBUTES) {
+			return false;
+		}
+		for (uint32_t i = 0; i < h.Layout.AttributeCount; i++) {
+			const MeshFileAttribute& attribute = h.Layout.Attributes[i];
+			if (attribute.Type >= MESH_ATTRIBUTE_TYPE_COUNT || attribute.Components == 0 || attribute.Components > 4
+				|| attribute.Offset + attribute.Components * meshAttributeTypeSize((meshAttributeType)attribute.Type) > h.Layout.Stride) {
+				return false;
+			}
+		}
+		if (h.Vertices.Size != (uint64_t)h.VertexCount * h.Layout.Stride || h.Lods.Size != (uint64_t)h.LodCount * sizeof(MeshFileLod)
+			|| h.Meshlets.Size != (uint64_t)h.MeshletCount * sizeof(MeshFileMeshlet) || h.LodCount == 0
+			|| (h.MeshletCount > 0 && h.MeshletTriangles.Size != h.Indices.Size / sizeof(uint32_t))) {
+			return false;
+		}
+		uint64_t indexCount = h.Indices.Size / sizeof(uint32_t);
+		uint64_t meshletVertexCount = h.MeshletVertices.Size / sizeof(uint32_t);
+		const MeshFileLod* levels = lods();
+		if (levels[0].IndexOffset != 0 || levels[0].IndexCount != h.IndexCount) {
+			return false;
+		}
+		for (uint32_t i = 0; i < h.LodCount; i++) {
+			if ((uint64_t)levels[i].IndexOffset + levels[i].IndexCount > indexCount || levels[i].IndexCount % 3 != 0
+				|| (uint64_t)levels[i].MeshletOffset + levels[i].MeshletCount > h.MeshletCount) {
+				return false;
+			}
+		}
+		const MeshFileMeshlet* clusters = meshlets();
+		for (uint32_t i = 0; i < h.MeshletCount; i++) {
+			if ((uint64_t)clusters[i].VertexOffset + clusters[i].VertexCount > meshletVertexCount
+				|| (uint64_t)clusters[i].TriangleOffset + clusters[i].TriangleCount * 3 > h.MeshletTriangles.Size) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,1409 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// one vertex in the layout every mesh shader reads: position, normal and texture coordinates
+// interleaved as eight floats
+struct MeshVertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoord;
+};
+
+static_assert(sizeof(MeshVertex) == 8 * sizeof(float), "mesh vertices are eight tightly packed floats");
+
+// a level of detail as a range of MeshData::Indices, drawn with the same vertices as the full mesh,
+// and the range of MeshData::Meshlets its triangles are split into
+struct MeshLod {
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+	float Error;       // object space distance the level deviates from the full mesh by
+	uint32_t MeshletOffset = 0;
+	uint32_t MeshletCount = 0;
+};
+
+// a cluster of a few dozen triangles drawn as a unit, bounded by a sphere and by a cone around the
+// normals of its triangles for culling, see mesh_meshlets.h
+struct Meshlet {
+	uint32_t VertexOffset;     // into MeshData::MeshletVertices
+	uint32_t TriangleOffset;   // into MeshData::MeshletTriangles, which mirrors Indices, so also its first index
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+	glm::vec3 Center;
+	float Radius;
+	glm::vec3 ConeAxis;
+	float ConeCutoff;          // cosine of the cone's half angle, 0 or less when it can never face away
+};
+
+static_assert(sizeof(Meshlet) == 48, "meshlets are copied to the GPU as they are");
+
+// an indexed triangle list ready to upload, texture coordinates with t = 0 at the top of the image
+// like the engine's textures
+struct MeshData {
+	std::vector<MeshVertex> Vertices;
+	std::vector<uint32_t> Indices;     // every level's indices one after the other, the full mesh first
+	std::vector<MeshLod> Lods;         // empty while Indices only holds the full mesh
+	std::vector<Meshlet> Meshlets;     // empty until the levels are split into clusters
+	std::vector<uint32_t> MeshletVertices;     // indices into Vertices
+	std::vector<uint8_t> MeshletTriangles;     // three local vertex numbers per triangle
+	glm::vec3 BoundsMin = glm::vec3(0.0f);
+	glm::vec3 BoundsMax = glm::vec3(0.0f);
+	float BoundingRadius = 0.0f;   // around the local origin
+};
+
+// indices of the full detail level
+inline uint32_t fullDetailIndexCount(const MeshData& mesh) {
+	return mesh.Lods.empty() ? (uint32_t)mesh.Indices.size() : mesh.Lods[0].IndexCount;
+}
+
+enum meshFileFormat {
+	MESH_FILE_OBJ,     // Wavefront OBJ
+	MESH_FILE_GLTF,    // glTF 2.0 JSON, buffers in .bin files or data URIs
+	MESH_FILE_GLB,     // glTF 2.0 binary container
+	MESH_FILE_FORMAT_COUNT
+};
+
+inline const char* meshFileFormatName(meshFileFormat format) {
+	static const char* names[MESH_FILE_FORMAT_COUNT] = { "obj", "gltf", "glb" };
+	return names[format];
+}
+
+// picks the format from the file extension, in any case
+inline bool meshFileFormatFromPath(const std::string& path, meshFileFormat& format) {
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos) {
+		return false;
+	}
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	for (unsigned int i = 0; i < MESH_FILE_FORMAT_COUNT; i++) {
+		if (extension == meshFileFormatName((meshFileFormat)i)) {
+			format = (meshFileFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Parsers for the model formats and the processing that readies their output for drawing. Both
+// parsers read the mapped file in place: numbers are converted straight out of the text with
+// std::from_chars, the glTF JSON becomes one flat array of tokens pointing into it, and every output
+// array is sized from a first pass, so importing allocates a handful of times however large the
+// model is.
+namespace meshimport {
+
+	const uint32_t EMPTY = ~0u;
+
+	inline uint32_t mixHash(uint32_t h) {
+		// murmur3 finalizer, spreads neighbouring keys over the whole table
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// smallest power of two table that keeps an open addressing hash at most half full
+	inline size_t hashCapacity(size_t count) {
+		size_t capacity = 16;
+		while (capacity < count * 2) {
+			capacity <<= 1;
+		}
+		return capacity;
+	}
+
+	inline bool isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* skipBlanks(const char* p, const char* end) {
+		while (p < end && isBlank(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* lineEnd(const char* p, const char* end) {
+		const void* newline = std::memchr(p, '\n', (size_t)(end - p));
+		return newline ? static_cast<const char*>(newline) : end;
+	}
+
+	inline bool parseFloats(const char*& p, const char* end, float* values, unsigned int count) {
+		for (unsigned int i = 0; i < count; i++) {
+			p = skipBlanks(p, end);
+			// from_chars takes no explicit plus sign, which some exporters write
+			if (p < end && *p == '+') {
+				p++;
+			}
+			std::from_chars_result result = std::from_chars(p, end, values[i]);
+			if (result.ec != std::errc()) {
+				return false;
+			}
+			p = result.ptr;
+		}
+		return true;
+	}
+
+	// OBJ indexes positions, texture coordinates and normals separately; every distinct triple a
+	// face corner uses becomes one vertex. open addressing over a flat array, -1 is an absent index
+	class CornerTable {
+	public:
+		explicit CornerTable(size_t expected) {
+			slots.assign(hashCapacity(expected), Slot{ 0, 0, 0, EMPTY });
+		}
+
+		// the vertex made for this triple earlier, or candidate, which is then recorded for it
+		uint32_t findOrInsert(int32_t position, int32_t texCoord, int32_t normal, uint32_t candidate) {
+			if ((used + 1) * 2 > slots.size()) {
+				grow();
+			}
+			size_t mask = slots.size() - 1;
+			size_t h = hash(position, texCoord, normal) & mask;
+			while (true) {
+				Slot& slot = slots[h];
+				if (slot.Vertex == EMPTY) {
+					slot = { position, texCoord, normal, candidate };
+					used++;
+					return candidate;
+				}
+				if (slot.Position == position && slot.TexCoord == texCoord && slot.Normal == normal) {
+					return slot.Vertex;
+				}
+				h = (h + 1) & mask;
+			}
+		}
+
+	private:
+		struct Slot {
+			int32_t Position, TexCoord, Normal;
+			uint32_t Vertex;
+		};
+
+		std::vector<Slot> slots;
+		size_t used = 0;
+
+		static uint32_t hash(int32_t position, int32_t texCoord, int32_t normal) {
+			return mixHash((uint32_t)position * 73856093u ^ (uint32_t)texCoord * 19349663u ^ (uint32_t)normal * 83492791u);
+		}
+
+		void grow() {
+			std::vector<Slot> old(slots.size() * 2, Slot{ 0, 0, 0, EMPTY });
+			old.swap(slots);
+			size_t mask = slots.size() - 1;
+			for (const Slot& slot : old) {
+				if (slot.Vertex == EMPTY) {
+					continue;
+				}
+				size_t h = hash(slot.Position, slot.TexCoord, slot.Normal) & mask;
+				while (slots[h].Vertex != EMPTY) {
+					h = (h + 1) & mask;
+				}
+				slots[h] = slot;
+			}
+		}
+	};
+
+	// 1-based from the start or negative from the end of what was defined so far, 0 is absent
+	inline bool resolveObjIndex(int64_t index, size_t count, int32_t& resolved) {
+		if (index == 0) {
+			resolved = -1;
+			return true;
+		}
+		int64_t value = index > 0 ? index - 1 : (int64_t)count + index;
+		if (value < 0 || value >= (int64_t)count) {
+			return false;
+		}
+		resolved = (int32_t)value;
+		return true;
+	}
+
+	inline bool parseObjIndex(const char*& p, const char* end, int64_t& index) {
+		std::from_chars_result result = std::from_chars(p, end, index);
+		if (result.ec != std::errc()) {
+			return false;
+		}
+		p = result.ptr;
+		return true;
+	}
+
+	enum jsonType : uint8_t {
+		JSON_OBJECT,
+		JSON_ARRAY,
+		JSON_STRING,
+		JSON_PRIMITIVE   // number, true, false or null
+	};
+
+	struct JsonToken {
+		jsonType Type;
+		uint32_t Start, End;   // byte range in the text, strings without their quotes
+		uint32_t Count;        // members of an object, elements of an array
+		uint32_t Next;         // the token after this value and everything nested in it
+	};
+
+	const uint32_t JSON_NONE = ~0u;
+	const int JSON_MAX_DEPTH = 64;
+
+	// A JSON document as one array of tokens in document order, each container followed by its
+	// contents and each object member by its key and then its value. Nothing is copied out of the
+	// text; lookups step over whole values with Next. Queries on JSON_NONE return JSON_NONE or the
+	// fallback, so a chain of lookups only has to be checked at its end.
+	class JsonDocument {
+	public:
+		bool parse(const char* data, size_t size) {
+			if (size >= JSON_NONE) {
+				return false;
+			}
+			text = data;
+			end = data + size;
+			tokens.clear();
+			tokens.reserve(size / 8 + 16);
+			const char* p = data;
+			return parseValue(p, 0);
+		}
+
+		uint32_t root() const {
+			return tokens.empty() ? JSON_NONE : 0;
+		}
+
+		// value of the object's member named key
+		uint32_t member(uint32_t object, const char* key) const {
+			if (object == JSON_NONE || tokens[object].Type != JSON_OBJECT) {
+				return JSON_NONE;
+			}
+			uint32_t child = object + 1;
+			for (uint32_t i = 0; i < tokens[object].Count; i++) {
+				if (equals(child, key)) {
+					return child + 1;
+				}
+				child = tokens[child + 1].Next;
+			}
+			return JSON_NONE;
+		}
+
+		// the array's elements, looked up once so indexing into them later is direct
+		void elements(uint32_t array, std::vector<uint32_t>& result) const {
+			result.clear();
+			if (array == JSON_NONE || tokens[array].Type != JSON_ARRAY) {
+				return;
+			}
+			result.reserve(tokens[array].Count);
+			uint32_t child = array + 1;
+			for (uint32_t i = 0; i < tokens[array].Count; i++) {
+				result.push_back(child);
+				child = tokens[child].Next;
+			}
+		}
+
+		uint32_t count(uint32_t value) const {
+			return value == JSON_NONE ? 0 : tokens[value].Count;
+		}
+
+		bool isArray(uint32_t value) const {
+			return value != JSON_NONE && tokens[value].Type == JSON_ARRAY;
+		}
+
+		double number(uint32_t value, double fallback) const {
+			if (value == JSON_NONE || tokens[value].Type != JSON_PRIMITIVE) {
+				return fallback;
+			}
+			double result;
+			const char* first = text + tokens[value].Start;
+			const char* last = text + tokens[value].End;
+			std::from_chars_result parsed = std::from_chars(first, last, result);
+			return parsed.ec == std::errc() ? result : fallback;
+		}
+
+		int64_t integer(uint32_t value, int64_t fallback) const {
+			return (int64_t)number(value, (double)fallback);
+		}
+
+		bool boolean(uint32_t value, bool fallback) const {
+			if (value == JSON_NONE || tokens[value].Type != JSON_PRIMITIVE) {
+				return fallback;
+			}
+			return text[tokens[value].Start] == 't';
+		}
+
+		// compares an unescaped string value with text
+		bool equals(uint32_t value, const char* compare) const {
+			if (value == JSON_NONE || tokens[value].Type != JSON_STRING) {
+				return false;
+			}
+			size_t length = tokens[value].End - tokens[value].Start;
+			return std::strlen(compare) == length && std::memcmp(text + tokens[value].Start, compare, length) == 0;
+		}
+
+		// the raw characters of a string, escapes included
+		std::pair<const char*, size_t> raw(uint32_t value) const {
+			if (value == JSON_NONE || tokens[value].Type != JSON_STRING) {
+				return { "", 0 };
+			}
+			return { text + tokens[value].Start, tokens[value].End - tokens[value].Start };
+		}
+
+		// a string with the common escapes resolved, \u only for ASCII which is all URIs contain
+		std::string string(uint32_t value) const {
+			std::pair<const char*, size_t> characters = raw(value);
+			std::string result;
+			result.reserve(characters.second);
+			for (size_t i = 0; i < characters.second; i++) {
+				char c = characters.first[i];
+				if (c != '\\' || i + 1 >= characters.second) {
+					result.push_back(c);
+					continue;
+				}
+				c = characters.first[++i];
+				if (c == 'n') {
+					result.push_back('\n');
+				}
+				else if (c == 't') {
+					result.push_back('\t');
+				}
+				else if (c == 'u' && i + 4 < characters.second) {
+					unsigned int code = 0;
+					std::from_chars(characters.first + i + 1, characters.first + i + 5, code, 16);
+					result.push_back(code < 0x80 ? (char)code : '?');
+					i += 4;
+				}
+				else {
+					result.push_back(c);
+				}
+			}
+			return result;
+		}
+
+	private:
+		const char* text = nullptr;
+		const char* end = nullptr;
+		std::vector<JsonToken> tokens;
+
+		uint32_t offset(const char* p) const {
+			return (uint32_t)(p - text);
+		}
+
+		const char* skipWhitespace(const char* p) const {
+			while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+				p++;
+			}
+			return p;
+		}
+
+		bool parseValue(const char*& p, int depth) {
+			p = skipWhitespace(p);
+			if (p >= end || depth > JSON_MAX_DEPTH) {
+				return false;
+			}
+			uint32_t index = (uint32_t)tokens.size();
+			tokens.push_back({ JSON_PRIMITIVE, offset(p), offset(p), 0, 0 });
+
+			if (*p == '{' || *p == '[') {
+				bool object = *p == '{';
+				char close = object ? '}' : ']';
+				tokens[index].Type = object ? JSON_OBJECT : JSON_ARRAY;
+				p = skipWhitespace(p + 1);
+				uint32_t count = 0;
+				if (p < end && *p == close) {
+					p++;
+				}
+				else {
+					while (true) {
+						if (object) {
+							p = skipWhitespace(p);
+							if (p >= end || *p != '"' || !parseValue(p, depth + 1)) {
+								return false;
+							}
+							p = skipWhitespace(p);
+							if (p >= end || *p != ':') {
+								return false;
+							}
+							p++;
+						}
+						if (!parseValue(p, depth + 1)) {
+							return false;
+						}
+						count++;
+						p = skipWhitespace(p);
+						if (p < end && *p == ',') {
+							p++;
+							continue;
+						}
+						if (p < end && *p == close) {
+							p++;
+							break;
+						}
+						return false;
+					}
+				}
+				tokens[index].Count = count;
+				tokens[index].End = offset(p);
+			}
+			else if (*p == '"') {
+				p++;
+				tokens[index].Type = JSON_STRING;
+				tokens[index].Start = offset(p);
+				while (p < end && *p != '"') {
+					p += *p == '\\' ? 2 : 1;
+				}
+				if (p >= end) {
+					return false;
+				}
+				tokens[index].End = offset(p);
+				p++;
+			}
+			else {
+				while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+					p++;
+				}
+				tokens[index].End = offset(p);
+				if (tokens[index].End == tokens[index].Start) {
+					return false;
+				}
+			}
+			tokens[index].Next = (uint32_t)tokens.size();
+			return true;
+		}
+	};
+
+	inline bool decodeBase64(const char* p, size_t size, std::vector<unsigned char>& result) {
+		static const std::array<uint8_t, 256> table = []() {
+			std::array<uint8_t, 256> values;
+			values.fill(0xFF);
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for (uint8_t i = 0; i < 64; i++) {
+				values[(unsigned char)alphabet[i]] = i;
+			}
+			return values;
+		}();
+
+		result.clear();
+		result.reserve(size / 4 * 3);
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for (size_t i = 0; i < size && p[i] != '='; i++) {
+			uint8_t value = table[(unsigned char)p[i]];
+			if (value == 0xFF) {
+				return false;
+			}
+			bits = (bits << 6) | value;
+			bitCount += 6;
+			if (bitCount >= 8) {
+				bitCount -= 8;
+				result.push_back((unsigned char)(bits >> bitCount));
+			}
+		}
+		return true;
+	}
+
+	// relative URIs may escape spaces and other characters as %XX
+	inline std::string decodeUri(const std::string& uri) {
+		std::string result;
+		result.reserve(uri.size());
+		for (size_t i = 0; i < uri.size(); i++) {
+			unsigned int code = 0;
+			if (uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, code, 16).ec == std::errc()) {
+				result.push_back((char)code);
+				i += 2;
+			}
+			else {
+				result.push_back(uri[i]);
+			}
+		}
+		return result;
+	}
+
+	const uint32_t GLTF_BYTE = 5120;
+	const uint32_t GLTF_UNSIGNED_BYTE = 5121;
+	const uint32_t GLTF_SHORT = 5122;
+	const uint32_t GLTF_UNSIGNED_SHORT = 5123;
+	const uint32_t GLTF_UNSIGNED_INT = 5125;
+	const uint32_t GLTF_FLOAT = 5126;
+	const int64_t GLTF_TRIANGLES = 4;
+
+	const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+	inline uint32_t gltfComponentSize(uint32_t componentType) {
+		switch (componentType) {
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE:
+			return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT:
+			return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	inline float readGltfComponent(const unsigned char* p, uint32_t componentType, bool normalized) {
+		switch (componentType) {
+		case GLTF_FLOAT: {
+			float value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		case GLTF_UNSIGNED_BYTE:
+			return normalized ? p[0] / 255.0f : (float)p[0];
+		case GLTF_BYTE:
+			return normalized ? std::max((int8_t)p[0] / 127.0f, -1.0f) : (float)(int8_t)p[0];
+		case GLTF_UNSIGNED_SHORT: {
+			uint16_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return normalized ? value / 65535.0f : (float)value;
+		}
+		case GLTF_SHORT: {
+			int16_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+		}
+		case GLTF_UNSIGNED_INT: {
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return (float)value;
+		}
+		default:
+			return 0.0f;
+		}
+	}
+
+	// an accessor resolved down to memory: Count elements of Components values each, Stride apart
+	struct GltfAccessor {
+		const unsigned char* Data = nullptr;
+		size_t Count = 0;
+		size_t Stride = 0;
+		uint32_t ComponentType = 0;
+		uint32_t Components = 0;
+		bool Normalized = false;
+
+		void read(size_t index, float* values) const {
+			const unsigned char* element = Data + index * Stride;
+			if (ComponentType == GLTF_FLOAT) {
+				std::memcpy(values, element, Components * sizeof(float));
+				return;
+			}
+			uint32_t size = gltfComponentSize(ComponentType);
+			for (uint32_t i = 0; i < Components; i++) {
+				values[i] = readGltfComponent(element + i * size, ComponentType, Normalized);
+			}
+		}
+
+		uint32_t readIndex(size_t index) const {
+			const unsigned char* element = Data + index * Stride;
+			if (ComponentType == GLTF_UNSIGNED_BYTE) {
+				return element[0];
+			}
+			if (ComponentType == GLTF_UNSIGNED_SHORT) {
+				uint16_t value;
+				std::memcpy(&value, element, sizeof(value));
+				return value;
+			}
+			uint32_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+	};
+
+	// Walks the default scene of a glTF document and appends the triangles of every mesh it places,
+	// transformed into the scene's space. Buffers are the GLB binary chunk, external files mapped like
+	// the model itself or base64 data URIs.
+	class GltfImporter {
+	public:
+		bool import(const char* data, size_t size, const std::string& directory, bool binary, MeshData& mesh) {
+			const char* jsonText = data;
+			size_t jsonSize = size;
+			if (binary && !readContainer(data, size, jsonText, jsonSize)) {
+				return false;
+			}
+			if (!json.parse(jsonText, jsonSize)) {
+				std::cout << "ERROR::MESH_IMPORT::GLTF_JSON_NOT_PARSED" << std::endl;
+				return false;
+			}
+			uint32_t root = json.root();
+			if (!loadBuffers(json.member(root, "buffers"), directory)) {
+				return false;
+			}
+			json.elements(json.member(root, "bufferViews"), bufferViews);
+			json.elements(json.member(root, "accessors"), accessors);
+			json.elements(json.member(root, "meshes"), meshes);
+			json.elements(json.member(root, "nodes"), nodes);
+
+			// counting first sizes the output arrays once
+			std::vector<uint32_t> primitives;
+			size_t vertexCount = 0;
+			size_t indexCount = 0;
+			for (uint32_t meshToken : meshes) {
+				json.elements(json.member(meshToken, "primitives"), primitives);
+				for (uint32_t primitive : primitives) {
+					GltfAccessor accessor;
+					uint32_t attributes = json.member(primitive, "attributes");
+					if (resolveAccessor(json.integer(json.member(attributes, "POSITION"), -1), accessor)) {
+						vertexCount += accessor.Count;
+						indexCount += accessor.Count;
+					}
+					if (resolveAccessor(json.integer(json.member(primitive, "indices"), -1), accessor)) {
+						indexCount += accessor.Count;
+					}
+				}
+			}
+			mesh.Vertices.reserve(vertexCount);
+			mesh.Indices.reserve(indexCount);
+
+			uint32_t scenes = json.member(root, "scenes");
+			if (json.count(scenes) == 0) {
+				// a document without scenes is a library of meshes, take each once as it is
+				for (size_t i = 0; i < meshes.size(); i++) {
+					if (!importMesh((uint32_t)i, glm::mat4(1.0f), mesh)) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			std::vector<uint32_t> sceneList;
+			json.elements(scenes, sceneList);
+			int64_t sceneIndex = json.integer(json.member(root, "scene"), 0);
+			if (sceneIndex < 0 || sceneIndex >= (int64_t)sceneList.size()) {
+				std::cout << "ERROR::MESH_IMPORT::GLTF_SCENE_OUT_OF_RANGE " << sceneIndex << std::endl;
+				return false;
+			}
+			std::vector<uint32_t> children;
+			json.elements(json.member(sceneList[sceneIndex], "nodes"), children);
+			std::vector<std::pair<int64_t, glm::mat4>> stack;
+			for (uint32_t child : children) {
+				stack.push_back({ json.integer(child, -1), glm::mat4(1.0f) });
+			}
+			// the node hierarchy has to be a forest, visiting more nodes than there are means a cycle
+			size_t visited = 0;
+			while (!stack.empty()) {
+				std::pair<int64_t, glm::mat4> entry = stack.back();
+				stack.pop_back();
+				if (entry.first < 0 || entry.first >= (int64_t)nodes.size() || ++visited > nodes.size()) {
+					std::cout << "ERROR::MESH_IMPORT::GLTF_INVALID_NODE_HIERARCHY" << std::endl;
+					return false;
+				}
+				uint32_t node = nodes[entry.first];
+				glm::mat4 world = entry.second * localMatrix(node);
+				int64_t meshIndex = json.integer(json.member(node, "mesh"), -1);
+				if (meshIndex >= 0 && !importMesh((uint32_t)meshIndex, world, mesh)) {
+					return false;
+				}
+				json.elements(json.member(node, "children"), children);
+				for (uint32_t child : children) {
+					stack.push_back({ json.integer(child, -1), world });
+				}
+			}
+			return true;
+		}
+
+	private:
+		struct Buffer {
+			const unsigned char* Data;
+			size_t Size;
+		};
+
+		JsonDocument json;
+		const unsigned char* binaryChunk = nullptr;
+		size_t binaryChunkSize = 0;
+		std::vector<Buffer> buffers;
+		std::vector<std::unique_ptr<MappedFile>> files;
+		std::vector<std::vector<unsigned char>> decoded;
+		std::vector<uint32_t> bufferViews;
+		std::vector<uint32_t> accessors;
+		std::vector<uint32_t> meshes;
+		std::vector<uint32_t> nodes;
+
+		// the 12 byte header, then the JSON chunk and an optional binary chunk, all little endian
+		bool readContainer(const char* data, size_t size, const char*& jsonText, size_t& jsonSize) {
+			uint32_t header[5];
+			if (size < sizeof(header)) {
+				std::cout << "ERROR::MESH_IMPORT::GLB_TRUNCATED" << std::endl;
+				return false;
+			}
+			std::memcpy(header, data, sizeof(header));
+			if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size || header[4] != GLB_CHUNK_JSON
+				|| (uint64_t)header[3] + sizeof(header) > header[2]) {
+				std::cout << "ERROR::MESH_IMPORT::GLB_INVALID_HEADER" << std::endl;
+				return false;
+			}
+			jsonText = data + sizeof(header);
+			jsonSize = header[3];
+
+			size_t chunk = sizeof(header) + ((header[3] + 3) & ~3u);
+			uint32_t chunkHeader[2];
+			if (chunk + sizeof(chunkHeader) <= header[2]) {
+				std::memcpy(chunkHeader, data + chunk, sizeof(chunkHeader));
+				if (chunkHeader[1] == GLB_CHUNK_BIN && chunk + sizeof(chunkHeader) + chunkHeader[0] <= header[2]) {
+					binaryChunk = reinterpret_cast<const unsigned char*>(data + chunk + sizeof(chunkHeader));
+					binaryChunkSize = chunkHeader[0];
+				}
+			}
+			return true;
+		}
+
+		bool loadBuffers(uint32_t list, const std::string& directory) {
+			std::vector<uint32_t> entries;
+			json.elements(list, entries);
+			for (size_t i = 0; i < entries.size(); i++) {
+				uint32_t uriToken = json.member(entries[i], "uri");
+				size_t byteLength = (size_t)json.integer(json.member(entries[i], "byteLength"), 0);
+				Buffer buffer = { nullptr, 0 };
+				if (uriToken == JSON_NONE) {
+					// only the first buffer of a GLB may leave out its URI, it is the binary chunk
+					if (i == 0 && binaryChunk) {
+						buffer = { binaryChunk, binaryChunkSize };
+					}
+				}
+				else {
+					std::pair<const char*, size_t> uri = json.raw(uriToken);
+					if (uri.second > 5 && std::memcmp(uri.first, "data:", 5) == 0) {
+						// the text is not null terminated, search within the string only
+						const char* uriEnd = uri.first + uri.second;
+						const char* base64 = ";base64,";
+						const char* marker = std::search(uri.first, uriEnd, base64, base64 + 8);
+						decoded.emplace_back();
+						if (marker != uriEnd) {
+							const char* payload = marker + 8;
+							if (decodeBase64(payload, (size_t)(uriEnd - payload), decoded.back())) {
+								buffer = { decoded.back().data(), decoded.back().size() };
+							}
+						}
+					}
+					else {
+						files.emplace_back(new MappedFile());
+						if (files.back()->open((directory + decodeUri(json.string(uriToken))).c_str())) {
+							buffer = { reinterpret_cast<const unsigned char*>(files.back()->data()), files.back()->size() };
+						}
+					}
+				}
+				if (!buffer.Data || buffer.Size < byteLength) {
+					std::cout << "ERROR::MESH_IMPORT::GLTF_BUFFER_NOT_LOADED " << i << std::endl;
+					return false;
+				}
+				buffers.push_back(buffer);
+			}
+			return true;
+		}
+
+		// checks the accessor, its view and its buffer cover each other, false for a missing index
+		bool resolveAccessor(int64_t index, GltfAccessor& accessor) const {
+			if (index < 0 || index >= (int64_t)accessors.size()) {
+				return false;
+			}
+			uint32_t token = accessors[index];
+			int64_t viewIndex = json.integer(json.member(token, "bufferView"), -1);
+			if (viewIndex < 0 || viewIndex >= (int64_t)bufferViews.size() || json.member(token, "sparse") != JSON_NONE) {
+				// accessors without a view are all zeros and sparse ones patch a base, neither comes up in meshes
+				std::cout << "ERROR::MESH_IMPORT::GLTF_ACCESSOR_UNSUPPORTED " << index << std::endl;
+				return false;
+			}
+			uint32_t type = json.member(token, "type");
+			accessor.Components = json.equals(type, "SCALAR") ? 1 : json.equals(type, "VEC2") ? 2 : json.equals(type, "VEC3") ? 3 : json.equals(type, "VEC4") ? 4 : 0;
+			accessor.ComponentType = (uint32_t)json.integer(json.member(token, "componentType"), 0);
+			accessor.Normalized = json.boolean(json.member(token, "normalized"), false);
+			accessor.Count = (size_t)json.integer(json.member(token, "count"), 0);
+			size_t elementSize = (size_t)accessor.Components * gltfComponentSize(accessor.ComponentType);
+
+			uint32_t view = bufferViews[viewIndex];
+			int64_t bufferIndex = json.integer(json.member(view, "buffer"), -1);
+			size_t viewOffset = (size_t)json.integer(json.member(view, "byteOffset"), 0);
+			size_t viewLength = (size_t)json.integer(json.member(view, "byteLength"), 0);
+			size_t offset = (size_t)json.integer(json.member(token, "byteOffset"), 0);
+			accessor.Stride = (size_t)json.integer(json.member(view, "byteStride"), 0);
+			if (accessor.Stride == 0) {
+				accessor.Stride = elementSize;
+			}
+			size_t needed = accessor.Count == 0 ? 0 : offset + accessor.Stride * (accessor.Count - 1) + elementSize;
+			if (elementSize == 0 || bufferIndex < 0 || bufferIndex >= (int64_t)buffers.size()
+				|| viewOffset + viewLength > buffers[bufferIndex].Size || needed > viewLength) {
+				std::cout << "ERROR::MESH_IMPORT::GLTF_ACCESSOR_OUT_OF_RANGE " << index << std::endl;
+				return false;
+			}
+			accessor.Data = buffers[bufferIndex].Data + viewOffset + offset;
+			return true;
+		}
+
+		glm::mat4 localMatrix(uint32_t node) const {
+			std::vector<uint32_t> values;
+			uint32_t matrix = json.member(node, "matrix");
+			if (json.count(matrix) == 16) {
+				// column major like glm
+				json.elements(matrix, values);
+				glm::mat4 result;
+				for (int i = 0; i < 16; i++) {
+					glm::value_ptr(result)[i] = (float)json.number(values[i], 0.0);
+				}
+				return result;
+			}
+			glm::vec3 translation(0.0f);
+			glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale(1.0f);
+			json.elements(json.member(node, "translation"), values);
+			if (values.size() == 3) {
+				translation = glm::vec3(json.number(values[0], 0.0), json.number(values[1], 0.0), json.number(values[2], 0.0));
+			}
+			json.elements(json.member(node, "rotation"), values);
+			if (values.size() == 4) {
+				// stored x, y, z, w
+				rotation = glm::quat((float)json.number(values[3], 1.0), (float)json.number(values[0], 0.0), (float)json.number(values[1], 0.0), (float)json.number(values[2], 0.0));
+			}
+			json.elements(json.member(node, "scale"), values);
+			if (values.size() == 3) {
+				scale = glm::vec3(json.number(values[0], 1.0), json.number(values[1], 1.0), json.number(values[2], 1.0));
+			}
+			glm::mat4 result = glm::mat4_cast(rotation);
+			result[0] *= scale.x;
+			result[1] *= scale.y;
+			result[2] *= scale.z;
+			result[3] = glm::vec4(translation, 1.0f);
+			return result;
+		}
+
+		bool importMesh(uint32_t index, const glm::mat4& world, MeshData& mesh) {
+			if (index >= meshes.size()) {
+				std::cout << "ERROR::MESH_IMPORT::GLTF_MESH_OUT_OF_RANGE " << index << std::endl;
+				return false;
+			}
+			glm::mat3 linear(world);
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+			// a mirroring transform turns the triangles inside out unless their winding flips with it
+			bool mirrored = glm::determinant(linear) < 0.0f;
+
+			std::vector<uint32_t> primitives;
+			json.elements(json.member(meshes[index], "primitives"), primitives);
+			for (uint32_t primitive : primitives) {
+				// points and lines have nothing to shade
+				if (json.integer(json.member(primitive, "mode"), GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+					continue;
+				}
+				uint32_t attributes = json.member(primitive, "attributes");
+				GltfAccessor positions, normals, texCoords, indices;
+				if (!resolveAccessor(json.integer(json.member(attributes, "POSITION"), -1), positions)
+					|| positions.Components != 3 || positions.ComponentType != GLTF_FLOAT) {
+					std::cout << "ERROR::MESH_IMPORT::GLTF_POSITIONS_NOT_FOUND" << std::endl;
+					return false;
+				}
+				bool hasNormals = resolveAccessor(json.integer(json.member(attributes, "NORMAL"), -1), normals)
+					&& normals.Components == 3 && normals.Count == positions.Count;
+				bool hasTexCoords = resolveAccessor(json.integer(json.member(attributes, "TEXCOORD_0"), -1), texCoords)
+					&& texCoords.Components == 2 && texCoords.Count == positions.Count;
+
+				size_t base = mesh.Vertices.size();
+				mesh.Vertices.resize(base + positions.Count);
+				for (size_t i = 0; i < positions.Count; i++) {
+					MeshVertex& vertex = mesh.Vertices[base + i];
+					glm::vec3 position;
+					positions.read(i, &position.x);
+					vertex.Position = glm::vec3(world * glm::vec4(position, 1.0f));
+					vertex.Normal = glm::vec3(0.0f);
+					vertex.TexCoord = glm::vec2(0.0f);
+					if (hasNormals) {
+						glm::vec3 normal;
+						normals.read(i, &normal.x);
+						vertex.Normal = normalMatrix * normal;
+					}
+					if (hasTexCoords) {
+						// glTF puts t = 0 at the top of the image too
+						texCoords.read(i, &vertex.TexCoord.x);
+					}
+				}
+
+				int64_t indexAccessor = json.integer(json.member(primitive, "indices"), -1);
+				if (indexAccessor < 0) {
+					size_t count = positions.Count / 3 * 3;
+					for (size_t i = 0; i < count; i += 3) {
+						mesh.Indices.push_back((uint32_t)(base + i));
+						mesh.Indices.push_back((uint32_t)(base + i + (mirrored ? 2 : 1)));
+						mesh.Indices.push_back((uint32_t)(base + i + (mirrored ? 1 : 2)));
+					}
+					continue;
+				}
+				if (!resolveAccessor(indexAccessor, indices) || indices.Components != 1
+					|| (indices.ComponentType != GLTF_UNSIGNED_BYTE && indices.ComponentType != GLTF_UNSIGNED_SHORT && indices.ComponentType != GLTF_UNSIGNED_INT)) {
+					std::cout << "ERROR::MESH_IMPORT::GLTF_INDICES_NOT_READ" << std::endl;
+					return false;
+				}
+				size_t count = indices.Count / 3 * 3;
+				for (size_t i = 0; i < count; i += 3) {
+					uint32_t a = indices.readIndex(i);
+					uint32_t b = indices.readIndex(i + 1);
+					uint32_t c = indices.readIndex(i + 2);
+					if (a >= positions.Count || b >= positions.Count || c >= positions.Count) {
+						std::cout << "ERROR::MESH_IMPORT::GLTF_INDEX_OUT_OF_RANGE" << std::endl;
+						return false;
+					}
+					if (mirrored) {
+						std::swap(b, c);
+					}
+					mesh.Indices.push_back((uint32_t)base + a);
+					mesh.Indices.push_back((uint32_t)base + b);
+					mesh.Indices.push_back((uint32_t)base + c);
+				}
+			}
+			return true;
+		}
+	};
+
+	// Forsyth's vertex score: vertices just used score high, the rest decay with their age in a
+	// modelled LRU cache, and vertices with few triangles left are favoured so nothing is stranded
+	const unsigned int FORSYTH_CACHE_SIZE = 32;
+	const unsigned int FORSYTH_VALENCE_TABLE = 32;
+
+	inline float forsythScore(int cachePosition, uint32_t remaining) {
+		static const std::array<float, FORSYTH_CACHE_SIZE> cacheScores = []() {
+			std::array<float, FORSYTH_CACHE_SIZE> scores;
+			for (unsigned int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+				// the last triangle's three vertices count the same, whichever order they went in
+				scores[i] = i < 3 ? 0.75f : std::pow(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+			}
+			return scores;
+		}();
+		static const std::array<float, FORSYTH_VALENCE_TABLE> valenceScores = []() {
+			std::array<float, FORSYTH_VALENCE_TABLE> scores;
+			scores[0] = 0.0f;
+			for (unsigned int i = 1; i < FORSYTH_VALENCE_TABLE; i++) {
+				scores[i] = 2.0f / std::sqrt((float)i);
+			}
+			return scores;
+		}();
+
+		if (remaining == 0) {
+			return -1.0f;
+		}
+		float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+		return score + (remaining < FORSYTH_VALENCE_TABLE ? valenceScores[remaining] : 2.0f / std::sqrt((float)remaining));
+	}
+
+	inline uint32_t hashVertex(const MeshVertex& vertex) {
+		uint32_t words[8];
+		std::memcpy(words, &vertex, sizeof(words));
+		uint32_t h = 2166136261u;
+		for (uint32_t word : words) {
+			h = (h ^ word) * 16777619u;
+		}
+		return mixHash(h);
+	}
+}
+
+// the parsers append to mesh, they do no processing of their own
+
+inline bool parseObj(const char* data, size_t size, MeshData& mesh) {
+	using namespace meshimport;
+	const char* end = data + size;
+
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0, faceCount = 0;
+	for (const char* p = data; p < end; p = lineEnd(p, end) + 1) {
+		const char* q = skipBlanks(p, end);
+		if (end - q < 3) {
+			continue;
+		}
+		if (q[0] == 'v') {
+			positionCount += isBlank(q[1]);
+			texCoordCount += q[1] == 't' && isBlank(q[2]);
+			normalCount += q[1] == 'n' && isBlank(q[2]);
+		}
+		else if (q[0] == 'f' && isBlank(q[1])) {
+			faceCount++;
+		}
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+	positions.reserve(positionCount);
+	texCoords.reserve(texCoordCount);
+	normals.reserve(normalCount);
+	// closed meshes have about as many distinct corners as positions, and mostly triangles
+	mesh.Vertices.reserve(mesh.Vertices.size() + positionCount + positionCount / 4);
+	mesh.Indices.reserve(mesh.Indices.size() + faceCount * 3);
+	CornerTable corners(positionCount);
+
+	for (const char* p = data; p < end;) {
+		const char* last = lineEnd(p, end);
+		const char* q = skipBlanks(p, last);
+		p = last + 1;
+		if (last - q < 3) {
+			continue;
+		}
+		if (q[0] == 'v') {
+			if (isBlank(q[1])) {
+				glm::vec3 position;
+				q += 2;
+				if (!parseFloats(q, last, &position.x, 3)) {
+					std::cout << "ERROR::MESH_IMPORT::OBJ_INVALID_POSITION" << std::endl;
+					return false;
+				}
+				positions.push_back(position);
+			}
+			else if (q[1] == 't' && isBlank(q[2])) {
+				glm::vec2 texCoord;
+				q += 3;
+				if (!parseFloats(q, last, &texCoord.x, 2)) {
+					std::cout << "ERROR::MESH_IMPORT::OBJ_INVALID_TEXCOORD" << std::endl;
+					return false;
+				}
+				// OBJ puts t = 0 at the bottom of the image
+				texCoords.push_back(glm::vec2(texCoord.x, 1.0f - texCoord.y));
+			}
+			else if (q[1] == 'n' && isBlank(q[2])) {
+				glm::vec3 normal;
+				q += 3;
+				if (!parseFloats(q, last, &normal.x, 3)) {
+					std::cout << "ERROR::MESH_IMPORT::OBJ_INVALID_NORMAL" << std::endl;
+					return false;
+				}
+				normals.push_back(normal);
+			}
+		}
+		else if (q[0] == 'f' && isBlank(q[1])) {
+			// polygons are split into a fan around their first corner
+			q += 2;
+			uint32_t first = 0, previous = 0;
+			unsigned int corner = 0;
+			while (true) {
+				q = skipBlanks(q, last);
+				if (q >= last || *q == '#') {
+					break;
+				}
+				// v, v/t, v//n or v/t/n
+				int64_t index[3] = { 0, 0, 0 };
+				bool parsed = parseObjIndex(q, last, index[0]);
+				if (parsed && q < last && *q == '/') {
+					q++;
+					if (q < last && *q != '/') {
+						parsed = parseObjIndex(q, last, index[1]);
+					}
+					if (parsed && q < last && *q == '/') {
+						q++;
+						parsed = parseObjIndex(q, last, index[2]);
+					}
+				}
+				int32_t position, texCoord, normal;
+				if (!parsed || index[0] == 0) {
+					std::cout << "ERROR::MESH_IMPORT::OBJ_INVALID_FACE" << std::endl;
+					return false;
+				}
+				if (!resolveObjIndex(index[0], positions.size(), position) || !resolveObjIndex(index[1], texCoords.size(), texCoord)
+					|| !resolveObjIndex(index[2], normals.size(), normal)) {
+					std::cout << "ERROR::MESH_IMPORT::OBJ_INDEX_OUT_OF_RANGE" << std::endl;
+					return false;
+				}
+
+				uint32_t vertex = corners.findOrInsert(position, texCoord, normal, (uint32_t)mesh.Vertices.size());
+				if (vertex == mesh.Vertices.size()) {
+					mesh.Vertices.push_back({
+						positions[position],
+						normal >= 0 ? normals[normal] : glm::vec3(0.0f),
+						texCoord >= 0 ? texCoords[texCoord] : glm::vec2(0.0f)
+					});
+				}
+				if (corner == 0) {
+					first = vertex;
+				}
+				else if (corner >= 2) {
+					mesh.Indices.push_back(first);
+					mesh.Indices.push_back(previous);
+					mesh.Indices.push_back(vertex);
+				}
+				previous = vertex;
+				corner++;
+			}
+		}
+	}
+	return true;
+}
+
+// directory is where relative buffer URIs are looked up, with its trailing separator
+inline bool parseGltf(const char* data, size_t size, const std::string& directory, bool binary, MeshData& mesh) {
+	meshimport::GltfImporter importer;
+	return importer.import(data, size, directory, binary, mesh);
+}
+
+// area weighted face normals for the vertices that came without one
+inline void generateMissingNormals(MeshData& mesh) {
+	std::vector<uint8_t> missing(mesh.Vertices.size(), 0);
+	bool any = false;
+	for (size_t i = 0; i < mesh.Vertices.size(); i++) {
+		if (mesh.Vertices[i].Normal == glm::vec3(0.0f)) {
+			missing[i] = 1;
+			any = true;
+		}
+	}
+	if (!any) {
+		return;
+	}
+	for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+		uint32_t a = mesh.Indices[i], b = mesh.Indices[i + 1], c = mesh.Indices[i + 2];
+		if (!missing[a] && !missing[b] && !missing[c]) {
+			continue;
+		}
+		// the cross product is twice the triangle's area long
+		glm::vec3 normal = glm::cross(mesh.Vertices[b].Position - mesh.Vertices[a].Position, mesh.Vertices[c].Position - mesh.Vertices[a].Position);
+		for (uint32_t vertex : { a, b, c }) {
+			if (missing[vertex]) {
+				mesh.Vertices[vertex].Normal += normal;
+			}
+		}
+	}
+	for (size_t i = 0; i < mesh.Vertices.size(); i++) {
+		if (missing[i]) {
+			glm::vec3& normal = mesh.Vertices[i].Normal;
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+}
+
+// merges vertices whose every attribute is bit for bit the same and drops the unreferenced tail
+inline void weldVertices(MeshData& mesh) {
+	using namespace meshimport;
+	size_t count = mesh.Vertices.size();
+	std::vector<uint32_t> table(hashCapacity(count), EMPTY);
+	std::vector<uint32_t> remap(count);
+	size_t mask = table.size() - 1;
+	uint32_t unique = 0;
+	for (size_t i = 0; i < count; i++) {
+		const MeshVertex vertex = mesh.Vertices[i];
+		size_t h = hashVertex(vertex) & mask;
+		while (true) {
+			uint32_t slot = table[h];
+			if (slot == EMPTY) {
+				// the unique vertices are compacted to the front as they are found
+				table[h] = unique;
+				mesh.Vertices[unique] = vertex;
+				remap[i] = unique++;
+				break;
+			}
+			if (std::memcmp(&mesh.Vertices[slot], &vertex, sizeof(MeshVertex)) == 0) {
+				remap[i] = slot;
+				break;
+			}
+			h = (h + 1) & mask;
+		}
+	}
+	mesh.Vertices.resize(unique);
+	for (uint32_t& index : mesh.Indices) {
+		index = remap[index];
+	}
+}
+
+// Reorders the triangles for the post-transform vertex cache with Forsyth's linear-speed algorithm:
+// the next triangle is always the best scoring one among those of the vertices in a modelled cache,
+// so nearby triangles follow each other and reuse the vertices the GPU just shaded.
+inline void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+	using namespace meshimport;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// the triangles of each vertex, as ranges of one array
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		offsets[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t k = 0; k < 3; k++) {
+			uint32_t v = indices[t * 3 + k];
+			adjacency[offsets[v] + remaining[v]++] = (uint32_t)t;
+		}
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScores[v] = forsythScore(-1, remaining[v]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	uint32_t best = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		const uint32_t* triangle = &indices[t * 3];
+		triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+		if (triangleScores[t] > triangleScores[best]) {
+			best = (uint32_t)t;
+		}
+	}
+
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t next[FORSYTH_CACHE_SIZE + 3];
+	size_t cacheSize = 0;
+	size_t cursor = 0;
+	for (size_t n = 0; n < triangleCount; n++) {
+		if (best == EMPTY) {
+			// nothing left around the cache, start again from the first triangle still waiting
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = (uint32_t)cursor;
+		}
+		emitted[best] = 1;
+		uint32_t triangle[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+		result.insert(result.end(), triangle, triangle + 3);
+
+		size_t nextSize = 0;
+		for (uint32_t v : triangle) {
+			uint32_t* begin = &adjacency[offsets[v]];
+			uint32_t* found = std::find(begin, begin + remaining[v], best);
+			std::swap(*found, begin[remaining[v] - 1]);
+			remaining[v]--;
+			if (std::find(next, next + nextSize, v) == next + nextSize) {
+				next[nextSize++] = v;
+			}
+		}
+		size_t newCount = nextSize;
+		for (size_t i = 0; i < cacheSize; i++) {
+			if (std::find(next, next + newCount, cache[i]) == next + newCount) {
+				next[nextSize++] = cache[i];
+			}
+		}
+
+		// vertices past the cache's end were evicted, rescore them with the rest
+		for (size_t i = 0; i < nextSize; i++) {
+			uint32_t v = next[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int32_t)i : -1;
+			vertexScores[v] = forsythScore(cachePosition[v], remaining[v]);
+		}
+		best = EMPTY;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < nextSize; i++) {
+			uint32_t v = next[i];
+			for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+				uint32_t t = adjacency[j];
+				const uint32_t* other = &indices[t * 3];
+				float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+				triangleScores[t] = score;
+				if (i < FORSYTH_CACHE_SIZE && score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+		cacheSize = std::min(nextSize, (size_t)FORSYTH_CACHE_SIZE);
+		std::copy(next, next + cacheSize, cache);
+	}
+	indices.swap(result);
+}
+
+// renumbers the vertices in the order the triangles first use them, so vertex fetches walk memory
+// forwards, and drops vertices nothing references
+inline void optimizeVertexFetch(MeshData& mesh) {
+	std::vector<uint32_t> remap(mesh.Vertices.size(), meshimport::EMPTY);
+	std::vector<MeshVertex> ordered;
+	ordered.reserve(mesh.Vertices.size());
+	for (uint32_t& index : mesh.Indices) {
+		if (remap[index] == meshimport::EMPTY) {
+			remap[index] = (uint32_t)ordered.size();
+			ordered.push_back(mesh.Vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.Vertices.swap(ordered);
+}
+
+// vertices transformed per triangle with a FIFO post-transform cache of cacheSize entries, 0.5 is
+// the ideal for a large regular mesh and 3 means no reuse at all
+inline float averageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize = 16) {
+	if (indices.size() < 3) {
+		return 0.0f;
+	}
+	// a vertex is still cached while fewer than cacheSize misses came after its own
+	std::vector<uint32_t> loadedAt(vertexCount, 0);
+	uint32_t misses = 0;
+	uint32_t time = cacheSize + 1;
+	for (uint32_t index : indices) {
+		if (time - loadedAt[index] > cacheSize) {
+			loadedAt[index] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+inline void computeMeshBounds(MeshData& mesh) {
+	mesh.BoundsMin = glm::vec3(0.0f);
+	mesh.BoundsMax = glm::vec3(0.0f);
+	mesh.BoundingRadius = 0.0f;
+	if (mesh.Vertices.empty()) {
+		return;
+	}
+	mesh.BoundsMin = mesh.BoundsMax = mesh.Vertices[0].Position;
+	float radiusSquared = 0.0f;
+	for (const MeshVertex& vertex : mesh.Vertices) {
+		mesh.BoundsMin = glm::min(mesh.BoundsMin, vertex.Position);
+		mesh.BoundsMax = glm::max(mesh.BoundsMax, vertex.Position);
+		radiusSquared = std::max(radiusSquared, glm::dot(vertex.Position, vertex.Position));
+	}
+	mesh.BoundingRadius = std::sqrt(radiusSquared);
+}
+
+// readies parsed triangles for drawing: welds, fills in normals, orders the triangles for the vertex
+// cache and the vertices for fetching, and measures the result
+inline void optimizeMesh(MeshData& mesh) {
+	weldVertices(mesh);
+	generateMissingNormals(mesh);
+	optimizeVertexCache(mesh.Indices, mesh.Vertices.size());
+	optimizeVertexFetch(mesh);
+	computeMeshBounds(mesh);
+}
+
+// maps the model file, parses it by its extension and optimizes the result
+inline bool importMesh(const std::string& path, MeshData& mesh) {
+	meshFileFormat format;
+	if (!meshFileFormatFromPath(path, format)) {
+		std::cout << "ERROR::MESH_IMPORT::UNKNOWN_FORMAT " << path << std::endl;
+		return false;
+	}
+	MappedFile file;
+	if (!file.open(path.c_str())) {
+		return false;
+	}
+
+	mesh = MeshData();
+	size_t separator = path.find_last_of("/\\");
+	std::string directory = separator == std::string::npos ? "" : path.substr(0, separator + 1);
+	bool parsed = format == MESH_FILE_OBJ
+		? parseObj(file.data(), file.size(), mesh)
+		: parseGltf(file.data(), file.size(), directory, format == MESH_FILE_GLB, mesh);
+	if (!parsed) {
+		std::cout << "ERROR::MESH_IMPORT::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+		return false;
+	}
+	if (mesh.Indices.empty()) {
+		std::cout << "ERROR::MESH_IMPORT::NO_TRIANGLES " << path << std::endl;
+		return false;
+	}
+	optimizeMesh(mesh);
+	return true;
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef MESH_MESHLETS_H
+#define MESH_MESHLETS_H
+
+#include <glm/glm.hpp>
+
+#include "mesh_import.h"
+#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;    // 372 local indices, a whole number of 32-bit words
+const float MESHLET_CONE_MARGIN = 1e-3f;       // widens every cone so triangles seen edge on are never culled
+
+namespace meshcluster {
+
+// whether every edge of the triangles is shared by exactly two of them, comparing positions so
+// texture seams do not count as borders. only the back faces of closed surfaces are always hidden
+inline bool isClosed(const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& positionOf) {
+	std::vector<uint64_t> edges;
+	edges.reserve(indexCount);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		for (size_t k = 0; k < 3; k++) {
+			uint32_t a = positionOf[indices[i + k]];
+			uint32_t b = positionOf[indices[i + (k + 1) % 3]];
+			if (a != b) {
+				edges.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+			}
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); i += 2) {
+		if (i + 1 >= edges.size() || edges[i] != edges[i + 1] || (i + 2 < edges.size() && edges[i + 2] == edges[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// bounding sphere around the centre of the box of the meshlet's vertices, and the cone around the
+// mean of its triangle normals that holds all of them
+inline void computeBounds(const MeshData& mesh, Meshlet& meshlet, const uint32_t* indices, bool closed) {
+	glm::vec3 low(std::numeric_limits<float>::max());
+	glm::vec3 high(-std::numeric_limits<float>::max());
+	for (uint32_t i = 0; i < meshlet.VertexCount; i++) {
+		const glm::vec3& p = mesh.Vertices[mesh.MeshletVertices[meshlet.VertexOffset + i]].Position;
+		low = glm::min(low, p);
+		high = glm::max(high, p);
+	}
+	meshlet.Center = (low + high) * 0.5f;
+	meshlet.Radius = 0.0f;
+	for (uint32_t i = 0; i < meshlet.VertexCount; i++) {
+		const glm::vec3& p = mesh.Vertices[mesh.MeshletVertices[meshlet.VertexOffset + i]].Position;
+		meshlet.Radius = std::max(meshlet.Radius, glm::length(p - meshlet.Center));
+	}
+
+	std::vector<glm::vec3> normals;
+	glm::vec3 sum(0.0f);
+	for (uint32_t i = 0; i < meshlet.TriangleCount * 3; i += 3) {
+		const glm::vec3& a = mesh.Vertices[indices[i]].Position;
+		glm::vec3 normal = glm::cross(mesh.Vertices[indices[i + 1]].Position - a, mesh.Vertices[indices[i + 2]].Position - a);
+		float length = glm::length(normal);
+		if (length > 0.0f) {
+			normals.push_back(normal / length);
+			sum += normals.back();
+		}
+	}
+	meshlet.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.ConeCutoff = 0.0f;
+	float axisLength = glm::length(sum);
+	if (!closed || normals.empty() || axisLength <= 0.0f) {
+		return;
+	}
+	meshlet.ConeAxis = sum / axisLength;
+	float cutoff = 1.0f;
+	for (const glm::vec3& normal : normals) {
+		cutoff = std::min(cutoff, glm::dot(normal, meshlet.ConeAxis));
+	}
+	meshlet.ConeCutoff = std::max(cutoff - MESHLET_CONE_MARGIN, 0.0f);
+}
+
+} // namespace meshcluster
+
+// Splits every level of detail into meshlets of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles and lists them in mesh.Meshlets. A meshlet starts at the first
+// triangle left in the level's cache order and grows by the adjacent triangle that adds the fewest
+// new vertices, the one nearest its centre among those, which keeps meshlets compact so their
+// spheres and normal cones stay tight. Each level's indices are rewritten in meshlet order, which
+// makes a meshlet's triangles one contiguous index range that can be drawn on its own. Meshlets of
+// levels that are not closed get cones that never cull, since the engine draws both faces and an
+// open surface shows its back.
+inline void buildMeshlets(MeshData& mesh) {
+	using namespace meshcluster;
+	if (mesh.Lods.empty()) {
+		mesh.Lods.assign(1, { 0, (uint32_t)mesh.Indices.size(), 0.0f });
+	}
+	mesh.Meshlets.clear();
+	mesh.MeshletVertices.clear();
+	mesh.MeshletTriangles.assign(mesh.Indices.size(), 0);
+	std::vector<uint32_t> positionOf;
+	meshsimplify::findPositions(mesh.Vertices, positionOf);
+
+	size_t vertexCount = mesh.Vertices.size();
+	const uint8_t UNUSED = 0xff;
+	std::vector<uint8_t> local(vertexCount, UNUSED);   // number of each vertex in the meshlet being grown
+	std::vector<uint32_t> adjacencyOffsets;
+	std::vector<uint32_t> adjacency;
+	std::vector<glm::vec3> centroids;
+	std::vector<uint8_t> used;
+	std::vector<uint32_t> ordered;
+	std::vector<uint32_t> vertices;
+	std::vector<uint32_t> triangles;
+
+	for (MeshLod& level : mesh.Lods) {
+		const uint32_t* indices = mesh.Indices.data() + level.IndexOffset;
+		uint32_t triangleCount = level.IndexCount / 3;
+		bool closed = isClosed(indices, level.IndexCount, positionOf);
+
+		// the triangles around each vertex
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < level.IndexCount; i++) {
+			adjacencyOffsets[indices[i] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(level.IndexCount);
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		centroids.resize(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			const uint32_t* triangle = indices + t * 3;
+			for (uint32_t k = 0; k < 3; k++) {
+				adjacency[fill[triangle[k]]++] = t;
+			}
+			centroids[t] = (mesh.Vertices[triangle[0]].Position + mesh.Vertices[triangle[1]].Position + mesh.Vertices[triangle[2]].Position) / 3.0f;
+		}
+
+		used.assign(triangleCount, 0);
+		ordered.clear();
+		ordered.reserve(level.IndexCount);
+		level.MeshletOffset = (uint32_t)mesh.Meshlets.size();
+		uint32_t seed = 0;
+		while (true) {
+			while (seed < triangleCount && used[seed]) {
+				seed++;
+			}
+			if (seed == triangleCount) {
+				break;
+			}
+			vertices.clear();
+			triangles.clear();
+			glm::vec3 centroidSum(0.0f);
+			auto newVertices = [&](uint32_t t) {
+				uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+				return (uint32_t)(local[a] == UNUSED) + (local[b] == UNUSED && b != a) + (local[c] == UNUSED && c != a && c != b);
+			};
+			auto add = [&](uint32_t t) {
+				const uint32_t* triangle = indices + t * 3;
+				for (uint32_t k = 0; k < 3; k++) {
+					if (local[triangle[k]] == UNUSED) {
+						local[triangle[k]] = (uint8_t)vertices.size();
+						vertices.push_back(triangle[k]);
+					}
+				}
+				used[t] = 1;
+				triangles.push_back(t);
+				centroidSum += centroids[t];
+			};
+			add(seed);
+
+			while (triangles.size() < MESHLET_MAX_TRIANGLES) {
+				glm::vec3 center = centroidSum / (float)triangles.size();
+				uint32_t best = triangleCount;
+				uint32_t bestNew = 4;
+				float bestDistance = std::numeric_limits<float>::max();
+				for (uint32_t vertex : vertices) {
+					for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+						uint32_t t = adjacency[a];
+						if (used[t]) {
+							continue;
+						}
+						uint32_t added = newVertices(t);
+						if (vertices.size() + added > MESHLET_MAX_VERTICES || added > bestNew) {
+							continue;
+						}
+						glm::vec3 offset = centroids[t] - center;
+						float distance = glm::dot(offset, offset);
+						if (added < bestNew || distance < bestDistance) {
+							best = t;
+							bestNew = added;
+							bestDistance = distance;
+						}
+					}
+				}
+				if (best == triangleCount) {
+					break;
+				}
+				add(best);
+			}
+
+			Meshlet meshlet = {};
+			meshlet.VertexOffset = (uint32_t)mesh.MeshletVertices.size();
+			meshlet.TriangleOffset = level.IndexOffset + (uint32_t)ordered.size();
+			meshlet.VertexCount = (uint32_t)vertices.size();
+			meshlet.TriangleCount = (uint32_t)triangles.size();
+			mesh.MeshletVertices.insert(mesh.MeshletVertices.end(), vertices.begin(), vertices.end());
+			for (uint32_t t : triangles) {
+				for (uint32_t k = 0; k < 3; k++) {
+					uint32_t vertex = indices[t * 3 + k];
+					mesh.MeshletTriangles[level.IndexOffset + ordered.size()] = local[vertex];
+					ordered.push_back(vertex);
+				}
+			}
+			for (uint32_t vertex : vertices) {
+				local[vertex] = UNUSED;
+			}
+			computeBounds(mesh, meshlet, ordered.data() + (meshlet.TriangleOffset - level.IndexOffset), closed);
+			mesh.Meshlets.push_back(meshlet);
+		}
+		std::copy(ordered.begin(), ordered.end(), mesh.Indices.begin() + level.IndexOffset);
+		level.MeshletCount = (uint32_t)mesh.Meshlets.size() - level.MeshletOffset;
+	}
+}
+
+#endif
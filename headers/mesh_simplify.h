@@ -0,0 +1,340 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include "mesh_import.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+const uint32_t MESH_LOD_LEVELS = 6;            // the full mesh and up to five simplified levels
+const float MESH_LOD_REDUCTION = 0.5f;         // triangles each level aims to keep of the one before
+const float MESH_LOD_MIN_REDUCTION = 0.9f;     // a level keeping more than this of the one before is not worth storing
+const uint32_t MESH_LOD_MIN_TRIANGLES = 32;    // no level is simplified below this
+
+namespace meshsimplify {
+
+// squared distances to a set of planes, each weighted by the area of the triangle it came from.
+// the symmetric 4x4 matrix of Garland and Heckbert is kept as its ten distinct entries
+struct Quadric {
+	double XX = 0.0, XY = 0.0, XZ = 0.0, YY = 0.0, YZ = 0.0, ZZ = 0.0;
+	double DX = 0.0, DY = 0.0, DZ = 0.0, DD = 0.0;
+	double Weight = 0.0;
+
+	// the plane of points p with dot(normal, p) + distance = 0, normal of unit length
+	void addPlane(const glm::vec3& normal, float distance, double weight) {
+		double x = normal.x, y = normal.y, z = normal.z, d = distance;
+		XX += weight * x * x; XY += weight * x * y; XZ += weight * x * z;
+		YY += weight * y * y; YZ += weight * y * z; ZZ += weight * z * z;
+		DX += weight * x * d; DY += weight * y * d; DZ += weight * z * d;
+		DD += weight * d * d;
+		Weight += weight;
+	}
+
+	void add(const Quadric& other) {
+		XX += other.XX; XY += other.XY; XZ += other.XZ;
+		YY += other.YY; YZ += other.YZ; ZZ += other.ZZ;
+		DX += other.DX; DY += other.DY; DZ += other.DZ;
+		DD += other.DD;
+		Weight += other.Weight;
+	}
+
+	// mean squared distance of p from the planes
+	double error(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double sum = XX * x * x + YY * y * y + ZZ * z * z + 2.0 * (XY * x * y + XZ * x * z + YZ * y * z)
+			+ 2.0 * (DX * x + DY * y + DZ * z) + DD;
+		return Weight > 0.0 ? std::max(sum, 0.0) / Weight : 0.0;
+	}
+};
+
+struct Collapse {
+	uint32_t From;
+	uint32_t To;
+	double Cost;
+};
+
+// the position shared by vertices that only differ in their other attributes, as an id per vertex
+inline uint32_t findPositions(const std::vector<MeshVertex>& vertices, std::vector<uint32_t>& positionOf) {
+	std::vector<uint32_t> order(vertices.size());
+	for (uint32_t i = 0; i < (uint32_t)order.size(); i++) {
+		order[i] = i;
+	}
+	auto less = [&vertices](uint32_t a, uint32_t b) {
+		const glm::vec3& p = vertices[a].Position;
+		const glm::vec3& q = vertices[b].Position;
+		return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+	};
+	std::sort(order.begin(), order.end(), less);
+	positionOf.resize(vertices.size());
+	uint32_t count = 0;
+	for (size_t i = 0; i < order.size(); i++) {
+		if (i > 0 && less(order[i - 1], order[i])) {
+			count++;
+		}
+		positionOf[order[i]] = count;
+	}
+	return order.empty() ? 0 : count + 1;
+}
+
+} // namespace meshsimplify
+
+// Simplifies a triangle list towards targetIndexCount indices by edge collapses in order of the
+// quadric error metric: every position carries the planes of the triangles around it, and moving a
+// vertex onto a neighbour costs the neighbour's distance from the planes of both. Vertices only ever
+// move onto existing ones, so the result indexes the same vertices as the input. Vertices on open
+// borders and attribute seams stay put, which keeps outlines and texture mapping intact, and no
+// collapse may turn a triangle over. Independent collapses are applied in passes, cheapest first.
+// error receives the object space distance the result deviates from the input by, as the root mean
+// square over the planes merged into the worst collapse.
+inline std::vector<uint32_t> simplifyMesh(const std::vector<MeshVertex>& vertices, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, float& error) {
+	using namespace meshsimplify;
+	error = 0.0f;
+	size_t vertexCount = vertices.size();
+	std::vector<uint32_t> positionOf;
+	uint32_t positionCount = findPositions(vertices, positionOf);
+
+	// degenerate triangles have no plane and nothing to collapse
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t a = positionOf[indices[i]], b = positionOf[indices[i + 1]], c = positionOf[indices[i + 2]];
+		if (a != b && b != c && c != a) {
+			result.insert(result.end(), indices + i, indices + i + 3);
+		}
+	}
+
+	// a position is locked when more than one vertex uses it or one of its edges is not shared by
+	// exactly two triangles
+	std::vector<uint8_t> locked(positionCount, 0);
+	std::vector<uint32_t> vertexAt(positionCount, meshimport::EMPTY);
+	std::vector<uint64_t> edges;
+	edges.reserve(result.size());
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (size_t k = 0; k < 3; k++) {
+			uint32_t vertex = result[i + k];
+			uint32_t position = positionOf[vertex];
+			if (vertexAt[position] != meshimport::EMPTY && vertexAt[position] != vertex) {
+				locked[position] = 1;
+			}
+			vertexAt[position] = vertex;
+			uint32_t next = positionOf[result[i + (k + 1) % 3]];
+			edges.push_back((uint64_t)std::min(position, next) << 32 | std::max(position, next));
+		}
+		const glm::vec3& p0 = vertices[result[i]].Position;
+		glm::vec3 normal = glm::cross(vertices[result[i + 1]].Position - p0, vertices[result[i + 2]].Position - p0);
+		float area = glm::length(normal);
+		if (area > 0.0f) {
+			normal /= area;
+			for (size_t k = 0; k < 3; k++) {
+				quadrics[positionOf[result[i + k]]].addPlane(normal, -glm::dot(normal, p0), area * 0.5f);
+			}
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();) {
+		size_t run = i;
+		while (run < edges.size() && edges[run] == edges[i]) {
+			run++;
+		}
+		if (run - i != 2) {
+			locked[edges[i] >> 32] = 1;
+			locked[edges[i] & 0xFFFFFFFFu] = 1;
+		}
+		i = run;
+	}
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> offsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	std::vector<uint64_t> shared;
+	double worst = 0.0;
+	while (result.size() > targetIndexCount) {
+		// one candidate per edge, in whichever direction moves an unlocked vertex more cheaply. an
+		// edge between two triangles shows up once in each direction, so only one is looked at
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t k = 0; k < 3; k++) {
+				uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+				if (a > b) {
+					continue;
+				}
+				uint32_t pa = positionOf[a], pb = positionOf[b];
+				Quadric merged = quadrics[pa];
+				merged.add(quadrics[pb]);
+				Collapse best = { a, b, -1.0 };
+				if (!locked[pa]) {
+					best.Cost = merged.error(vertices[b].Position);
+				}
+				if (!locked[pb]) {
+					double cost = merged.error(vertices[a].Position);
+					if (best.Cost < 0.0 || cost < best.Cost) {
+						best = { b, a, cost };
+					}
+				}
+				if (best.Cost >= 0.0) {
+					collapses.push_back(best);
+				}
+			}
+		}
+		if (collapses.empty()) {
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.Cost < y.Cost; });
+
+		// each collapse removes about two triangles. the costliest one needed to reach the target,
+		// with some slack, bounds the pass so cheap collapses of the next pass are not skipped over
+		size_t triangleCount = result.size() / 3;
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t goal = std::max<size_t>((triangleCount - targetTriangles) / 2, 1);
+		double limit = collapses[std::min(goal, collapses.size()) - 1].Cost * 1.5;
+
+		// the triangles of each vertex, as ranges of one array
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t index : result) {
+			offsets[index + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			offsets[v + 1] += offsets[v];
+		}
+		adjacency.resize(result.size());
+		for (size_t i = 0; i < result.size(); i++) {
+			adjacency[offsets[result[i]]++] = (uint32_t)(i / 3);
+		}
+		for (size_t v = vertexCount; v > 0; v--) {
+			offsets[v] = offsets[v - 1];
+		}
+		offsets[0] = 0;
+
+		for (size_t v = 0; v < vertexCount; v++) {
+			remap[v] = (uint32_t)v;
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t applied = 0;
+		for (const Collapse& collapse : collapses) {
+			if (collapse.Cost > limit || triangleCount <= targetTriangles) {
+				break;
+			}
+			if (touched[collapse.From] || touched[collapse.To]) {
+				continue;
+			}
+			// the triangles around the moving vertex must keep facing the way they did
+			const glm::vec3& target = vertices[collapse.To].Position;
+			bool flips = false;
+			size_t removed = 0;
+			for (uint32_t j = offsets[collapse.From]; j < offsets[collapse.From + 1] && !flips; j++) {
+				const uint32_t* triangle = &result[adjacency[j] * 3];
+				if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) {
+					removed++;
+					continue;
+				}
+				glm::vec3 p[3], q[3];
+				for (size_t k = 0; k < 3; k++) {
+					p[k] = vertices[triangle[k]].Position;
+					q[k] = triangle[k] == collapse.From ? target : p[k];
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+			if (flips) {
+				continue;
+			}
+			// and the two ends may only share the neighbours of the edge itself, anything else would
+			// fold the surface onto itself (the link condition)
+			shared.clear();
+			for (uint32_t end : { collapse.From, collapse.To }) {
+				for (uint32_t j = offsets[end]; j < offsets[end + 1]; j++) {
+					const uint32_t* triangle = &result[adjacency[j] * 3];
+					for (size_t k = 0; k < 3; k++) {
+						uint32_t position = positionOf[triangle[k]];
+						if (position != positionOf[collapse.From] && position != positionOf[collapse.To]) {
+							shared.push_back((uint64_t)position << 1 | (end == collapse.To));
+						}
+					}
+				}
+			}
+			std::sort(shared.begin(), shared.end());
+			shared.erase(std::unique(shared.begin(), shared.end()), shared.end());
+			size_t common = 0;
+			for (size_t k = 1; k < shared.size(); k++) {
+				common += (shared[k] >> 1) == (shared[k - 1] >> 1);
+			}
+			if (common > 2) {
+				continue;
+			}
+
+			// the neighbourhood of both ends is left alone for the rest of the pass: the fan of From is
+			// about to change, and the checks above only held for the fan of To as it was
+			for (uint32_t end : { collapse.From, collapse.To }) {
+				for (uint32_t j = offsets[end]; j < offsets[end + 1]; j++) {
+					const uint32_t* triangle = &result[adjacency[j] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+				}
+			}
+			remap[collapse.From] = collapse.To;
+			quadrics[positionOf[collapse.To]].add(quadrics[positionOf[collapse.From]]);
+			worst = std::max(worst, collapse.Cost);
+			triangleCount -= std::min(removed, triangleCount);
+			applied++;
+		}
+		if (applied == 0) {
+			break;
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (a != b && b != c && c != a) {
+				result[kept++] = a;
+				result[kept++] = b;
+				result[kept++] = c;
+			}
+		}
+		result.resize(kept);
+	}
+	error = (float)std::sqrt(worst);
+	return result;
+}
+
+// Appends a chain of simplified levels to the full mesh in mesh.Indices and lists every level in
+// mesh.Lods, each simplified from the one before, keeping about MESH_LOD_REDUCTION of its triangles
+// and ordered for the vertex cache on its own. The errors add up along the chain, so each level's
+// is an upper bound of its distance from the full mesh. The chain ends early once a level would no
+// longer shrink much, as with meshes that are mostly borders and seams.
+inline void buildMeshLods(MeshData& mesh, uint32_t maxLevels = MESH_LOD_LEVELS) {
+	uint32_t fullCount = fullDetailIndexCount(mesh);
+	mesh.Indices.resize(fullCount);
+	mesh.Lods.assign(1, { 0, fullCount, 0.0f });
+	// meshlets index the old levels, buildMeshlets splits the new ones
+	mesh.Meshlets.clear();
+	mesh.MeshletVertices.clear();
+	mesh.MeshletTriangles.clear();
+	std::vector<uint32_t> level = mesh.Indices;
+	float error = 0.0f;
+	while (mesh.Lods.size() < maxLevels) {
+		size_t targetTriangles = (size_t)(level.size() / 3 * MESH_LOD_REDUCTION);
+		if (targetTriangles < MESH_LOD_MIN_TRIANGLES) {
+			break;
+		}
+		float levelError;
+		std::vector<uint32_t> simplified = simplifyMesh(mesh.Vertices, level.data(), level.size(), targetTriangles * 3, levelError);
+		if (simplified.empty() || simplified.size() > level.size() * MESH_LOD_MIN_REDUCTION) {
+			break;
+		}
+		error += levelError;
+		optimizeVertexCache(simplified, mesh.Vertices.size());
+		mesh.Lods.push_back({ (uint32_t)mesh.Indices.size(), (uint32_t)simplified.size(), error });
+		mesh.Indices.insert(mesh.Indices.end(), simplified.begin(), simplified.end());
+		level.swap(simplified);
+	}
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef MESH_STREAMER_H
+#define MESH_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "components.h"
+#include "mesh_format.h"
+#include "render_stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+const size_t MESH_STAGING_SIZE = 16 * 1024 * 1024;
+const unsigned int MESH_STAGING_SEGMENTS = 4;
+
+// GL type and normalization of each meshAttributeType
+inline void meshAttributeFormat(meshAttributeType type, GLenum& glType, GLboolean& normalized) {
+	static const GLenum types[MESH_ATTRIBUTE_TYPE_COUNT] = { GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_BYTE, GL_SHORT };
+	glType = types[type];
+	normalized = type == MESH_ATTRIBUTE_UNORM8 || type == MESH_ATTRIBUTE_SNORM16 ? GL_TRUE : GL_FALSE;
+}
+
+// Uploads meshes through one persistently mapped staging buffer. The source, typically a mapped mesh
+// file, is copied into the staging memory in segments and each segment is copied on into immutable
+// GPU buffers with glCopyBufferSubData, a fence guarding it until the GPU has read it, so reading
+// the next segment from disk overlaps with the GPU copy of the last one and nothing is parsed or
+// converted on the way. Runs on the GL thread; the staging buffer is only needed while loading.
+class MeshStreamer {
+public:
+	uint64_t BytesStreamed = 0;
+
+	MeshStreamer() = default;
+	MeshStreamer(const MeshStreamer&) = delete;
+	MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+	bool create(size_t size = MESH_STAGING_SIZE) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &staging);
+		glBindBuffer(GL_COPY_READ_BUFFER, staging);
+		glBufferStorage(GL_COPY_READ_BUFFER, size, nullptr, flags);
+		mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		if (!mapped) {
+			std::cout << "ERROR::MESH_STREAMER::STAGING_NOT_MAPPED" << std::endl;
+			destroy();
+			return false;
+		}
+		segmentSize = size / MESH_STAGING_SEGMENTS;
+		trackGpuMemory((int64_t)size);
+		capacity = size;
+		return true;
+	}
+
+	// waits for the copies still reading the staging buffer, then frees it
+	void destroy() {
+		finish();
+		if (staging) {
+			glBindBuffer(GL_COPY_READ_BUFFER, staging);
+			if (mapped) {
+				glUnmapBuffer(GL_COPY_READ_BUFFER);
+			}
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glDeleteBuffers(1, &staging);
+			trackGpuMemory(-(int64_t)capacity);
+		}
+		staging = 0;
+		mapped = nullptr;
+		capacity = 0;
+	}
+
+	// blocks until every copy issued so far has completed on the GPU
+	void finish() {
+		for (GLsync& fence : fences) {
+			wait(fence);
+		}
+	}
+
+	// an immutable buffer of size bytes filled from data
+	GLuint createBuffer(const void* data, size_t size) {
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size > 0 ? size : 1, nullptr, 0);
+		trackGpuMemory((int64_t)size);
+
+		const unsigned char* source = static_cast<const unsigned char*>(data);
+		glBindBuffer(GL_COPY_READ_BUFFER, staging);
+		for (size_t offset = 0; offset < size; offset += segmentSize) {
+			size_t chunk = std::min(segmentSize, size - offset);
+			GLsync& fence = fences[segment];
+			wait(fence);
+			std::memcpy(mapped + segment * segmentSize, source + offset, chunk);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, segment * segmentSize, offset, chunk);
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			segment = (segment + 1) % MESH_STAGING_SEGMENTS;
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		BytesStreamed += size;
+		return buffer;
+	}
+
+	// vertex array reading the interleaved vertices in layout from vertexData and 32-bit indices
+	// from indexData, all drawn as one level. buffers receives the vertex, element and meshlet
+	// buffer for deleting them later, the last stays 0 without meshlets
+	Mesh upload(const MeshFileLayout& layout, const void* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount,
+		float boundingRadius, GLuint buffers[3]) {
+		Mesh mesh = { 0, (GLsizei)vertexCount, boundingRadius, (GLsizei)indexCount };
+		buffers[0] = createBuffer(vertexData, (size_t)vertexCount * layout.Stride);
+		buffers[1] = createBuffer(indexData, (size_t)indexCount * sizeof(uint32_t));
+		buffers[2] = 0;
+
+		glGenVertexArrays(1, &mesh.VAO);
+		glBindVertexArray(mesh.VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		// the element buffer binding is part of the vertex array's state
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+		for (uint32_t i = 0; i < layout.AttributeCount; i++) {
+			const MeshFileAttribute& attribute = layout.Attributes[i];
+			GLenum type;
+			GLboolean normalized;
+			meshAttributeFormat((meshAttributeType)attribute.Type, type, normalized);
+			glVertexAttribPointer(attribute.Location, attribute.Components, type, normalized, layout.Stride, (void*)(uintptr_t)attribute.Offset);
+			glEnableVertexAttribArray(attribute.Location);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return mesh;
+	}
+
+	// a mapped mesh file with every level of detail it has, up to MESH_MAX_LODS, and their meshlets
+	Mesh upload(const MeshFile& file, GLuint buffers[3]) {
+		const MeshFileHeader& header = file.header();
+		Mesh mesh = upload(header.Layout, file.vertices(), header.VertexCount, file.indices(), (uint32_t)(header.Indices.Size / sizeof(uint32_t)),
+			header.BoundingRadius, buffers);
+		mesh.IndexCount = (GLsizei)header.IndexCount;
+		mesh.LodCount = std::min(header.LodCount, MESH_MAX_LODS);
+		for (uint32_t i = 0; i < mesh.LodCount; i++) {
+			const MeshFileLod& level = file.lods()[i];
+			mesh.Lods[i] = { (GLsizei)level.IndexOffset, (GLsizei)level.IndexCount, level.Error, level.MeshletOffset, level.MeshletCount };
+		}
+		if (header.MeshletCount > 0) {
+			// the records are laid out for std430, the culling shader reads them as they are
+			buffers[2] = mesh.MeshletBuffer = createBuffer(file.meshlets(), header.Meshlets.Size);
+		}
+		return mesh;
+	}
+
+	Mesh upload(const MeshData& data, GLuint buffers[3]) {
+		Mesh mesh = upload(meshVertexLayout(), data.Vertices.data(), (uint32_t)data.Vertices.size(), data.Indices.data(), (uint32_t)data.Indices.size(),
+			data.BoundingRadius, buffers);
+		mesh.IndexCount = (GLsizei)fullDetailIndexCount(data);
+		mesh.LodCount = std::min((uint32_t)data.Lods.size(), MESH_MAX_LODS);
+		for (uint32_t i = 0; i < mesh.LodCount; i++) {
+			const MeshLod& level = data.Lods[i];
+			mesh.Lods[i] = { (GLsizei)level.IndexOffset, (GLsizei)level.IndexCount, level.Error, level.MeshletOffset, level.MeshletCount };
+		}
+		if (!data.Meshlets.empty()) {
+			buffers[2] = mesh.MeshletBuffer = createBuffer(data.Meshlets.data(), data.Meshlets.size() * sizeof(Meshlet));
+		}
+		return mesh;
+	}
+
+private:
+	GLuint staging = 0;
+	unsigned char* mapped = nullptr;
+	size_t capacity = 0;
+	size_t segmentSize = 0;
+	unsigned int segment = 0;      // next staging segment to fill
+	GLsync fences[MESH_STAGING_SEGMENTS] = {};
+
+	static void wait(GLsync& fence) {
+		if (!fence) {
+			return;
+		}
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0));
+		glDeleteSync(fence);
+		fence = 0;
+	}
+};
+
+#endif
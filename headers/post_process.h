@@ -0,0 +1,417 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+
+#include "command_buffer.h"
+#include "gpu_profiler.h"
+#include "render_stats.h"
+#include "shader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// stages of the HDR post chain, each one can be left out with --post
+enum postEffect : uint32_t {
+	POST_BLOOM = 1,      // compute downsample/upsample mip chain mixed back into the scene
+	POST_EXPOSURE = 2,   // automatic exposure from a luminance histogram
+	POST_TONEMAP = 4,    // ACES filmic curve, without it the HDR colour is clamped
+	POST_ALL = POST_BLOOM | POST_EXPOSURE | POST_TONEMAP
+};
+
+const unsigned int POST_EFFECT_COUNT = 3;
+
+// comma separated, in the order the stages run, or "none"
+inline std::string postEffectsName(uint32_t effects) {
+	static const char* names[POST_EFFECT_COUNT] = { "bloom", "exposure", "tonemap" };
+	std::string result;
+	for (unsigned int i = 0; i < POST_EFFECT_COUNT; i++) {
+		if (effects & (1u << i)) {
+			result += (result.empty() ? "" : ",") + std::string(names[i]);
+		}
+	}
+	return result.empty() ? "none" : result;
+}
+
+inline bool parsePostEffects(const std::string& list, uint32_t& effects) {
+	uint32_t parsed = 0;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = list.find(',', start);
+		std::string name = list.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		bool found = name == "none";
+		for (unsigned int i = 0; i < POST_EFFECT_COUNT && !found; i++) {
+			if (name == postEffectsName(1u << i)) {
+				parsed |= 1u << i;
+				found = true;
+			}
+		}
+		if (!found) {
+			return false;
+		}
+		if (end == std::string::npos) {
+			break;
+		}
+		start = end + 1;
+	}
+	effects = parsed;
+	return true;
+}
+
+const unsigned int BLOOM_MAX_LEVELS = 6;
+const int BLOOM_MIN_SIZE = 8;              // no level is downsampled below this many texels on its short side
+const float BLOOM_STRENGTH = 0.05f;         // share of the blurred image in the final colour
+const unsigned int POST_GROUP_SIZE = 8;     // bloom compute groups are 8x8 texels
+
+const unsigned int HISTOGRAM_BINS = 256;    // must match the histogram and exposure shaders
+const unsigned int HISTOGRAM_GROUP_SIZE = 16;
+const unsigned int HISTOGRAM_STRIDE = 2;    // every other pixel in both directions is counted
+const float EXPOSURE_MIN_LOG = -8.0f;       // log2 luminance range the histogram covers
+const float EXPOSURE_LOG_RANGE = 12.0f;
+const float EXPOSURE_KEY = 0.18f;           // average luminance the exposure maps the scene to
+const float EXPOSURE_MIN = 0.25f;
+const float EXPOSURE_MAX = 4.0f;
+const float EXPOSURE_SPEED = 1.5f;          // adaptation rate, per second
+
+// texture units the post chain samples from, above the ones the lit shaders use
+const GLenum POST_SOURCE_UNIT = 4;
+const GLenum POST_BLOOM_UNIT = 5;
+const GLuint POST_EXPOSURE_BINDING = 0;     // shader storage binding of the histogram and exposure
+
+// Turns the HDR scene colour into the displayed image with as few full-screen passes as possible.
+// Bloom runs as compute over a half resolution mip chain: each level is a 13-tap downsample of the
+// one above, then the chain is walked back up adding a tent-filtered copy of the smaller level, so
+// the wide blur costs a few passes over ever smaller images. Exposure builds a log luminance
+// histogram of every other pixel in shared memory, and a single group reduces it to the average and
+// eases the exposure towards it, all on the GPU without a readback. The only full-resolution pass
+// after the scene is the final one, which mixes in the bloom, applies the exposure and tonemaps
+// while writing the output. Size changes are recorded like RenderTarget's.
+//
+// With dynamic resolution the scene only covers the bottom left renderWidth x renderHeight of its
+// target; every stage reads just that region and the final pass upscales it with a Catmull-Rom
+// filter, which keeps edges sharper than the bilinear blit.
+class PostProcess {
+public:
+	PostProcess() = default;
+	PostProcess(const PostProcess&) = delete;
+	PostProcess& operator=(const PostProcess&) = delete;
+
+	bool create(int width, int height, uint32_t postEffects, bool dynamicResolution) {
+		effects = postEffects;
+		std::string defines = dynamicResolution ? "#define DYNAMIC_RESOLUTION\n" : "";
+		defines += effects & POST_BLOOM ? "#define BLOOM\n" : "";
+		defines += effects & POST_EXPOSURE ? "#define EXPOSURE\n" : "";
+		defines += effects & POST_TONEMAP ? "#define TONEMAP\n" : "";
+		finalShader = new Shader("./shaders/post/final-vs.glsl", "./shaders/post/final-fs.glsl", nullptr, defines);
+		finalShader->use();
+		finalShader->setInt("scene", POST_SOURCE_UNIT);
+		finalShader->setInt("bloom", POST_BLOOM_UNIT);
+		finalShader->setFloat("bloomStrength", BLOOM_STRENGTH);
+		glGenVertexArrays(1, &emptyVertexArray);
+
+		// one filter for every post input: linear within a level, the level picked by textureLod
+		glGenSamplers(1, &sampler);
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindSampler(POST_SOURCE_UNIT, sampler);
+		glBindSampler(POST_BLOOM_UNIT, sampler);
+
+		if (effects & POST_BLOOM) {
+			downsampleShader = new Shader(Shader::compute("./shaders/post/bloom-down-cs.glsl"));
+			downsampleShader->use();
+			downsampleShader->setInt("source", POST_SOURCE_UNIT);
+			upsampleShader = new Shader(Shader::compute("./shaders/post/bloom-up-cs.glsl"));
+			upsampleShader->use();
+			upsampleShader->setInt("source", POST_SOURCE_UNIT);
+
+			glGenTextures(1, &bloomTexture);
+			glBindTexture(GL_TEXTURE_2D, bloomTexture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			allocateBloom(width, height);
+		}
+
+		if (effects & POST_EXPOSURE) {
+			histogramShader = new Shader(Shader::compute("./shaders/post/histogram-cs.glsl"));
+			histogramShader->use();
+			histogramShader->setInt("source", POST_SOURCE_UNIT);
+			histogramShader->setFloat("minLogLuminance", EXPOSURE_MIN_LOG);
+			histogramShader->setFloat("inverseLogRange", 1.0f / EXPOSURE_LOG_RANGE);
+			exposureShader = new Shader(Shader::compute("./shaders/post/exposure-cs.glsl"));
+			exposureShader->use();
+			exposureShader->setFloat("minLogLuminance", EXPOSURE_MIN_LOG);
+			exposureShader->setFloat("logRange", EXPOSURE_LOG_RANGE);
+			exposureShader->setFloat("key", EXPOSURE_KEY);
+			exposureShader->setFloat("minExposure", EXPOSURE_MIN);
+			exposureShader->setFloat("maxExposure", EXPOSURE_MAX);
+			exposureShader->setFloat("speed", EXPOSURE_SPEED);
+			uniforms.SampleCount = exposureShader->uniformLocation("sampleCount");
+			uniforms.DeltaTime = exposureShader->uniformLocation("deltaTime");
+
+			// the bins start cleared and a zero exposure makes the first frame take the target directly
+			uint32_t initial[HISTOGRAM_BINS + 2] = {};
+			glGenBuffers(1, &exposureBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, exposureBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(initial), initial, GL_DYNAMIC_COPY);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POST_EXPOSURE_BINDING, exposureBuffer);
+			trackGpuMemory(sizeof(initial));
+		}
+		glUseProgram(0);
+
+		uniforms.DownsampleLod = downsampleShader ? downsampleShader->uniformLocation("sourceLod") : -1;
+		uniforms.DownsampleFirst = downsampleShader ? downsampleShader->uniformLocation("firstPass") : -1;
+		uniforms.DownsampleRegion = downsampleShader ? downsampleShader->uniformLocation("sourceRegion") : -1;
+		uniforms.DownsampleSize = downsampleShader ? downsampleShader->uniformLocation("destinationSize") : -1;
+		uniforms.UpsampleRegion = upsampleShader ? upsampleShader->uniformLocation("sourceRegion") : -1;
+		uniforms.UpsampleSize = upsampleShader ? upsampleShader->uniformLocation("destinationSize") : -1;
+		uniforms.BloomRegion = finalShader->uniformLocation("bloomRegion");
+		uniforms.HistogramSize = histogramShader ? histogramShader->uniformLocation("sourceSize") : -1;
+		uniforms.RenderSize = finalShader->uniformLocation("renderSize");
+		uniforms.UpsampleLod = upsampleShader ? upsampleShader->uniformLocation("sourceLod") : -1;
+		uniforms.BloomScale = finalShader->uniformLocation("bloomScale");
+		recordedWidth = width;
+		recordedHeight = height;
+		return true;
+	}
+
+	void destroy() {
+		for (Shader** shader : { &finalShader, &downsampleShader, &upsampleShader, &histogramShader, &exposureShader }) {
+			if (*shader) {
+				glDeleteProgram((*shader)->ID);
+				delete *shader;
+				*shader = nullptr;
+			}
+		}
+		if (bloomTexture) {
+			glDeleteTextures(1, &bloomTexture);
+			trackGpuMemory(-bloomBytes);
+			bloomTexture = 0;
+			bloomBytes = 0;
+		}
+		if (exposureBuffer) {
+			glDeleteBuffers(1, &exposureBuffer);
+			trackGpuMemory(-(int64_t)((HISTOGRAM_BINS + 2) * sizeof(uint32_t)));
+			exposureBuffer = 0;
+		}
+		glDeleteSamplers(1, &sampler);
+		glDeleteVertexArrays(1, &emptyVertexArray);
+		sampler = emptyVertexArray = 0;
+	}
+
+	uint32_t enabledEffects() const {
+		return effects;
+	}
+
+	// main thread: resizes the bloom chain at this point of the frame if the scene size changed
+	void recordResize(CommandBuffer& commands, int width, int height) {
+		if (width == recordedWidth && height == recordedHeight) {
+			return;
+		}
+		recordedWidth = width;
+		recordedHeight = height;
+		if (effects & POST_BLOOM) {
+			commands.callback(&PostProcess::resizeCallback, this, ((uint64_t)(uint32_t)width << 32) | (uint32_t)height);
+		}
+	}
+
+	// runs the enabled stages on the renderWidth x renderHeight corner of sceneColor and writes the
+	// result into output, which stays bound. time is the render time of the frame, exposure adapts
+	// by the time passed since the last one
+	void record(CommandBuffer& commands, GpuProfiler& profiler, GLuint sceneColor, int renderWidth, int renderHeight,
+		GLuint output, int outputWidth, int outputHeight, double time) {
+		float deltaTime = lastTime >= 0.0 && time > lastTime ? (float)(time - lastTime) : 0.0f;
+		lastTime = time;
+
+		if (effects & POST_BLOOM) {
+			profiler.recordBegin(commands, "bloom");
+			recordBloom(commands, sceneColor, renderWidth, renderHeight);
+			profiler.recordEnd(commands);
+		}
+		if (effects & POST_EXPOSURE) {
+			profiler.recordBegin(commands, "exposure");
+			recordExposure(commands, sceneColor, renderWidth, renderHeight, deltaTime);
+			profiler.recordEnd(commands);
+		}
+
+		// bloom, exposure and the tonemap curve in one pass over the output
+		profiler.recordBegin(commands, "tonemap");
+		commands.bindFramebuffer(GL_FRAMEBUFFER, output);
+		commands.viewport(0, 0, outputWidth, outputHeight);
+		commands.callback(&PostProcess::beginFullscreenCallback, this);
+		commands.useProgram(finalShader->ID);
+		commands.bindTexture(GL_TEXTURE0 + POST_SOURCE_UNIT, GL_TEXTURE_2D, sceneColor);
+		commands.setVec2(uniforms.RenderSize, glm::vec2(renderWidth, renderHeight));
+		if (effects & POST_BLOOM) {
+			commands.bindTexture(GL_TEXTURE0 + POST_BLOOM_UNIT, GL_TEXTURE_2D, bloomTexture);
+			commands.setFloat(uniforms.BloomScale, 1.0f / (float)bloomLevels(recordedWidth, recordedHeight));
+			commands.setVec2(uniforms.BloomRegion, bloomRegion);
+		}
+		commands.bindVertexArray(emptyVertexArray);
+		commands.drawArrays(GL_TRIANGLES, 0, 3);
+		commands.callback(&PostProcess::endFullscreenCallback, this);
+		profiler.recordEnd(commands);
+	}
+
+private:
+	struct Uniforms {
+		GLint DownsampleLod = -1;
+		GLint DownsampleFirst = -1;
+		GLint DownsampleRegion = -1;
+		GLint DownsampleSize = -1;
+		GLint UpsampleRegion = -1;
+		GLint UpsampleSize = -1;
+		GLint BloomRegion = -1;
+		GLint HistogramSize = -1;
+		GLint RenderSize = -1;
+		GLint UpsampleLod = -1;
+		GLint BloomScale = -1;
+		GLint SampleCount = -1;
+		GLint DeltaTime = -1;
+	};
+
+	uint32_t effects = POST_ALL;
+	Shader* finalShader = nullptr;
+	Shader* downsampleShader = nullptr;
+	Shader* upsampleShader = nullptr;
+	Shader* histogramShader = nullptr;
+	Shader* exposureShader = nullptr;
+	Uniforms uniforms;
+	GLuint emptyVertexArray = 0;   // the fullscreen triangle is generated from gl_VertexID
+	GLuint sampler = 0;
+	GLuint bloomTexture = 0;
+	GLuint exposureBuffer = 0;
+	int64_t bloomBytes = 0;
+	int recordedWidth = 0;         // scene size as of the last recorded command, main thread only
+	int recordedHeight = 0;
+	double lastTime = -1.0;
+	glm::vec2 bloomRegion = glm::vec2(1.0f);   // part of bloom level 0 the last recordBloom filled
+
+	// size of the first bloom level, half the scene
+	static void bloomSize(int width, int height, int& levelWidth, int& levelHeight) {
+		levelWidth = width / 2 > 1 ? width / 2 : 1;
+		levelHeight = height / 2 > 1 ? height / 2 : 1;
+	}
+
+	// levels until the short side would drop below BLOOM_MIN_SIZE, the same on both threads
+	static unsigned int bloomLevels(int width, int height) {
+		int levelWidth, levelHeight;
+		bloomSize(width, height, levelWidth, levelHeight);
+		unsigned int levels = 1;
+		while (levels < BLOOM_MAX_LEVELS && (levelWidth >> levels) >= BLOOM_MIN_SIZE && (levelHeight >> levels) >= BLOOM_MIN_SIZE) {
+			levels++;
+		}
+		return levels;
+	}
+
+	static GLuint groups(int size, unsigned int groupSize) {
+		return (GLuint)((size + (int)groupSize - 1) / (int)groupSize);
+	}
+
+	void recordBloom(CommandBuffer& commands, GLuint sceneColor, int renderWidth, int renderHeight) {
+		// the chain is allocated for the whole target, but only the part matching the rendered
+		// region is filled, so bloom gets cheaper along with the scene
+		int levelWidth, levelHeight, drawnWidth, drawnHeight;
+		bloomSize(recordedWidth, recordedHeight, levelWidth, levelHeight);
+		bloomSize(renderWidth, renderHeight, drawnWidth, drawnHeight);
+		unsigned int levels = bloomLevels(recordedWidth, recordedHeight);
+
+		// down: the scene into level 0, then every level into the next
+		commands.useProgram(downsampleShader->ID);
+		for (unsigned int level = 0; level < levels; level++) {
+			glm::vec2 region = level == 0 ? glm::vec2((float)renderWidth / recordedWidth, (float)renderHeight / recordedHeight)
+				: levelRegion(drawnWidth, drawnHeight, levelWidth, levelHeight, level - 1);
+			commands.bindTexture(GL_TEXTURE0 + POST_SOURCE_UNIT, GL_TEXTURE_2D, level == 0 ? sceneColor : bloomTexture);
+			commands.setFloat(uniforms.DownsampleLod, level == 0 ? 0.0f : (float)(level - 1));
+			commands.setInt(uniforms.DownsampleFirst, level == 0 ? 1 : 0);
+			commands.setVec2(uniforms.DownsampleRegion, region);
+			recordLevelDispatch(commands, uniforms.DownsampleSize, drawnWidth, drawnHeight, level, GL_WRITE_ONLY);
+		}
+
+		// up: each level adds the blurred level below it, so level 0 ends up with the whole chain
+		commands.useProgram(upsampleShader->ID);
+		commands.bindTexture(GL_TEXTURE0 + POST_SOURCE_UNIT, GL_TEXTURE_2D, bloomTexture);
+		for (unsigned int level = levels - 1; level-- > 0;) {
+			commands.setFloat(uniforms.UpsampleLod, (float)(level + 1));
+			commands.setVec2(uniforms.UpsampleRegion, levelRegion(drawnWidth, drawnHeight, levelWidth, levelHeight, level + 1));
+			recordLevelDispatch(commands, uniforms.UpsampleSize, drawnWidth, drawnHeight, level, GL_READ_WRITE);
+		}
+		bloomRegion = levelRegion(drawnWidth, drawnHeight, levelWidth, levelHeight, 0);
+	}
+
+	static int levelSize(int size, unsigned int level) {
+		return size >> level > 1 ? size >> level : 1;
+	}
+
+	// fraction of a level that holds the drawn region
+	static glm::vec2 levelRegion(int drawnWidth, int drawnHeight, int levelWidth, int levelHeight, unsigned int level) {
+		return glm::vec2((float)levelSize(drawnWidth, level) / levelSize(levelWidth, level),
+			(float)levelSize(drawnHeight, level) / levelSize(levelHeight, level));
+	}
+
+	// one texel per invocation over the drawn part of a level
+	void recordLevelDispatch(CommandBuffer& commands, GLint sizeLocation, int drawnWidth, int drawnHeight, unsigned int level, GLenum access) {
+		int width = levelSize(drawnWidth, level);
+		int height = levelSize(drawnHeight, level);
+		commands.setVec2(sizeLocation, glm::vec2(width, height));
+		commands.bindImageTexture(0, bloomTexture, (GLint)level, access, GL_R11F_G11F_B10F);
+		commands.dispatchCompute(groups(width, POST_GROUP_SIZE), groups(height, POST_GROUP_SIZE));
+		commands.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	void recordExposure(CommandBuffer& commands, GLuint sceneColor, int renderWidth, int renderHeight, float deltaTime) {
+		int sampledWidth = (renderWidth + (int)HISTOGRAM_STRIDE - 1) / (int)HISTOGRAM_STRIDE;
+		int sampledHeight = (renderHeight + (int)HISTOGRAM_STRIDE - 1) / (int)HISTOGRAM_STRIDE;
+
+		commands.useProgram(histogramShader->ID);
+		commands.bindTexture(GL_TEXTURE0 + POST_SOURCE_UNIT, GL_TEXTURE_2D, sceneColor);
+		commands.setVec2(uniforms.HistogramSize, glm::vec2(renderWidth, renderHeight));
+		commands.dispatchCompute(groups(sampledWidth, HISTOGRAM_GROUP_SIZE), groups(sampledHeight, HISTOGRAM_GROUP_SIZE));
+		commands.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		commands.useProgram(exposureShader->ID);
+		commands.setFloat(uniforms.SampleCount, (float)sampledWidth * (float)sampledHeight);
+		commands.setFloat(uniforms.DeltaTime, deltaTime);
+		commands.dispatchCompute(1, 1);
+		commands.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	void allocateBloom(int width, int height) {
+		int levelWidth, levelHeight;
+		bloomSize(width, height, levelWidth, levelHeight);
+		unsigned int levels = bloomLevels(width, height);
+
+		// mutable storage keeps the texture name stable, the main thread records it into commands
+		glBindTexture(GL_TEXTURE_2D, bloomTexture);
+		int64_t bytes = 0;
+		for (unsigned int level = 0; level < levels; level++) {
+			int w = levelWidth >> level > 1 ? levelWidth >> level : 1;
+			int h = levelHeight >> level > 1 ? levelHeight >> level : 1;
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_R11F_G11F_B10F, w, h, 0, GL_RGB, GL_FLOAT, nullptr);
+			bytes += (int64_t)w * h * 4;
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		trackGpuMemory(bytes - bloomBytes);
+		bloomBytes = bytes;
+	}
+
+	static void resizeCallback(void* user, uint64_t size) {
+		static_cast<PostProcess*>(user)->allocateBloom((int)(size >> 32), (int)(size & 0xFFFFFFFFu));
+	}
+
+	static void beginFullscreenCallback(void*, uint64_t) {
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	static void endFullscreenCallback(void*, uint64_t) {
+		glEnable(GL_DEPTH_TEST);
+	}
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// CPU instrumentation. PROFILE_SCOPE("name") times the rest of the enclosing block and
+// PROFILE_THREAD("name") labels the calling thread's track. Both compile to nothing unless
+// ENGINE_PROFILE is defined, so release builds carry no trace of them.
+#ifdef ENGINE_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) profiler().nameThread(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+const uint32_t PROFILE_BUFFER_EVENTS = 1 << 16;    // per thread, must be a power of two
+const unsigned int PROFILE_FLUSH_INTERVAL_MS = 10;
+
+// raw timestamp, the cycle counter where there is one
+inline uint64_t profileClock() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct ProfileEvent {
+	const char* Name;
+	uint64_t Begin;
+	uint64_t End;
+};
+
+// Single-producer single-consumer ring owned by one thread. The owner appends without locks or
+// waiting; the flusher drains it from the other end. A full ring drops events instead of blocking.
+struct ProfileThreadBuffer {
+	uint32_t Track = 0;
+	alignas(64) std::atomic<uint64_t> Head{ 0 };   // written by the owner
+	uint64_t CachedTail = 0;                        // owner's last look at Tail
+	std::atomic<uint64_t> Dropped{ 0 };
+	alignas(64) std::atomic<uint64_t> Tail{ 0 };   // written by the flusher
+	ProfileEvent Events[PROFILE_BUFFER_EVENTS];
+
+	void push(const char* name, uint64_t begin, uint64_t end) {
+		uint64_t head = Head.load(std::memory_order_relaxed);
+		if (head - CachedTail >= PROFILE_BUFFER_EVENTS) {
+			CachedTail = Tail.load(std::memory_order_acquire);
+			if (head - CachedTail >= PROFILE_BUFFER_EVENTS) {
+				Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		Events[head & (PROFILE_BUFFER_EVENTS - 1)] = { name, begin, end };
+		Head.store(head + 1, std::memory_order_release);
+	}
+};
+
+// Owns the per-thread buffers and the background thread that drains them into a TraceLog every
+// PROFILE_FLUSH_INTERVAL_MS. Timestamps stay raw on the hot path and are converted to the trace
+// clock by the flusher, using a rate measured against steady_clock when the profiler starts.
+class Profiler {
+public:
+	~Profiler() {
+		stop();
+		for (ProfileThreadBuffer* buffer : buffers) {
+			delete buffer;
+		}
+	}
+
+	bool enabled() const {
+		return running.load(std::memory_order_relaxed);
+	}
+
+	// calibrates the clock and starts draining into trace, which should already be open for streaming
+	void start(TraceLog& trace) {
+		if (running) {
+			return;
+		}
+		uint64_t startTicks = profileClock();
+		double startTime = traceNow();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		ticksPerMicrosecond = (profileClock() - startTicks) / (traceNow() - startTime);
+		baseTicks = startTicks;
+		baseTime = startTime;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->trace = &trace;
+			for (const auto& name : pendingNames) {
+				trace.nameTrack(name.first, name.second);
+			}
+		}
+
+		stopping = false;
+		running = true;
+		flusher = std::thread([this]() {
+			std::unique_lock<std::mutex> lock(flushMutex);
+			while (!stopping) {
+				flushCondition.wait_for(lock, std::chrono::milliseconds(PROFILE_FLUSH_INTERVAL_MS));
+				drain();
+			}
+		});
+	}
+
+	// drains what is left and stops the flusher; scopes still open are not recorded
+	void stop() {
+		if (!running) {
+			return;
+		}
+		running = false;
+		{
+			std::lock_guard<std::mutex> lock(flushMutex);
+			stopping = true;
+		}
+		flushCondition.notify_all();
+		flusher.join();
+		drain();
+		trace = nullptr;
+
+		uint64_t dropped = 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		for (ProfileThreadBuffer* buffer : buffers) {
+			dropped += buffer->Dropped.load(std::memory_order_relaxed);
+		}
+		if (dropped > 0) {
+			std::cout << "profiler: " << dropped << " scopes dropped, the flusher could not keep up" << std::endl;
+		}
+	}
+
+	// the calling thread's buffer, registered on first use and kept until the profiler goes away
+	ProfileThreadBuffer& threadBuffer() {
+		thread_local ProfileThreadBuffer* buffer = nullptr;
+		if (!buffer) {
+			buffer = new ProfileThreadBuffer();
+			buffer->Track = traceThreadId();
+			std::lock_guard<std::mutex> lock(mutex);
+			buffers.push_back(buffer);
+		}
+		return *buffer;
+	}
+
+	void nameThread(const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (trace) {
+			trace->nameTrack(traceThreadId(), name);
+		}
+		else {
+			pendingNames.push_back({ traceThreadId(), name });
+		}
+	}
+
+private:
+	std::mutex mutex;   // guards buffers, pendingNames and trace
+	std::vector<ProfileThreadBuffer*> buffers;
+	std::vector<std::pair<uint32_t, std::string>> pendingNames;
+	TraceLog* trace = nullptr;
+
+	std::atomic<bool> running{ false };
+	std::thread flusher;
+	std::mutex flushMutex;
+	std::condition_variable flushCondition;
+	bool stopping = false;
+
+	double ticksPerMicrosecond = 1.0;
+	uint64_t baseTicks = 0;
+	double baseTime = 0.0;
+
+	void drain() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (ProfileThreadBuffer* buffer : buffers) {
+			uint64_t head = buffer->Head.load(std::memory_order_acquire);
+			uint64_t tail = buffer->Tail.load(std::memory_order_relaxed);
+			for (; tail < head; tail++) {
+				const ProfileEvent& event = buffer->Events[tail & (PROFILE_BUFFER_EVENTS - 1)];
+				double start = baseTime + (double)(int64_t)(event.Begin - baseTicks) / ticksPerMicrosecond;
+				double duration = (double)(event.End - event.Begin) / ticksPerMicrosecond;
+				trace->add({ event.Name, "cpu", buffer->Track, start, duration });
+			}
+			buffer->Tail.store(head, std::memory_order_release);
+		}
+		trace->flush();
+	}
+};
+
+inline Profiler& profiler() {
+	static Profiler instance;
+	return instance;
+}
+
+// records one event from construction to destruction while the profiler is running
+class ProfileScope {
+public:
+	explicit ProfileScope(const char* name) : name(name), begin(profiler().enabled() ? profileClock() : 0) {
+	}
+
+	~ProfileScope() {
+		if (begin) {
+			profiler().threadBuffer().push(name, begin, profileClock());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	uint64_t begin;
+};
+
+#endif
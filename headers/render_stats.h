@@ -0,0 +1,327 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include "frame_stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// identifies the build in exported metrics, the build system may pass something more specific
+#ifndef ENGINE_BUILD_ID
+#define ENGINE_BUILD_ID "dev"
+#endif
+
+// what the engine asks of the driver, counted per frame
+enum renderCounter : uint32_t {
+	COUNTER_DRAW_CALLS,
+	COUNTER_TRIANGLES,                 // submitted by the mesh draws; cluster culled ones submit their whole level
+	COUNTER_UNIFORM_UPLOADS,
+	COUNTER_PROGRAM_BINDS,
+	COUNTER_TEXTURE_BINDS,
+	COUNTER_VERTEX_ARRAY_BINDS,
+	COUNTER_TEXTURE_UPLOADS,
+	COUNTER_TEXTURE_UPLOAD_BYTES,
+	COUNTER_DISPATCHES,
+	COUNTER_FULL_DETAIL_TRIANGLES,     // what the draws would have cost without levels of detail
+	COUNTER_COUNT
+};
+
+// column names in exported metrics
+inline const char* counterName(renderCounter counter) {
+	static const char* names[COUNTER_COUNT] = {
+		"draw_calls",
+		"triangles",
+		"uniform_uploads",
+		"program_binds",
+		"texture_binds",
+		"vertex_array_binds",
+		"texture_uploads",
+		"texture_upload_bytes",
+		"dispatches",
+		"full_detail_triangles"
+	};
+	return names[counter];
+}
+
+struct RenderCounters {
+	uint64_t Values[COUNTER_COUNT] = {};
+
+	void add(renderCounter counter, uint64_t amount = 1) {
+		Values[counter] += amount;
+	}
+
+	void add(const RenderCounters& other) {
+		for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+			Values[i] += other.Values[i];
+		}
+	}
+
+	uint64_t operator[](renderCounter counter) const {
+		return Values[counter];
+	}
+
+	// program, texture and vertex array binds
+	uint64_t stateChanges() const {
+		return Values[COUNTER_PROGRAM_BINDS] + Values[COUNTER_TEXTURE_BINDS] + Values[COUNTER_VERTEX_ARRAY_BINDS];
+	}
+};
+
+// Work issued straight to GL instead of through a command buffer (Shader setters, texture uploads)
+// is counted here, from whichever thread owns the context, and folded into the frame it lands in.
+struct ImmediateCounters {
+	std::atomic<uint64_t> Values[COUNTER_COUNT] = {};
+	std::atomic<int64_t> GpuMemory{ 0 };    // bytes of textures and buffers the engine has allocated
+};
+
+inline ImmediateCounters& immediateCounters() {
+	static ImmediateCounters counters;
+	return counters;
+}
+
+inline void countImmediate(renderCounter counter, uint64_t amount = 1) {
+	immediateCounters().Values[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline RenderCounters takeImmediateCounters() {
+	RenderCounters result;
+	for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+		result.Values[i] = immediateCounters().Values[i].exchange(0, std::memory_order_relaxed);
+	}
+	return result;
+}
+
+// bytes may be negative when something is freed
+inline void trackGpuMemory(int64_t bytes) {
+	immediateCounters().GpuMemory.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+inline int64_t gpuMemory() {
+	return immediateCounters().GpuMemory.load(std::memory_order_relaxed);
+}
+
+// resident set size of the process, 0 where it cannot be read
+inline int64_t processMemory() {
+#ifdef __linux__
+	long pages = 0, resident = 0;
+	FILE* file = std::fopen("/proc/self/statm", "r");
+	if (!file) {
+		return 0;
+	}
+	if (std::fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+		resident = 0;
+	}
+	std::fclose(file);
+	return (int64_t)resident * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+// everything known about one frame once it has been recorded
+struct FrameSample {
+	uint64_t Frame = 0;
+	double CpuTime = 0.0;       // ms since the previous frame was recorded
+	double GpuTime = 0.0;       // ms of the newest frame the GPU profiler has read back
+	RenderCounters Counters;
+	uint64_t Commands = 0;
+	uint64_t CommandBytes = 0;
+	float RenderScale = 1.0f;   // fraction of the output resolution the scene was drawn at, per axis
+};
+
+// averages over a window of frames, what the overlay shows and what gets exported
+struct StatsReport {
+	uint64_t Frame = 0;         // last frame of the window
+	double Time = 0.0;          // seconds since the recorder was created
+	uint64_t Frames = 0;
+	StatSummary CpuTime;
+	StatSummary GpuTime;
+	double Counters[COUNTER_COUNT] = {};
+	double StateChanges = 0.0;
+	double Commands = 0.0;
+	double CommandBytes = 0.0;
+	double RenderScale = 1.0;
+	int64_t GpuMemory = 0;
+	int64_t ProcessMemory = 0;
+};
+
+const unsigned int STATS_OVERLAY_FRAMES = 30;   // frames averaged per overlay update
+const unsigned int STATS_EXPORT_FRAMES = 120;   // default frames per exported record
+
+// Gathers one FrameSample per frame on the main thread. Every STATS_OVERLAY_FRAMES frames the
+// window is summarized for the overlay, and every export interval a record is appended to the
+// metrics file, as CSV when the path ends in .csv and as JSON lines (one object per line) otherwise.
+class StatsRecorder {
+public:
+	StatsRecorder() : created(std::chrono::steady_clock::now()), lastFrame(created) {
+	}
+
+	~StatsRecorder() {
+		closeExport();
+	}
+
+	StatsRecorder(const StatsRecorder&) = delete;
+	StatsRecorder& operator=(const StatsRecorder&) = delete;
+
+	bool openExport(const std::string& path, unsigned int intervalFrames = STATS_EXPORT_FRAMES) {
+		file.open(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR::STATS::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+		exportInterval = intervalFrames > 0 ? intervalFrames : 1;
+		if (csv) {
+			file << "build,frame,time,frames,cpu_ms_mean,cpu_ms_p50,cpu_ms_p99,gpu_ms_mean,gpu_ms_p99";
+			for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+				file << "," << counterName((renderCounter)i);
+			}
+			file << ",state_changes,commands,command_bytes,render_scale,gpu_memory_bytes,process_memory_bytes\n";
+		}
+		return true;
+	}
+
+	// writes out the frames gathered since the last record
+	void closeExport() {
+		if (!file.is_open()) {
+			return;
+		}
+		if (exportWindow.Frames > 0) {
+			writeRecord(exportWindow.report(elapsed()));
+		}
+		file.close();
+	}
+
+	// call once per frame after it has been recorded; Frame, GpuTime, the counters and the command
+	// sizes are filled in by the caller, the CPU time is measured here
+	void add(FrameSample sample) {
+		auto now = std::chrono::steady_clock::now();
+		sample.CpuTime = frames > 0 ? std::chrono::duration<double, std::milli>(now - lastFrame).count() : 0.0;
+		lastFrame = now;
+		frames++;
+
+		overlayWindow.add(sample);
+		if (overlayWindow.Frames >= STATS_OVERLAY_FRAMES) {
+			overlay = overlayWindow.report(elapsed());
+			overlay.ProcessMemory = processMemory();
+			overlayWindow = Window();
+			overlayVersion++;
+		}
+
+		if (file.is_open()) {
+			exportWindow.add(sample);
+			if (exportWindow.Frames >= exportInterval) {
+				writeRecord(exportWindow.report(elapsed()));
+				exportWindow = Window();
+			}
+		}
+	}
+
+	// the latest overlay summary and a counter that changes whenever it is replaced
+	const StatsReport& overlayReport() const {
+		return overlay;
+	}
+
+	uint64_t overlayReportVersion() const {
+		return overlayVersion;
+	}
+
+private:
+	// running sums of a window of frames
+	struct Window {
+		uint64_t Frames = 0;
+		uint64_t LastFrame = 0;
+		FrameStats CpuTimes;
+		FrameStats GpuTimes;
+		RenderCounters Counters;
+		uint64_t Commands = 0;
+		uint64_t CommandBytes = 0;
+		double RenderScale = 0.0;
+
+		void add(const FrameSample& sample) {
+			Frames++;
+			LastFrame = sample.Frame;
+			CpuTimes.add(sample.CpuTime);
+			GpuTimes.add(sample.GpuTime);
+			Counters.add(sample.Counters);
+			Commands += sample.Commands;
+			CommandBytes += sample.CommandBytes;
+			RenderScale += sample.RenderScale;
+		}
+
+		StatsReport report(double time) const {
+			StatsReport result;
+			double count = Frames > 0 ? (double)Frames : 1.0;
+			result.Frame = LastFrame;
+			result.Time = time;
+			result.Frames = Frames;
+			result.CpuTime = CpuTimes.summarize();
+			result.GpuTime = GpuTimes.summarize();
+			for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+				result.Counters[i] = Counters.Values[i] / count;
+			}
+			result.StateChanges = Counters.stateChanges() / count;
+			result.Commands = Commands / count;
+			result.CommandBytes = CommandBytes / count;
+			result.RenderScale = Frames > 0 ? RenderScale / count : 1.0;
+			result.GpuMemory = gpuMemory();
+			return result;
+		}
+	};
+
+	std::chrono::steady_clock::time_point created;
+	std::chrono::steady_clock::time_point lastFrame;
+	uint64_t frames = 0;
+
+	Window overlayWindow;
+	StatsReport overlay;
+	uint64_t overlayVersion = 0;
+
+	Window exportWindow;
+	unsigned int exportInterval = STATS_EXPORT_FRAMES;
+	std::ofstream file;
+	bool csv = false;
+
+	double elapsed() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - created).count();
+	}
+
+	void writeRecord(StatsReport report) {
+		report.ProcessMemory = processMemory();
+		if (csv) {
+			file << ENGINE_BUILD_ID << "," << report.Frame << "," << report.Time << "," << report.Frames
+				<< "," << report.CpuTime.Mean << "," << report.CpuTime.P50 << "," << report.CpuTime.P99
+				<< "," << report.GpuTime.Mean << "," << report.GpuTime.P99;
+			for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+				file << "," << report.Counters[i];
+			}
+			file << "," << report.StateChanges << "," << report.Commands << "," << report.CommandBytes << "," << report.RenderScale
+				<< "," << report.GpuMemory << "," << report.ProcessMemory << "\n";
+		}
+		else {
+			file << "{\"build\":\"" << ENGINE_BUILD_ID << "\",\"frame\":" << report.Frame << ",\"time\":" << report.Time
+				<< ",\"frames\":" << report.Frames
+				<< ",\"cpu_ms_mean\":" << report.CpuTime.Mean << ",\"cpu_ms_p50\":" << report.CpuTime.P50 << ",\"cpu_ms_p99\":" << report.CpuTime.P99
+				<< ",\"gpu_ms_mean\":" << report.GpuTime.Mean << ",\"gpu_ms_p99\":" << report.GpuTime.P99;
+			for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+				file << ",\"" << counterName((renderCounter)i) << "\":" << report.Counters[i];
+			}
+			file << ",\"state_changes\":" << report.StateChanges << ",\"commands\":" << report.Commands
+				<< ",\"command_bytes\":" << report.CommandBytes << ",\"render_scale\":" << report.RenderScale
+				<< ",\"gpu_memory_bytes\":" << report.GpuMemory
+				<< ",\"process_memory_bytes\":" << report.ProcessMemory << "}\n";
+		}
+		// flushed per record so monitoring can tail the file while the engine runs
+		file.flush();
+	}
+};
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+
+#include "command_buffer.h"
+#include "render_stats.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// how the scene's depth buffer is set up, the camera projection has to match (Camera::setReversedDepth)
+enum depthMode {
+	DEPTH_STANDARD,    // 24-bit fixed point depth, [-1, 1] clip range, GL_LESS and a finite far plane
+	DEPTH_REVERSED,    // 32-bit float depth, [0, 1] clip range, GL_GREATER, near at 1 and infinity at 0
+	DEPTH_MODE_COUNT
+};
+
+inline const char* depthModeName(depthMode mode) {
+	static const char* names[DEPTH_MODE_COUNT] = { "standard", "reversed" };
+	return names[mode];
+}
+
+inline bool parseDepthMode(const std::string& name, depthMode& mode) {
+	for (unsigned int i = 0; i < DEPTH_MODE_COUNT; i++) {
+		if (name == depthModeName((depthMode)i)) {
+			mode = (depthMode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// sets the clip range, depth test and depth clear value of the current context for mode
+inline bool applyDepthMode(depthMode mode) {
+	if (!glClipControl) {
+		if (mode == DEPTH_REVERSED) {
+			std::cout << "ERROR::RENDER_TARGET::CLIP_CONTROL_NOT_SUPPORTED" << std::endl;
+			return false;
+		}
+	}
+	else {
+		glClipControl(GL_LOWER_LEFT, mode == DEPTH_REVERSED ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+	}
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(mode == DEPTH_REVERSED ? GL_GREATER : GL_LESS);
+	glClearDepth(mode == DEPTH_REVERSED ? 0.0 : 1.0);
+	return true;
+}
+
+// Offscreen colour and depth textures the scene is drawn into, then resolved into the window or
+// headless framebuffer. The default framebuffer has no float depth format, and later passes can
+// sample both textures. The colour is RGBA8 for an LDR scene or GL_R11F_G11F_B10F for HDR, which
+// keeps values above 1 at the same four bytes per pixel. An optional second attachment holds the
+// screen-space motion of every pixel since the previous frame (RG16F, in UV units), written by the
+// scene shaders built with VELOCITY, for any temporal pass to reproject its history with. Size
+// changes are recorded like any other command and applied on the render thread, so the main thread
+// never touches the GL objects after create.
+class RenderTarget {
+public:
+	GLuint Framebuffer = 0;
+	GLuint ColorTexture = 0;
+	GLuint DepthTexture = 0;
+	GLuint VelocityTexture = 0;   // only with velocity, see create
+
+	RenderTarget() = default;
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	bool create(int width, int height, depthMode mode, GLenum colorInternalFormat = GL_RGBA8, bool velocity = false) {
+		colorFormat = colorInternalFormat;
+		colorType = colorFormat == GL_RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+		depthFormat = mode == DEPTH_REVERSED ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+		depthType = mode == DEPTH_REVERSED ? GL_FLOAT : GL_UNSIGNED_INT;
+
+		glGenFramebuffers(1, &Framebuffer);
+		glGenTextures(1, &ColorTexture);
+		glGenTextures(1, &DepthTexture);
+		if (velocity) {
+			glGenTextures(1, &VelocityTexture);
+		}
+		for (GLuint texture : { ColorTexture, DepthTexture, VelocityTexture }) {
+			if (!texture) {
+				continue;
+			}
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			// a single level, so samplers with mipmap filtering still see a complete texture
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		}
+		allocate(width, height);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ColorTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, DepthTexture, 0);
+		if (velocity) {
+			GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, VelocityTexture, 0);
+			glDrawBuffers(2, buffers);
+		}
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::RENDER_TARGET::FRAMEBUFFER_INCOMPLETE " << status << std::endl;
+			destroy();
+			return false;
+		}
+		recordedWidth = width;
+		recordedHeight = height;
+		return true;
+	}
+
+	void destroy() {
+		if (!Framebuffer) {
+			return;
+		}
+		glDeleteFramebuffers(1, &Framebuffer);
+		glDeleteTextures(1, &ColorTexture);
+		glDeleteTextures(1, &DepthTexture);
+		if (VelocityTexture) {
+			glDeleteTextures(1, &VelocityTexture);
+		}
+		trackGpuMemory(-allocatedBytes);
+		Framebuffer = ColorTexture = DepthTexture = VelocityTexture = 0;
+		allocatedBytes = 0;
+	}
+
+	// main thread: reallocates the textures at this point of the frame if the size changed
+	void recordResize(CommandBuffer& commands, int width, int height) {
+		if (width == recordedWidth && height == recordedHeight) {
+			return;
+		}
+		recordedWidth = width;
+		recordedHeight = height;
+		commands.callback(&RenderTarget::resizeCallback, this, ((uint64_t)(uint32_t)width << 32) | (uint32_t)height);
+	}
+
+	void recordBind(CommandBuffer& commands) {
+		commands.bindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+	}
+
+	// clears colour and depth, and the velocity to no motion rather than to the clear colour
+	void recordClear(CommandBuffer& commands, const glm::vec4& color) {
+		commands.clear(color, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (VelocityTexture) {
+			commands.callback(&RenderTarget::clearVelocityCallback, this);
+		}
+	}
+
+	// copies the bottom left sourceWidth x sourceHeight of the colour into output, which stays bound
+	// for whatever is drawn on top. the source is the whole target unless the scene was drawn smaller
+	void recordResolve(CommandBuffer& commands, GLuint output, int outputWidth, int outputHeight, int sourceWidth = 0, int sourceHeight = 0) {
+		sourceWidth = sourceWidth > 0 ? sourceWidth : recordedWidth;
+		sourceHeight = sourceHeight > 0 ? sourceHeight : recordedHeight;
+		commands.blitFramebuffer(Framebuffer, sourceWidth, sourceHeight, output, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT,
+			outputWidth == sourceWidth && outputHeight == sourceHeight ? GL_NEAREST : GL_LINEAR);
+		commands.bindFramebuffer(GL_FRAMEBUFFER, output);
+	}
+
+private:
+	GLenum colorFormat = GL_RGBA8;
+	GLenum colorType = GL_UNSIGNED_BYTE;
+	GLenum depthFormat = GL_DEPTH_COMPONENT32F;
+	GLenum depthType = GL_FLOAT;
+	int recordedWidth = 0;     // size as of the last recorded command, main thread only
+	int recordedHeight = 0;
+	int64_t allocatedBytes = 0;
+
+	void allocate(int width, int height) {
+		width = width > 0 ? width : 1;
+		height = height > 0 ? height : 1;
+		glBindTexture(GL_TEXTURE_2D, ColorTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, colorFormat == GL_RGBA8 ? GL_RGBA : GL_RGB, colorType, nullptr);
+		glBindTexture(GL_TEXTURE_2D, DepthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, depthFormat, width, height, 0, GL_DEPTH_COMPONENT, depthType, nullptr);
+		if (VelocityTexture) {
+			glBindTexture(GL_TEXTURE_2D, VelocityTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, width, height, 0, GL_RG, GL_FLOAT, nullptr);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// both colour formats are four bytes, 24-bit depth is padded to four bytes as well
+		int64_t bytes = (int64_t)width * height * (VelocityTexture ? 12 : 8);
+		trackGpuMemory(bytes - allocatedBytes);
+		allocatedBytes = bytes;
+	}
+
+	static void clearVelocityCallback(void*, uint64_t) {
+		const GLfloat none[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearBufferfv(GL_COLOR, 1, none);
+	}
+
+	static void resizeCallback(void* user, uint64_t size) {
+		static_cast<RenderTarget*>(user)->allocate((int)(size >> 32), (int)(size & 0xFFFFFFFFu));
+	}
+};
+
+#endif
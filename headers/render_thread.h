@@ -0,0 +1,173 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "command_buffer.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// per-stage frame time totals of both threads, in milliseconds
+struct FrameTimings {
+	unsigned int Frames = 0;
+	double MainRecord = 0.0;     // building the command buffer on the main thread
+	double MainStall = 0.0;      // main thread waiting for the render thread to free a buffer
+	double RenderIdle = 0.0;     // render thread waiting for a recorded frame
+	double RenderReplay = 0.0;   // replaying commands into the driver
+	double RenderPresent = 0.0;  // swapping buffers
+};
+
+// Owns the GL context on a dedicated thread and replays command buffers recorded by the main
+// thread. Two buffers alternate: while the render thread replays frame N, the main thread is
+// already recording frame N + 1, so CPU scene work overlaps with driver overhead.
+class RenderThread {
+public:
+	typedef std::function<void()> ContextFunction;
+
+	// makeCurrent/release move the context onto and off the render thread, present ends a frame
+	RenderThread(ContextFunction makeCurrent, ContextFunction present, ContextFunction release)
+		: makeCurrent(makeCurrent), present(present), release(release) {
+	}
+
+	~RenderThread() {
+		stop();
+	}
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// the calling thread must have released the context before starting
+	void start() {
+		stopping = false;
+		worker = std::thread([this]() { renderLoop(); });
+	}
+
+	// replays everything already submitted, then hands the context back
+	void stop() {
+		if (!worker.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		worker.join();
+	}
+
+	// returns the buffer for the next frame, waiting until the render thread is done with it
+	CommandBuffer& beginFrame() {
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return states[recordIndex] == BUFFER_FREE; });
+		}
+		mainStall += elapsedMs(start);
+		recordStart = std::chrono::steady_clock::now();
+
+		buffers[recordIndex].reset();
+		return buffers[recordIndex];
+	}
+
+	void submit() {
+		mainRecord += elapsedMs(recordStart);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			states[recordIndex] = BUFFER_PENDING;
+		}
+		condition.notify_all();
+		recordIndex ^= 1;
+	}
+
+	// returns the totals gathered since the last call and starts over
+	FrameTimings collectTimings() {
+		std::lock_guard<std::mutex> lock(mutex);
+		FrameTimings result = timings;
+		result.MainRecord = mainRecord;
+		result.MainStall = mainStall;
+		timings = FrameTimings();
+		mainRecord = 0.0;
+		mainStall = 0.0;
+		return result;
+	}
+
+private:
+	enum bufferState {
+		BUFFER_FREE,
+		BUFFER_PENDING,
+		BUFFER_REPLAYING
+	};
+
+	ContextFunction makeCurrent;
+	ContextFunction present;
+	ContextFunction release;
+
+	CommandBuffer buffers[2];
+	bufferState states[2] = { BUFFER_FREE, BUFFER_FREE };
+	unsigned int recordIndex = 0;   // main thread only
+	unsigned int replayIndex = 0;   // render thread only
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	FrameTimings timings;           // render side, guarded by mutex
+	double mainRecord = 0.0;
+	double mainStall = 0.0;
+	std::chrono::steady_clock::time_point recordStart;
+
+	static double elapsedMs(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void renderLoop() {
+		PROFILE_THREAD("render thread");
+		makeCurrent();
+
+		for (;;) {
+			auto idleStart = std::chrono::steady_clock::now();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || states[replayIndex] == BUFFER_PENDING; });
+				if (states[replayIndex] != BUFFER_PENDING) {
+					break;
+				}
+				states[replayIndex] = BUFFER_REPLAYING;
+			}
+			double idle = elapsedMs(idleStart);
+
+			auto replayStart = std::chrono::steady_clock::now();
+			{
+				PROFILE_SCOPE("replay");
+				buffers[replayIndex].execute();
+			}
+			double replay = elapsedMs(replayStart);
+
+			auto presentStart = std::chrono::steady_clock::now();
+			{
+				PROFILE_SCOPE("present");
+				present();
+			}
+			double presented = elapsedMs(presentStart);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				states[replayIndex] = BUFFER_FREE;
+				timings.Frames++;
+				timings.RenderIdle += idle;
+				timings.RenderReplay += replay;
+				timings.RenderPresent += presented;
+			}
+			condition.notify_all();
+			replayIndex ^= 1;
+		}
+
+		release();
+	}
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "job_system.h"
+#include "profiler.h"
+
+#include <cstdint>
+#include <vector>
+
+const uint32_t INVALID_NODE = 0xFFFFFFFFu;
+
+// Transform hierarchy stored as parallel arrays in depth-first order.
+// The subtree of the node in slot i always occupies slots [i, i + SubtreeSize[i]),
+// so a dirty node and everything below it can be updated as one contiguous range.
+class SceneGraph {
+public:
+	// per-slot attributes, indexed by slot (not by node handle)
+	std::vector<int32_t> Parent;
+	std::vector<uint32_t> SubtreeSize;
+	std::vector<glm::vec3> Position;
+	std::vector<glm::quat> Rotation;
+	std::vector<glm::vec3> Scale;
+	std::vector<glm::mat4> Local;
+	std::vector<glm::mat4> World;
+	std::vector<uint8_t> Dirty;
+
+	void reserve(size_t count) {
+		Parent.reserve(count);
+		SubtreeSize.reserve(count);
+		Position.reserve(count);
+		Rotation.reserve(count);
+		Scale.reserve(count);
+		Local.reserve(count);
+		World.reserve(count);
+		Dirty.reserve(count);
+		nodeToSlot.reserve(count);
+		slotToNode.reserve(count);
+	}
+
+	size_t size() const {
+		return Parent.size();
+	}
+
+	// adds a node as the last child of parent (or as a new root) and returns a handle
+	// that stays valid when later insertions shift slots around
+	uint32_t addNode(
+		uint32_t parent = INVALID_NODE,
+		const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		const glm::vec3& scale = glm::vec3(1.0f)
+	) {
+		uint32_t slot = (uint32_t)size();
+		int32_t parentSlot = -1;
+		if (parent != INVALID_NODE) {
+			parentSlot = (int32_t)nodeToSlot[parent];
+			slot = (uint32_t)parentSlot + SubtreeSize[parentSlot];
+		}
+
+		Parent.insert(Parent.begin() + slot, parentSlot);
+		SubtreeSize.insert(SubtreeSize.begin() + slot, 1u);
+		Position.insert(Position.begin() + slot, position);
+		Rotation.insert(Rotation.begin() + slot, rotation);
+		Scale.insert(Scale.begin() + slot, scale);
+		Local.insert(Local.begin() + slot, glm::mat4(1.0f));
+		World.insert(World.begin() + slot, glm::mat4(1.0f));
+		Dirty.insert(Dirty.begin() + slot, (uint8_t)1);
+
+		uint32_t node = (uint32_t)nodeToSlot.size();
+		nodeToSlot.push_back(slot);
+		slotToNode.insert(slotToNode.begin() + slot, node);
+
+		// everything after the insertion point moved down by one slot
+		for (uint32_t i = slot + 1; i < (uint32_t)size(); i++) {
+			if (Parent[i] >= (int32_t)slot) {
+				Parent[i]++;
+			}
+			nodeToSlot[slotToNode[i]] = i;
+		}
+
+		for (int32_t ancestor = parentSlot; ancestor >= 0; ancestor = Parent[ancestor]) {
+			SubtreeSize[ancestor]++;
+		}
+
+		return node;
+	}
+
+	uint32_t slotOf(uint32_t node) const {
+		return nodeToSlot[node];
+	}
+
+	void setPosition(uint32_t node, const glm::vec3& position) {
+		uint32_t slot = nodeToSlot[node];
+		Position[slot] = position;
+		Dirty[slot] = 1;
+	}
+
+	void setRotation(uint32_t node, const glm::quat& rotation) {
+		uint32_t slot = nodeToSlot[node];
+		Rotation[slot] = rotation;
+		Dirty[slot] = 1;
+	}
+
+	void setScale(uint32_t node, const glm::vec3& scale) {
+		uint32_t slot = nodeToSlot[node];
+		Scale[slot] = scale;
+		Dirty[slot] = 1;
+	}
+
+	const glm::mat4& getWorldMatrix(uint32_t node) const {
+		return World[nodeToSlot[node]];
+	}
+
+	// recomputes world matrices for every dirty node and its descendants
+	void updateWorldTransforms() {
+		uint32_t count = (uint32_t)size();
+		uint32_t i = 0;
+		while (i < count) {
+			if (!Dirty[i]) {
+				i++;
+				continue;
+			}
+			uint32_t end = i + SubtreeSize[i];
+			updateRange(i, end);
+			i = end;
+		}
+	}
+
+	// same result as updateWorldTransforms, but dirty subtrees are spread across the job system.
+	// subtrees wider than grainSize are split at their children so a single huge
+	// dirty parent still produces enough independent work
+	void updateWorldTransformsParallel(JobSystem& jobs, uint32_t grainSize = 2048) {
+		PROFILE_SCOPE("SceneGraph::updateWorldTransforms");
+		std::vector<NodeRange> ranges;
+		collectDirtyRanges(ranges, grainSize);
+
+		// batch neighbouring ranges so every job touches roughly grainSize nodes
+		std::vector<uint32_t> batchStart;
+		uint32_t batchNodes = grainSize;
+		for (uint32_t r = 0; r < (uint32_t)ranges.size(); r++) {
+			if (batchNodes >= grainSize) {
+				batchStart.push_back(r);
+				batchNodes = 0;
+			}
+			batchNodes += ranges[r].End - ranges[r].Begin;
+		}
+		batchStart.push_back((uint32_t)ranges.size());
+
+		JobCounter counter;
+		auto updateBatches = [&](uint32_t begin, uint32_t end) {
+			for (uint32_t r = batchStart[begin]; r < batchStart[end]; r++) {
+				updateRange(ranges[r].Begin, ranges[r].End);
+			}
+		};
+		jobs.parallelFor(counter, (uint32_t)batchStart.size() - 1, 1, updateBatches);
+		jobs.wait(counter);
+	}
+
+private:
+	struct NodeRange {
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	std::vector<uint32_t> nodeToSlot;
+	std::vector<uint32_t> slotToNode;
+
+	// finds the top-most dirty subtrees; their roots have clean ancestors, so the
+	// resulting ranges can be updated independently of each other
+	void collectDirtyRanges(std::vector<NodeRange>& ranges, uint32_t grainSize) {
+		std::vector<NodeRange> pending;
+		uint32_t count = (uint32_t)size();
+		uint32_t i = 0;
+		while (i < count) {
+			if (!Dirty[i]) {
+				i++;
+				continue;
+			}
+			pending.push_back({ i, i + SubtreeSize[i] });
+			i += SubtreeSize[i];
+		}
+
+		while (!pending.empty()) {
+			NodeRange range = pending.back();
+			pending.pop_back();
+
+			if (range.End - range.Begin <= grainSize) {
+				ranges.push_back(range);
+				continue;
+			}
+
+			// update the root now, then each child subtree becomes its own range
+			updateSlot(range.Begin);
+			uint32_t child = range.Begin + 1;
+			while (child < range.End) {
+				pending.push_back({ child, child + SubtreeSize[child] });
+				child += SubtreeSize[child];
+			}
+		}
+	}
+
+	void updateRange(uint32_t begin, uint32_t end) {
+		for (uint32_t slot = begin; slot < end; slot++) {
+			updateSlot(slot);
+		}
+	}
+
+	void updateSlot(uint32_t slot) {
+		if (Dirty[slot]) {
+			// translate * rotate * scale without going through three 4x4 multiplies
+			glm::mat4 local = glm::mat4_cast(Rotation[slot]);
+			local[0] *= Scale[slot].x;
+			local[1] *= Scale[slot].y;
+			local[2] *= Scale[slot].z;
+			local[3] = glm::vec4(Position[slot], 1.0f);
+			Local[slot] = local;
+			Dirty[slot] = 0;
+		}
+
+		int32_t parent = Parent[slot];
+		World[slot] = parent < 0 ? Local[slot] : World[parent] * Local[slot];
+	}
+};
+
+#endif
@@ -4,7 +4,11 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "profiler.h"
+#include "render_stats.h"
+
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -13,15 +17,20 @@ class Shader {
 public:
 	unsigned int ID;
 
-	Shader(const char* vertexPath, const  char* fragmentPath) {
+	// defines are inserted after the #version line of every stage, e.g. "#define LIGHT_SHADOWS\n"
+	Shader(const char* vertexPath, const  char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = std::string()) {
+		PROFILE_SCOPE("Shader::Shader");
 		std::string vertexCode;
 		std::string fragmentCode;
+		std::string geometryCode;
 		std::ifstream vShaderFile;
 		std::ifstream fShaderFile;
+		std::ifstream gShaderFile;
 
 		// ensure ifstream objects can throw exceptions
 		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 		
 		try {
 			vShaderFile.open(vertexPath);
@@ -39,10 +48,27 @@ public:
 			// convert stream into string
 			vertexCode = vShaderStream.str();
 			fragmentCode = fShaderStream.str();
+
+			// the geometry shader is optional
+			if (geometryPath) {
+				gShaderFile.open(geometryPath);
+				std::stringstream gShaderStream;
+				gShaderStream << gShaderFile.rdbuf();
+				gShaderFile.close();
+				geometryCode = gShaderStream.str();
+			}
 		}
 		catch (std::ifstream::failure& e) {
 			std::cout << "ERROR:SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 		}
+		if (!defines.empty()) {
+			for (std::string* code : { &vertexCode, &fragmentCode, &geometryCode }) {
+				size_t line = code->find('\n');
+				if (line != std::string::npos) {
+					code->insert(line + 1, defines);
+				}
+			}
+		}
 		
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
@@ -60,48 +86,153 @@ public:
 		glShaderSource(fragment, 1, &fShaderCode, NULL);
 		glCompileShader(fragment);
 		checkCompileErrors(fragment, "FRAGMENT");
+
+		// geometry shader
+		unsigned int geometry = 0;
+		if (geometryPath) {
+			const char* gShaderCode = geometryCode.c_str();
+			geometry = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(geometry, 1, &gShaderCode, NULL);
+			glCompileShader(geometry);
+			checkCompileErrors(geometry, "GEOMETRY");
+		}
 		
 		// shader program
 		ID = glCreateProgram();
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
+		if (geometryPath) {
+			glAttachShader(ID, geometry);
+		}
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
 
 		// delete the shaders as they are now linked in the program and are no longer necessary
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+		if (geometryPath) {
+			glDeleteShader(geometry);
+		}
+
+		cacheUniformLocations();
 	};
 
+	// compute program from a single stage, defines are inserted the same way
+	static Shader compute(const char* computePath, const std::string& defines = std::string()) {
+		PROFILE_SCOPE("Shader::compute");
+		std::string computeCode;
+		std::ifstream cShaderFile;
+		cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		try {
+			cShaderFile.open(computePath);
+			std::stringstream cShaderStream;
+			cShaderStream << cShaderFile.rdbuf();
+			cShaderFile.close();
+			computeCode = cShaderStream.str();
+		}
+		catch (std::ifstream::failure& e) {
+			std::cout << "ERROR:SHADER::FILE_NOT_SUCCESSFULLY_READ " << computePath << std::endl;
+		}
+		size_t line = computeCode.find('\n');
+		if (!defines.empty() && line != std::string::npos) {
+			computeCode.insert(line + 1, defines);
+		}
+
+		Shader shader;
+		const char* cShaderCode = computeCode.c_str();
+		unsigned int stage = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(stage, 1, &cShaderCode, NULL);
+		glCompileShader(stage);
+		shader.checkCompileErrors(stage, "COMPUTE");
+
+		shader.ID = glCreateProgram();
+		glAttachShader(shader.ID, stage);
+		glLinkProgram(shader.ID);
+		shader.checkCompileErrors(shader.ID, "PROGRAM");
+		glDeleteShader(stage);
+
+		shader.cacheUniformLocations();
+		return shader;
+	}
+
+	// location of an active uniform, or -1. uses the table built at link time, so it needs no
+	// GL context and can be called from threads that only record commands
+	GLint uniformLocation(const std::string& name) const {
+		auto found = uniformLocations.find(name);
+		return found != uniformLocations.end() ? found->second : -1;
+	}
+
 	void use() {
 		glUseProgram(ID);
+		countImmediate(COUNTER_PROGRAM_BINDS);
 	};
 
 	void setBool(const std::string &name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(uniformLocation(name), (int)value);
+		countImmediate(COUNTER_UNIFORM_UPLOADS);
 	};
 
 	void setInt(const std::string &name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(uniformLocation(name), value);
+		countImmediate(COUNTER_UNIFORM_UPLOADS);
 	};
 
 	void setFloat(const std::string &name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(uniformLocation(name), value);
+		countImmediate(COUNTER_UNIFORM_UPLOADS);
 	};
 
 	void setVec3(const std::string& name, const glm::vec3& value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(uniformLocation(name), 1, &value[0]);
+		countImmediate(COUNTER_UNIFORM_UPLOADS);
 	}
 
 	void setVec3(const std::string &name, float x, float y, float z) const {
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(uniformLocation(name), x, y, z);
+		countImmediate(COUNTER_UNIFORM_UPLOADS);
 	}
 
 	void setMat4(const std::string &name, const glm::mat4 &mat) const {
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+		countImmediate(COUNTER_UNIFORM_UPLOADS);
 	};
 
 private:
+	std::unordered_map<std::string, GLint> uniformLocations;
+
+	Shader() : ID(0) {
+	}
+
+	// queries every active uniform once instead of calling glGetUniformLocation per set
+	void cacheUniformLocations() {
+		GLint count = 0;
+		GLint maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		std::string name(maxLength > 0 ? maxLength : 1, '\0');
+		for (GLint i = 0; i < count; i++) {
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+
+			std::string uniform = name.substr(0, length);
+			GLint location = glGetUniformLocation(ID, uniform.c_str());
+			uniformLocations[uniform] = location;
+
+			// arrays of basic types are reported once as "name[0]", make "name" and every element resolve as well
+			if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+				std::string base = uniform.substr(0, uniform.size() - 3);
+				uniformLocations[base] = location;
+				for (GLint element = 1; element < size; element++) {
+					std::string elementName = base + "[" + std::to_string(element) + "]";
+					uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+				}
+			}
+		}
+	}
+
 	void checkCompileErrors(unsigned int shader, std::string type) {
 		int success;
 		char infoLog[1024];
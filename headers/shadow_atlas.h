@@ -0,0 +1,677 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "camera.h"
+#include "command_buffer.h"
+#include "components.h"
+#include "culling.h"
+#include "ecs.h"
+#include "job_system.h"
+#include "lighting.h"
+#include "profiler.h"
+#include "render_stats.h"
+#include "render_target.h"
+#include "scene_graph.h"
+#include "shader.h"
+#include "simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+const int SHADOW_ATLAS_SIZE = 2048;
+const int SHADOW_TILE_MIN = 64;
+const int SHADOW_TILE_MAX_POINT = 256;              // per cube face
+const int SHADOW_TILE_MAX_SPOT = 512;
+const float SHADOW_TILE_COVERAGE = 0.5f;            // tile texels per pixel of the light's projected diameter
+const float SHADOW_MIN_COVERAGE = 32.0f;            // lights smaller than this many pixels on screen cast no shadow
+const float SHADOW_LIGHT_THRESHOLD = 1.0f / 32.0f;  // attenuation where the shadow range of a light ends
+const float SHADOW_LIGHT_NEAR = 0.05f;
+const uint16_t SHADOW_STATIC_FRAMES = 16;           // frames a caster has to keep still before it is cached
+const unsigned int SHADOW_ATLAS_UPDATE_BUDGET = 8;  // tiles rendered per frame at most
+const unsigned int SHADOW_ATLAS_TILES = MAX_POINT_LIGHTS * 6 + 1;   // six cube faces per point light, then the flashlight
+const GLuint LIGHT_SHADOW_BLOCK_BINDING = 1;        // must match the binding of LightShadows in the lit shaders
+
+// What the lit shaders read, std140 layout of the LightShadows block. Cube faces are projected in
+// the shader from the light's position rather than with a matrix each, which keeps the lookup to
+// one vec4 per face when every fragment may pick a different face.
+struct LightShadowBlock {
+	glm::vec4 PointFaces[MAX_POINT_LIGHTS * 6];     // xy centre of the face's tile in the atlas, z half its size over tan(fov / 2)
+	glm::vec4 PointLights[MAX_POINT_LIGHTS];        // xyz position the faces were rendered from, w normal offset per unit of distance, 0 when unshadowed
+	glm::vec4 PointDepths[MAX_POINT_LIGHTS];        // depth is x + y / distance along the face's axis
+	glm::mat4 Spot;                                 // world to atlas coordinates and depth
+	glm::vec4 SpotLight;
+};
+
+// an object that casts shadows, its world matrix and bounds are looked up by slot
+struct ShadowCaster {
+	uint32_t Slot;
+	uint32_t Mesh;
+	uint32_t Lod;   // level of detail the camera view draws it at, cached tiles keep the one they were rendered with
+};
+
+// distance where 1 / (constant + linear * d + quadratic * d^2) falls to SHADOW_LIGHT_THRESHOLD
+inline float lightShadowRange(float constant, float linear, float quadratic) {
+	float c = constant - 1.0f / SHADOW_LIGHT_THRESHOLD;
+	if (quadratic <= 0.0f) {
+		return linear > 0.0f ? -c / linear : 1000.0f;
+	}
+	return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+}
+
+// Shadow maps of the point lights and the flashlight, packed into one depth texture. Every light gets
+// a power-of-two tile (six for point lights) sized by how much of the screen its range covers.
+//
+// Tiles are only rendered when their content would change. Casters that have kept still for a while
+// are drawn once into a static copy of the atlas; a tile whose light holds still and that has moving
+// casters in its frustum is refreshed by copying its static part and drawing only the moving casters
+// on top, and a tile with nothing moving in it is not touched at all. Lights that move themselves
+// render everything directly. At most SHADOW_ATLAS_UPDATE_BUDGET tiles are refreshed per frame,
+// stalest first, so the cost follows how much changes rather than how many lights there are; the
+// shaders always look up each tile with the projection it was last rendered with.
+class ShadowAtlas {
+public:
+	GLuint Texture = 0;         // sampled by the lit shaders with depth comparison
+	GLuint UniformBuffer = 0;   // the LightShadowBlock, bound to LIGHT_SHADOW_BLOCK_BINDING
+
+	ShadowAtlas() = default;
+	ShadowAtlas(const ShadowAtlas&) = delete;
+	ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+	// without shadows only the uniform block is created, which leaves every light unshadowed
+	bool create(depthMode mode, bool shadows, const Shader& shader) {
+		reversed = mode == DEPTH_REVERSED;
+		std::memset(&uploaded, 0, sizeof(uploaded));
+		glGenBuffers(1, &UniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, UniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightShadowBlock), &uploaded, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_SHADOW_BLOCK_BINDING, UniformBuffer);
+		trackGpuMemory(sizeof(LightShadowBlock));
+		if (!shadows) {
+			return true;
+		}
+
+		GLuint textures[2];
+		glGenTextures(2, textures);
+		Texture = textures[0];
+		staticTexture = textures[1];
+		for (GLuint texture : textures) {
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, reversed ? GL_GEQUAL : GL_LEQUAL);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		trackGpuMemory(2 * (int64_t)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE * 4);
+
+		glGenFramebuffers(2, framebuffers);
+		for (int i = 0; i < 2; i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[i], 0);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			if (status != GL_FRAMEBUFFER_COMPLETE) {
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				std::cout << "ERROR::SHADOW_ATLAS::FRAMEBUFFER_INCOMPLETE " << status << std::endl;
+				destroy();
+				return false;
+			}
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		program = shader.ID;
+		mvpLocation = shader.uniformLocation("mvp");
+		return true;
+	}
+
+	void destroy() {
+		if (UniformBuffer) {
+			glDeleteBuffers(1, &UniformBuffer);
+			trackGpuMemory(-(int64_t)sizeof(LightShadowBlock));
+			UniformBuffer = 0;
+		}
+		if (Texture) {
+			GLuint textures[2] = { Texture, staticTexture };
+			glDeleteTextures(2, textures);
+			glDeleteFramebuffers(2, framebuffers);
+			trackGpuMemory(-2 * (int64_t)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE * 4);
+			Texture = staticTexture = 0;
+		}
+	}
+
+	bool enabled() const {
+		return Texture != 0;
+	}
+
+	// Main thread: sizes and places the tiles, renders the ones due within the budget and uploads the
+	// lookup block. Lights are read like recordLightUniforms reads them, so indices match the shaders.
+	// world holds the interpolated matrices the casters are drawn with; whether a caster moves is
+	// decided from the two simulation ticks, which are exactly equal for anything standing still.
+	void record(CommandBuffer& commands, JobSystem& jobs, EntityRegistry& registry, const SceneGraph& scene, const SimulationSnapshot& snapshot,
+		Camera& camera, int viewportHeight, const std::vector<ShadowCaster>& casters, const std::vector<glm::mat4>& world, const Mesh* meshes,
+		uint64_t frame) {
+		PROFILE_SCOPE("shadow atlas");
+		refreshed = 0;
+		shadowed = 0;
+		if (enabled()) {
+			placeTiles(registry, scene, snapshot.Current, camera, viewportHeight);
+			classifyCasters(jobs, casters, snapshot, world, meshes);
+			refreshTiles(commands, jobs, casters, world, meshes, frame);
+			refreshedTotal += refreshed;
+			recordedFrames++;
+		}
+		uploadBlock(commands);
+	}
+
+	// tiles refreshed and lights shadowed in the last recorded frame
+	unsigned int refreshedTiles() const {
+		return refreshed;
+	}
+
+	double averageRefreshedTiles() const {
+		return recordedFrames > 0 ? (double)refreshedTotal / recordedFrames : 0.0;
+	}
+
+	unsigned int shadowedLights() const {
+		return shadowed;
+	}
+
+private:
+	struct Tile {
+		int Size = 0;                   // texels on a side, 0 when the light gets no shadow this frame
+		int X = 0, Y = 0;
+		glm::mat4 ViewProjection = glm::mat4(0.0f);
+		glm::mat4 PreviousViewProjection = glm::mat4(0.0f);
+		Frustum Bounds = {};
+		glm::vec3 Position = glm::vec3(0.0f);
+		float OffsetScale = 0.0f;       // normal offset per unit of distance, about a texel and a half
+		glm::vec4 Face = glm::vec4(0.0f);   // see LightShadowBlock::PointFaces
+		glm::vec2 Depth = glm::vec2(0.0f);  // see LightShadowBlock::PointDepths
+		bool MovingInside = false;
+
+		// what the atlas currently holds for this tile
+		bool Rendered = false;
+		bool HadMoving = false;         // moving casters were drawn into it
+		bool Stale = false;             // a caster became or stopped being static inside it since
+		uint64_t LastRefresh = 0;
+		glm::mat4 RenderedViewProjection = glm::mat4(0.0f);
+		glm::mat4 RenderedLookup = glm::mat4(0.0f);
+		glm::vec3 RenderedPosition = glm::vec3(0.0f);
+		float RenderedOffsetScale = 0.0f;
+		glm::vec4 RenderedFace = glm::vec4(0.0f);
+		glm::vec2 RenderedDepth = glm::vec2(0.0f);
+
+		// the static copy, drawn with StaticViewProjection
+		bool StaticValid = false;
+		bool StaticEmpty = false;       // no static caster in view, the copy would only hold the clear
+		glm::mat4 StaticViewProjection = glm::mat4(0.0f);
+	};
+
+	struct Light {
+		glm::vec3 Position = glm::vec3(0.0f);
+		glm::vec3 Direction = glm::vec3(0.0f);
+		float OuterCutOff = 0.0f;
+		float Range = 0.0f;
+		int Size = 0;   // tile size after hysteresis, before the atlas is fitted
+	};
+
+	bool reversed = true;
+	GLuint staticTexture = 0;
+	GLuint framebuffers[2] = { 0, 0 };     // the atlas and its static copy
+	GLuint program = 0;        // depth only, draws with a single mvp
+	GLint mvpLocation = -1;
+
+	Tile tiles[SHADOW_ATLAS_TILES];
+	Light lights[MAX_POINT_LIGHTS + 1];
+	unsigned int pointLightCount = 0;
+	bool spotActive = false;
+
+	// per slot: how many frames it has not moved
+	std::vector<uint16_t> stillFrames;
+	// per caster, rebuilt every frame
+	std::vector<glm::vec4> casterSpheres;
+	std::vector<uint8_t> casterStatic;
+	std::vector<uint32_t> movingCasters;
+	std::vector<glm::vec4> toggledSpheres;  // old and new bounds of casters that became or stopped being static
+	std::vector<uint32_t> tileCasters;      // casters drawn into the tile being refreshed
+
+	LightShadowBlock block;
+	LightShadowBlock uploaded;
+	unsigned int refreshed = 0;
+	unsigned int shadowed = 0;
+	uint64_t refreshedTotal = 0;
+	uint64_t recordedFrames = 0;
+
+	// power-of-two tile size for a light of the given range, 0 when it is off screen or too small to matter
+	static int coverageTileSize(Camera& camera, int viewportHeight, const glm::vec3& position, float range, int maxSize) {
+		if (!sphereInFrustum(camera.getFrustum(), position, range)) {
+			return 0;
+		}
+		float distance = glm::length(position - camera.getPosition());
+		float diameter = (float)viewportHeight;
+		if (distance > range) {
+			float focal = viewportHeight * 0.5f / std::tan(glm::radians(camera.getFov()) * 0.5f);
+			diameter = std::min(diameter, 2.0f * range / std::sqrt(distance * distance - range * range) * focal);
+		}
+		if (diameter < SHADOW_MIN_COVERAGE) {
+			return 0;
+		}
+		int size = SHADOW_TILE_MIN;
+		while (size < maxSize && size < diameter * SHADOW_TILE_COVERAGE) {
+			size *= 2;
+		}
+		return size;
+	}
+
+	// sizes only shrink once they are four times too large, so lights hovering at a boundary keep their tiles
+	static int withHysteresis(int current, int desired) {
+		if (current == 0 || desired == 0 || desired > current || desired * 4 <= current) {
+			return desired;
+		}
+		return current;
+	}
+
+	// every other bit of a Morton code, so tiles placed in Z order stay aligned to their size
+	static uint32_t compactBits(uint32_t x) {
+		x &= 0x55555555u;
+		x = (x | (x >> 1)) & 0x33333333u;
+		x = (x | (x >> 2)) & 0x0F0F0F0Fu;
+		x = (x | (x >> 4)) & 0x00FF00FFu;
+		x = (x | (x >> 8)) & 0x0000FFFFu;
+		return x;
+	}
+
+	glm::mat4 projection(float fovy, float nearPlane, float farPlane) const {
+		// with reversed depth near and far swap places, so closer to the light is larger
+		return reversed ? glm::perspectiveRH_ZO(fovy, 1.0f, farPlane, nearPlane) : glm::perspectiveRH_NO(fovy, 1.0f, nearPlane, farPlane);
+	}
+
+	// clip space to the tile's rectangle of the atlas and to [0, 1] depth
+	glm::mat4 tileLookup(const Tile& tile) const {
+		float scale = (float)tile.Size / (2.0f * SHADOW_ATLAS_SIZE);
+		glm::mat4 bias(0.0f);
+		bias[0][0] = bias[1][1] = scale;
+		bias[2][2] = reversed ? 1.0f : 0.5f;
+		bias[3] = glm::vec4((tile.X + tile.Size * 0.5f) / SHADOW_ATLAS_SIZE, (tile.Y + tile.Size * 0.5f) / SHADOW_ATLAS_SIZE, reversed ? 0.0f : 0.5f, 1.0f);
+		return bias * tile.ViewProjection;
+	}
+
+	void placeTiles(EntityRegistry& registry, const SceneGraph& scene, const SimulationState& state, Camera& camera, int viewportHeight) {
+		unsigned int index = 0;
+		registry.each<Transform, PointLight>([&](Entity, Transform& transform, PointLight& light) {
+			if (index >= MAX_POINT_LIGHTS) {
+				return;
+			}
+			Light& target = lights[index++];
+			target.Position = glm::vec3(state.World[scene.slotOf(transform.Node)][3]);
+			target.Range = lightShadowRange(light.Constant, light.Linear, light.Quadratic);
+			target.Size = withHysteresis(target.Size, coverageTileSize(camera, viewportHeight, target.Position, target.Range, SHADOW_TILE_MAX_POINT));
+		});
+		for (unsigned int i = index; i < pointLightCount; i++) {
+			lights[i].Size = 0;
+		}
+		pointLightCount = index;
+
+		Light& spot = lights[MAX_POINT_LIGHTS];
+		spotActive = false;
+		registry.each<SpotLight>([&](Entity, SpotLight& light) {
+			spot.Position = light.Position;
+			spot.Direction = glm::normalize(light.Direction);
+			spot.OuterCutOff = light.OuterCutOff;
+			spot.Range = lightShadowRange(light.Constant, light.Linear, light.Quadratic);
+			spotActive = light.Enabled;
+		});
+		spot.Size = spotActive ? withHysteresis(spot.Size, coverageTileSize(camera, viewportHeight, spot.Position, spot.Range, SHADOW_TILE_MAX_SPOT)) : 0;
+
+		// biggest tiles first, halving the largest until everything fits
+		struct Request {
+			unsigned int Tile;
+			int Size;
+		};
+		std::vector<Request> requests;
+		for (unsigned int i = 0; i < pointLightCount; i++) {
+			for (unsigned int face = 0; face < 6 && lights[i].Size > 0; face++) {
+				requests.push_back({ i * 6 + face, lights[i].Size });
+			}
+		}
+		if (spot.Size > 0) {
+			requests.push_back({ SHADOW_ATLAS_TILES - 1, spot.Size });
+		}
+		auto bySize = [](const Request& a, const Request& b) { return a.Size != b.Size ? a.Size > b.Size : a.Tile < b.Tile; };
+		std::sort(requests.begin(), requests.end(), bySize);
+		int64_t area = 0;
+		for (const Request& request : requests) {
+			area += (int64_t)request.Size * request.Size;
+		}
+		while (area > (int64_t)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE) {
+			int largest = requests.front().Size;
+			if (largest <= SHADOW_TILE_MIN) {
+				// even the smallest tiles do not fit, the last lights go without
+				area -= (int64_t)requests.back().Size * requests.back().Size;
+				requests.pop_back();
+				continue;
+			}
+			for (Request& request : requests) {
+				if (request.Size == largest) {
+					request.Size /= 2;
+					area -= (int64_t)largest * largest * 3 / 4;
+				}
+			}
+			std::sort(requests.begin(), requests.end(), bySize);
+		}
+
+		bool active[SHADOW_ATLAS_TILES] = {};
+		uint32_t cursor = 0;
+		for (const Request& request : requests) {
+			Tile& tile = tiles[request.Tile];
+			uint32_t cells = (uint32_t)(request.Size / SHADOW_TILE_MIN);
+			int x = (int)compactBits(cursor) * SHADOW_TILE_MIN;
+			int y = (int)compactBits(cursor >> 1) * SHADOW_TILE_MIN;
+			cursor += cells * cells;
+			if (tile.Size != request.Size || tile.X != x || tile.Y != y) {
+				tile.Size = request.Size;
+				tile.X = x;
+				tile.Y = y;
+				tile.Rendered = false;
+				tile.StaticValid = false;
+			}
+			active[request.Tile] = true;
+		}
+
+		// cube faces in the usual +X, -X, +Y, -Y, +Z, -Z order and orientation, which CalcPointShadow
+		// relies on; the field of view leaves a one texel border, so filtering at the edge of a face
+		// never reads the neighbouring tile
+		static const glm::vec3 faceDirections[6] = {
+			glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+		};
+		static const glm::vec3 faceUps[6] = {
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+			glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+		};
+		for (unsigned int t = 0; t < SHADOW_ATLAS_TILES; t++) {
+			Tile& tile = tiles[t];
+			if (!active[t]) {
+				tile.Size = 0;
+				tile.Rendered = false;
+				tile.StaticValid = false;
+				continue;
+			}
+			const Light& light = t < SHADOW_ATLAS_TILES - 1 ? lights[t / 6] : spot;
+			float border = (float)tile.Size / (float)(tile.Size - 2);
+			glm::mat4 view;
+			float tanHalfFov;
+			if (t < SHADOW_ATLAS_TILES - 1) {
+				view = glm::lookAt(light.Position, light.Position + faceDirections[t % 6], faceUps[t % 6]);
+				tanHalfFov = border;
+			}
+			else {
+				glm::vec3 up = std::fabs(light.Direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				view = glm::lookAt(light.Position, light.Position + light.Direction, up);
+				float cosine = glm::clamp(light.OuterCutOff, 0.1f, 1.0f);
+				tanHalfFov = std::sqrt(1.0f - cosine * cosine) / cosine * border;
+			}
+			glm::mat4 lightProjection = projection(2.0f * std::atan(tanHalfFov), SHADOW_LIGHT_NEAR, light.Range);
+			tile.PreviousViewProjection = tile.ViewProjection;
+			tile.ViewProjection = lightProjection * view;
+			tile.Bounds = extractFrustum(tile.ViewProjection, reversed);
+			tile.Position = light.Position;
+			tile.OffsetScale = 1.5f * 2.0f * tanHalfFov / tile.Size;
+
+			// at distance d along the axis the projection gives depth -[2][2] + [3][2] / d, then [0, 1]
+			float half = tile.Size * 0.5f / SHADOW_ATLAS_SIZE;
+			tile.Face = glm::vec4((tile.X + tile.Size * 0.5f) / SHADOW_ATLAS_SIZE, (tile.Y + tile.Size * 0.5f) / SHADOW_ATLAS_SIZE, half / tanHalfFov, 0.0f);
+			tile.Depth = reversed ? glm::vec2(-lightProjection[2][2], lightProjection[3][2])
+				: glm::vec2(0.5f - 0.5f * lightProjection[2][2], 0.5f * lightProjection[3][2]);
+		}
+	}
+
+	// sorts the casters into static and moving, and notes where the static set changed
+	void classifyCasters(JobSystem& jobs, const std::vector<ShadowCaster>& casters, const SimulationSnapshot& snapshot, const std::vector<glm::mat4>& world,
+		const Mesh* meshes) {
+		const std::vector<glm::mat4>& previous = snapshot.Previous.World;
+		const std::vector<glm::mat4>& current = snapshot.Current.World;
+		if (stillFrames.size() < world.size()) {
+			stillFrames.resize(world.size(), 0);
+		}
+		casterSpheres.resize(casters.size());
+		casterStatic.resize(casters.size());
+
+		JobCounter classified;
+		auto classify = [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				uint32_t slot = casters[i].Slot;
+				float radius = meshes[casters[i].Mesh].BoundingRadius;
+				bool wasStatic = stillFrames[slot] >= SHADOW_STATIC_FRAMES;
+				if (slot < previous.size() && slot < current.size() && previous[slot] == current[slot]) {
+					stillFrames[slot] = (uint16_t)std::min<int>(stillFrames[slot] + 1, SHADOW_STATIC_FRAMES);
+				}
+				else {
+					stillFrames[slot] = 0;
+				}
+				casterSpheres[i] = worldBoundingSphere(world[slot], radius);
+				casterStatic[i] = stillFrames[slot] >= SHADOW_STATIC_FRAMES;
+				// a caster changing sides has to be added to or removed from the static copies around it
+				casterStatic[i] |= (uint8_t)((wasStatic != (casterStatic[i] != 0)) << 1);
+			}
+		};
+		jobs.parallelFor(classified, (uint32_t)casters.size(), 1024, classify);
+		jobs.wait(classified);
+
+		movingCasters.clear();
+		toggledSpheres.clear();
+		for (uint32_t i = 0; i < (uint32_t)casters.size(); i++) {
+			uint32_t slot = casters[i].Slot;
+			if (casterStatic[i] & 2) {
+				// where it was cached or starts moving from, and where it is now
+				toggledSpheres.push_back(worldBoundingSphere(slot < previous.size() ? previous[slot] : world[slot], meshes[casters[i].Mesh].BoundingRadius));
+				toggledSpheres.push_back(casterSpheres[i]);
+				casterStatic[i] &= 1;
+			}
+			if (!casterStatic[i]) {
+				movingCasters.push_back(i);
+			}
+		}
+	}
+
+	void refreshTiles(CommandBuffer& commands, JobSystem& jobs, const std::vector<ShadowCaster>& casters, const std::vector<glm::mat4>& world,
+		const Mesh* meshes, uint64_t frame) {
+		// which tiles have moving casters in them now, and which lost static ones or gained them
+		// one job per thread, a job per tile would churn through the job pool for very little work each
+		JobCounter tested;
+		uint32_t grain = (SHADOW_ATLAS_TILES + jobs.threadCount() - 1) / jobs.threadCount();
+		auto testTiles = [&](uint32_t begin, uint32_t end) {
+			for (uint32_t t = begin; t < end; t++) {
+				Tile& tile = tiles[t];
+				tile.MovingInside = false;
+				if (!tile.Size) {
+					continue;
+				}
+				for (uint32_t caster : movingCasters) {
+					const glm::vec4& sphere = casterSpheres[caster];
+					if (sphereInFrustum(tile.Bounds, glm::vec3(sphere), sphere.w)) {
+						tile.MovingInside = true;
+						break;
+					}
+				}
+				for (const glm::vec4& sphere : toggledSpheres) {
+					if (sphereInFrustum(tile.Bounds, glm::vec3(sphere), sphere.w)) {
+						tile.Stale = true;
+						tile.StaticValid = false;
+						break;
+					}
+				}
+			}
+		};
+		jobs.parallelFor(tested, SHADOW_ATLAS_TILES, grain, testTiles);
+		jobs.wait(tested);
+
+		// stalest first, tiles that have never been drawn before anything else
+		std::vector<uint32_t> due;
+		for (uint32_t t = 0; t < SHADOW_ATLAS_TILES; t++) {
+			const Tile& tile = tiles[t];
+			if (tile.Size && (!tile.Rendered || tile.Stale || tile.MovingInside || tile.HadMoving || tile.ViewProjection != tile.RenderedViewProjection)) {
+				due.push_back(t);
+			}
+		}
+		std::sort(due.begin(), due.end(), [this](uint32_t a, uint32_t b) {
+			if (tiles[a].Rendered != tiles[b].Rendered) {
+				return !tiles[a].Rendered;
+			}
+			return tiles[a].LastRefresh != tiles[b].LastRefresh ? tiles[a].LastRefresh < tiles[b].LastRefresh : a < b;
+		});
+		if (due.size() > SHADOW_ATLAS_UPDATE_BUDGET) {
+			due.resize(SHADOW_ATLAS_UPDATE_BUDGET);
+		}
+		if (due.empty()) {
+			return;
+		}
+
+		commands.callback(&ShadowAtlas::beginPassCommand, this);
+		commands.useProgram(program);
+		uint32_t boundMesh = ~0u;
+		// which: 0 every caster, 1 static ones, 2 moving ones
+		auto gatherCasters = [&](const Tile& tile, int which) {
+			tileCasters.clear();
+			for (uint32_t i = 0; i < (uint32_t)casters.size(); i++) {
+				if ((which == 1 && !casterStatic[i]) || (which == 2 && casterStatic[i])) {
+					continue;
+				}
+				const glm::vec4& sphere = casterSpheres[i];
+				if (sphereInFrustum(tile.Bounds, glm::vec3(sphere), sphere.w)) {
+					tileCasters.push_back(i);
+				}
+			}
+		};
+		auto drawCasters = [&](const Tile& tile) {
+			for (uint32_t i : tileCasters) {
+				const Mesh& mesh = meshes[casters[i].Mesh];
+				if (casters[i].Mesh != boundMesh) {
+					commands.bindVertexArray(mesh.VAO);
+					boundMesh = casters[i].Mesh;
+				}
+				commands.setMat4(mvpLocation, tile.ViewProjection * world[casters[i].Slot]);
+				recordDrawMesh(commands, mesh, casters[i].Lod);
+			}
+		};
+
+		for (uint32_t t : due) {
+			Tile& tile = tiles[t];
+			uint64_t rectangle = ((uint64_t)tile.X << 32) | ((uint64_t)tile.Y << 16) | (uint64_t)tile.Size;
+			bool lightMoving = tile.ViewProjection != tile.PreviousViewProjection;
+			if (lightMoving) {
+				// the light itself is moving, a static copy would be out of date by the next frame
+				tile.StaticValid = false;
+				gatherCasters(tile, 0);
+				commands.callback(&ShadowAtlas::clearTileCommand, this, rectangle);
+				drawCasters(tile);
+			}
+			else {
+				if (!tile.StaticValid || tile.StaticViewProjection != tile.ViewProjection) {
+					gatherCasters(tile, 1);
+					tile.StaticEmpty = tileCasters.empty();
+					if (!tile.StaticEmpty) {
+						commands.callback(&ShadowAtlas::clearTileCommand, this, rectangle | STATIC_COPY);
+						drawCasters(tile);
+					}
+					tile.StaticValid = true;
+					tile.StaticViewProjection = tile.ViewProjection;
+				}
+				// with nothing static in view a clear does what the copy would
+				commands.callback(tile.StaticEmpty ? &ShadowAtlas::clearTileCommand : &ShadowAtlas::copyTileCommand, this, rectangle);
+				gatherCasters(tile, 2);
+				drawCasters(tile);
+			}
+
+			tile.Rendered = true;
+			tile.HadMoving = tile.MovingInside;
+			tile.Stale = false;
+			tile.LastRefresh = frame;
+			tile.RenderedViewProjection = tile.ViewProjection;
+			tile.RenderedLookup = tileLookup(tile);
+			tile.RenderedPosition = tile.Position;
+			tile.RenderedOffsetScale = tile.OffsetScale;
+			tile.RenderedFace = tile.Face;
+			tile.RenderedDepth = tile.Depth;
+		}
+		commands.callback(&ShadowAtlas::endPassCommand, this);
+		refreshed = (unsigned int)due.size();
+	}
+
+	// a light is only shadowed once every face it needs has been drawn
+	void uploadBlock(CommandBuffer& commands) {
+		std::memset(&block, 0, sizeof(block));
+		for (unsigned int i = 0; i < pointLightCount; i++) {
+			bool ready = true;
+			for (unsigned int face = 0; face < 6; face++) {
+				const Tile& tile = tiles[i * 6 + face];
+				ready = ready && tile.Size && tile.Rendered;
+				block.PointFaces[i * 6 + face] = tile.RenderedFace;
+			}
+			if (ready) {
+				block.PointLights[i] = glm::vec4(tiles[i * 6].RenderedPosition, tiles[i * 6].RenderedOffsetScale);
+				block.PointDepths[i] = glm::vec4(tiles[i * 6].RenderedDepth, 0.0f, 0.0f);
+				shadowed++;
+			}
+		}
+		const Tile& spot = tiles[SHADOW_ATLAS_TILES - 1];
+		if (spotActive && spot.Size && spot.Rendered) {
+			block.Spot = spot.RenderedLookup;
+			block.SpotLight = glm::vec4(spot.RenderedPosition, spot.RenderedOffsetScale);
+			shadowed++;
+		}
+
+		if (std::memcmp(&block, &uploaded, sizeof(block)) != 0) {
+			commands.bufferSubData(GL_UNIFORM_BUFFER, UniformBuffer, &block, sizeof(block));
+			uploaded = block;
+		}
+	}
+
+	static const uint64_t STATIC_COPY = 1ull << 48;
+
+	static void beginPassCommand(void* user, uint64_t) {
+		// slope scaled bias pushes casters away from the light, which is towards 0 with reversed depth
+		float sign = static_cast<ShadowAtlas*>(user)->reversed ? -1.0f : 1.0f;
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.0f * sign, 1.0f * sign);
+	}
+
+	static void endPassCommand(void*, uint64_t) {
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+
+	// binds the atlas or its static copy and clears the tile, draws that follow land in the tile
+	static void clearTileCommand(void* user, uint64_t rectangle) {
+		ShadowAtlas* atlas = static_cast<ShadowAtlas*>(user);
+		GLint x = (GLint)((rectangle >> 32) & 0xFFFF), y = (GLint)((rectangle >> 16) & 0xFFFF), size = (GLint)(rectangle & 0xFFFF);
+		glBindFramebuffer(GL_FRAMEBUFFER, atlas->framebuffers[(rectangle & STATIC_COPY) ? 1 : 0]);
+		glViewport(x, y, size, size);
+		glScissor(x, y, size, size);
+		glEnable(GL_SCISSOR_TEST);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+	}
+
+	// starts the tile from its static copy, moving casters are drawn on top
+	static void copyTileCommand(void* user, uint64_t rectangle) {
+		ShadowAtlas* atlas = static_cast<ShadowAtlas*>(user);
+		GLint x = (GLint)((rectangle >> 32) & 0xFFFF), y = (GLint)((rectangle >> 16) & 0xFFFF), size = (GLint)(rectangle & 0xFFFF);
+		glCopyImageSubData(atlas->staticTexture, GL_TEXTURE_2D, 0, x, y, 0, atlas->Texture, GL_TEXTURE_2D, 0, x, y, 0, size, size, 1);
+		glBindFramebuffer(GL_FRAMEBUFFER, atlas->framebuffers[0]);
+		glViewport(x, y, size, size);
+	}
+};
+
+#endif
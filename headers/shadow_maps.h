@@ -0,0 +1,236 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "camera.h"
+#include "command_buffer.h"
+#include "culling.h"
+#include "render_stats.h"
+#include "render_target.h"
+#include "shader.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// must match SHADOW_CASCADES in the shadow and lit shaders
+const unsigned int SHADOW_CASCADE_COUNT = 4;
+const int SHADOW_MAP_SIZE = 1024;
+const float SHADOW_DISTANCE = 60.0f;        // view distance the last cascade reaches, nothing further is shadowed
+const float SHADOW_SPLIT_LAMBDA = 0.75f;    // 0 splits the distance evenly, 1 logarithmically
+
+// GPU profiler pass names of the cascades when they are rendered one by one
+const char* const SHADOW_CASCADE_NAMES[SHADOW_CASCADE_COUNT] = { "cascade 0", "cascade 1", "cascade 2", "cascade 3" };
+
+enum shadowMode {
+	SHADOWS_OFF,
+	SHADOWS_LAYERED,   // every caster drawn once, a geometry shader writes it into each cascade it touches
+	SHADOWS_SPLIT,     // one pass per cascade, slower but the GPU profiler times every cascade
+	SHADOW_MODE_COUNT
+};
+
+inline const char* shadowModeName(shadowMode mode) {
+	static const char* names[SHADOW_MODE_COUNT] = { "off", "layered", "split" };
+	return names[mode];
+}
+
+inline bool parseShadowMode(const std::string& name, shadowMode& mode) {
+	for (unsigned int i = 0; i < SHADOW_MODE_COUNT; i++) {
+		if (name == shadowModeName((shadowMode)i)) {
+			mode = (shadowMode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+struct ShadowCascade {
+	glm::mat4 ViewProjection;  // world to light clip space, what the shadow pass renders with
+	glm::mat4 Lookup;          // world to shadow map coordinates and reference depth, for the lit shaders
+	Frustum Bounds;            // everything inside may cast into the cascade
+	float SplitDistance;       // view depth where the next cascade takes over
+	float TexelSize;           // world units covered by one shadow map texel
+};
+
+// view depth where each cascade ends, blending logarithmic and uniform splits (the practical split scheme)
+inline void computeCascadeSplits(float nearPlane, float farPlane, float lambda, float* splits) {
+	for (unsigned int i = 1; i <= SHADOW_CASCADE_COUNT; i++) {
+		float fraction = (float)i / SHADOW_CASCADE_COUNT;
+		float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+		splits[i - 1] = lambda * logarithmic + (1.0f - lambda) * uniform;
+	}
+}
+
+// Fits every cascade around its slice of the camera frustum. Each slice is enclosed in the smallest
+// sphere that holds it, which only depends on the split distances and the field of view, so the
+// cascade keeps its size while the camera turns; its centre is then snapped to whole shadow map
+// texels in light space, so moving the camera never shifts the rasterised shadow edges by a fraction
+// of a texel. The depth range is fitted to casterMin/casterMax, the bounds of everything that casts,
+// so casters between the light and the slice are kept without wasting precision.
+inline void fitShadowCascades(Camera& camera, const glm::vec3& lightDirection, const glm::vec3& casterMin, const glm::vec3& casterMax,
+	depthMode mode, ShadowCascade* cascades) {
+	float splits[SHADOW_CASCADE_COUNT];
+	computeCascadeSplits(camera.getNearPlane(), SHADOW_DISTANCE, SHADOW_SPLIT_LAMBDA, splits);
+
+	// light space only rotates, every cascade shares it so snapping happens on the same grid
+	glm::vec3 direction = glm::normalize(lightDirection);
+	glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+	// view depth of every caster bound corner, the light looks down -z
+	float casterNear = 1e30f;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 point((corner & 1) ? casterMax.x : casterMin.x, (corner & 2) ? casterMax.y : casterMin.y, (corner & 4) ? casterMax.z : casterMin.z);
+		casterNear = glm::min(casterNear, -(lightView * glm::vec4(point, 1.0f)).z);
+	}
+
+	// squared distance of a frustum corner from the view axis, per unit of view depth
+	float tanHalfFov = std::tan(glm::radians(camera.getFov()) * 0.5f);
+	float spread = tanHalfFov * tanHalfFov * (1.0f + camera.getAspect() * camera.getAspect());
+	glm::vec3 eye = camera.getPosition();
+	glm::vec3 front = camera.getFront();
+
+	float sliceNear = camera.getNearPlane();
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+		float sliceFar = splits[i];
+		// the point on the view axis equally far from the near and far corners of the slice
+		float centerDepth = glm::min(0.5f * (sliceNear + sliceFar) * (1.0f + spread), sliceFar);
+		float radius = std::sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) + spread * sliceFar * sliceFar);
+		// rounding keeps the texel size from jittering with floating point noise
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+		float texelSize = 2.0f * radius / SHADOW_MAP_SIZE;
+
+		glm::vec3 center = glm::vec3(lightView * glm::vec4(eye + front * centerDepth, 1.0f));
+		center.x = std::floor(center.x / texelSize) * texelSize;
+		center.y = std::floor(center.y / texelSize) * texelSize;
+
+		float nearDepth = glm::min(casterNear, -center.z - radius);
+		float farDepth = -center.z + radius;
+
+		glm::mat4 projection;
+		glm::mat4 bias(1.0f);
+		if (mode == DEPTH_REVERSED) {
+			// swapping near and far keeps the reversed convention, closer to the light is larger
+			projection = glm::orthoRH_ZO(center.x - radius, center.x + radius, center.y - radius, center.y + radius, farDepth, nearDepth);
+			bias[0][0] = bias[1][1] = 0.5f;
+			bias[3] = glm::vec4(0.5f, 0.5f, 0.0f, 1.0f);
+		}
+		else {
+			projection = glm::orthoRH_NO(center.x - radius, center.x + radius, center.y - radius, center.y + radius, nearDepth, farDepth);
+			bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+		}
+
+		ShadowCascade& cascade = cascades[i];
+		cascade.ViewProjection = projection * lightView;
+		cascade.Lookup = bias * cascade.ViewProjection;
+		cascade.Bounds = extractFrustum(cascade.ViewProjection, mode == DEPTH_REVERSED);
+		cascade.SplitDistance = sliceFar;
+		cascade.TexelSize = texelSize;
+		sliceNear = sliceFar;
+	}
+}
+
+// uniform locations of the shadow pass program
+struct ShadowPassUniforms {
+	GLuint Program;
+	GLint Model, CascadeMask;
+	GLint Cascades[SHADOW_CASCADE_COUNT];
+};
+
+inline ShadowPassUniforms resolveShadowPassUniforms(const Shader& shader) {
+	ShadowPassUniforms uniforms;
+	uniforms.Program = shader.ID;
+	uniforms.Model = shader.uniformLocation("model");
+	uniforms.CascadeMask = shader.uniformLocation("cascadeMask");
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+		uniforms.Cascades[i] = shader.uniformLocation("cascadeMatrices[" + std::to_string(i) + "]");
+	}
+	return uniforms;
+}
+
+// Depth texture array with one layer per cascade, attached layered so a single pass can write all
+// of them. Sampled with hardware depth comparison, which also gives 2x2 PCF through linear filtering.
+class ShadowMaps {
+public:
+	GLuint Framebuffer = 0;
+	GLuint DepthTexture = 0;
+
+	ShadowMaps() = default;
+	ShadowMaps(const ShadowMaps&) = delete;
+	ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+	bool create(depthMode mode) {
+		reversed = mode == DEPTH_REVERSED;
+
+		glGenTextures(1, &DepthTexture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, DepthTexture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADE_COUNT, 0,
+			GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		// lit when the fragment is at least as close to the light as the nearest caster
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, reversed ? GL_GEQUAL : GL_LEQUAL);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		trackGpuMemory((int64_t)SHADOW_MAP_SIZE * SHADOW_MAP_SIZE * SHADOW_CASCADE_COUNT * 4);
+
+		glGenFramebuffers(1, &Framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, DepthTexture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::SHADOW_MAPS::FRAMEBUFFER_INCOMPLETE " << status << std::endl;
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	void destroy() {
+		if (!DepthTexture) {
+			return;
+		}
+		glDeleteFramebuffers(1, &Framebuffer);
+		glDeleteTextures(1, &DepthTexture);
+		trackGpuMemory(-(int64_t)SHADOW_MAP_SIZE * SHADOW_MAP_SIZE * SHADOW_CASCADE_COUNT * 4);
+		Framebuffer = DepthTexture = 0;
+	}
+
+	// binds and clears every layer and turns on the depth bias, the pass draws after this
+	void recordBeginPass(CommandBuffer& commands) {
+		commands.callback(&ShadowMaps::beginPassCommand, this);
+	}
+
+	void recordEndPass(CommandBuffer& commands) {
+		commands.callback(&ShadowMaps::endPassCommand, this);
+	}
+
+private:
+	bool reversed = true;
+
+	static void beginPassCommand(void* user, uint64_t) {
+		ShadowMaps* maps = static_cast<ShadowMaps*>(user);
+		glBindFramebuffer(GL_FRAMEBUFFER, maps->Framebuffer);
+		glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		// slope scaled bias pushes casters away from the light, which is towards 0 with reversed depth
+		float sign = maps->reversed ? -1.0f : 1.0f;
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.0f * sign, 1.0f * sign);
+	}
+
+	static void endPassCommand(void*, uint64_t) {
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+};
+
+#endif
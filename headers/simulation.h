@@ -0,0 +1,172 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include "batch_transform.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Single-producer single-consumer triple buffer. The writer always has a private slot to fill,
+// the reader always owns the slot it is looking at, and publishing or picking up the latest
+// value is a single atomic exchange, so neither side ever waits for the other.
+template <typename T>
+class TripleBuffer {
+public:
+	// writer side: the slot to fill before calling publish
+	T& back() {
+		return slots[backIndex];
+	}
+
+	void publish() {
+		backIndex = latest.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// reader side: swaps in the newest published slot if there is one
+	const T& front() {
+		if (latest.load(std::memory_order_relaxed) & FRESH) {
+			frontIndex = latest.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		}
+		return slots[frontIndex];
+	}
+
+private:
+	static const uint32_t FRESH = 4;
+	static const uint32_t INDEX_MASK = 3;
+
+	T slots[3];
+	uint32_t backIndex = 0;
+	uint32_t frontIndex = 1;
+	std::atomic<uint32_t> latest{ 2 };
+};
+
+// everything the renderer needs from one simulation tick
+struct SimulationState {
+	double Time = 0.0;
+	glm::vec3 CameraPosition = glm::vec3(0.0f);
+	std::vector<glm::mat4> World;   // scene graph world matrices, indexed by slot
+	TransformArrays Transforms;     // the same split into translation, rotation and scale for interpolation
+};
+
+// the two most recent ticks, so the renderer can interpolate between them
+struct SimulationSnapshot {
+	uint64_t Tick = 0;
+	SimulationState Previous;
+	SimulationState Current;
+};
+
+// Fixed-timestep simulation. Every tick calls the step function with a constant dt and publishes
+// the result; rendering reads the latest pair of ticks lock-free and interpolates between them.
+// It can run on its own thread (start/stop) or be advanced explicitly for deterministic runs.
+class Simulation {
+public:
+	// step(state, time, dt) advances the world by dt and fills state with the result for time
+	typedef std::function<void(SimulationState& state, double time, double dt)> StepFunction;
+	// called on the simulation thread before the first tick, e.g. to register with a job system
+	typedef std::function<void()> ThreadInit;
+
+	double TickLength;
+	unsigned int MaxTicksPerUpdate;     // caps how far the simulation tries to catch up after a stall
+
+	Simulation(StepFunction step, double tickRate = 60.0, unsigned int maxTicksPerUpdate = 5)
+		: TickLength(1.0 / tickRate), MaxTicksPerUpdate(maxTicksPerUpdate), step(step) {
+	}
+
+	~Simulation() {
+		stop();
+	}
+
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	void start(ThreadInit init = ThreadInit()) {
+		startTime = std::chrono::steady_clock::now();
+		running = true;
+		worker = std::thread([this, init]() {
+			if (init) {
+				init();
+			}
+			while (running.load(std::memory_order_relaxed)) {
+				advanceTo(elapsed());
+
+				double wait = nextTick - elapsed();
+				if (wait > 0.0) {
+					std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+				}
+			}
+		});
+	}
+
+	void stop() {
+		running = false;
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+
+	// runs every tick due up to time; when more than MaxTicksPerUpdate are due the backlog
+	// is dropped so a slow frame does not turn into a spiral of ever longer catch-ups
+	void advanceTo(double time) {
+		unsigned int ticks = 0;
+		while (nextTick <= time && ticks < MaxTicksPerUpdate) {
+			tick();
+			ticks++;
+		}
+		if (nextTick <= time) {
+			nextTick = time + TickLength;
+		}
+	}
+
+	// seconds on the simulation clock, shared by both threads
+	double elapsed() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// render side: the latest published pair of ticks
+	const SimulationSnapshot& latest() {
+		return snapshots.front();
+	}
+
+	// how far between Previous and Current to render at the given time. rendering trails
+	// the simulation by one tick, so there is always a newer state to blend towards
+	float interpolationAlpha(const SimulationSnapshot& snapshot, double time) const {
+		float alpha = (float)((time - snapshot.Current.Time) / TickLength);
+		return alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+	}
+
+private:
+	StepFunction step;
+	TripleBuffer<SimulationSnapshot> snapshots;
+	SimulationState previous;
+	SimulationState current;
+	uint64_t tickCount = 0;
+	double nextTick = 0.0;
+
+	std::thread worker;
+	std::atomic<bool> running{ false };
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	void tick() {
+		std::swap(previous, current);
+		step(current, nextTick, TickLength);
+		current.Time = nextTick;
+		if (tickCount == 0) {
+			previous = current;
+		}
+		tickCount++;
+		nextTick += TickLength;
+
+		SimulationSnapshot& snapshot = snapshots.back();
+		snapshot.Tick = tickCount;
+		snapshot.Previous = previous;
+		snapshot.Current = current;
+		snapshots.publish();
+	}
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef STATS_OVERLAY_H
+#define STATS_OVERLAY_H
+
+#include "command_buffer.h"
+#include "render_stats.h"
+#include "shader.h"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 5x7 glyphs in 6x8 cells, one byte per row with the leftmost pixel in bit 4
+struct OverlayGlyph {
+	char Character;
+	unsigned char Rows[7];
+};
+
+const OverlayGlyph OVERLAY_GLYPHS[] = {
+	{ '?', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 } },     // stands in for anything not listed
+	{ ' ', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+	{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+	{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+	{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+	{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+	{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+	{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+	{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+	{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+	{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+	{ 'A', { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 } },
+	{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+	{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+	{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+	{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+	{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+	{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+	{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+	{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+	{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+	{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+	{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+	{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+	{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+	{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+	{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+	{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+	{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+	{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+	{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+	{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+	{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+	{ 'Y', { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 } },
+	{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+	{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+	{ ',', { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 } },
+	{ ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+	{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+	{ '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+	{ '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+	{ ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+	{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+	{ '+', { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 } },
+	{ '=', { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 } },
+	{ '_', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F } },
+	{ '|', { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } }
+};
+
+const unsigned int OVERLAY_GLYPH_COUNT = sizeof(OVERLAY_GLYPHS) / sizeof(OVERLAY_GLYPHS[0]);
+const int OVERLAY_CELL_WIDTH = 6;
+const int OVERLAY_CELL_HEIGHT = 8;
+const int OVERLAY_SCALE = 2;            // screen pixels per font pixel
+const int OVERLAY_MARGIN = 8;
+const unsigned int OVERLAY_SLOTS = 2;   // one vertex copy per RenderThread command buffer
+
+struct OverlayVertex {
+	float X, Y;         // pixels from the top left corner
+	float U, V;
+	uint32_t Color;     // RGBA8
+};
+
+// Text overlay with frame statistics. The text only changes when the StatsRecorder publishes a new
+// summary; it is laid out into quads on the main thread and the whole overlay, background included,
+// goes out as a single draw call on the render thread. The overlay's own draw is not counted.
+class StatsOverlay {
+public:
+	StatsOverlay() = default;
+	StatsOverlay(const StatsOverlay&) = delete;
+	StatsOverlay& operator=(const StatsOverlay&) = delete;
+
+	~StatsOverlay() {
+		delete shader;
+	}
+
+	// GL thread
+	void create() {
+		shader = new Shader("./shaders/overlay/overlay-vs.glsl", "./shaders/overlay/overlay-fs.glsl");
+		screenSize = shader->uniformLocation("screenSize");
+		shader->use();
+		shader->setInt("font", 0);
+		createFont();
+
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, X));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, U));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, Color));
+		glEnableVertexAttribArray(2);
+		glBindVertexArray(0);
+	}
+
+	// GL thread
+	void destroy() {
+		if (!vertexArray) {
+			return;
+		}
+		glDeleteVertexArrays(1, &vertexArray);
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteTextures(1, &fontTexture);
+		trackGpuMemory(-(int64_t)(fontWidth * OVERLAY_CELL_HEIGHT + bufferCapacity));
+		glDeleteProgram(shader->ID);
+		vertexArray = 0;
+	}
+
+	// main thread: lays out the statistics again whenever the recorder has a new summary
+	void update(const StatsRecorder& stats) {
+		if (stats.overlayReportVersion() == reportVersion) {
+			return;
+		}
+		reportVersion = stats.overlayReportVersion();
+		layout(formatReport(stats.overlayReport()));
+	}
+
+	// main thread: draws the overlay over whatever the frame has drawn so far
+	void record(CommandBuffer& commands, uint64_t frame) {
+		if (vertices.empty()) {
+			return;
+		}
+		// the render thread may still be reading the other slot, see OVERLAY_SLOTS
+		unsigned int index = (unsigned int)(frame % OVERLAY_SLOTS);
+		if (slots[index].Version != verticesVersion) {
+			slots[index].Vertices = vertices;
+			slots[index].Version = verticesVersion;
+		}
+		commands.callback(&StatsOverlay::drawCommand, this, index);
+	}
+
+	// the overlay text of a summary, one string per line
+	static std::vector<std::string> formatReport(const StatsReport& report) {
+		const double MB = 1024.0 * 1024.0;
+		double fps = report.CpuTime.Mean > 0.0 ? 1000.0 / report.CpuTime.Mean : 0.0;
+		char line[128];
+		std::vector<std::string> lines;
+
+		std::snprintf(line, sizeof(line), "FPS %.1f  CPU %.2f MS  P99 %.2f", fps, report.CpuTime.Mean, report.CpuTime.P99);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "GPU %.2f MS  P99 %.2f  SCALE %.2f", report.GpuTime.Mean, report.GpuTime.P99, report.RenderScale);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "DRAWS %.0f  DISPATCHES %.0f", report.Counters[COUNTER_DRAW_CALLS], report.Counters[COUNTER_DISPATCHES]);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "TRIS %.0f  WITHOUT LOD %.0f", report.Counters[COUNTER_TRIANGLES], report.Counters[COUNTER_FULL_DETAIL_TRIANGLES]);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "UNIFORMS %.0f  STATE %.0f (PROG %.0f TEX %.0f VAO %.0f)", report.Counters[COUNTER_UNIFORM_UPLOADS],
+			report.StateChanges, report.Counters[COUNTER_PROGRAM_BINDS], report.Counters[COUNTER_TEXTURE_BINDS], report.Counters[COUNTER_VERTEX_ARRAY_BINDS]);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "TEX UPLOADS %.1f (%.2f MB)", report.Counters[COUNTER_TEXTURE_UPLOADS], report.Counters[COUNTER_TEXTURE_UPLOAD_BYTES] / MB);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "COMMANDS %.0f (%.1f KB)", report.Commands, report.CommandBytes / 1024.0);
+		lines.push_back(line);
+		std::snprintf(line, sizeof(line), "GPU MEM %.1f MB  RSS %.1f MB", report.GpuMemory / MB, report.ProcessMemory / MB);
+		lines.push_back(line);
+		return lines;
+	}
+
+private:
+	struct Slot {
+		std::vector<OverlayVertex> Vertices;
+		uint64_t Version = 0;
+	};
+
+	Shader* shader = nullptr;
+	GLint screenSize = -1;
+	GLuint fontTexture = 0;
+	int fontWidth = 0;
+	GLuint vertexArray = 0;
+	GLuint vertexBuffer = 0;
+
+	// main thread
+	uint64_t reportVersion = 0;
+	std::vector<OverlayVertex> vertices;
+	uint64_t verticesVersion = 0;
+	Slot slots[OVERLAY_SLOTS];
+
+	// render thread
+	uint64_t uploadedVersion = 0;
+	size_t bufferCapacity = 0;
+	GLsizei uploadedCount = 0;
+
+	// one row of glyph cells; the extra cell past the last glyph is solid and used for the background
+	void createFont() {
+		fontWidth = (OVERLAY_GLYPH_COUNT + 1) * OVERLAY_CELL_WIDTH;
+		std::vector<unsigned char> pixels((size_t)fontWidth * OVERLAY_CELL_HEIGHT, 0);
+		for (unsigned int glyph = 0; glyph < OVERLAY_GLYPH_COUNT; glyph++) {
+			for (int y = 0; y < 7; y++) {
+				for (int x = 0; x < 5; x++) {
+					if (OVERLAY_GLYPHS[glyph].Rows[y] & (0x10 >> x)) {
+						pixels[(size_t)y * fontWidth + glyph * OVERLAY_CELL_WIDTH + x] = 255;
+					}
+				}
+			}
+		}
+		for (int y = 0; y < OVERLAY_CELL_HEIGHT; y++) {
+			for (int x = 0; x < OVERLAY_CELL_WIDTH; x++) {
+				pixels[(size_t)y * fontWidth + OVERLAY_GLYPH_COUNT * OVERLAY_CELL_WIDTH + x] = 255;
+			}
+		}
+
+		glGenTextures(1, &fontTexture);
+		glBindTexture(GL_TEXTURE_2D, fontTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, fontWidth, OVERLAY_CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		countImmediate(COUNTER_TEXTURE_UPLOADS);
+		countImmediate(COUNTER_TEXTURE_UPLOAD_BYTES, pixels.size());
+		trackGpuMemory((int64_t)pixels.size());
+	}
+
+	static unsigned int glyphIndex(char character) {
+		if (character >= 'a' && character <= 'z') {
+			character = (char)(character - 'a' + 'A');
+		}
+		for (unsigned int i = 1; i < OVERLAY_GLYPH_COUNT; i++) {
+			if (OVERLAY_GLYPHS[i].Character == character) {
+				return i;
+			}
+		}
+		return 0;
+	}
+
+	// two triangles covering a cell of the font texture
+	void addQuad(float x, float y, float width, float height, unsigned int cell, float cellWidth, uint32_t color) {
+		float u0 = (float)(cell * OVERLAY_CELL_WIDTH) / fontWidth;
+		float u1 = (float)(cell * OVERLAY_CELL_WIDTH + cellWidth) / fontWidth;
+		OverlayVertex topLeft = { x, y, u0, 0.0f, color };
+		OverlayVertex topRight = { x + width, y, u1, 0.0f, color };
+		OverlayVertex bottomLeft = { x, y + height, u0, 1.0f, color };
+		OverlayVertex bottomRight = { x + width, y + height, u1, 1.0f, color };
+		vertices.insert(vertices.end(), { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight });
+	}
+
+	void layout(const std::vector<std::string>& lines) {
+		const uint32_t textColor = 0xFFFFFFFFu;
+		const uint32_t backgroundColor = 0xA0000000u;
+		const float cellWidth = (float)(OVERLAY_CELL_WIDTH * OVERLAY_SCALE);
+		const float cellHeight = (float)(OVERLAY_CELL_HEIGHT * OVERLAY_SCALE);
+
+		size_t columns = 0;
+		for (const std::string& line : lines) {
+			columns = line.size() > columns ? line.size() : columns;
+		}
+
+		vertices.clear();
+		float padding = (float)OVERLAY_SCALE * 2.0f;
+		addQuad(OVERLAY_MARGIN - padding, OVERLAY_MARGIN - padding, columns * cellWidth + padding * 2.0f,
+			lines.size() * cellHeight + padding * 2.0f, OVERLAY_GLYPH_COUNT, (float)OVERLAY_CELL_WIDTH, backgroundColor);
+		for (size_t row = 0; row < lines.size(); row++) {
+			for (size_t column = 0; column < lines[row].size(); column++) {
+				unsigned int glyph = glyphIndex(lines[row][column]);
+				if (glyph == 1) {
+					continue;
+				}
+				addQuad(OVERLAY_MARGIN + column * cellWidth, OVERLAY_MARGIN + row * cellHeight, cellWidth, cellHeight, glyph, (float)OVERLAY_CELL_WIDTH, textColor);
+			}
+		}
+		verticesVersion++;
+	}
+
+	static void drawCommand(void* user, uint64_t slot) {
+		static_cast<StatsOverlay*>(user)->draw(static_cast<StatsOverlay*>(user)->slots[slot]);
+	}
+
+	// render thread: uploads the slot if its text is newer than the buffer's, then draws it blended on top
+	void draw(const Slot& slot) {
+		glBindVertexArray(vertexArray);
+		if (slot.Version != uploadedVersion) {
+			size_t size = slot.Vertices.size() * sizeof(OverlayVertex);
+			glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+			if (size > bufferCapacity) {
+				glBufferData(GL_ARRAY_BUFFER, size, slot.Vertices.data(), GL_DYNAMIC_DRAW);
+				trackGpuMemory((int64_t)size - (int64_t)bufferCapacity);
+				bufferCapacity = size;
+			}
+			else {
+				glBufferSubData(GL_ARRAY_BUFFER, 0, size, slot.Vertices.data());
+			}
+			uploadedVersion = slot.Version;
+			uploadedCount = (GLsizei)slot.Vertices.size();
+		}
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glUseProgram(shader->ID);
+		glUniform2f(screenSize, (float)viewport[2], (float)viewport[3]);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, fontTexture);
+
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArrays(GL_TRIANGLES, 0, uploadedCount);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+	}
+};
+
+#endif
@@ -1,2 +1,5 @@
+// the CMake build compiles the implementation once into the assets library (stb_image.c)
+#ifndef ENGINE_STB_IMAGE_LIBRARY
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#endif
+#include "stb_image.h"
@@ -0,0 +1,174 @@
+#ifndef TEMPORAL_AA_H
+#define TEMPORAL_AA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "command_buffer.h"
+#include "gpu_profiler.h"
+#include "render_stats.h"
+#include "render_target.h"
+#include "shader.h"
+
+#include <cstdint>
+#include <string>
+
+const unsigned int TAA_SAMPLE_COUNT = 8;     // jitter positions before the sequence repeats
+const float TAA_FEEDBACK = 0.9f;             // share of the history kept every frame
+const unsigned int TAA_GROUP_SIZE = 8;       // the resolve runs in 8x8 groups
+
+// texture units of the resolve inputs, above the ones the post chain binds its sampler to
+const GLenum TAA_SCENE_UNIT = 6;
+const GLenum TAA_VELOCITY_UNIT = 7;
+const GLenum TAA_DEPTH_UNIT = 8;
+const GLenum TAA_HISTORY_UNIT = 9;
+
+// element of the Halton low discrepancy sequence, in [0, 1)
+inline float halton(uint32_t index, uint32_t base) {
+	float result = 0.0f;
+	float fraction = 1.0f;
+	while (index > 0) {
+		fraction /= (float)base;
+		result += fraction * (float)(index % base);
+		index /= base;
+	}
+	return result;
+}
+
+// Temporal anti-aliasing. The camera projection is shifted by a different sub-pixel offset every
+// frame, so over a few frames each pixel is sampled at several positions; the resolve keeps a
+// history of earlier frames and blends the new one into it. The scene target's velocity attachment
+// says where every pixel was in the previous frame, which lets the history follow moving objects
+// and the camera, and clamping it to the colours around the pixel rejects whatever became hidden
+// or changed. Two history textures are used in turn, one read while the other is written, and the
+// one written is what the post chain takes as the scene. Size changes are recorded like
+// RenderTarget's and drop the history.
+class TemporalAA {
+public:
+	TemporalAA() = default;
+	TemporalAA(const TemporalAA&) = delete;
+	TemporalAA& operator=(const TemporalAA&) = delete;
+
+	bool create(int width, int height, depthMode mode) {
+		resolveShader = new Shader(Shader::compute("./shaders/taa/resolve-cs.glsl", mode == DEPTH_REVERSED ? "#define REVERSED_DEPTH\n" : ""));
+		resolveShader->use();
+		resolveShader->setInt("scene", TAA_SCENE_UNIT);
+		resolveShader->setInt("velocity", TAA_VELOCITY_UNIT);
+		resolveShader->setInt("depth", TAA_DEPTH_UNIT);
+		resolveShader->setInt("history", TAA_HISTORY_UNIT);
+		resolveShader->setFloat("feedback", TAA_FEEDBACK);
+		glUseProgram(0);
+		uniforms.RenderSize = resolveShader->uniformLocation("renderSize");
+		uniforms.HistoryRegion = resolveShader->uniformLocation("historyRegion");
+		uniforms.HistoryValid = resolveShader->uniformLocation("historyValid");
+
+		glGenTextures(2, historyTextures);
+		for (GLuint texture : historyTextures) {
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		}
+		allocate(width, height);
+		recordedWidth = width;
+		recordedHeight = height;
+		historyValid = false;
+		return true;
+	}
+
+	void destroy() {
+		if (resolveShader) {
+			glDeleteProgram(resolveShader->ID);
+			delete resolveShader;
+			resolveShader = nullptr;
+		}
+		if (historyTextures[0]) {
+			glDeleteTextures(2, historyTextures);
+			trackGpuMemory(-allocatedBytes);
+			historyTextures[0] = historyTextures[1] = 0;
+			allocatedBytes = 0;
+		}
+	}
+
+	// projection offset for frame in normalized device coordinates, within one pixel of a
+	// renderWidth x renderHeight viewport and centred on it
+	static glm::vec2 jitter(uint64_t frame, int renderWidth, int renderHeight) {
+		uint32_t index = (uint32_t)(frame % TAA_SAMPLE_COUNT) + 1;
+		glm::vec2 offset(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+		return offset * glm::vec2(2.0f / (float)renderWidth, 2.0f / (float)renderHeight);
+	}
+
+	// main thread: resizes the history at this point of the frame if the scene size changed
+	void recordResize(CommandBuffer& commands, int width, int height) {
+		if (width == recordedWidth && height == recordedHeight) {
+			return;
+		}
+		recordedWidth = width;
+		recordedHeight = height;
+		historyValid = false;
+		commands.callback(&TemporalAA::resizeCallback, this, ((uint64_t)(uint32_t)width << 32) | (uint32_t)height);
+	}
+
+	// resolves the renderWidth x renderHeight corner of the scene target into the history and
+	// returns the texture holding the result, the same corner of it is filled
+	GLuint record(CommandBuffer& commands, GpuProfiler& profiler, const RenderTarget& scene, int renderWidth, int renderHeight) {
+		GLuint destination = historyTextures[current];
+		profiler.recordBegin(commands, "taa");
+		commands.useProgram(resolveShader->ID);
+		commands.bindTexture(GL_TEXTURE0 + TAA_SCENE_UNIT, GL_TEXTURE_2D, scene.ColorTexture);
+		commands.bindTexture(GL_TEXTURE0 + TAA_VELOCITY_UNIT, GL_TEXTURE_2D, scene.VelocityTexture);
+		commands.bindTexture(GL_TEXTURE0 + TAA_DEPTH_UNIT, GL_TEXTURE_2D, scene.DepthTexture);
+		commands.bindTexture(GL_TEXTURE0 + TAA_HISTORY_UNIT, GL_TEXTURE_2D, historyTextures[1 - current]);
+		commands.setVec2(uniforms.RenderSize, glm::vec2(renderWidth, renderHeight));
+		commands.setVec2(uniforms.HistoryRegion, historyRegion);
+		commands.setInt(uniforms.HistoryValid, historyValid ? 1 : 0);
+		commands.bindImageTexture(0, destination, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+		commands.dispatchCompute((GLuint)((renderWidth + TAA_GROUP_SIZE - 1) / TAA_GROUP_SIZE),
+			(GLuint)((renderHeight + TAA_GROUP_SIZE - 1) / TAA_GROUP_SIZE));
+		commands.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		profiler.recordEnd(commands);
+
+		historyRegion = glm::vec2((float)renderWidth / (float)recordedWidth, (float)renderHeight / (float)recordedHeight);
+		historyValid = true;
+		current = 1 - current;
+		return destination;
+	}
+
+private:
+	struct Uniforms {
+		GLint RenderSize = -1;
+		GLint HistoryRegion = -1;
+		GLint HistoryValid = -1;
+	};
+
+	Shader* resolveShader = nullptr;
+	Uniforms uniforms;
+	GLuint historyTextures[2] = { 0, 0 };
+	unsigned int current = 0;      // history texture written next, main thread only
+	bool historyValid = false;
+	glm::vec2 historyRegion = glm::vec2(1.0f);   // part of the other history the last resolve filled
+	int recordedWidth = 0;
+	int recordedHeight = 0;
+	int64_t allocatedBytes = 0;
+
+	void allocate(int width, int height) {
+		width = width > 0 ? width : 1;
+		height = height > 0 ? height : 1;
+		for (GLuint texture : historyTextures) {
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		int64_t bytes = (int64_t)width * height * 4 * 2;
+		trackGpuMemory(bytes - allocatedBytes);
+		allocatedBytes = bytes;
+	}
+
+	static void resizeCallback(void* user, uint64_t size) {
+		static_cast<TemporalAA*>(user)->allocate((int)(size >> 32), (int)(size & 0xFFFFFFFFu));
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one complete ("X") event on a timeline track, times in microseconds since traceNow's epoch
+struct TraceEvent {
+	const char* Name;
+	const char* Category;
+	uint32_t Track;
+	double Start;
+	double Duration;
+};
+
+// track of GPU work in exported traces, CPU threads use traceThreadId
+const uint32_t TRACE_GPU_TRACK = 1000;
+
+// microseconds on a clock shared by every thread and by the GPU profiler's calibration
+inline double traceNow() {
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// small stable id for the calling thread, used as its track in traces
+inline uint32_t traceThreadId() {
+	static std::atomic<uint32_t> nextId{ 1 };
+	thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+	return id;
+}
+
+// text for inside a JSON string, quotes and backslashes escaped
+inline std::string jsonEscape(const char* text) {
+	std::string result;
+	for (; *text; text++) {
+		if (*text == '"' || *text == '\\') {
+			result += '\\';
+		}
+		result += *text;
+	}
+	return result;
+}
+
+// Collects events from any thread and writes them as Chrome trace event JSON, which loads in
+// chrome://tracing and ui.perfetto.dev. Either everything is written at the end with write, or the
+// file is opened up front and flush streams out what has been added so far, which keeps long runs
+// from piling up events in memory. Events beyond MaxEvents between two writes are dropped and counted.
+class TraceLog {
+public:
+	size_t MaxEvents;
+
+	explicit TraceLog(size_t maxEvents = 1000000) : MaxEvents(maxEvents) {
+	}
+
+	~TraceLog() {
+		close();
+	}
+
+	void add(const TraceEvent& event) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (events.size() >= MaxEvents) {
+			dropped++;
+			return;
+		}
+		events.push_back(event);
+	}
+
+	void nameTrack(uint32_t track, const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		trackNames[track] = name;
+		namesWritten = false;
+	}
+
+	// starts streaming to path
+	bool open(const std::string& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+		file.open(path);
+		if (!file.is_open()) {
+			std::cout << "ERROR::TRACE::FILE_NOT_SUCCESSFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		file.precision(3);
+		file << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		firstEvent = true;
+		return true;
+	}
+
+	// writes out and forgets the events added since the last flush
+	void flush() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!file.is_open()) {
+			return;
+		}
+		if (!namesWritten) {
+			// chrome accepts metadata anywhere in the stream, renamed tracks simply take the last name
+			for (const auto& track : trackNames) {
+				separate();
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track.first
+					<< ",\"args\":{\"name\":\"" << jsonEscape(track.second.c_str()) << "\"}}";
+			}
+			namesWritten = true;
+		}
+		for (const TraceEvent& event : events) {
+			separate();
+			file << "{\"name\":\"" << jsonEscape(event.Name) << "\",\"cat\":\"" << jsonEscape(event.Category)
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.Track << ",\"ts\":" << event.Start << ",\"dur\":" << event.Duration << "}";
+		}
+		events.clear();
+		file.flush();
+	}
+
+	void close() {
+		flush();
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!file.is_open()) {
+			return;
+		}
+		file << "\n]}\n";
+		file.close();
+		if (dropped > 0) {
+			std::cout << "trace: " << dropped << " events dropped, raise MaxEvents or flush more often to keep them" << std::endl;
+		}
+	}
+
+	// everything at once, for runs that did not open the file up front
+	bool write(const std::string& path) {
+		if (!open(path)) {
+			return false;
+		}
+		close();
+		return true;
+	}
+
+private:
+	std::mutex mutex;
+	std::vector<TraceEvent> events;
+	std::map<uint32_t, std::string> trackNames;
+	size_t dropped = 0;
+	std::ofstream file;
+	bool firstEvent = true;
+	bool namesWritten = false;
+
+	void separate() {
+		file << (firstEvent ? "" : ",\n");
+		firstEvent = false;
+	}
+};
+
+#endif
@@ -1,23 +1,132 @@
 #include <glad/glad.h>
+#ifndef ENGINE_NO_WINDOW
 #include <GLFW/glfw3.h>
+#endif
 
 #include "./headers/stb_image_imp.h"
 #include "./headers/shader.h"
 #include "./headers/camera.h"
-
+#include "./headers/scene_graph.h"
+#include "./headers/ecs.h"
+#include "./headers/components.h"
+#include "./headers/job_system.h"
+#include "./headers/culling.h"
+#include "./headers/simulation.h"
+#include "./headers/batch_transform.h"
+#include "./headers/lighting.h"
+#include "./headers/render_thread.h"
+#include "./headers/headless_context.h"
+#include "./headers/camera_path.h"
+#include "./headers/frame_stats.h"
+#include "./headers/frame_capture.h"
+#include "./headers/gpu_profiler.h"
+#include "./headers/trace.h"
+#include "./headers/profiler.h"
+#include "./headers/render_stats.h"
+#include "./headers/stats_overlay.h"
+#include "./headers/render_target.h"
+#include "./headers/shadow_maps.h"
+#include "./headers/shadow_atlas.h"
+#include "./headers/post_process.h"
+#include "./headers/dynamic_resolution.h"
+#include "./headers/temporal_aa.h"
+#include "./headers/coarse_shading.h"
+#include "./headers/mesh_import.h"
+#include "./headers/mesh_format.h"
+#include "./headers/mesh_streamer.h"
+#include "./headers/lod_selection.h"
+#include "./headers/cluster_culling.h"
+#include "./headers/bench_scenes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 // GLM
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-
+#include <glm/gtc/quaternion.hpp>
+
+// decoded image data waiting to be uploaded on the GL thread
+struct TextureData {
+    const char* Path = nullptr;
+    unsigned char* Pixels = nullptr;
+    int Width = 0;
+    int Height = 0;
+    int Components = 0;
+};
+
+// command line settings, see parseOptions
+struct EngineOptions {
+    bool Headless = false;
+    benchScene Scene = SCENE_DEFAULT;
+    unsigned int Frames = 600;
+    unsigned int WarmupFrames = 10;     // headless frames rendered before timing starts
+    int Width = 0;
+    int Height = 0;
+    const char* CameraPathFile = nullptr;
+    const char* RecordCameraPathFile = nullptr;   // windowed runs save the camera's flight here
+    const char* ReportFile = nullptr;             // headless frame time summary as JSON, read by engine_bench
+    const char* TraceFile = nullptr;        // chrome trace of the CPU scopes and the GPU passes
+    std::vector<uint64_t> CaptureFrames;   // sorted frame numbers to read back and write out
+    std::string CaptureDirectory = "captures";
+    bool CapturePng = true;
+    bool CapturePam = false;
+    const char* StatsFile = nullptr;        // per-interval metrics, CSV when it ends in .csv, JSON lines otherwise
+    unsigned int StatsInterval = STATS_EXPORT_FRAMES;
+    bool Overlay = false;
+    depthMode Depth = DEPTH_REVERSED;
+    shadowMode Shadows = SHADOWS_LAYERED;
+    bool LightShadows = true;   // point light and flashlight shadows from the atlas
+    bool Hdr = true;            // float scene colour and the post chain, off resolves LDR with a blit
+    uint32_t PostEffects = POST_ALL;
+    float FrameBudget = 0.0f;   // GPU ms per frame dynamic resolution aims for, 0 renders at full resolution
+    bool Taa = true;            // jittered projection and temporal resolve, needs the HDR post chain
+    coarseShadingRate CoarseShading = COARSE_SHADING_OFF;  // lighting rate of the materials that allow it
+    const char* ModelFile = nullptr;    // .mesh, OBJ, glTF or GLB model shown at the origin
+    float LodPixelError = LOD_PIXEL_ERROR;  // on screen error levels of detail may show, 0 draws full detail
+    bool ClusterCulling = true;         // meshlets of models that have them are culled on the GPU
+};
+
+#ifndef ENGINE_NO_WINDOW
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xPos, double yPos);
 void scroll_callback(GLFWwindow* window, double xOffset, double yOffset);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
-unsigned int loadTexture(const char* path);
+#endif
+bool parseOptions(int argc, char** argv, EngineOptions& options);
+void printHeadlessReport(const EngineOptions& options, const FrameStats& frameTimes, const FrameTimings& timings);
+void printGpuReport(GpuProfiler& profiler);
+bool writeReport(const EngineOptions& options, const StatSummary& cpuTime, const StatSummary& gpuTime);
+void writeCapture(const EngineOptions& options, const CapturedFrame& frame);
+TextureData decodeTexture(const char* path);
+unsigned int uploadTexture(TextureData& texture);
+
+// a single draw gathered from the Renderable components
+struct DrawItem {
+    uint32_t Material;
+    uint32_t Mesh;
+    uint32_t Slot;  // world, MVP and normal matrices of the frame are indexed by slot
+    bool Visible;
+    uint8_t ShadowCascades; // one bit per cascade the item casts a shadow into
+    uint8_t Lod;            // level of detail of the mesh to draw
+    uint32_t Clusters;      // first indirect command of its culled meshlets, CLUSTER_NONE draws the level whole
+};
+
+// input handed from the main thread to the simulation thread
+struct InputState {
+    uint32_t Movement = 0;  // one bit per cameraMovement
+    float Yaw = YAW;
+    float Pitch = PITCH;
+};
 
 // settings
 const GLuint SCREEN_WIDTH = 1280;
@@ -32,48 +141,167 @@ bool firstMouse = true;
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+bool showTimings = false;
+bool showOverlay = false;
+
+// framebuffer size, applied by the render thread through a viewport command
+int framebufferWidth = SCREEN_WIDTH;
+int framebufferHeight = SCREEN_HEIGHT;
 
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 bool flashlight = true;
 
-int main() {
+// simulation input, written once per frame by processInput
+TripleBuffer<InputState> inputMailbox;
 
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// timeline streamed out with --trace, global so it outlives the profiler's flusher
+TraceLog traceLog;
 
-    // glfw: window creation
-    GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+int main(int argc, char** argv) {
+
+    EngineOptions options;
+    if (!parseOptions(argc, argv, options)) {
         return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
+    framebufferWidth = options.Width;
+    framebufferHeight = options.Height;
+    showOverlay = options.Overlay;
+
+    // CPU scopes are streamed to the trace by a background flusher while the engine runs
+    PROFILE_THREAD("main");
+    if (options.TraceFile) {
+        if (!traceLog.open(options.TraceFile)) {
+            return -1;
+        }
+        profiler().start(traceLog);
+    }
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // worker threads for animation, transform updates, culling and asset decoding
+    JobSystem jobs;
+
+    // headless runs render into an offscreen framebuffer through EGL, no window or input involved
+    HeadlessContext headless;
+    GLADloadproc loadProc = NULL;
+    if (options.Headless) {
+        if (!headless.create(options.Width, options.Height)) {
+            std::cout << "Failed to create headless context" << std::endl;
+            return -1;
+        }
+        loadProc = (GLADloadproc)HeadlessContext::getProcAddress;
+    }
+#ifndef ENGINE_NO_WINDOW
+    GLFWwindow* window = NULL;
+    if (!options.Headless) {
+        // glfw: initialize and configure
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        // glfw: window creation
+        window = glfwCreateWindow(options.Width, options.Height, "OpenGL", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        loadProc = (GLADloadproc)glfwGetProcAddress;
+    }
+#endif
 
     // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    if (!gladLoadGLLoader(loadProc)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    if (options.Headless && !headless.createFramebuffer()) {
+        return -1;
+    }
 
-    // confiure global OpenGL state
-    glEnable(GL_DEPTH_TEST);
+    // frames picked with --capture are read back asynchronously and written out on the job system
+    FrameCapture capture;
+    bool capturing = !options.CaptureFrames.empty();
+    if (capturing) {
+        capture.create();
+        std::filesystem::create_directories(options.CaptureDirectory);
+    }
+
+    // GPU time of every pass, exported on the same timeline as the CPU scopes when --trace is set
+    GpuProfiler gpuProfiler;
+    gpuProfiler.create(options.TraceFile ? &traceLog : nullptr);
+
+    // per-frame counters and timings, shown by the overlay and exported with --stats
+    StatsRecorder stats;
+    if (options.StatsFile && !stats.openExport(options.StatsFile, options.StatsInterval)) {
+        return -1;
+    }
+    StatsOverlay overlay;
+    overlay.create();
+
+    // confiure global OpenGL state, reversed depth keeps precision out to an infinite far plane
+    if (!applyDepthMode(options.Depth)) {
+        return -1;
+    }
+    camera.setReversedDepth(options.Depth == DEPTH_REVERSED);
+
+    // the scene is drawn offscreen and resolved into the window or headless framebuffer, the
+    // overlay goes on top of the resolved image. with HDR the post chain does the resolve
+    RenderTarget sceneTarget;
+    if (!sceneTarget.create(framebufferWidth, framebufferHeight, options.Depth, options.Hdr ? GL_R11F_G11F_B10F : GL_RGBA8, options.Taa)) {
+        return -1;
+    }
+    // with TAA the scene also writes its velocity, and the temporal resolve feeds the post chain
+    TemporalAA temporalAA;
+    if (options.Taa && !temporalAA.create(framebufferWidth, framebufferHeight, options.Depth)) {
+        return -1;
+    }
+    GLuint outputFramebuffer = options.Headless ? headless.Framebuffer : 0;
+    PostProcess postProcess;
+    if (options.Hdr && !postProcess.create(framebufferWidth, framebufferHeight, options.PostEffects, options.FrameBudget > 0.0f)) {
+        return -1;
+    }
+
+    // point and spot lighting of the low detail materials at a lower rate
+    CoarseShading coarseShading;
+    if (options.CoarseShading != COARSE_SHADING_OFF && !coarseShading.create(framebufferWidth, framebufferHeight, options.CoarseShading, options.Depth)) {
+        return -1;
+    }
+
+    // the scene may be drawn into a smaller part of its target when the GPU falls behind the budget
+    DynamicResolution dynamicResolution;
+    dynamicResolution.configure(options.FrameBudget);
+    FrameStats renderScales;
+
+    // cascaded shadow maps for the directional light
+    ShadowMaps shadowMaps;
+    if (options.Shadows != SHADOWS_OFF && !shadowMaps.create(options.Depth)) {
+        return -1;
+    }
 
     // build and compile our shader program
-    Shader cubeShader("./shaders/cube/cube-vs.glsl", "./shaders/cube/cube-fs.glsl");
-    Shader lampShader("./shaders/lamp/lightCube-vs.glsl", "./shaders/lamp/lightCube-fs.glsl");
-    Shader pyramidShader("./shaders/pyramid/pyramid-vs.glsl", "./shaders/pyramid/pyramid-fs.glsl");
+    std::string velocityDefines = options.Taa ? "#define VELOCITY\n" : "";
+    std::string litDefines = (options.LightShadows ? "#define LIGHT_SHADOWS\n" : "") + velocityDefines;
+    Shader cubeShader("./shaders/cube/cube-vs.glsl", "./shaders/cube/cube-fs.glsl", nullptr, litDefines);
+    Shader lampShader("./shaders/lamp/lightCube-vs.glsl", "./shaders/lamp/lightCube-fs.glsl", nullptr, velocityDefines);
+    Shader pyramidShader("./shaders/pyramid/pyramid-vs.glsl", "./shaders/pyramid/pyramid-fs.glsl", nullptr, litDefines);
+    Shader shadowShader("./shaders/shadow/shadow-vs.glsl", "./shaders/shadow/shadow-fs.glsl", "./shaders/shadow/shadow-gs.glsl");
+    Shader atlasShader("./shaders/shadow/atlas-vs.glsl", "./shaders/shadow/shadow-fs.glsl");
+
+    // shadow maps of the point lights and the flashlight, cached between frames
+    ShadowAtlas shadowAtlas;
+    if (!shadowAtlas.create(options.Depth, options.LightShadows, atlasShader)) {
+        return -1;
+    }
 
     // set up vertex data
     GLfloat verticesCube[] = {
@@ -189,6 +417,7 @@ int main() {
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(verticesCube), verticesCube, GL_STATIC_DRAW);
+    trackGpuMemory(sizeof(verticesCube));
 
     glBindVertexArray(cubeVAO);
     
@@ -225,6 +454,7 @@ int main() {
 
     glBindBuffer(GL_ARRAY_BUFFER, pyramidVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(verticesPyramid), verticesPyramid, GL_STATIC_DRAW);
+    trackGpuMemory(sizeof(verticesPyramid));
 
     glBindVertexArray(pyramidVAO);
     
@@ -241,346 +471,1214 @@ int main() {
     glEnableVertexAttribArray(2);
     // ---------------------------------------------------------------------------------------------
 
-    // load the textures
-    unsigned int diffuseMap = loadTexture("./assets/textures/container.png");
-    unsigned int specularMap = loadTexture("./assets/textures/container_specular.png");
-    unsigned int diffuseMap2 = loadTexture("./assets/textures/wooden_box.png");
-    unsigned int pyramidMap = loadTexture("./assets/textures/pyramid.png");
+    // load the textures, decoding happens on the job system while GL uploads stay on this thread
+    TextureData textures[] = {
+        { "./assets/textures/container.png" },
+        { "./assets/textures/container_specular.png" },
+        { "./assets/textures/wooden_box.png" },
+        { "./assets/textures/pyramid.png" }
+    };
+    // parallelFor keeps a pointer to the body, which has to outlive the wait below
+    auto decodeTextures = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            textures[i] = decodeTexture(textures[i].Path);
+        }
+    };
+    JobCounter texturesDecoded;
+    jobs.parallelFor(texturesDecoded, 4, 1, decodeTextures);
+    // a model in the engine's format is only mapped, others are parsed and optimized meanwhile
+    MeshFile modelFile;
+    MeshData modelData;
+    bool modelNative = options.ModelFile && isMeshFilePath(options.ModelFile);
+    bool modelLoaded = false;
+    double modelMs = 0.0;
+    auto elapsedMs = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    JobCounter modelParsed;
+    if (modelNative) {
+        auto start = std::chrono::steady_clock::now();
+        modelLoaded = modelFile.open(options.ModelFile);
+        modelMs += elapsedMs(start);
+    }
+    else if (options.ModelFile) {
+        jobs.run(modelParsed, [&]() {
+            PROFILE_SCOPE("importMesh");
+            auto start = std::chrono::steady_clock::now();
+            modelLoaded = importMesh(options.ModelFile, modelData);
+            modelMs += elapsedMs(start);
+        });
+    }
+    jobs.wait(texturesDecoded);
+    jobs.wait(modelParsed);
+
+    unsigned int diffuseMap = uploadTexture(textures[0]);
+    unsigned int specularMap = uploadTexture(textures[1]);
+    unsigned int diffuseMap2 = uploadTexture(textures[2]);
+    unsigned int pyramidMap = uploadTexture(textures[3]);
 
     cubeShader.use();
     cubeShader.setInt("material.diffuse", 0);
     cubeShader.setInt("material.specular", 1);
+    cubeShader.setInt("shadowMap", 2);
+    cubeShader.setInt("shadowAtlas", 3);
 
     lampShader.use();
 
     pyramidShader.use();
     pyramidShader.setInt("material.diffuse", 0);
     pyramidShader.setInt("material.specular", 1);
+    pyramidShader.setInt("shadowMap", 2);
+    pyramidShader.setInt("shadowAtlas", 3);
+
+    ProgramUniforms cubeUniforms = resolveUniforms(cubeShader, "cube");
+    ProgramUniforms lampUniforms = resolveUniforms(lampShader, "lamp");
+    ProgramUniforms pyramidUniforms = resolveUniforms(pyramidShader, "pyramid");
+    ShadowPassUniforms shadowUniforms = resolveShadowPassUniforms(shadowShader);
+
+    // with coarse shading each lit shader is built twice more: to shade the lighting buffer and to
+    // read it back. the materials point into coarsePrograms, so it must never reallocate
+    std::vector<std::unique_ptr<Shader>> coarseShaders;
+    std::vector<ProgramUniforms> coarsePrograms;
+    coarsePrograms.reserve(4);
+    auto addCoarsePrograms = [&](const char* vertexPath, const char* fragmentPath, const char* passName, const char* name) {
+        std::string passDefines = options.LightShadows ? "#define LIGHT_SHADOWS\n#define COARSE_PASS\n" : "#define COARSE_PASS\n";
+        coarseShaders.emplace_back(new Shader(vertexPath, fragmentPath, nullptr, passDefines));
+        coarseShaders.back()->use();
+        coarseShaders.back()->setInt("shadowMap", 2);
+        coarseShaders.back()->setInt("shadowAtlas", 3);
+        coarsePrograms.push_back(resolveUniforms(*coarseShaders.back(), passName));
+
+        coarseShaders.emplace_back(new Shader(vertexPath, fragmentPath, nullptr, litDefines + "#define COARSE_LIGHTING\n"));
+        coarseShaders.back()->use();
+        coarseShaders.back()->setInt("material.diffuse", 0);
+        coarseShaders.back()->setInt("material.specular", 1);
+        coarseShaders.back()->setInt("shadowMap", 2);
+        coarseShaders.back()->setInt("shadowAtlas", 3);
+        coarseShaders.back()->setInt("coarseDiffuse", COARSE_DIFFUSE_UNIT);
+        coarseShaders.back()->setInt("coarseSpecular", COARSE_SPECULAR_UNIT);
+        coarseShaders.back()->setInt("coarseGeometry", COARSE_GEOMETRY_UNIT);
+        coarsePrograms.push_back(resolveUniforms(*coarseShaders.back(), name));
+    };
 
-    // render loop
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        processInput(window);
-
-        // render
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // cube lighting
-        // -----------------------------------------------------------------------------------
-        // activate shader
-        cubeShader.use();
-        cubeShader.setVec3("viewPos", camera.Position);
-        cubeShader.setFloat("material.shininess", 32.0f);
-
-        // directional light
-        cubeShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        cubeShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        cubeShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        cubeShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-        // point light 1
-        cubeShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        cubeShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        cubeShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        cubeShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        cubeShader.setFloat("pointLights[0].constant", 1.0f);
-        cubeShader.setFloat("pointLights[0].linear", 0.09f);
-        cubeShader.setFloat("pointLights[0].quadratic", 0.032f);
-
-        // point light 2
-        cubeShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        cubeShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        cubeShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        cubeShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        cubeShader.setFloat("pointLights[1].constant", 1.0f);
-        cubeShader.setFloat("pointLights[1].linear", 0.09f);
-        cubeShader.setFloat("pointLights[1].quadratic", 0.032f);
-
-        // point light 3
-        cubeShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        cubeShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        cubeShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        cubeShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        cubeShader.setFloat("pointLights[2].constant", 1.0f);
-        cubeShader.setFloat("pointLights[2].linear", 0.09f);
-        cubeShader.setFloat("pointLights[2].quadratic", 0.032f);
-
-        // point light 4
-        cubeShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        cubeShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        cubeShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        cubeShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        cubeShader.setFloat("pointLights[3].constant", 1.0f);
-        cubeShader.setFloat("pointLights[3].linear", 0.09f);
-        cubeShader.setFloat("pointLights[3].quadratic", 0.032f);
-
-        // spotLight
-        if (flashlight) {
-            cubeShader.setVec3("spotLight.position", camera.Position);
-            cubeShader.setVec3("spotLight.direction", camera.Front);
-            cubeShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            cubeShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-            cubeShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-            cubeShader.setFloat("spotLight.constant", 1.0f);
-            cubeShader.setFloat("spotLight.linear", 0.09f);
-            cubeShader.setFloat("spotLight.quadratic", 0.032f);
-            cubeShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-            cubeShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+    // meshes and materials referenced by the Renderable components
+    // ---------------------------------------------------------------------------------------------
+    enum { MESH_CUBE, MESH_LAMP, MESH_PYRAMID, MESH_MODEL };
+    std::vector<Mesh> meshes = {
+        { cubeVAO, 36, 0.866f },
+        { lightCubeVAO, 36, 0.866f },
+        { pyramidVAO, 18, 0.866f }
+    };
+    GLuint modelBuffers[3] = { 0, 0, 0 };
+    glm::vec3 modelBoundsMin(0.0f), modelBoundsMax(0.0f);
+    if (modelLoaded) {
+        PROFILE_SCOPE("uploadMesh");
+        auto start = std::chrono::steady_clock::now();
+        MeshStreamer streamer;
+        if (streamer.create()) {
+            meshes.push_back(modelNative ? streamer.upload(modelFile, modelBuffers) : streamer.upload(modelData, modelBuffers));
+            streamer.destroy();
         }
         else {
-            cubeShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            cubeShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-            cubeShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
-        }
-        // -----------------------------------------------------------------------------------
-
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.getViewMatrix();
-        cubeShader.setMat4("projection", projection);
-        cubeShader.setMat4("view", view);
-
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        cubeShader.setMat4("model", model);
-
-        // bind the diffuse map
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-        // bind the specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
-
-        // setup for the moving cubes
-        glBindVertexArray(cubeVAO);
-        float moveAmount = static_cast<float>(sin(glfwGetTime()) * 1.0f);
-
-        // render the x-moving cube
-        // ------------------------------------------------------------------------------
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(moveAmount - 5.0f, 0.0f, -4.0f));
-        model = glm::rotate(model, (float)(glfwGetTime() * sin(10.0f)), glm::vec3(1.0f));
-        cubeShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // ------------------------------------------------------------------------------
-
-        // render the y-moving cube
-        // ------------------------------------------------------------------------------
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-0.5f, moveAmount + 3.0f, -5.0f));
-        model = glm::rotate(model, (float)(glfwGetTime() * sin(5.0f)), glm::vec3(1.0f));
-        cubeShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // ------------------------------------------------------------------------------
-
-        // render the z-moving cube
-        // ------------------------------------------------------------------------------
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(5.5f, 0.0f, moveAmount - 2.5f));
-        model = glm::rotate(model, (float)(glfwGetTime() * sin(2.5f)), glm::vec3(1.0f));
-        cubeShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        // ------------------------------------------------------------------------------
-
-        // render the first set of cubes
-        for (unsigned int i = 0; i < 5; i++) {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::rotate(model, (float)(glfwGetTime() * sin(i + 10.0f)), cubePositions1[i]);
-            model = glm::translate(model, cubePositions1[i]);
-            model = glm::scale(model, glm::vec3(i * 0.5f));
-            cubeShader.setMat4("model", model);
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            modelLoaded = false;
+        }
+        if (modelNative) {
+            modelBoundsMin = glm::make_vec3(modelFile.header().BoundsMin);
+            modelBoundsMax = glm::make_vec3(modelFile.header().BoundsMax);
+            modelFile.close();
         }
+        else {
+            modelBoundsMin = modelData.BoundsMin;
+            modelBoundsMax = modelData.BoundsMax;
+            modelData = MeshData();
+        }
+        modelMs += elapsedMs(start);
+    }
+    if (modelLoaded) {
+        std::cout << "model " << options.ModelFile << ": " << meshes[MESH_MODEL].VertexCount << " vertices, "
+            << meshes[MESH_MODEL].IndexCount / 3 << " triangles, " << std::max(meshes[MESH_MODEL].LodCount, 1u)
+            << " levels of detail, " << meshes[MESH_MODEL].Lods[0].MeshletCount << " meshlets, loaded in " << modelMs << " ms" << std::endl;
+    }
 
-        // bind the diffuse map to the second set of cubes
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap2);
+    // dense models converted with meshlets have them culled against the view on the GPU
+    ClusterCulling clusterCulling;
+    if (modelLoaded && meshes[MESH_MODEL].MeshletBuffer && options.ClusterCulling && !clusterCulling.create()) {
+        return -1;
+    }
+
+    enum { MATERIAL_CONTAINER, MATERIAL_WOODEN_BOX, MATERIAL_LAMP, MATERIAL_PYRAMID };
+    std::vector<Material> materials = {
+        { &cubeUniforms, diffuseMap, specularMap, true },
+        { &cubeUniforms, diffuseMap2, 0, true },
+        { &lampUniforms, 0, 0, false },
+        { &pyramidUniforms, pyramidMap, 0, true }
+    };
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    // the wooden box and the pyramids have no specular map and little detail for the lights to pick out
+    if (coarseShading.enabled()) {
+        addCoarsePrograms("./shaders/cube/cube-vs.glsl", "./shaders/cube/cube-fs.glsl", "cube coarse lighting", "cube coarse");
+        addCoarsePrograms("./shaders/pyramid/pyramid-vs.glsl", "./shaders/pyramid/pyramid-fs.glsl", "pyramid coarse lighting", "pyramid coarse");
+        materials[MATERIAL_WOODEN_BOX].CoarsePass = &coarsePrograms[0];
+        materials[MATERIAL_WOODEN_BOX].Program = &coarsePrograms[1];
+        materials[MATERIAL_PYRAMID].CoarsePass = &coarsePrograms[2];
+        materials[MATERIAL_PYRAMID].Program = &coarsePrograms[3];
+    }
+
+    // resources only the generated benchmark scenes use
+    std::vector<std::unique_ptr<Shader>> benchShaders;
+    std::vector<ProgramUniforms> benchPrograms;
+    std::vector<unsigned int> benchTextures;
+    // ---------------------------------------------------------------------------------------------
+
+    // populate the scene
+    // ---------------------------------------------------------------------------------------------
+    const glm::quat noRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    const glm::vec3 diagonal = glm::normalize(glm::vec3(1.0f));
+    SceneGraph scene;
+    EntityRegistry registry;
+
+    registry.create(DirectionalLight{
+        glm::vec3(-0.2f, -1.0f, -0.3f),
+        glm::vec3(0.05f), glm::vec3(0.4f), glm::vec3(0.5f)
+    });
+
+    registry.create(SpotLight{
+        camera.getPosition(), camera.getFront(),
+        glm::vec3(0.0f), glm::vec3(1.0f), glm::vec3(1.0f),
+        1.0f, 0.09f, 0.032f,
+        glm::cos(glm::radians(12.5f)), glm::cos(glm::radians(15.0f)),
+        flashlight
+    });
+
+    if (options.Scene == SCENE_DEFAULT) {
+        // the x, y and z moving cubes
+        const glm::vec3 movingCubeBases[] = {
+            glm::vec3(-5.0f, 0.0f, -4.0f),
+            glm::vec3(-0.5f, 3.0f, -5.0f),
+            glm::vec3(5.5f, 0.0f, -2.5f)
+        };
+        const float movingCubeSpins[] = { std::sin(10.0f), std::sin(5.0f), std::sin(2.5f) };
+        for (unsigned int i = 0; i < 3; i++) {
+            glm::vec3 moveDirection(0.0f);
+            moveDirection[i] = 1.0f;
+            registry.create(
+                Transform{ scene.addNode() },
+                Renderable{ MESH_CUBE, MATERIAL_CONTAINER },
+                Animation{ movingCubeBases[i], moveDirection, diagonal, movingCubeSpins[i] }
+            );
+        }
 
-        // render the second set of cubes
+        // the sets of cubes orbit around an axis through the origin, so each cube hangs off a spinning pivot
+        for (unsigned int i = 0; i < 5; i++) {
+            uint32_t pivot = scene.addNode();
+            registry.create(Transform{ pivot }, Animation{ glm::vec3(0.0f), glm::vec3(0.0f), glm::normalize(cubePositions1[i]), std::sin(i + 10.0f) });
+            registry.create(
+                Transform{ scene.addNode(pivot, cubePositions1[i], noRotation, glm::vec3(i * 0.5f)) },
+                Renderable{ MESH_CUBE, MATERIAL_CONTAINER }
+            );
+        }
         for (unsigned int i = 0; i < 5; i++) {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f);
-            
-            model = glm::rotate(model, (float)(glfwGetTime() * sin(i + 2.0f)), cubePositions2[i]);
-            model = glm::translate(model, cubePositions2[i]);
-            model = glm::scale(model, glm::vec3(i * 0.3f));
-            
-            cubeShader.setMat4("model", model);
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-        
-        // draw the lamp object
-        lampShader.use();
-        lampShader.setMat4("projection", projection);
-        lampShader.setMat4("view", view);
-       
-        glBindVertexArray(lightCubeVAO);
-       
+            uint32_t pivot = scene.addNode();
+            registry.create(Transform{ pivot }, Animation{ glm::vec3(0.0f), glm::vec3(0.0f), glm::normalize(cubePositions2[i]), std::sin(i + 2.0f) });
+            registry.create(
+                Transform{ scene.addNode(pivot, cubePositions2[i], noRotation, glm::vec3(i * 0.3f)) },
+                Renderable{ MESH_CUBE, MATERIAL_WOODEN_BOX }
+            );
+        }
+
+        // the lamps never move, so their transforms are only computed once
         for (unsigned int i = 0; i < 4; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f));
-           
-            lampShader.setMat4("model", model);
-            
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-
-        // bind the diffuse map to the pyramid
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pyramidMap);
-
-        // pyramid lighting
-        // -----------------------------------------------------------------------------------
-        // activate shader
-        pyramidShader.use();
-        pyramidShader.setMat4("projection", projection);
-        pyramidShader.setMat4("view", view);
-        pyramidShader.setMat4("model", model);
-
-        // directional light
-        pyramidShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        pyramidShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        pyramidShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        pyramidShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-        // point light 1
-        pyramidShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        pyramidShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        pyramidShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        pyramidShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        pyramidShader.setFloat("pointLights[0].constant", 1.0f);
-        pyramidShader.setFloat("pointLights[0].linear", 0.09f);
-        pyramidShader.setFloat("pointLights[0].quadratic", 0.032f);
-
-        // point light 2
-        pyramidShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        pyramidShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        pyramidShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        pyramidShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        pyramidShader.setFloat("pointLights[1].constant", 1.0f);
-        pyramidShader.setFloat("pointLights[1].linear", 0.09f);
-        pyramidShader.setFloat("pointLights[1].quadratic", 0.032f);
-
-        // point light 3
-        pyramidShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        pyramidShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        pyramidShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        pyramidShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        pyramidShader.setFloat("pointLights[2].constant", 1.0f);
-        pyramidShader.setFloat("pointLights[2].linear", 0.09f);
-        pyramidShader.setFloat("pointLights[2].quadratic", 0.032f);
-
-        // point light 4
-        pyramidShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        pyramidShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        pyramidShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        pyramidShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        pyramidShader.setFloat("pointLights[3].constant", 1.0f);
-        pyramidShader.setFloat("pointLights[3].linear", 0.09f);
-        pyramidShader.setFloat("pointLights[3].quadratic", 0.032f);
-
-        // spotLight
-        if (flashlight) {
-            pyramidShader.setVec3("spotLight.position", camera.Position);
-            pyramidShader.setVec3("spotLight.direction", camera.Front);
-            pyramidShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            pyramidShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-            pyramidShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-            pyramidShader.setFloat("spotLight.constant", 1.0f);
-            pyramidShader.setFloat("spotLight.linear", 0.09f);
-            pyramidShader.setFloat("spotLight.quadratic", 0.032f);
-            pyramidShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-            pyramidShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+            registry.create(
+                Transform{ scene.addNode(INVALID_NODE, pointLightPositions[i], noRotation, glm::vec3(0.2f)) },
+                Renderable{ MESH_LAMP, MATERIAL_LAMP },
+                PointLight{ glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f }
+            );
+        }
+
+        registry.create(
+            Transform{ scene.addNode() },
+            Renderable{ MESH_PYRAMID, MATERIAL_PYRAMID },
+            Animation{ glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), std::sin(10.0f) * 2 }
+        );
+        for (unsigned int i = 0; i < 3; i++) {
+            uint32_t pivot = scene.addNode();
+            registry.create(Transform{ pivot }, Animation{ glm::vec3(0.0f), glm::vec3(0.0f), glm::normalize(pyramidPositions[i]), std::sin(2.0f + i) });
+            registry.create(
+                Transform{ scene.addNode(pivot, pyramidPositions[i]) },
+                Renderable{ MESH_PYRAMID, MATERIAL_PYRAMID }
+            );
+        }
+    }
+    else {
+        // generated benchmark scenes, lit by drifting point lights that are drawn as lamps
+        std::vector<uint32_t> gridMaterials;
+        if (options.Scene == SCENE_TEXTURES) {
+            for (uint32_t i = 0; i < BENCH_TEXTURE_COUNT; i++) {
+                TextureData texture = { "generated", createPatternPixels(i, BENCH_TEXTURE_SIZE), (int)BENCH_TEXTURE_SIZE, (int)BENCH_TEXTURE_SIZE, 4 };
+                benchTextures.push_back(uploadTexture(texture));
+                gridMaterials.push_back((uint32_t)materials.size());
+                materials.push_back({ &cubeUniforms, benchTextures.back(), specularMap, true });
+            }
+        }
+        else if (options.Scene == SCENE_SHADERS) {
+            // the materials point into benchPrograms, so it must never reallocate
+            benchPrograms.reserve(BENCH_SHADER_COUNT);
+            for (uint32_t i = 0; i < BENCH_SHADER_COUNT; i++) {
+                benchShaders.emplace_back(new Shader("./shaders/cube/cube-vs.glsl", "./shaders/cube/cube-fs.glsl", nullptr, litDefines));
+                benchShaders.back()->use();
+                benchShaders.back()->setInt("material.diffuse", 0);
+                benchShaders.back()->setInt("material.specular", 1);
+                benchShaders.back()->setInt("shadowMap", 2);
+                benchShaders.back()->setInt("shadowAtlas", 3);
+                benchPrograms.push_back(resolveUniforms(*benchShaders.back(), "cube copy"));
+                gridMaterials.push_back((uint32_t)materials.size());
+                materials.push_back({ &benchPrograms.back(), i % 2 ? diffuseMap2 : diffuseMap, specularMap, true });
+            }
         }
         else {
-            pyramidShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            pyramidShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-            pyramidShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
+            gridMaterials = { MATERIAL_CONTAINER, MATERIAL_WOODEN_BOX };
         }
-        // -----------------------------------------------------------------------------------
 
-        // pyramid material properties
-        pyramidShader.setFloat("material.shininess", 32.0f);
+        unsigned int gridSize = benchGridSize(options.Scene);
+        unsigned int lightCount = options.Scene == SCENE_LIGHTS ? MAX_POINT_LIGHTS : 4;
+        addObjectGrid(scene, registry, MESH_CUBE, gridMaterials, gridSize, BENCH_GRID_SPACING);
+        addPointLights(scene, registry, MESH_LAMP, MATERIAL_LAMP, lightCount, gridSize * BENCH_GRID_SPACING * 0.5f);
+    }
 
-        glBindVertexArray(pyramidVAO);
+    // the imported model turns slowly at the origin, centred and scaled to about the size of a cube
+    if (modelLoaded) {
+        glm::vec3 center = (modelBoundsMin + modelBoundsMax) * 0.5f;
+        float extent = glm::length(modelBoundsMax - modelBoundsMin) * 0.5f;
+        float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+        uint32_t pivot = scene.addNode();
+        registry.create(Transform{ pivot }, Animation{ glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0.5f });
+        registry.create(
+            Transform{ scene.addNode(pivot, -center * scale, noRotation, glm::vec3(scale)) },
+            Renderable{ MESH_MODEL, MATERIAL_CONTAINER }
+        );
+    }
+    // ---------------------------------------------------------------------------------------------
 
-        // pyramid
-        // ---------------------------------------------------------------------------------
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, -5.0f));
-        model = glm::rotate(model, (float)(glfwGetTime() * sin(10.0f) * 2), glm::vec3(0.0f, 1.0f, 0.0f));
-        pyramidShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 18);
-        // ---------------------------------------------------------------------------------
+    // fixed-timestep simulation: camera movement, animation and transform updates
+    // ---------------------------------------------------------------------------------------------
+    // the registry and the scene graph are not structurally modified from here on, so the
+    // render side may keep reading components and node slots while the simulation runs
+    Camera simulatedCamera = camera;
+    std::vector<ChunkView> animatedChunks;
+
+    Simulation simulation([&](SimulationState& state, double time, double dt) {
+        PROFILE_SCOPE("simulation tick");
+        const InputState& input = inputMailbox.front();
+        simulatedCamera.setOrientation(input.Yaw, input.Pitch);
+        for (int direction = FORWARD; direction <= RIGHT; direction++) {
+            if (input.Movement & (1u << direction)) {
+                simulatedCamera.processKeyboard((cameraMovement)direction, (float)dt);
+            }
+        }
 
-        for (unsigned int i = 0; i < 3; i++) {
-            model = glm::mat4(1.0f);
+        // animation system, one job per chunk of animated entities
+        {
+            PROFILE_SCOPE("animation");
+            float simulationTime = (float)time;
+            float moveAmount = static_cast<float>(sin(time) * 1.0f);
+            animatedChunks.clear();
+            registry.query<Transform, Animation>(animatedChunks);
+
+            JobCounter animated;
+            auto animate = [&](uint32_t begin, uint32_t end) {
+                for (uint32_t c = begin; c < end; c++) {
+                    const ChunkView& chunk = animatedChunks[c];
+                    Transform* transforms = chunk.array<Transform>();
+                    Animation* animations = chunk.array<Animation>();
+                    for (uint32_t i = 0; i < chunk.Count; i++) {
+                        // every entity owns a different node, so the writes never overlap between jobs
+                        scene.setPosition(transforms[i].Node, animations[i].BasePosition + animations[i].MoveDirection * moveAmount);
+                        scene.setRotation(transforms[i].Node, glm::angleAxis(simulationTime * animations[i].SpinSpeed, animations[i].SpinAxis));
+                    }
+                }
+            };
+            jobs.parallelFor(animated, (uint32_t)animatedChunks.size(), 1, animate);
+            jobs.wait(animated);
+        }
+
+        scene.updateWorldTransformsParallel(jobs);
+
+        state.CameraPosition = simulatedCamera.getPosition();
+        state.World = scene.World;
+
+        // split once per tick, so every frame in between only blends and rebuilds matrices
+        {
+            PROFILE_SCOPE("decompose");
+            state.Transforms.resize(scene.size());
+            JobCounter decomposed;
+            auto decompose = [&](uint32_t begin, uint32_t end) {
+                decomposeTransforms(scene.World.data(), begin, end, state.Transforms);
+            };
+            jobs.parallelFor(decomposed, (uint32_t)scene.size(), 1024, decompose);
+            jobs.wait(decomposed);
+        }
+    });
+
+    // produce the first tick up front so the renderer always has a snapshot to read. headless runs
+    // advance the simulation themselves, one frame at a time, so they do not depend on wall time
+    simulation.advanceTo(0.0);
+    if (!options.Headless) {
+        simulation.start([&]() {
+            PROFILE_THREAD("simulation");
+            jobs.registerThread();
+        });
+    }
+    // ---------------------------------------------------------------------------------------------
+
+    // hand the GL context to the render thread, from here on this thread only records commands
+    // ---------------------------------------------------------------------------------------------
+    RenderThread::ContextFunction makeCurrent, present, release;
+    if (options.Headless) {
+        headless.release();
+        makeCurrent = [&headless]() { headless.makeCurrent(); };
+        // nothing to show, so waiting for the GPU to finish stands in for the swap
+        present = []() { glFinish(); };
+        release = [&headless]() { headless.release(); };
+    }
+#ifndef ENGINE_NO_WINDOW
+    else {
+        glfwMakeContextCurrent(NULL);
+        makeCurrent = [window]() { glfwMakeContextCurrent(window); };
+        present = [window]() { glfwSwapBuffers(window); };
+        release = []() { glfwMakeContextCurrent(NULL); };
+    }
+#endif
+    RenderThread renderThread(makeCurrent, present, release);
+    renderThread.start();
+    // ---------------------------------------------------------------------------------------------
+
+    std::vector<DrawItem> drawList;
+    std::vector<DrawItem> shadowList;   // every caster inside at least one cascade
+    std::vector<ShadowCaster> lightCasters; // everything lit, the atlas culls against each light itself
+    ShadowCascade shadowCascades[SHADOW_CASCADE_COUNT];
+    unsigned int shadowCascadeCount = 0;
+    LodSelector lodSelector;
+    lodSelector.PixelError = options.LodPixelError;
+    // triangles drawn after warm-up, and what the same draws would have cost at full detail
+    uint64_t drawnTriangles = 0;
+    uint64_t fullDetailTriangles = 0;
+    // interpolated transforms and the matrices built from them, indexed by scene graph slot
+    TransformArrays frameTransforms;
+    std::vector<glm::mat4> frameWorld;
+    std::vector<glm::mat4> frameMvp;
+    // last frame's world matrices and unjittered view-projection, what the velocity is measured against
+    std::vector<glm::mat4> previousWorld;
+    glm::mat4 previousViewProjection(1.0f);
+    bool previousValid = false;
+    std::vector<glm::mat3> frameNormal;
+    std::vector<CapturedFrame> capturedFrames;
+    JobCounter capturesWritten;
+
+    // hands finished readbacks to the job system, each job owns and frees its frame
+    auto writeCaptures = [&]() {
+        capture.takeCompleted(capturedFrames);
+        for (CapturedFrame& captured : capturedFrames) {
+            CapturedFrame* frame = new CapturedFrame(std::move(captured));
+            jobs.run(capturesWritten, [&options, frame]() {
+                writeCapture(options, *frame);
+                delete frame;
+            });
+        }
+        capturedFrames.clear();
+    };
+
+    // culls, sorts and records one frame from the camera and the interpolated simulation state
+    auto recordFrame = [&](uint64_t frame, const SimulationSnapshot& snapshot, float alpha) {
+        // the flashlight follows the camera
+        registry.each<SpotLight>([&](Entity, SpotLight& light) {
+            light.Position = camera.getPosition();
+            light.Direction = camera.getFront();
+            light.Enabled = flashlight;
+        });
+
+        // view/projection transformations, rebuilt by the camera only when it moved or zoomed
+        camera.setProjection(framebufferHeight > 0 ? (float)framebufferWidth / (float)framebufferHeight : 1.0f);
+
+        // both axes shrink by the same factor, so the aspect ratio and projection stay as they are
+        float renderScale = dynamicResolution.update(gpuProfiler.latestFrameTime());
+        int renderWidth = dynamicResolution.scaled(framebufferWidth);
+        int renderHeight = dynamicResolution.scaled(framebufferHeight);
+        if (dynamicResolution.enabled()) {
+            renderScales.add(renderScale);
+        }
+        // a new sub-pixel offset every frame, within a pixel of the size actually rendered
+        if (options.Taa) {
+            camera.setJitter(TemporalAA::jitter(frame, renderWidth, renderHeight));
+        }
+        const glm::mat4& viewProjection = camera.getViewProjectionMatrix();
+
+        // interpolate every node between the two ticks and build its matrices, several nodes per instruction
+        {
+            PROFILE_SCOPE("transform");
+            uint32_t count = (uint32_t)snapshot.Current.Transforms.size();
+            if (options.Taa) {
+                previousWorld.swap(frameWorld);
+            }
+            frameTransforms.resize(count);
+            frameWorld.resize(count);
+            frameMvp.resize(count);
+            frameNormal.resize(count);
+            JobCounter transformed;
+            auto transform = [&](uint32_t begin, uint32_t end) {
+                interpolateTransforms(snapshot.Previous.Transforms, snapshot.Current.Transforms, alpha, begin, end, frameTransforms);
+                batchTransform(frameTransforms, begin, end, viewProjection, frameWorld.data(), frameMvp.data(), frameNormal.data());
+            };
+            jobs.parallelFor(transformed, count, 1024, transform);
+            jobs.wait(transformed);
+        }
+
+        // gather the draws, drop everything outside the view frustum and find the cascades each caster reaches
+        {
+            PROFILE_SCOPE("cull");
+            drawList.clear();
+            registry.each<Transform, Renderable>([&](Entity, Transform& transform, Renderable& renderable) {
+                drawList.push_back({ renderable.Material, renderable.Mesh, scene.slotOf(transform.Node), true, 0, 0, CLUSTER_NONE });
+            });
+
+            // the cascades are fitted around the view and the bounds of everything lit, which is what casts
+            shadowCascadeCount = 0;
+            glm::vec3 lightDirection(0.0f);
+            registry.each<DirectionalLight>([&](Entity, DirectionalLight& light) { lightDirection = light.Direction; });
+            if (options.Shadows != SHADOWS_OFF && lightDirection != glm::vec3(0.0f)) {
+                glm::vec3 casterMin(1e30f), casterMax(-1e30f);
+                for (const DrawItem& item : drawList) {
+                    if (materials[item.Material].Lit) {
+                        glm::vec4 sphere = worldBoundingSphere(frameWorld[item.Slot], meshes[item.Mesh].BoundingRadius);
+                        casterMin = glm::min(casterMin, glm::vec3(sphere) - sphere.w);
+                        casterMax = glm::max(casterMax, glm::vec3(sphere) + sphere.w);
+                    }
+                }
+                if (casterMin.x <= casterMax.x) {
+                    fitShadowCascades(camera, lightDirection, casterMin, casterMax, options.Depth, shadowCascades);
+                    shadowCascadeCount = SHADOW_CASCADE_COUNT;
+                }
+            }
+
+            // the level of detail is picked from the same bounding sphere, shadows draw it too
+            const Frustum& frustum = camera.getFrustum();
+            lodSelector.begin(camera, renderHeight, (uint32_t)frameWorld.size());
+            JobCounter culled;
+            auto cull = [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    DrawItem& item = drawList[i];
+                    glm::vec4 sphere = worldBoundingSphere(frameWorld[item.Slot], meshes[item.Mesh].BoundingRadius);
+                    item.Visible = sphereInFrustum(frustum, glm::vec3(sphere), sphere.w);
+                    item.Lod = (uint8_t)lodSelector.select(meshes[item.Mesh], item.Slot, sphere);
+                    if (materials[item.Material].Lit) {
+                        for (unsigned int c = 0; c < shadowCascadeCount; c++) {
+                            if (sphereInFrustum(shadowCascades[c].Bounds, glm::vec3(sphere), sphere.w)) {
+                                item.ShadowCascades |= (uint8_t)(1u << c);
+                            }
+                        }
+                    }
+                }
+            };
+            jobs.parallelFor(culled, (uint32_t)drawList.size(), 256, cull);
+            jobs.wait(culled);
+
+            shadowList.clear();
+            lightCasters.clear();
+            for (const DrawItem& item : drawList) {
+                if (item.ShadowCascades) {
+                    shadowList.push_back(item);
+                }
+                if (shadowAtlas.enabled() && materials[item.Material].Lit) {
+                    lightCasters.push_back({ item.Slot, item.Mesh, item.Lod });
+                }
+            }
+            drawList.erase(std::remove_if(drawList.begin(), drawList.end(), [](const DrawItem& item) { return !item.Visible; }), drawList.end());
+        }
 
-            model = glm::rotate(model, (float)(glfwGetTime() * sin(2.0f + i)), pyramidPositions[i]);
-            model = glm::translate(model, pyramidPositions[i]);
+        // sort the draws so each material is only bound once
+        {
+            PROFILE_SCOPE("sort");
+            std::sort(drawList.begin(), drawList.end(), [](const DrawItem& a, const DrawItem& b) {
+                return a.Material != b.Material ? a.Material < b.Material : a.Mesh < b.Mesh;
+            });
+            // the shadow pass has one program, so only mesh changes matter
+            std::sort(shadowList.begin(), shadowList.end(), [](const DrawItem& a, const DrawItem& b) {
+                return a.Mesh < b.Mesh;
+            });
+        }
+
+        // record the frame, the render thread replays it while we move on to the next one
+        PROFILE_SCOPE("record");
+        CommandBuffer& commands = renderThread.beginFrame();
+        gpuProfiler.recordBeginFrame(commands, frame);
+
+        // depth from the light into every cascade. layered draws each caster once and lets the geometry
+        // shader route it to its cascades; split draws the cascades one after another so each is timed
+        if (shadowCascadeCount > 0) {
+            gpuProfiler.recordBegin(commands, "shadows");
+            shadowMaps.recordBeginPass(commands);
+            commands.useProgram(shadowUniforms.Program);
+            for (unsigned int c = 0; c < shadowCascadeCount; c++) {
+                commands.setMat4(shadowUniforms.Cascades[c], shadowCascades[c].ViewProjection);
+            }
+
+            bool split = options.Shadows == SHADOWS_SPLIT;
+            uint32_t shadowMesh = ~0u;
+            for (unsigned int pass = 0; pass < (split ? shadowCascadeCount : 1); pass++) {
+                uint32_t passMask = split ? 1u << pass : ~0u;
+                if (split) {
+                    gpuProfiler.recordBegin(commands, SHADOW_CASCADE_NAMES[pass]);
+                }
+                for (const DrawItem& item : shadowList) {
+                    uint32_t mask = item.ShadowCascades & passMask;
+                    if (!mask) {
+                        continue;
+                    }
+                    if (item.Mesh != shadowMesh) {
+                        commands.bindVertexArray(meshes[item.Mesh].VAO);
+                        shadowMesh = item.Mesh;
+                    }
+                    commands.setMat4(shadowUniforms.Model, frameWorld[item.Slot]);
+                    commands.setInt(shadowUniforms.CascadeMask, (int)mask);
+                    recordDrawMesh(commands, meshes[item.Mesh], item.Lod);
+                }
+                if (split) {
+                    gpuProfiler.recordEnd(commands);
+                }
+            }
+            shadowMaps.recordEndPass(commands);
+            gpuProfiler.recordEnd(commands);
+        }
+
+        // point light and flashlight tiles whose casters or light changed, within the update budget
+        gpuProfiler.recordBegin(commands, "light shadows");
+        shadowAtlas.record(commands, jobs, registry, scene, snapshot, camera, renderHeight, lightCasters, frameWorld, meshes.data(), frame);
+        gpuProfiler.recordEnd(commands);
+
+        if (shadowCascadeCount > 0) {
+            commands.bindTexture(GL_TEXTURE2, GL_TEXTURE_2D_ARRAY, shadowMaps.DepthTexture);
+        }
+        if (shadowAtlas.enabled()) {
+            commands.bindTexture(GL_TEXTURE3, GL_TEXTURE_2D, shadowAtlas.Texture);
+        }
 
-            pyramidShader.setMat4("model", model);
+        // meshlets of the visible meshes that have them, tested against the camera before any pass
+        // that draws from it
+        if (clusterCulling.enabled()) {
+            gpuProfiler.recordBegin(commands, "cluster culling");
+            clusterCulling.recordBegin(commands, camera.getFrustum(), camera.getPosition());
+            for (DrawItem& item : drawList) {
+                item.Clusters = clusterCulling.recordCull(commands, meshes[item.Mesh], item.Lod, frameWorld[item.Slot]);
+            }
+            clusterCulling.recordEnd(commands);
+            gpuProfiler.recordEnd(commands);
+        }
+        auto recordDrawItem = [&](const DrawItem& item) {
+            if (item.Clusters != CLUSTER_NONE) {
+                clusterCulling.recordDraw(commands, meshes[item.Mesh], item.Lod, item.Clusters);
+            }
+            else {
+                recordDrawMesh(commands, meshes[item.Mesh], item.Lod);
+            }
+        };
+
+        // point and spot lighting of the coarse materials into the lighting buffer, which the main
+        // pass reads back. only their geometry is drawn and no texture maps are sampled
+        if (coarseShading.enabled()) {
+            gpuProfiler.recordBegin(commands, "coarse lighting");
+            coarseShading.recordResize(commands, framebufferWidth, framebufferHeight);
+            coarseShading.recordBeginPass(commands, renderWidth, renderHeight);
+            const ProgramUniforms* boundProgram = nullptr;
+            uint32_t boundMesh = ~0u;
+            for (const DrawItem& item : drawList) {
+                const ProgramUniforms* program = materials[item.Material].CoarsePass;
+                if (!program) {
+                    continue;
+                }
+                if (program != boundProgram) {
+                    commands.useProgram(program->Program);
+                    commands.setVec3(program->ViewPos, camera.getPosition());
+                    commands.setFloat(program->Shininess, 32.0f);
+                    recordLightUniforms(commands, *program, registry, scene, snapshot.Current);
+                    recordShadowUniforms(commands, *program, shadowCascades, shadowCascadeCount, camera.getFront());
+                    boundProgram = program;
+                }
+                if (item.Mesh != boundMesh) {
+                    commands.bindVertexArray(meshes[item.Mesh].VAO);
+                    boundMesh = item.Mesh;
+                }
+                commands.setMat4(program->Model, frameWorld[item.Slot]);
+                commands.setMat3(program->NormalMatrix, frameNormal[item.Slot]);
+                commands.setMat4(program->Mvp, frameMvp[item.Slot]);
+                recordDrawItem(item);
+            }
+            coarseShading.recordBindTextures(commands);
+            gpuProfiler.recordEnd(commands);
+        }
 
-            glDrawArrays(GL_TRIANGLES, 0, 18);
+        gpuProfiler.recordBegin(commands, "clear");
+        sceneTarget.recordResize(commands, framebufferWidth, framebufferHeight);
+        if (options.Taa) {
+            temporalAA.recordResize(commands, framebufferWidth, framebufferHeight);
+        }
+        if (options.Hdr) {
+            postProcess.recordResize(commands, framebufferWidth, framebufferHeight);
+        }
+        sceneTarget.recordBind(commands);
+        commands.viewport(0, 0, renderWidth, renderHeight);
+        sceneTarget.recordClear(commands, glm::vec4(0.2f, 0.3f, 0.3f, 1.0f));
+        gpuProfiler.recordEnd(commands);
+
+        uint32_t boundMaterial = ~0u;
+        uint32_t boundMesh = ~0u;
+        for (const DrawItem& item : drawList) {
+            const Material& material = materials[item.Material];
+            const ProgramUniforms& program = *material.Program;
+            if (item.Material != boundMaterial) {
+                // switching programs only when the material changes keeps uniform uploads to a minimum
+                if (boundMaterial == ~0u || materials[boundMaterial].Program != material.Program) {
+                    // each program is one pass in the GPU profile
+                    if (boundMaterial != ~0u) {
+                        gpuProfiler.recordEnd(commands);
+                    }
+                    gpuProfiler.recordBegin(commands, program.Name);
+                    commands.useProgram(program.Program);
+                    if (options.Taa) {
+                        commands.setVec2(program.Jitter, camera.getJitter());
+                    }
+                    if (material.Lit) {
+                        commands.setVec3(program.ViewPos, camera.getPosition());
+                        commands.setFloat(program.Shininess, 32.0f);
+                        recordLightUniforms(commands, program, registry, scene, snapshot.Current);
+                        recordShadowUniforms(commands, program, shadowCascades, shadowCascadeCount, camera.getFront());
+                    }
+                    if (material.CoarsePass) {
+                        glm::vec2 coarseSize(coarseShading.coarseSize(renderWidth), coarseShading.coarseSize(renderHeight));
+                        commands.setVec2(program.CoarseScale, coarseSize / glm::vec2(renderWidth, renderHeight));
+                        commands.setVec2(program.CoarseSize, coarseSize);
+                    }
+                }
+
+                // bind the diffuse and specular maps
+                commands.bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, material.Diffuse);
+                commands.bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, material.Specular);
+                boundMaterial = item.Material;
+            }
+
+            if (item.Mesh != boundMesh) {
+                commands.bindVertexArray(meshes[item.Mesh].VAO);
+                boundMesh = item.Mesh;
+            }
+
+            // unlit programs only take the MVP
+            if (material.Lit) {
+                commands.setMat4(program.Model, frameWorld[item.Slot]);
+                commands.setMat3(program.NormalMatrix, frameNormal[item.Slot]);
+            }
+            commands.setMat4(program.Mvp, frameMvp[item.Slot]);
+            if (options.Taa) {
+                // nodes that did not exist last frame are treated as if they had not moved
+                const glm::mat4& world = item.Slot < previousWorld.size() && previousValid ? previousWorld[item.Slot] : frameWorld[item.Slot];
+                commands.setMat4(program.PreviousMvp, (previousValid ? previousViewProjection : camera.getUnjitteredViewProjectionMatrix()) * world);
+            }
+            recordDrawItem(item);
+        }
+        if (boundMaterial != ~0u) {
+            gpuProfiler.recordEnd(commands);
         }
 
-        // glfw: swap buffers and poll IO events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (options.Hdr) {
+            double renderTime = snapshot.Previous.Time + (snapshot.Current.Time - snapshot.Previous.Time) * alpha;
+            gpuProfiler.recordBegin(commands, "post");
+            GLuint sceneColor = sceneTarget.ColorTexture;
+            if (options.Taa) {
+                sceneColor = temporalAA.record(commands, gpuProfiler, sceneTarget, renderWidth, renderHeight);
+            }
+            postProcess.record(commands, gpuProfiler, sceneColor, renderWidth, renderHeight, outputFramebuffer,
+                framebufferWidth, framebufferHeight, renderTime);
+            gpuProfiler.recordEnd(commands);
+        }
+        else {
+            gpuProfiler.recordBegin(commands, "resolve");
+            sceneTarget.recordResolve(commands, outputFramebuffer, framebufferWidth, framebufferHeight, renderWidth, renderHeight);
+            commands.viewport(0, 0, framebufferWidth, framebufferHeight);
+            gpuProfiler.recordEnd(commands);
+        }
+
+        if (showOverlay) {
+            overlay.update(stats);
+            gpuProfiler.recordBegin(commands, "overlay");
+            overlay.record(commands, frame);
+            gpuProfiler.recordEnd(commands);
+        }
+        gpuProfiler.recordEndFrame(commands);
+
+        if (capturing) {
+            if (std::binary_search(options.CaptureFrames.begin(), options.CaptureFrames.end(), frame)) {
+                capture.recordCapture(commands, frame);
+            }
+            capture.recordPoll(commands);
+        }
+
+        FrameSample sample;
+        sample.Frame = frame;
+        sample.GpuTime = gpuProfiler.latestFrameTime();
+        sample.Counters = commands.renderCounters();
+        sample.Counters.add(takeImmediateCounters());
+        sample.Commands = commands.count();
+        sample.CommandBytes = commands.size();
+        sample.RenderScale = renderScale;
+        stats.add(sample);
+        if (frame >= options.WarmupFrames) {
+            drawnTriangles += sample.Counters[COUNTER_TRIANGLES];
+            fullDetailTriangles += sample.Counters[COUNTER_FULL_DETAIL_TRIANGLES];
+        }
+
+        previousViewProjection = camera.getUnjitteredViewProjectionMatrix();
+        previousValid = true;
+
+        renderThread.submit();
+    };
+
+    if (options.Headless) {
+        // scripted run: the camera follows a path and every frame advances the clock by one tick,
+        // so the same frame always shows the same simulation state regardless of how long it took
+        CameraPath cameraPath;
+        if (options.CameraPathFile) {
+            if (!cameraPath.load(options.CameraPathFile)) {
+                renderThread.stop();
+                headless.destroy();
+                return -1;
+            }
+        }
+        else {
+            cameraPath = benchCameraPath(options.Scene);
+        }
+
+        FrameStats frameTimes;
+        FrameStats gpuFrameTimes;
+        frameTimes.reserve(options.Frames);
+        gpuFrameTimes.reserve(options.Frames);
+        for (unsigned int frame = 0; frame < options.WarmupFrames + options.Frames; frame++) {
+            if (frame == options.WarmupFrames) {
+                renderThread.collectTimings();
+            }
+            PROFILE_SCOPE("frame");
+            auto frameStart = std::chrono::steady_clock::now();
+
+            double time = frame * simulation.TickLength;
+            simulation.advanceTo(time);
+            const SimulationSnapshot& snapshot = simulation.latest();
+
+            CameraKeyframe pose = cameraPath.sample((float)time);
+            camera.setPosition(pose.Position);
+            camera.setOrientation(pose.Yaw, pose.Pitch);
+
+            recordFrame(frame, snapshot, simulation.interpolationAlpha(snapshot, time));
+            writeCaptures();
+
+            if (frame >= options.WarmupFrames) {
+                frameTimes.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+                // lags a few frames behind, which evens out over a run
+                gpuFrameTimes.add(gpuProfiler.latestFrameTime());
+            }
+        }
+
+        renderThread.stop();
+        headless.makeCurrent();
+        gpuProfiler.destroy();
+        printHeadlessReport(options, frameTimes, renderThread.collectTimings());
+        printGpuReport(gpuProfiler);
+        if (shadowAtlas.enabled()) {
+            std::cout << "light shadows: " << shadowAtlas.shadowedLights() << " lights shadowed, "
+                << shadowAtlas.averageRefreshedTiles() << " atlas tiles rendered per frame" << std::endl;
+        }
+        if (frameTimes.count() > 0) {
+            std::cout << "lod: " << drawnTriangles / frameTimes.count() << " triangles submitted per frame, "
+                << fullDetailTriangles / frameTimes.count() << " at full detail (" << options.LodPixelError << " px error)" << std::endl;
+        }
+        if (clusterCulling.enabled()) {
+            std::cout << "clusters: " << clusterCulling.averageTested() << " meshlets tested, " << clusterCulling.averageDrawn()
+                << " drawn per frame, " << clusterCulling.averageDrawnTriangles() << " triangles after culling" << std::endl;
+        }
+        if (dynamicResolution.enabled()) {
+            StatSummary scale = renderScales.summarize();
+            std::cout << "dynamic resolution: " << dynamicResolution.budgetMs() << " ms budget, render scale mean " << scale.Mean
+                << ", min " << scale.Min << ", max " << scale.Max << ", last " << dynamicResolution.currentScale() << std::endl;
+        }
+        if (options.ReportFile && !writeReport(options, frameTimes.summarize(), gpuFrameTimes.summarize())) {
+            return -1;
+        }
+    }
+#ifndef ENGINE_NO_WINDOW
+    else {
+        double lastTimingReport = glfwGetTime();
+        uint64_t frame = 0;
+        CameraPath recordedPath;
+        double nextKeyframe = 0.0;
+
+        // render loop
+        while (!glfwWindowShouldClose(window)) {
+            // per-frame time logic
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            PROFILE_SCOPE("frame");
+
+            // input
+            processInput(window);
+
+            // pick up the newest simulation state and place the frame between its last two ticks
+            const SimulationSnapshot& snapshot = simulation.latest();
+            float alpha = simulation.interpolationAlpha(snapshot, simulation.elapsed());
+            camera.setPosition(glm::mix(snapshot.Previous.CameraPosition, snapshot.Current.CameraPosition, alpha));
+
+            recordFrame(frame++, snapshot, alpha);
+            writeCaptures();
+
+            // a few keyframes per second are plenty, playback smooths them with a spline
+            if (options.RecordCameraPathFile && glfwGetTime() >= nextKeyframe) {
+                recordedPath.Keyframes.push_back({ (float)glfwGetTime(), camera.getPosition(), camera.getYaw(), camera.getPitch() });
+                nextKeyframe = glfwGetTime() + 0.25;
+            }
+
+            // average per-stage frame times of both threads
+            if (showTimings && glfwGetTime() - lastTimingReport >= 2.0) {
+                FrameTimings timings = renderThread.collectTimings();
+                double frames = timings.Frames > 0 ? timings.Frames : 1;
+                std::cout << "main: record " << timings.MainRecord / frames << " ms, stall " << timings.MainStall / frames << " ms"
+                    << " | render: idle " << timings.RenderIdle / frames << " ms, replay " << timings.RenderReplay / frames
+                    << " ms, present " << timings.RenderPresent / frames << " ms (" << timings.Frames << " frames)" << std::endl;
+                printGpuReport(gpuProfiler);
+                lastTimingReport = glfwGetTime();
+            }
+
+            // glfw: poll IO events, buffers are swapped on the render thread
+            glfwPollEvents();
+        }
+
+        renderThread.stop();
+        glfwMakeContextCurrent(window);
+        if (options.RecordCameraPathFile && recordedPath.save(options.RecordCameraPathFile)) {
+            std::cout << "camera path written to " << options.RecordCameraPathFile << std::endl;
+        }
     }
+#endif
+
+    // the GL context is back on this thread, so the last readbacks and queries can be waited for
+    if (capturing) {
+        capture.destroy();
+        writeCaptures();
+        jobs.wait(capturesWritten);
+    }
+    gpuProfiler.destroy();
+    if (options.StatsFile) {
+        stats.closeExport();
+        std::cout << "stats written to " << options.StatsFile << std::endl;
+    }
+    overlay.destroy();
+    sceneTarget.destroy();
+    coarseShading.destroy();
+    temporalAA.destroy();
+    postProcess.destroy();
+    clusterCulling.destroy();
+    shadowMaps.destroy();
+    shadowAtlas.destroy();
+    if (options.TraceFile) {
+        profiler().stop();
+        traceLog.close();
+        std::cout << "trace written to " << options.TraceFile << std::endl;
+    }
+    simulation.stop();
 
     // de-allocate all resources once they have outlived their purpose
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteVertexArrays(1, &pyramidVAO);
     glDeleteBuffers(1, &VBO);
+    if (modelLoaded) {
+        glDeleteVertexArrays(1, &meshes[MESH_MODEL].VAO);
+        glDeleteBuffers(3, modelBuffers);
+    }
 
-    // glfw: terminate, clearing all previously allocated glfw resources
-    glfwTerminate();
+    if (options.Headless) {
+        headless.destroy();
+    }
+#ifndef ENGINE_NO_WINDOW
+    else {
+        // glfw: terminate, clearing all previously allocated glfw resources
+        glfwTerminate();
+    }
+#endif
     return 0;
 }
 
-// handles the camera speed and camera controls
+// reads the command line, every option is listed in the usage message below
+bool parseOptions(int argc, char** argv, EngineOptions& options) {
+#ifdef ENGINE_NO_WINDOW
+    options.Headless = true;
+#endif
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--headless") {
+            options.Headless = true;
+        }
+        else if (argument == "--frames" && hasValue) {
+            options.Frames = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (argument == "--warmup" && hasValue) {
+            options.WarmupFrames = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (argument == "--width" && hasValue) {
+            options.Width = std::atoi(argv[++i]);
+        }
+        else if (argument == "--height" && hasValue) {
+            options.Height = std::atoi(argv[++i]);
+        }
+        else if (argument == "--camera-path" && hasValue) {
+            options.CameraPathFile = argv[++i];
+        }
+        else if (argument == "--record-camera-path" && hasValue) {
+            options.RecordCameraPathFile = argv[++i];
+        }
+        else if (argument == "--scene" && hasValue) {
+            if (!parseSceneName(argv[++i], options.Scene)) {
+                std::cout << "unknown scene " << argv[i] << ", expected default, cubes, lights, textures or shaders" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--report" && hasValue) {
+            options.ReportFile = argv[++i];
+        }
+        else if (argument == "--trace" && hasValue) {
+            options.TraceFile = argv[++i];
+        }
+        else if (argument == "--capture" && hasValue) {
+            // comma separated frame numbers, counted from the first frame including warm-up
+            for (char* next = argv[++i]; *next;) {
+                options.CaptureFrames.push_back(std::strtoull(next, &next, 10));
+                while (*next == ',' || *next == ' ') {
+                    next++;
+                }
+            }
+        }
+        else if (argument == "--capture-dir" && hasValue) {
+            options.CaptureDirectory = argv[++i];
+        }
+        else if (argument == "--stats" && hasValue) {
+            options.StatsFile = argv[++i];
+        }
+        else if (argument == "--stats-interval" && hasValue) {
+            options.StatsInterval = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (argument == "--overlay") {
+            options.Overlay = true;
+        }
+        else if (argument == "--depth" && hasValue) {
+            if (!parseDepthMode(argv[++i], options.Depth)) {
+                std::cout << "unknown depth mode " << argv[i] << ", expected standard or reversed" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--shadows" && hasValue) {
+            if (!parseShadowMode(argv[++i], options.Shadows)) {
+                std::cout << "unknown shadow mode " << argv[i] << ", expected off, layered or split" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--light-shadows" && hasValue) {
+            std::string value = argv[++i];
+            if (value != "on" && value != "off") {
+                std::cout << "unknown light shadow setting " << value << ", expected on or off" << std::endl;
+                return false;
+            }
+            options.LightShadows = value == "on";
+        }
+        else if (argument == "--hdr" && hasValue) {
+            std::string value = argv[++i];
+            if (value != "on" && value != "off") {
+                std::cout << "unknown hdr setting " << value << ", expected on or off" << std::endl;
+                return false;
+            }
+            options.Hdr = value == "on";
+        }
+        else if (argument == "--taa" && hasValue) {
+            std::string value = argv[++i];
+            if (value != "on" && value != "off") {
+                std::cout << "unknown taa setting " << value << ", expected on or off" << std::endl;
+                return false;
+            }
+            options.Taa = value == "on";
+        }
+        else if (argument == "--coarse-shading" && hasValue) {
+            if (!parseCoarseShadingRate(argv[++i], options.CoarseShading)) {
+                std::cout << "unknown coarse shading rate " << argv[i] << ", expected off, half or quarter" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--model" && hasValue) {
+            options.ModelFile = argv[++i];
+        }
+        else if (argument == "--lod-error" && hasValue) {
+            std::string value = argv[++i];
+            options.LodPixelError = value == "off" ? 0.0f : std::strtof(value.c_str(), NULL);
+            if (value != "off" && options.LodPixelError <= 0.0f) {
+                std::cout << "unknown level of detail error " << value << ", expected pixels or off" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--cluster-culling" && hasValue) {
+            std::string value = argv[++i];
+            if (value != "on" && value != "off") {
+                std::cout << "unknown cluster culling setting " << value << ", expected on or off" << std::endl;
+                return false;
+            }
+            options.ClusterCulling = value == "on";
+        }
+        else if (argument == "--dynamic-resolution" && hasValue) {
+            std::string value = argv[++i];
+            options.FrameBudget = value == "off" ? 0.0f : std::strtof(value.c_str(), NULL);
+            if (value != "off" && options.FrameBudget <= 0.0f) {
+                std::cout << "unknown dynamic resolution budget " << value << ", expected milliseconds per frame or off" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--post" && hasValue) {
+            if (!parsePostEffects(argv[++i], options.PostEffects)) {
+                std::cout << "unknown post effects " << argv[i] << ", expected a comma separated list of bloom, exposure and tonemap, or none" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--capture-format" && hasValue) {
+            std::string format = argv[++i];
+            options.CapturePng = format == "png" || format == "both";
+            options.CapturePam = format == "pam" || format == "both";
+        }
+        else {
+            std::cout << "usage: " << argv[0] << " [--headless] [--frames N] [--warmup N] [--width W] [--height H] [--camera-path FILE]"
+                << " [--scene default|cubes|lights|textures|shaders] [--report FILE] [--record-camera-path FILE]"
+                << " [--trace FILE] [--stats FILE] [--stats-interval N] [--overlay]"
+                << " [--capture N,N,...] [--capture-dir DIR] [--capture-format png|pam|both] [--depth standard|reversed]"
+                << " [--shadows off|layered|split] [--light-shadows on|off] [--hdr on|off] [--post bloom,exposure,tonemap|none]"
+                << " [--dynamic-resolution MS|off] [--taa on|off] [--coarse-shading off|half|quarter]"
+                << " [--model FILE.mesh|obj|gltf|glb] [--lod-error PIXELS|off] [--cluster-culling on|off]" << std::endl;
+            return false;
+        }
+    }
+    std::sort(options.CaptureFrames.begin(), options.CaptureFrames.end());
+    // the resolve hands its result to the post chain, the LDR path has nothing to take it
+    options.Taa = options.Taa && options.Hdr;
+
+    if (options.Width <= 0) {
+        options.Width = SCREEN_WIDTH;
+    }
+    if (options.Height <= 0) {
+        options.Height = SCREEN_HEIGHT;
+    }
+    return true;
+}
+
+// frame time distribution and per-stage averages of a headless run
+void printHeadlessReport(const EngineOptions& options, const FrameStats& frameTimes, const FrameTimings& timings) {
+    StatSummary frame = frameTimes.summarize();
+    double frames = timings.Frames > 0 ? timings.Frames : 1;
+
+    std::cout << "headless: " << frame.Count << " frames at " << options.Width << "x" << options.Height
+        << " on " << glGetString(GL_RENDERER) << ", " << simdLevelName(activeSimdLevel()) << " transforms, "
+        << depthModeName(options.Depth) << " depth, " << shadowModeName(options.Shadows) << " shadows, light shadows "
+        << (options.LightShadows ? "on" : "off") << ", post " << (options.Hdr ? postEffectsName(options.PostEffects) : "ldr")
+        << ", taa " << (options.Taa ? "on" : "off") << ", coarse shading " << coarseShadingRateName(options.CoarseShading) << std::endl;
+    std::cout << "frame ms: mean " << frame.Mean << ", min " << frame.Min << ", p50 " << frame.P50
+        << ", p95 " << frame.P95 << ", p99 " << frame.P99 << ", max " << frame.Max
+        << " (" << (frame.Mean > 0.0 ? 1000.0 / frame.Mean : 0.0) << " fps)" << std::endl;
+    std::cout << "main: record " << timings.MainRecord / frames << " ms, stall " << timings.MainStall / frames << " ms"
+        << " | render: idle " << timings.RenderIdle / frames << " ms, replay " << timings.RenderReplay / frames
+        << " ms, gpu finish " << timings.RenderPresent / frames << " ms" << std::endl;
+}
+
+// writes the frame time distributions of a headless run as one JSON object, the format engine_bench reads
+bool writeReport(const EngineOptions& options, const StatSummary& cpuTime, const StatSummary& gpuTime) {
+    std::ofstream file(options.ReportFile);
+    if (!file.is_open()) {
+        std::cout << "ERROR::REPORT::FILE_NOT_SUCCESSFULLY_WRITTEN " << options.ReportFile << std::endl;
+        return false;
+    }
+
+    auto writeSummary = [&file](const char* name, const StatSummary& summary) {
+        file << ",\n  \"" << name << "\": {\"mean\": " << summary.Mean << ", \"min\": " << summary.Min << ", \"p50\": " << summary.P50
+            << ", \"p95\": " << summary.P95 << ", \"p99\": " << summary.P99 << ", \"max\": " << summary.Max << "}";
+    };
+    file << "{\n  \"scene\": \"" << sceneName(options.Scene) << "\",\n  \"frames\": " << cpuTime.Count
+        << ",\n  \"width\": " << options.Width << ",\n  \"height\": " << options.Height
+        << ",\n  \"renderer\": \"" << jsonEscape((const char*)glGetString(GL_RENDERER)) << "\",\n  \"simd\": \"" << simdLevelName(activeSimdLevel())
+        << "\",\n  \"depth\": \"" << depthModeName(options.Depth)
+        << "\",\n  \"shadows\": \"" << shadowModeName(options.Shadows)
+        << "\",\n  \"light_shadows\": \"" << (options.LightShadows ? "on" : "off")
+        << "\",\n  \"hdr\": \"" << (options.Hdr ? "on" : "off")
+        << "\",\n  \"post\": \"" << (options.Hdr ? postEffectsName(options.PostEffects) : "none")
+        << "\",\n  \"dynamic_resolution\": \"" << (options.FrameBudget > 0.0f ? std::to_string(options.FrameBudget) + " ms" : "off")
+        << "\",\n  \"taa\": \"" << (options.Taa ? "on" : "off")
+        << "\",\n  \"coarse_shading\": \"" << coarseShadingRateName(options.CoarseShading) << "\"";
+    writeSummary("cpu_ms", cpuTime);
+    writeSummary("gpu_ms", gpuTime);
+    file << "\n}\n";
+    return true;
+}
+
+// rolling GPU time per pass, nested passes are indented under the frame
+void printGpuReport(GpuProfiler& profiler) {
+    for (const GpuScopeStats& scope : profiler.statistics()) {
+        std::cout << "gpu: " << std::string(scope.Depth * 2, ' ') << scope.Name << " min " << scope.Time.Min
+            << " ms, avg " << scope.Time.Mean << " ms, p99 " << scope.Time.P99 << " ms | render cpu " << scope.CpuTime << " ms" << std::endl;
+    }
+}
+
+// writes one captured frame as frame_NNNNNN.png and/or .pam into the capture directory
+void writeCapture(const EngineOptions& options, const CapturedFrame& frame) {
+    std::string number = std::to_string(frame.Frame);
+    std::string path = options.CaptureDirectory + "/frame_" + std::string(number.size() < 6 ? 6 - number.size() : 0, '0') + number;
+    if (options.CapturePng) {
+        writePng(path + ".png", frame.Pixels);
+    }
+    if (options.CapturePam) {
+        writePam(path + ".pam", frame.Pixels);
+    }
+}
+
+#ifndef ENGINE_NO_WINDOW
+// handles the camera controls, movement itself is applied by the simulation
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
 
-    float cameraSpeed = static_cast<float>(2.5 * deltaTime);
+    InputState& input = inputMailbox.back();
+    input.Movement = 0;
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera.processKeyboard(FORWARD, deltaTime);
+        input.Movement |= 1u << FORWARD;
     }
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera.processKeyboard(BACKWARD, deltaTime);
+        input.Movement |= 1u << BACKWARD;
     }
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera.processKeyboard(LEFT, deltaTime);
+        input.Movement |= 1u << LEFT;
     }
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera.processKeyboard(RIGHT, deltaTime);
+        input.Movement |= 1u << RIGHT;
     }
+    input.Yaw = camera.getYaw();
+    input.Pitch = camera.getPitch();
+    inputMailbox.publish();
 }
 
 // glfw: whenever the window is resized, this function is called
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
-// handles the flashlight controls
+// handles the flashlight, frame timing and overlay controls
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_F && action == GLFW_PRESS) {
         if (flashlight) {
@@ -590,6 +1688,12 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             flashlight = true;
         }
     }
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        showTimings = !showTimings;
+    }
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        showOverlay = !showOverlay;
+    }
 }
 
 // glfw: whenever the mouse moves, this function is called
@@ -616,40 +1720,52 @@ void mouse_callback(GLFWwindow* window, double xPosIn, double yPosIn) {
 void scroll_callback(GLFWwindow* window, double xOffset, double yOffset) {
     camera.processMouseScroll(static_cast<float>(yOffset));
 }
+#endif
+
+// decodes an image file into memory, safe to call from any thread
+TextureData decodeTexture(const char* path) {
+    PROFILE_SCOPE("decodeTexture");
+    TextureData texture = { path, nullptr, 0, 0, 0 };
+    texture.Pixels = stbi_load(path, &texture.Width, &texture.Height, &texture.Components, 0);
+    return texture;
+}
 
-// utility function for loading a 2D texture from a file
-unsigned int loadTexture(char const* path) {
+// uploads a decoded image as a mipmapped 2D texture and frees the pixels
+unsigned int uploadTexture(TextureData& texture) {
+    PROFILE_SCOPE("uploadTexture");
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
+    if (texture.Pixels) {
+        GLenum format = GL_RGBA;
+        if (texture.Components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (texture.Components == 2)
+            format = GL_RG;
+        else if (texture.Components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, texture.Width, texture.Height, 0, format, GL_UNSIGNED_BYTE, texture.Pixels);
         glGenerateMipmap(GL_TEXTURE_2D);
 
+        // a full mip chain adds a third on top of the base level
+        size_t bytes = (size_t)texture.Width * texture.Height * texture.Components;
+        countImmediate(COUNTER_TEXTURE_UPLOADS);
+        countImmediate(COUNTER_TEXTURE_UPLOAD_BYTES, bytes);
+        trackGpuMemory((int64_t)(bytes + bytes / 3));
+
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Texture failed to load at path: " << texture.Path << std::endl;
     }
 
+    stbi_image_free(texture.Pixels);
+    texture.Pixels = nullptr;
     return textureID;
 }
 
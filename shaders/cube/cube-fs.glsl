@@ -1,5 +1,18 @@
-#version 460 core
-out vec4 FragColor;
+#version 450 core
+#ifdef COARSE_PASS
+// point and spot lighting of the coarse lighting buffer, see CoarseShading
+layout (location = 0) out vec3 DiffuseLight;
+layout (location = 1) out vec3 SpecularLight;
+layout (location = 2) out vec4 Geometry;    // normal and view depth, what the upsample weighs by
+#else
+layout (location = 0) out vec4 FragColor;
+#endif
+#ifdef VELOCITY
+layout (location = 1) out vec2 Velocity;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+uniform vec2 jitter;    // taken out again so only real motion remains
+#endif
 
 struct Material {
 	sampler2D diffuse;
@@ -42,7 +55,14 @@ struct SpotLight {
     vec3 specular;
 };
 
-#define NR_POINT_LIGHTS 4
+// light arriving at the fragment, before the material's colours are applied
+struct Lighting {
+    vec3 diffuse;   // ambient and diffuse, times the diffuse map
+    vec3 specular;  // times the specular map
+};
+
+#define NR_POINT_LIGHTS 32
+#define SHADOW_CASCADES 4
 
 in vec3 Normal;
 in vec3 FragPos;
@@ -53,12 +73,45 @@ uniform Material material;
 
 uniform DirLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform int pointLightCount;
 uniform SpotLight spotLight;
 
+// cascaded shadow maps of the directional light
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[SHADOW_CASCADES];      // world to shadow map coordinates and depth
+uniform float shadowSplits[SHADOW_CASCADES];       // view depth where each cascade ends
+uniform float shadowTexelSizes[SHADOW_CASCADES];   // world size of a shadow map texel
+uniform int shadowCascadeCount;                    // 0 when shadows are off
+uniform vec3 viewForward;
+
+// shadow maps of the point lights and the flashlight, tiles of one atlas. only looked up with
+// LIGHT_SHADOWS defined, a software rasterizer pays for the lookups of every light otherwise
+uniform sampler2DShadow shadowAtlas;
+layout (std140, binding = 1) uniform LightShadows {
+    vec4 pointShadowFaces[NR_POINT_LIGHTS * 6];     // +X, -X, +Y, -Y, +Z, -Z: xy centre of the tile, z half its size over tan(fov / 2)
+    vec4 pointShadowLights[NR_POINT_LIGHTS];        // xyz where the faces were rendered from, w normal offset per unit of distance, 0 unshadowed
+    vec4 pointShadowDepths[NR_POINT_LIGHTS];        // depth is x + y / distance along the face's axis
+    mat4 spotShadowMatrix;                          // world to atlas coordinates and depth
+    vec4 spotShadowLight;
+};
+
+#ifdef COARSE_LIGHTING
+// the point and spot lighting, shaded at a lower rate by the COARSE_PASS build of this shader
+uniform sampler2D coarseDiffuse;
+uniform sampler2D coarseSpecular;
+uniform sampler2D coarseGeometry;
+uniform vec2 coarseScale;   // coarse texels per pixel
+uniform vec2 coarseSize;    // coarse texels that were shaded, from the bottom left
+#endif
+
 // function prototypes
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+Lighting CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+float CalcDirShadow(vec3 normal, vec3 fragPos);
+Lighting CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
+float CalcPointShadow(int index, vec3 normal, vec3 fragPos);
+Lighting CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
+float CalcSpotShadow(vec3 normal, vec3 fragPos);
+Lighting CoarseLighting(vec3 normal, vec3 fragPos);
 
 void main() {
     // properties
@@ -72,21 +125,161 @@ void main() {
     // this fragment's final color.
     // == =====================================================
     
-    // phase 1: directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    
+    // phase 1: directional lighting, always per pixel since its shadow edges are sharp
+#ifdef COARSE_PASS
+    Lighting lighting = Lighting(vec3(0.0), vec3(0.0));
+#else
+    Lighting lighting = CalcDirLight(dirLight, norm, viewDir, CalcDirShadow(norm, FragPos));
+#endif
+
+#ifdef COARSE_LIGHTING
+    // phases 2 and 3 were shaded at a lower rate and are upsampled here
+    Lighting coarse = CoarseLighting(norm, FragPos);
+    lighting.diffuse += coarse.diffuse;
+    lighting.specular += coarse.specular;
+#else
     // phase 2: point lights
-    for (int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
-    
+    for (int i = 0; i < pointLightCount; i++) {
+        float shadow = 1.0;
+#ifdef LIGHT_SHADOWS
+        // the same for every fragment, so unshadowed lights skip the lookup where branches are real
+        if (pointShadowLights[i].w != 0.0)
+            shadow = CalcPointShadow(i, norm, FragPos);
+#endif
+        Lighting point = CalcPointLight(pointLights[i], norm, FragPos, viewDir, shadow);
+        lighting.diffuse += point.diffuse;
+        lighting.specular += point.specular;
+    }
+
     // phase 3: spot light
-    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+    float spotShadow = 1.0;
+#ifdef LIGHT_SHADOWS
+    if (spotShadowLight.w != 0.0)
+        spotShadow = CalcSpotShadow(norm, FragPos);
+#endif
+    Lighting spot = CalcSpotLight(spotLight, norm, FragPos, viewDir, spotShadow);
+    lighting.diffuse += spot.diffuse;
+    lighting.specular += spot.specular;
+#endif
 
+#ifdef COARSE_PASS
+    DiffuseLight = lighting.diffuse;
+    SpecularLight = lighting.specular;
+    Geometry = vec4(norm, dot(FragPos - viewPos, viewForward));
+#else
+    // the maps are sampled once for all the lights
+    vec3 result = lighting.diffuse * vec3(texture(material.diffuse, TexCoords))
+        + lighting.specular * vec3(texture(material.specular, TexCoords));
     FragColor = vec4(result, 1.0);
+#ifdef VELOCITY
+    Velocity = ((CurrentClip.xy / CurrentClip.w - jitter) - PreviousClip.xy / PreviousClip.w) * 0.5;
+#endif
+#endif
+}
+
+// how much of the directional light reaches the fragment, 0 in full shadow
+float CalcDirShadow(vec3 normal, vec3 fragPos) {
+    // the first cascade whose slice of the view contains the fragment
+    float depth = dot(fragPos - viewPos, viewForward);
+    int cascade = 0;
+    while (cascade < shadowCascadeCount && depth > shadowSplits[cascade])
+        cascade++;
+    if (cascade >= shadowCascadeCount)
+        return 1.0;
+
+    // looking up a little way along the normal keeps lit surfaces from shadowing themselves
+    vec3 lookupPos = fragPos + normal * shadowTexelSizes[cascade] * 1.5;
+    vec3 coords = (shadowMatrices[cascade] * vec4(lookupPos, 1.0)).xyz;
+    // the depth comparison with linear filtering averages the four nearest texels
+    return texture(shadowMap, vec4(coords.xy, cascade, coords.z));
+}
+
+// how much of a point light reaches the fragment, the cube face is the major axis from the light
+float CalcPointShadow(int index, vec3 normal, vec3 fragPos) {
+    vec4 light = pointShadowLights[index];
+    // texels grow with the distance from the light, so does the offset along the normal
+    vec3 lookupPos = fragPos + normal * light.w * length(fragPos - light.xyz);
+    vec3 direction = lookupPos - light.xyz;
+    vec3 size = abs(direction);
+
+    // the face's axis and its right and up, as the faces were rendered
+    int face;
+    float distance;
+    vec2 coords;
+    if (size.x >= size.y && size.x >= size.z) {
+        face = direction.x > 0.0 ? 0 : 1;
+        distance = size.x;
+        coords = vec2(direction.x > 0.0 ? -direction.z : direction.z, -direction.y);
+    } else if (size.y >= size.z) {
+        face = direction.y > 0.0 ? 2 : 3;
+        distance = size.y;
+        coords = vec2(direction.x, direction.y > 0.0 ? direction.z : -direction.z);
+    } else {
+        face = direction.z > 0.0 ? 4 : 5;
+        distance = size.z;
+        coords = vec2(direction.z > 0.0 ? direction.x : -direction.x, -direction.y);
+    }
+
+    vec4 tile = pointShadowFaces[index * 6 + face];
+    vec2 depth = pointShadowDepths[index].xy;
+    vec2 uv = tile.xy + coords * (tile.z / distance);
+    return texture(shadowAtlas, vec3(uv, clamp(depth.x + depth.y / distance, 0.0, 1.0)));
+}
+
+// how much of the flashlight reaches the fragment
+float CalcSpotShadow(vec3 normal, vec3 fragPos) {
+    vec3 lookupPos = fragPos + normal * spotShadowLight.w * length(fragPos - spotShadowLight.xyz);
+    vec4 coords = spotShadowMatrix * vec4(lookupPos, 1.0);
+    if (coords.w <= 0.0)
+        return 1.0;
+    coords.xyz /= coords.w;
+    return texture(shadowAtlas, vec3(coords.xy, clamp(coords.z, 0.0, 1.0)));
+}
+
+// the point and spot lighting of the four coarse texels around the fragment, each weighed by its
+// bilinear weight and by how well its normal and depth match, so light does not bleed across
+// edges. where none of them lies on this surface the closest match is taken on its own
+Lighting CoarseLighting(vec3 normal, vec3 fragPos) {
+    Lighting lighting = Lighting(vec3(0.0), vec3(0.0));
+#ifdef COARSE_LIGHTING
+    float depth = dot(fragPos - viewPos, viewForward);
+    vec2 position = gl_FragCoord.xy * coarseScale - 0.5;
+    vec2 base = floor(position);
+    vec2 f = position - base;
+
+    float total = 0.0;
+    float bestMatch = -1.0;
+    ivec2 best = ivec2(0);
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = ivec2(clamp(base + vec2(offset), vec2(0.0), coarseSize - 1.0));
+        vec4 geometry = texelFetch(coarseGeometry, texel, 0);
+        // w is 0 where nothing was shaded
+        float match = geometry.w > 0.0 ? pow(max(dot(normal, geometry.xyz), 0.0), 8.0)
+            * exp(-abs(depth - geometry.w) / (depth * 0.02)) : 0.0;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y * match;
+        lighting.diffuse += texelFetch(coarseDiffuse, texel, 0).rgb * weight;
+        lighting.specular += texelFetch(coarseSpecular, texel, 0).rgb * weight;
+        total += weight;
+        if (match > bestMatch) {
+            bestMatch = match;
+            best = texel;
+        }
+    }
+    if (total > 1e-4) {
+        lighting.diffuse /= total;
+        lighting.specular /= total;
+    } else {
+        lighting.diffuse = texelFetch(coarseDiffuse, best, 0).rgb;
+        lighting.specular = texelFetch(coarseSpecular, best, 0).rgb;
+    }
+#endif
+    return lighting;
 }
 
 // calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
+Lighting CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow) {
     vec3 lightDir = normalize(-light.direction);
     
     // diffuse shading
@@ -97,14 +290,14 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
+    Lighting lighting;
+    lighting.diffuse = light.ambient + shadow * light.diffuse * diff;
+    lighting.specular = shadow * light.specular * spec;
+    return lighting;
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+Lighting CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow) {
     vec3 lightDir = normalize(light.position - fragPos);
     
     // diffuse shading
@@ -119,17 +312,14 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+    Lighting lighting;
+    lighting.diffuse = (light.ambient + shadow * light.diffuse * diff) * attenuation;
+    lighting.specular = shadow * light.specular * spec * attenuation;
+    return lighting;
 }
 
 // calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+Lighting CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow) {
     vec3 lightDir = normalize(light.position - fragPos);
     
     // diffuse shading
@@ -149,13 +339,10 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
+    Lighting lighting;
+    lighting.diffuse = (light.ambient + shadow * light.diffuse * diff) * (attenuation * intensity);
+    lighting.specular = shadow * light.specular * spec * (attenuation * intensity);
+    return lighting;
 }
 
 // code modified from https://learnopengl.com/
\ No newline at end of file
@@ -0,0 +1,90 @@
+#version 450 core
+layout(local_size_x = 64) in;
+
+// a MeshFileMeshlet record
+struct Meshlet {
+	uint VertexOffset;
+	uint TriangleOffset;    // also the first index of its triangles
+	uint VertexCount;
+	uint TriangleCount;
+	vec3 Center;
+	float Radius;
+	vec3 ConeAxis;
+	float ConeCutoff;       // cosine of the cone's half angle, 0 or less never faces away
+};
+
+// the parameters of glDrawElementsIndirect
+struct DrawCommand {
+	uint Count;
+	uint InstanceCount;
+	uint FirstIndex;
+	int BaseVertex;
+	uint BaseInstance;
+};
+
+layout(std140, binding = 2) uniform ClusterView {
+	vec4 Planes[6];         // world space frustum, inward normals in xyz
+	vec4 ViewPosition;
+};
+
+layout(std430, binding = 1) writeonly buffer Draws {
+	DrawCommand Commands[];
+};
+
+layout(std430, binding = 2) readonly buffer Meshlets {
+	Meshlet Clusters[];
+};
+
+// what survived culling in each statistics slot
+struct FrameStatistics {
+	uint Meshlets;
+	uint Triangles;
+};
+
+layout(std430, binding = 3) buffer Statistics {
+	FrameStatistics Frames[];
+};
+
+uniform mat4 model;
+uniform float scale;        // largest axis scale of model
+uniform bool coneCulling;   // off when model scales its axes differently, which bends the normals
+uniform int meshletOffset;
+uniform int meshletCount;
+uniform int drawOffset;
+uniform int statisticsSlot;
+
+// one meshlet per invocation: its draw command keeps the meshlet's triangles if its bounding sphere
+// is inside the frustum and the camera is not behind every triangle, and draws nothing otherwise.
+// the cone test takes the normal within the cone that is closest to facing the camera and checks it
+// still faces away from every point of the sphere
+void main() {
+	int index = int(gl_GlobalInvocationID.x);
+	if (index >= meshletCount) {
+		return;
+	}
+	Meshlet meshlet = Clusters[meshletOffset + index];
+	vec3 center = (model * vec4(meshlet.Center, 1.0)).xyz;
+	float radius = meshlet.Radius * scale;
+
+	bool visible = true;
+	for (int i = 0; i < 6; i++) {
+		visible = visible && dot(Planes[i].xyz, center) + Planes[i].w >= -radius;
+	}
+	if (visible && coneCulling && meshlet.ConeCutoff > 0.0) {
+		vec3 axis = normalize(mat3(model) * meshlet.ConeAxis);
+		vec3 view = center - ViewPosition.xyz;
+		float distance = length(view);
+		float cosine = dot(view, axis) / max(distance, 1e-6);
+		float sine = sqrt(max(1.0 - cosine * cosine, 0.0));
+		float coneSine = sqrt(max(1.0 - meshlet.ConeCutoff * meshlet.ConeCutoff, 0.0));
+		visible = distance * (cosine * meshlet.ConeCutoff - sine * coneSine) < radius;
+	}
+
+	DrawCommand command = DrawCommand(0u, 0u, 0u, 0, 0u);
+	if (visible) {
+		command = DrawCommand(meshlet.TriangleCount * 3u, 1u, meshlet.TriangleOffset, 0, 0u);
+		atomicAdd(Frames[statisticsSlot].Meshlets, 1u);
+		atomicAdd(Frames[statisticsSlot].Triangles, meshlet.TriangleCount);
+	}
+	Commands[drawOffset + index] = command;
+}
@@ -1,8 +1,16 @@
-#version 460 core
-out vec4 FragColor;
+#version 450 core
+layout (location = 0) out vec4 FragColor;
+#ifdef VELOCITY
+layout (location = 1) out vec2 Velocity;
+in vec4 CurrentClip;
+in vec4 PreviousClip;
+uniform vec2 jitter;
+#endif
 
+// emissive and brighter than white, so the lamps bloom with HDR. an LDR target clamps it to white
 void main() {
-	FragColor = vec4(1.0);
+	FragColor = vec4(vec3(4.0), 1.0);
+#ifdef VELOCITY
+	Velocity = ((CurrentClip.xy / CurrentClip.w - jitter) - PreviousClip.xy / PreviousClip.w) * 0.5;
+#endif
 }
-
-// code modified from https://learnopengl.com/
\ No newline at end of file
@@ -1,12 +1,20 @@
-#version 460 core
+#version 450 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
+
+#ifdef VELOCITY
+uniform mat4 previousMvp;
+out vec4 CurrentClip;
+out vec4 PreviousClip;
+#endif
 
 void main() {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = mvp * vec4(aPos, 1.0f);
+#ifdef VELOCITY
+	CurrentClip = gl_Position;
+	PreviousClip = previousMvp * vec4(aPos, 1.0);
+#endif
 }
 
 // code modified from https://learnopengl.com/
\ No newline at end of file
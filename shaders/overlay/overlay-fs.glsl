@@ -0,0 +1,12 @@
+#version 450 core
+in vec2 TexCoords;
+in vec4 Color;
+
+out vec4 FragColor;
+
+// one channel coverage of the bitmap font
+uniform sampler2D font;
+
+void main() {
+    FragColor = vec4(Color.rgb, Color.a * texture(font, TexCoords).r);
+}
@@ -0,0 +1,61 @@
+#version 450 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// the level above, or the scene for the first level
+uniform sampler2D source;
+uniform float sourceLod;
+// the scene pass weighs each box by its brightness so single bright pixels do not flicker
+uniform int firstPass;
+// the part of the source to read, less than the whole scene with dynamic resolution
+uniform vec2 sourceRegion;
+
+layout(r11f_g11f_b10f, binding = 0) writeonly uniform image2D destination;
+// texels of the destination to fill, from the bottom left
+uniform vec2 destinationSize;
+
+float karisWeight(vec3 color) {
+	return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+// bilinear tap, clamped to the edge of the region like a texture of its size would be
+vec3 tap(vec2 uv, vec2 step) {
+	return textureLod(source, clamp(uv, 0.5 * step, sourceRegion - 0.5 * step), sourceLod).rgb;
+}
+
+// 13 bilinear taps arranged as five overlapping 4x4 boxes (Jimenez, Next Generation Post Processing in Call of Duty)
+void main() {
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = ivec2(destinationSize);
+	if (texel.x >= size.x || texel.y >= size.y) {
+		return;
+	}
+	vec2 uv = (vec2(texel) + 0.5) / vec2(size) * sourceRegion;
+	vec2 step = 1.0 / vec2(textureSize(source, int(sourceLod)));
+
+	vec3 a = tap(uv + step * vec2(-2.0,  2.0), step);
+	vec3 b = tap(uv + step * vec2( 0.0,  2.0), step);
+	vec3 c = tap(uv + step * vec2( 2.0,  2.0), step);
+	vec3 d = tap(uv + step * vec2(-2.0,  0.0), step);
+	vec3 e = tap(uv, step);
+	vec3 f = tap(uv + step * vec2( 2.0,  0.0), step);
+	vec3 g = tap(uv + step * vec2(-2.0, -2.0), step);
+	vec3 h = tap(uv + step * vec2( 0.0, -2.0), step);
+	vec3 i = tap(uv + step * vec2( 2.0, -2.0), step);
+	vec3 j = tap(uv + step * vec2(-1.0,  1.0), step);
+	vec3 k = tap(uv + step * vec2( 1.0,  1.0), step);
+	vec3 l = tap(uv + step * vec2(-1.0, -1.0), step);
+	vec3 m = tap(uv + step * vec2( 1.0, -1.0), step);
+
+	vec3 boxes[5] = vec3[5]((j + k + l + m) * 0.25, (a + b + d + e) * 0.25, (b + c + e + f) * 0.25,
+		(d + e + g + h) * 0.25, (e + f + h + i) * 0.25);
+	float weights[5] = float[5](0.5, 0.125, 0.125, 0.125, 0.125);
+
+	vec3 color = vec3(0.0);
+	float total = 0.0;
+	for (int box = 0; box < 5; box++) {
+		float weight = weights[box] * (firstPass != 0 ? karisWeight(boxes[box]) : 1.0);
+		color += boxes[box] * weight;
+		total += weight;
+	}
+	imageStore(destination, texel, vec4(color / total, 1.0));
+}
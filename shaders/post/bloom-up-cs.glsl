@@ -0,0 +1,35 @@
+#version 450 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// the smaller level below the one being written
+uniform sampler2D source;
+uniform float sourceLod;
+uniform vec2 sourceRegion;      // the part of the smaller level that was filled
+
+layout(r11f_g11f_b10f, binding = 0) uniform image2D destination;
+uniform vec2 destinationSize;
+
+// bilinear tap, clamped to the edge of the filled region
+vec3 tap(vec2 uv, vec2 step) {
+	return textureLod(source, clamp(uv, 0.5 * step, sourceRegion - 0.5 * step), sourceLod).rgb;
+}
+
+// 3x3 tent over the smaller level added onto this one
+void main() {
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = ivec2(destinationSize);
+	if (texel.x >= size.x || texel.y >= size.y) {
+		return;
+	}
+	vec2 uv = (vec2(texel) + 0.5) / vec2(size) * sourceRegion;
+	vec2 step = 1.0 / vec2(textureSize(source, int(sourceLod)));
+
+	vec3 blurred = tap(uv, step) * 4.0;
+	blurred += (tap(uv + step * vec2(-1.0, 0.0), step) + tap(uv + step * vec2(1.0, 0.0), step)
+		+ tap(uv + step * vec2(0.0, -1.0), step) + tap(uv + step * vec2(0.0, 1.0), step)) * 2.0;
+	blurred += tap(uv + step * vec2(-1.0, -1.0), step) + tap(uv + step * vec2(1.0, -1.0), step)
+		+ tap(uv + step * vec2(-1.0, 1.0), step) + tap(uv + step * vec2(1.0, 1.0), step);
+
+	vec3 current = imageLoad(destination, texel).rgb;
+	imageStore(destination, texel, vec4(current + blurred / 16.0, 1.0));
+}
@@ -0,0 +1,51 @@
+#version 450 core
+layout(local_size_x = 256) in;
+
+const uint BINS = 256;
+
+uniform float sampleCount;      // pixels the histogram counted
+uniform float deltaTime;
+uniform float minLogLuminance;
+uniform float logRange;
+uniform float key;
+uniform float minExposure;
+uniform float maxExposure;
+uniform float speed;
+
+layout(std430, binding = 0) buffer Exposure {
+	uint Bins[BINS];
+	float Value;
+	float AverageLuminance;
+};
+
+shared float weighted[BINS];
+
+// one group: a parallel sum of bin * count over the histogram, then thread 0 eases the exposure
+// towards the one that maps the average luminance to the key. the bins are cleared for next frame
+void main() {
+	uint bin = gl_LocalInvocationIndex;
+	uint count = Bins[bin];
+	weighted[bin] = float(count) * float(bin);
+	Bins[bin] = 0u;
+	barrier();
+
+	for (uint stride = BINS / 2u; stride > 0u; stride >>= 1u) {
+		if (bin < stride) {
+			weighted[bin] += weighted[bin + stride];
+		}
+		barrier();
+	}
+
+	if (bin == 0u) {
+		// bin 0 is black and left out of the average
+		float lit = max(sampleCount - float(count), 1.0);
+		float averageLog = (weighted[0] / lit - 1.0) / 254.0 * logRange + minLogLuminance;
+		float luminance = exp2(averageLog);
+		float target = clamp(key / luminance, minExposure, maxExposure);
+
+		// zero until the first frame, which starts at the target
+		float current = Value > 0.0 ? Value : target;
+		Value = current + (target - current) * (1.0 - exp(-deltaTime * speed));
+		AverageLuminance = luminance;
+	}
+}
@@ -0,0 +1,75 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float bloomStrength;
+uniform float bloomScale;     // level 0 holds the sum of every level, this averages them
+uniform vec2 renderSize;      // texels of the scene that were rendered, from the bottom left
+uniform vec2 bloomRegion;     // and the part of the bloom level they cover
+
+layout(std430, binding = 0) readonly buffer Exposure {
+	uint Bins[256];
+	float Value;
+	float AverageLuminance;
+};
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 tonemapAces(vec3 color) {
+	return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+#ifdef DYNAMIC_RESOLUTION
+// Catmull-Rom upscale of the rendered part of the scene. The two middle weights of each axis are
+// folded into one bilinear tap between their texels, and the four corner taps, which carry little
+// weight, are left out and the rest renormalized: 5 taps instead of 16 fetches (Jimenez, Filmic SMAA)
+vec3 sampleScene(vec2 uv) {
+	vec2 texelSize = 1.0 / vec2(textureSize(scene, 0));
+	vec2 position = uv * renderSize;
+	vec2 centre = floor(position - 0.5) + 0.5;
+	vec2 f = position - centre;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+
+	// clamped to the rendered region, whatever lies beyond it is from an older, larger frame
+	vec2 low = vec2(0.5);
+	vec2 high = renderSize - 0.5;
+	vec2 p0 = clamp(centre - 1.0, low, high) * texelSize;
+	vec2 p12 = clamp(centre + w2 / w12, low, high) * texelSize;
+	vec2 p3 = clamp(centre + 2.0, low, high) * texelSize;
+
+	vec3 color = textureLod(scene, vec2(p12.x, p0.y), 0.0).rgb * (w12.x * w0.y)
+		+ textureLod(scene, vec2(p0.x, p12.y), 0.0).rgb * (w0.x * w12.y)
+		+ textureLod(scene, vec2(p12.x, p12.y), 0.0).rgb * (w12.x * w12.y)
+		+ textureLod(scene, vec2(p3.x, p12.y), 0.0).rgb * (w3.x * w12.y)
+		+ textureLod(scene, vec2(p12.x, p3.y), 0.0).rgb * (w12.x * w3.y);
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+	// the negative lobes can ring below zero around bright edges
+	return max(color / weight, vec3(0.0));
+}
+#else
+vec3 sampleScene(vec2 uv) {
+	return texture(scene, uv).rgb;
+}
+#endif
+
+// the only full-screen pass of the post chain: bloom, exposure and tonemapping in one
+void main() {
+	vec3 color = sampleScene(TexCoords);
+#ifdef BLOOM
+	color = mix(color, texture(bloom, TexCoords * bloomRegion).rgb * bloomScale, bloomStrength);
+#endif
+#ifdef EXPOSURE
+	color *= Value;
+#endif
+#ifdef TONEMAP
+	color = tonemapAces(color);
+#endif
+	FragColor = vec4(color, 1.0);
+}
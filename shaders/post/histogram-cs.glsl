@@ -0,0 +1,46 @@
+#version 450 core
+layout(local_size_x = 16, local_size_y = 16) in;
+
+const uint BINS = 256;
+const int STRIDE = 2;   // every other pixel in both directions
+
+uniform sampler2D source;
+uniform vec2 sourceSize;    // the part of the source the scene was rendered into
+uniform float minLogLuminance;
+uniform float inverseLogRange;
+
+layout(std430, binding = 0) buffer Exposure {
+	uint Bins[BINS];
+	float Value;
+	float AverageLuminance;
+};
+
+shared uint groupBins[BINS];
+
+// bin 0 holds black pixels, the rest split the log2 luminance range evenly
+uint luminanceBin(vec3 color) {
+	float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	if (luminance < exp2(minLogLuminance)) {
+		return 0u;
+	}
+	float position = clamp((log2(luminance) - minLogLuminance) * inverseLogRange, 0.0, 1.0);
+	return uint(position * 254.0 + 1.0);
+}
+
+// counts into shared memory first, so the global histogram only sees one add per bin and group
+void main() {
+	groupBins[gl_LocalInvocationIndex] = 0u;
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy) * STRIDE;
+	ivec2 size = ivec2(sourceSize);
+	if (pixel.x < size.x && pixel.y < size.y) {
+		atomicAdd(groupBins[luminanceBin(texelFetch(source, pixel, 0).rgb)], 1u);
+	}
+	barrier();
+
+	uint count = groupBins[gl_LocalInvocationIndex];
+	if (count > 0u) {
+		atomicAdd(Bins[gl_LocalInvocationIndex], count);
+	}
+}
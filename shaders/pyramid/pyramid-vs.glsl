@@ -1,4 +1,4 @@
-#version 460 core
+#version 450 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
@@ -8,15 +8,26 @@ out vec3 Normal;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;   // inverse transpose of the model matrix, built on the CPU
+
+#ifdef VELOCITY
+// where the vertex was last frame, for the velocity buffer
+uniform mat4 previousMvp;
+out vec4 CurrentClip;
+out vec4 PreviousClip;
+#endif
 
 void main() {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
 
-    gl_Position = projection * view * vec4(FragPos, 1.0f);
+    gl_Position = mvp * vec4(aPos, 1.0f);
+#ifdef VELOCITY
+    CurrentClip = gl_Position;
+    PreviousClip = previousMvp * vec4(aPos, 1.0);
+#endif
 }
 
 // code modified from https://learnopengl.com/
\ No newline at end of file
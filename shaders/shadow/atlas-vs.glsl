@@ -0,0 +1,9 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 mvp;
+
+void main() {
+	// straight into the light's tile, the atlas viewport places it
+	gl_Position = mvp * vec4(aPos, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 450 core
+#define SHADOW_CASCADES 4
+
+// one invocation per cascade, each writes the triangle into its own layer of the shadow map array
+layout (triangles, invocations = SHADOW_CASCADES) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+uniform mat4 cascadeMatrices[SHADOW_CASCADES];
+uniform int cascadeMask;    // cascades the object was not culled from, one bit each
+
+void main() {
+	if ((cascadeMask & (1 << gl_InvocationID)) == 0) {
+		return;
+	}
+	for (int i = 0; i < 3; i++) {
+		gl_Layer = gl_InvocationID;
+		gl_Position = cascadeMatrices[gl_InvocationID] * gl_in[i].gl_Position;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
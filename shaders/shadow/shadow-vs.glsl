@@ -0,0 +1,9 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+void main() {
+	// the geometry shader projects into each cascade, so only go to world space here
+	gl_Position = model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,71 @@
+#version 450 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// this frame's jittered scene and its motion, the bottom left renderSize texels are drawn
+uniform sampler2D scene;
+uniform sampler2D velocity;
+uniform sampler2D depth;
+uniform vec2 renderSize;
+
+// last frame's resolve and the part of it that was filled
+uniform sampler2D history;
+uniform vec2 historyRegion;
+uniform int historyValid;
+uniform float feedback;
+
+layout(r11f_g11f_b10f, binding = 0) writeonly uniform image2D destination;
+
+float luminance(vec3 color) {
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// a nearer surface has greater depth with the reversed projection
+bool nearer(float a, float b) {
+#ifdef REVERSED_DEPTH
+	return a > b;
+#else
+	return a < b;
+#endif
+}
+
+// Reprojects the history along the velocity of the nearest surface around the pixel, so edges of
+// moving objects take their motion rather than the background's, clamps it into the range of the
+// pixel and its neighbours to reject what is no longer visible and blends it with this frame
+void main() {
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = ivec2(renderSize);
+	if (texel.x >= size.x || texel.y >= size.y) {
+		return;
+	}
+
+	vec3 current = texelFetch(scene, texel, 0).rgb;
+	vec3 low = current;
+	vec3 high = current;
+	ivec2 closest = texel;
+	float closestDepth = texelFetch(depth, texel, 0).r;
+	// the four direct neighbours, the corners add little to the clamp for almost twice the fetches
+	const ivec2 offsets[4] = ivec2[4](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+	for (int i = 0; i < 4; i++) {
+		ivec2 neighbour = clamp(texel + offsets[i], ivec2(0), size - 1);
+		vec3 color = texelFetch(scene, neighbour, 0).rgb;
+		low = min(low, color);
+		high = max(high, color);
+		float neighbourDepth = texelFetch(depth, neighbour, 0).r;
+		if (nearer(neighbourDepth, closestDepth)) {
+			closestDepth = neighbourDepth;
+			closest = neighbour;
+		}
+	}
+
+	vec2 uv = (vec2(texel) + 0.5) / renderSize;
+	vec2 previous = uv - texelFetch(velocity, closest, 0).rg;
+	vec3 result = current;
+	if (historyValid != 0 && all(greaterThanEqual(previous, vec2(0.0))) && all(lessThanEqual(previous, vec2(1.0)))) {
+		vec3 past = clamp(textureLod(history, previous * historyRegion, 0.0).rgb, low, high);
+		// weighting by inverse luminance keeps single bright samples from dominating the average
+		float currentWeight = (1.0 - feedback) / (1.0 + luminance(current));
+		float pastWeight = feedback / (1.0 + luminance(past));
+		result = (current * currentWeight + past * pastWeight) / (currentWeight + pastWeight);
+	}
+	imageStore(destination, texel, vec4(result, 1.0));
+}
@@ -0,0 +1,2 @@
+// stb_image implementation for the assets library; everything linking it sees only the declarations
+#include "headers/stb_image_imp.h"
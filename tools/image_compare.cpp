@@ -0,0 +1,113 @@
+// Compares a captured frame against a reference image. Two pixels match when no colour channel differs by
+// more than the tolerance; the run fails when too many pixels mismatch or the PSNR drops below the limit.
+// Only RGB is compared, alpha is not part of what ends up on screen.
+//
+//   image_compare <reference> <candidate> [--tolerance N] [--max-mismatch FRACTION] [--min-psnr DB] [--diff OUT.png]
+//
+// exit code 0 = match, 1 = mismatch, 2 = the images could not be compared
+
+#include "../headers/stb_image_imp.h"
+#include "../headers/image_io.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " <reference> <candidate> [--tolerance N] [--max-mismatch FRACTION] [--min-psnr DB] [--diff OUT.png]" << std::endl;
+        std::cout << "compares the RGB channels only, alpha is ignored by the tolerance and the PSNR" << std::endl;
+        return 2;
+    }
+
+    int tolerance = 2;
+    double maxMismatch = 0.0;
+    double minPsnr = 0.0;
+    std::string diffPath;
+    for (int i = 3; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--tolerance" && hasValue) {
+            tolerance = std::atoi(argv[++i]);
+        }
+        else if (argument == "--max-mismatch" && hasValue) {
+            maxMismatch = std::atof(argv[++i]);
+        }
+        else if (argument == "--min-psnr" && hasValue) {
+            minPsnr = std::atof(argv[++i]);
+        }
+        else if (argument == "--diff" && hasValue) {
+            diffPath = argv[++i];
+        }
+        else {
+            std::cout << "unknown option " << argument << std::endl;
+            return 2;
+        }
+    }
+
+    Image reference, candidate;
+    if (!loadImage(argv[1], reference) || !loadImage(argv[2], candidate)) {
+        return 2;
+    }
+    if (reference.Width != candidate.Width || reference.Height != candidate.Height) {
+        std::cout << "size mismatch: " << reference.Width << "x" << reference.Height
+            << " vs " << candidate.Width << "x" << candidate.Height << std::endl;
+        return 2;
+    }
+    if (reference.Width == 0 || reference.Height == 0) {
+        std::cout << "empty images: " << reference.Width << "x" << reference.Height << ", nothing to compare" << std::endl;
+        return 2;
+    }
+
+    // mismatching pixels are painted red over a dimmed copy of the reference
+    Image diff;
+    diff.Width = reference.Width;
+    diff.Height = reference.Height;
+    diff.Pixels.resize(reference.Pixels.size());
+
+    size_t pixelCount = (size_t)reference.Width * reference.Height;
+    size_t mismatched = 0;
+    int maxDifference = 0;
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        const unsigned char* a = &reference.Pixels[i * 4];
+        const unsigned char* b = &candidate.Pixels[i * 4];
+        int pixelDifference = 0;
+        for (int c = 0; c < 3; c++) {
+            int difference = std::abs((int)a[c] - (int)b[c]);
+            pixelDifference = difference > pixelDifference ? difference : pixelDifference;
+            squaredError += (double)difference * difference;
+        }
+        maxDifference = pixelDifference > maxDifference ? pixelDifference : maxDifference;
+
+        unsigned char* out = &diff.Pixels[i * 4];
+        if (pixelDifference > tolerance) {
+            mismatched++;
+            out[0] = 255;
+            out[1] = 0;
+            out[2] = 0;
+        }
+        else {
+            unsigned char gray = (unsigned char)((a[0] + a[1] + a[2]) / 12);
+            out[0] = out[1] = out[2] = gray;
+        }
+        out[3] = 255;
+    }
+
+    double meanSquaredError = squaredError / (pixelCount * 3.0);
+    double psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+    double mismatchFraction = (double)mismatched / pixelCount;
+
+    std::cout << reference.Width << "x" << reference.Height << ": max difference " << maxDifference
+        << ", " << mismatched << " pixels above tolerance " << tolerance << " (" << mismatchFraction * 100.0 << "%)"
+        << ", psnr " << psnr << " dB" << std::endl;
+
+    if (!diffPath.empty()) {
+        writePng(diffPath, diff);
+    }
+
+    bool passed = mismatchFraction <= maxMismatch && psnr >= minPsnr;
+    std::cout << (passed ? "PASS" : "FAIL") << std::endl;
+    return passed ? 0 : 1;
+}
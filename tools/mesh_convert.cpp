@@ -0,0 +1,59 @@
+// Converts a model to the engine's mesh file, which the engine loads without parsing. The input is
+// imported and optimized like --model does at runtime, simplified into a chain of levels of detail,
+// each level split into meshlets for cluster culling, and written out with mesh_format.h.
+//
+//   mesh_convert <input.obj|gltf|glb> <output.mesh>
+//
+// exit code 0 = written, 2 = the input could not be read or the output not written
+
+#include "../headers/mesh_import.h"
+#include "../headers/mesh_format.h"
+#include "../headers/mesh_meshlets.h"
+#include "../headers/mesh_simplify.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cout << "usage: " << argv[0] << " <input.obj|gltf|glb> <output.mesh>" << std::endl;
+        return 2;
+    }
+    std::string input = argv[1];
+    std::string output = argv[2];
+
+    auto start = std::chrono::steady_clock::now();
+    MeshData mesh;
+    if (!importMesh(input, mesh)) {
+        return 2;
+    }
+    auto imported = std::chrono::steady_clock::now();
+    buildMeshLods(mesh);
+    auto simplified = std::chrono::steady_clock::now();
+    buildMeshlets(mesh);
+    auto clustered = std::chrono::steady_clock::now();
+    if (!writeMeshFile(output, mesh)) {
+        return 2;
+    }
+    auto written = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> fullDetail(mesh.Indices.begin(), mesh.Indices.begin() + fullDetailIndexCount(mesh));
+    std::cout << output << ": " << mesh.Vertices.size() << " vertices, " << fullDetail.size() / 3 << " triangles, ACMR "
+        << averageCacheMissRatio(fullDetail, mesh.Vertices.size()) << ", import "
+        << std::chrono::duration<double, std::milli>(imported - start).count() << " ms, simplify "
+        << std::chrono::duration<double, std::milli>(simplified - imported).count() << " ms, meshlets "
+        << std::chrono::duration<double, std::milli>(clustered - simplified).count() << " ms, write "
+        << std::chrono::duration<double, std::milli>(written - clustered).count() << " ms" << std::endl;
+    for (size_t i = 0; i < mesh.Lods.size(); i++) {
+        const MeshLod& level = mesh.Lods[i];
+        uint32_t culling = 0;
+        for (uint32_t m = level.MeshletOffset; m < level.MeshletOffset + level.MeshletCount; m++) {
+            culling += mesh.Meshlets[m].ConeCutoff > 0.0f;
+        }
+        std::cout << "  lod " << i << ": " << level.IndexCount / 3 << " triangles, error " << level.Error << ", " << level.MeshletCount
+            << " meshlets, " << culling << " with a normal cone" << std::endl;
+    }
+    return 0;
+}